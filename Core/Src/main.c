@@ -23,6 +23,9 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "usbd_msc.h"
+#include "usbd_storage_qspi.h"
+#include "usbd_storage_uf2.h"
 
 /* USER CODE END Includes */
 
@@ -44,6 +47,7 @@
 /* Private variables ---------------------------------------------------------*/
 
 /* USER CODE BEGIN PV */
+extern USBD_HandleTypeDef hUsbDeviceFS;
 
 /* USER CODE END PV */
 
@@ -66,6 +70,8 @@ void SystemClock_Config(void);
 int main(void)
 {
     /* USER CODE BEGIN 1 */
+    /* Jump to a valid image at STORAGE_UF2_APP_ADDR, before anything is set up */
+    STORAGE_UF2_Boot();
 
     /* USER CODE END 1 */
 
@@ -89,6 +95,7 @@ int main(void)
     MX_GPIO_Init();
     MX_USB_Device_Init();
     /* USER CODE BEGIN 2 */
+    uint32_t hello_tick = HAL_GetTick();
 
     /* USER CODE END 2 */
 
@@ -98,10 +105,28 @@ int main(void)
         /* USER CODE END WHILE */
 
         /* USER CODE BEGIN 3 */
-        char data[] = "Hello World\n";
-        CDC_Transmit_FS((uint8_t *)data, strlen(data));
-
-        HAL_Delay(1000);
+        /* MSC media requests complete here, so the loop must not block */
+        USBD_MSC_Process(&hUsbDeviceFS);
+        STORAGE_QSPI_Process();
+        STORAGE_UF2_Process();
+
+        if (HAL_GetTick() - hello_tick >= 1000) {
+            char data[] = "Hello World\n";
+            hello_tick += 1000;
+            CDC_Transmit_FS((uint8_t *)data, strlen(data));
+        }
+
+        /* Echo the host on every port, reading only what the transmit ring can take */
+        for (uint8_t port = 0; port < USBD_CDC_PORT_NBR; port++) {
+            if (CDC_TxFree_FS(port) >= CDC_DATA_FS_MAX_PACKET_SIZE) {
+                uint8_t echo[CDC_DATA_FS_MAX_PACKET_SIZE];
+                uint16_t n = CDC_Read_FS(port, echo, sizeof(echo));
+
+                if (n != 0U) {
+                    CDC_TransmitPort_FS(port, echo, n);
+                }
+            }
+        }
     }
     /* USER CODE END 3 */
 }
@@ -45,6 +45,25 @@ extern "C" {
 #define CDC_OUT_EP                                  0x02U  /* EP1 for data OUT */
 #define CDC_CMD_EP                                  0x83U  /* EP2 for CDC commands */
 
+#ifndef USBD_CDC_PORT_NBR
+#define USBD_CDC_PORT_NBR                           1U
+#endif /* USBD_CDC_PORT_NBR */
+
+/* Port n takes the next two endpoint numbers: data on 2 + 2n, commands on 3 + 2n */
+#define CDC_IN_EP_PORT(n)                           (CDC_IN_EP + (2U * (n)))
+#define CDC_OUT_EP_PORT(n)                          (CDC_OUT_EP + (2U * (n)))
+#define CDC_CMD_EP_PORT(n)                          (CDC_CMD_EP + (2U * (n)))
+#define CDC_EP_PORT(epnum)                          ((((epnum) & 0x7FU) - (CDC_OUT_EP & 0x7FU)) / 2U)
+
+#if (USBD_CDC_PORT_NBR == 0U)
+#error "USBD_CDC_PORT_NBR: at least one CDC port is needed"
+#endif
+
+/* The FS device has 8 endpoint numbers, EP0 and the MSC take the first two */
+#if (((CDC_CMD_EP & 0x7FU) + (2U * (USBD_CDC_PORT_NBR - 1U))) > 7U)
+#error "USBD_CDC_PORT_NBR: not enough endpoint numbers for the CDC ports"
+#endif
+
 #ifndef CDC_HS_BINTERVAL
 #define CDC_HS_BINTERVAL                            0x10U
 #endif /* CDC_HS_BINTERVAL */
@@ -101,11 +120,12 @@ typedef struct
 
 typedef struct _USBD_CDC_Itf
 {
-  int8_t (* Init)(void);
-  int8_t (* DeInit)(void);
-  int8_t (* Control)(uint8_t cmd, uint8_t *pbuf, uint16_t length);
-  int8_t (* Receive)(uint8_t *Buf, uint32_t *Len);
-  int8_t (* TransmitCplt)(uint8_t *Buf, uint32_t *Len, uint8_t epnum);
+  int8_t (* Init)(uint8_t port);
+  int8_t (* DeInit)(uint8_t port);
+  int8_t (* Control)(uint8_t port, uint8_t cmd, uint8_t *pbuf, uint16_t length);
+  int8_t (* Receive)(uint8_t port, uint8_t *Buf, uint32_t *Len);
+  int8_t (* TransmitCplt)(uint8_t port, uint8_t *Buf, uint32_t *Len, uint8_t epnum);
+  int8_t (* SOF)(uint8_t port);       /* optional, start of each frame */
 } USBD_CDC_ItfTypeDef;
 
 
@@ -149,20 +169,23 @@ extern USBD_ClassTypeDef USBD_CDC;
 uint8_t USBD_CDC_RegisterInterface(USBD_HandleTypeDef *pdev,
                                    USBD_CDC_ItfTypeDef *fops);
 
-uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff,
-                             uint32_t length);
+uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef *pdev, uint8_t port,
+                             uint8_t *pbuff, uint32_t length);
 
-uint8_t USBD_CDC_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff);
-uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev);
-uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev);
+uint8_t USBD_CDC_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t port, uint8_t *pbuff);
+uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev, uint8_t port);
+uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev, uint8_t port);
 
 
 uint8_t USBD_CDC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
 uint8_t USBD_CDC_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
 uint8_t USBD_CDC_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+uint8_t USBD_CDC_SetupPort(USBD_HandleTypeDef *pdev, uint8_t port,
+                           USBD_SetupReqTypedef *req);
 uint8_t USBD_CDC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum);
 uint8_t USBD_CDC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum);
 uint8_t USBD_CDC_EP0_RxReady(USBD_HandleTypeDef *pdev);
+uint8_t USBD_CDC_SOF(USBD_HandleTypeDef *pdev);
 
 uint8_t *USBD_CDC_GetFSCfgDesc(uint16_t *length);
 uint8_t *USBD_CDC_GetHSCfgDesc(uint16_t *length);
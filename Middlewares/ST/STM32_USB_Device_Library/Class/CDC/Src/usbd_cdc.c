@@ -26,6 +26,8 @@
   *             - Abstract Control Model compliant
   *             - Union Functional collection (using 1 IN endpoint for control)
   *             - Data interface class
+  *             - USBD_CDC_PORT_NBR ports, each with its own handle, endpoints and
+  *               interface pair; the interface callbacks get the port number
   *
   *           These aspects may be enriched or modified for a specific user application.
   *
@@ -89,7 +91,12 @@ EndBSPDependencies */
 /** @defgroup USBD_CDC_Private_Macros
   * @{
   */
+#if ((USBD_CDC_CLASS_ID + USBD_CDC_PORT_NBR) > USBD_CLASS_DATA_CAPACITY)
+#error "USBD_CLASS_DATA_CAPACITY: no class data slot left for each CDC port"
+#endif
 
+#define CDC_HANDLE(pdev, port)  ((USBD_CDC_HandleTypeDef *)(pdev)->pClassDatas[USBD_CDC_CLASS_ID + (port)])
+#define CDC_ITF(pdev)           ((USBD_CDC_ItfTypeDef *)(pdev)->pUserDatas[USBD_CDC_USERDATA_ID])
 /**
   * @}
   */
@@ -133,7 +140,7 @@ USBD_ClassTypeDef  USBD_CDC =
   USBD_CDC_EP0_RxReady,
   USBD_CDC_DataIn,
   USBD_CDC_DataOut,
-  NULL,
+  USBD_CDC_SOF,
   NULL,
   NULL,
   USBD_CDC_GetHSCfgDesc,
@@ -445,89 +452,134 @@ __ALIGN_BEGIN static uint8_t USBD_CDC_OtherSpeedCfgDesc[USB_CDC_CONFIG_DESC_SIZ]
   */
 
 /**
-  * @brief  USBD_CDC_Init
-  *         Initialize the CDC interface
+  * @brief  USBD_CDC_GetPort
+  *         Find the port of a data or command endpoint
+  * @param  epnum: endpoint number
+  * @retval port number, USBD_CDC_PORT_NBR if no port owns the endpoint
+  */
+static uint8_t USBD_CDC_GetPort(uint8_t epnum)
+{
+  epnum &= 0x7FU;
+
+  if ((epnum < (CDC_OUT_EP & 0x7FU)) || (epnum > (CDC_CMD_EP_PORT(USBD_CDC_PORT_NBR - 1U) & 0x7FU)))
+  {
+    return (uint8_t)USBD_CDC_PORT_NBR;
+  }
+
+  return (uint8_t)CDC_EP_PORT(epnum);
+}
+
+/**
+  * @brief  USBD_CDC_InitPort
+  *         Open the endpoints of a port and initialize its interface
   * @param  pdev: device instance
-  * @param  cfgidx: Configuration index
+  * @param  port: CDC port
   * @retval status
   */
-uint8_t USBD_CDC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+static uint8_t USBD_CDC_InitPort(USBD_HandleTypeDef *pdev, uint8_t port)
 {
-  UNUSED(cfgidx);
   USBD_CDC_HandleTypeDef *hcdc;
+  uint8_t in_ep = CDC_IN_EP_PORT(port);
+  uint8_t out_ep = CDC_OUT_EP_PORT(port);
+  uint8_t cmd_ep = CDC_CMD_EP_PORT(port);
 
   hcdc = USBD_malloc(sizeof(USBD_CDC_HandleTypeDef));
 
   if (hcdc == NULL)
   {
-    pdev->pClassDatas[USBD_CDC_CLASS_ID] = NULL;
+    pdev->pClassDatas[USBD_CDC_CLASS_ID + port] = NULL;
     return (uint8_t)USBD_EMEM;
   }
 
-  pdev->pClassDatas[USBD_CDC_CLASS_ID] = (void *)hcdc;
+  pdev->pClassDatas[USBD_CDC_CLASS_ID + port] = (void *)hcdc;
 
   if (pdev->dev_speed == USBD_SPEED_HIGH)
   {
     /* Open EP IN */
-    (void)USBD_LL_OpenEP(pdev, CDC_IN_EP, USBD_EP_TYPE_BULK,
+    (void)USBD_LL_OpenEP(pdev, in_ep, USBD_EP_TYPE_BULK,
                          CDC_DATA_HS_IN_PACKET_SIZE);
 
-    pdev->ep_in[CDC_IN_EP & 0xFU].is_used = 1U;
+    pdev->ep_in[in_ep & 0xFU].is_used = 1U;
 
     /* Open EP OUT */
-    (void)USBD_LL_OpenEP(pdev, CDC_OUT_EP, USBD_EP_TYPE_BULK,
+    (void)USBD_LL_OpenEP(pdev, out_ep, USBD_EP_TYPE_BULK,
                          CDC_DATA_HS_OUT_PACKET_SIZE);
 
-    pdev->ep_out[CDC_OUT_EP & 0xFU].is_used = 1U;
+    pdev->ep_out[out_ep & 0xFU].is_used = 1U;
 
     /* Set bInterval for CDC CMD Endpoint */
-    pdev->ep_in[CDC_CMD_EP & 0xFU].bInterval = CDC_HS_BINTERVAL;
+    pdev->ep_in[cmd_ep & 0xFU].bInterval = CDC_HS_BINTERVAL;
   }
   else
   {
     /* Open EP IN */
-    (void)USBD_LL_OpenEP(pdev, CDC_IN_EP, USBD_EP_TYPE_BULK,
+    (void)USBD_LL_OpenEP(pdev, in_ep, USBD_EP_TYPE_BULK,
                          CDC_DATA_FS_IN_PACKET_SIZE);
 
-    pdev->ep_in[CDC_IN_EP & 0xFU].is_used = 1U;
+    pdev->ep_in[in_ep & 0xFU].is_used = 1U;
 
     /* Open EP OUT */
-    (void)USBD_LL_OpenEP(pdev, CDC_OUT_EP, USBD_EP_TYPE_BULK,
+    (void)USBD_LL_OpenEP(pdev, out_ep, USBD_EP_TYPE_BULK,
                          CDC_DATA_FS_OUT_PACKET_SIZE);
 
-    pdev->ep_out[CDC_OUT_EP & 0xFU].is_used = 1U;
+    pdev->ep_out[out_ep & 0xFU].is_used = 1U;
 
     /* Set bInterval for CMD Endpoint */
-    pdev->ep_in[CDC_CMD_EP & 0xFU].bInterval = CDC_FS_BINTERVAL;
+    pdev->ep_in[cmd_ep & 0xFU].bInterval = CDC_FS_BINTERVAL;
   }
 
   /* Open Command IN EP */
-  (void)USBD_LL_OpenEP(pdev, CDC_CMD_EP, USBD_EP_TYPE_INTR, CDC_CMD_PACKET_SIZE);
-  pdev->ep_in[CDC_CMD_EP & 0xFU].is_used = 1U;
-
-  /* Init  physical Interface components */
-  ((USBD_CDC_ItfTypeDef *)pdev->pUserDatas[USBD_CDC_USERDATA_ID])->Init();
+  (void)USBD_LL_OpenEP(pdev, cmd_ep, USBD_EP_TYPE_INTR, CDC_CMD_PACKET_SIZE);
+  pdev->ep_in[cmd_ep & 0xFU].is_used = 1U;
 
-  /* Init Xfer states */
+  /* Init Xfer states, the interface may start a transfer from its Init */
   hcdc->TxState = 0U;
   hcdc->RxState = 0U;
+  hcdc->CmdOpCode = 0xFFU;
+
+  /* Init  physical Interface components */
+  CDC_ITF(pdev)->Init(port);
 
   if (pdev->dev_speed == USBD_SPEED_HIGH)
   {
     /* Prepare Out endpoint to receive next packet */
-    (void)USBD_LL_PrepareReceive(pdev, CDC_OUT_EP, hcdc->RxBuffer,
+    (void)USBD_LL_PrepareReceive(pdev, out_ep, hcdc->RxBuffer,
                                  CDC_DATA_HS_OUT_PACKET_SIZE);
   }
   else
   {
     /* Prepare Out endpoint to receive next packet */
-    (void)USBD_LL_PrepareReceive(pdev, CDC_OUT_EP, hcdc->RxBuffer,
+    (void)USBD_LL_PrepareReceive(pdev, out_ep, hcdc->RxBuffer,
                                  CDC_DATA_FS_OUT_PACKET_SIZE);
   }
 
   return (uint8_t)USBD_OK;
 }
 
+/**
+  * @brief  USBD_CDC_Init
+  *         Initialize the CDC interface
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+uint8_t USBD_CDC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  UNUSED(cfgidx);
+  uint8_t ret = (uint8_t)USBD_OK;
+  uint8_t port;
+
+  for (port = 0U; port < USBD_CDC_PORT_NBR; port++)
+  {
+    if (USBD_CDC_InitPort(pdev, port) != (uint8_t)USBD_OK)
+    {
+      ret = (uint8_t)USBD_EMEM;
+    }
+  }
+
+  return ret;
+}
+
 /**
   * @brief  USBD_CDC_Init
   *         DeInitialize the CDC layer
@@ -538,26 +590,33 @@ uint8_t USBD_CDC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 uint8_t USBD_CDC_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 {
   UNUSED(cfgidx);
+  uint8_t port;
+  uint8_t cmd_ep;
+
+  for (port = 0U; port < USBD_CDC_PORT_NBR; port++)
+  {
+    cmd_ep = CDC_CMD_EP_PORT(port);
 
-  /* Close EP IN */
-  (void)USBD_LL_CloseEP(pdev, CDC_IN_EP);
-  pdev->ep_in[CDC_IN_EP & 0xFU].is_used = 0U;
+    /* Close EP IN */
+    (void)USBD_LL_CloseEP(pdev, CDC_IN_EP_PORT(port));
+    pdev->ep_in[CDC_IN_EP_PORT(port) & 0xFU].is_used = 0U;
 
-  /* Close EP OUT */
-  (void)USBD_LL_CloseEP(pdev, CDC_OUT_EP);
-  pdev->ep_out[CDC_OUT_EP & 0xFU].is_used = 0U;
+    /* Close EP OUT */
+    (void)USBD_LL_CloseEP(pdev, CDC_OUT_EP_PORT(port));
+    pdev->ep_out[CDC_OUT_EP_PORT(port) & 0xFU].is_used = 0U;
 
-  /* Close Command IN EP */
-  (void)USBD_LL_CloseEP(pdev, CDC_CMD_EP);
-  pdev->ep_in[CDC_CMD_EP & 0xFU].is_used = 0U;
-  pdev->ep_in[CDC_CMD_EP & 0xFU].bInterval = 0U;
+    /* Close Command IN EP */
+    (void)USBD_LL_CloseEP(pdev, cmd_ep);
+    pdev->ep_in[cmd_ep & 0xFU].is_used = 0U;
+    pdev->ep_in[cmd_ep & 0xFU].bInterval = 0U;
 
-  /* DeInit  physical Interface components */
-  if (pdev->pClassDatas[USBD_CDC_CLASS_ID] != NULL)
-  {
-    ((USBD_CDC_ItfTypeDef *)pdev->pUserDatas[USBD_CDC_USERDATA_ID])->DeInit();
-    (void)USBD_free(pdev->pClassDatas[USBD_CDC_CLASS_ID]);
-    pdev->pClassDatas[USBD_CDC_CLASS_ID] = NULL;
+    /* DeInit  physical Interface components */
+    if (CDC_HANDLE(pdev, port) != NULL)
+    {
+      CDC_ITF(pdev)->DeInit(port);
+      (void)USBD_free(pdev->pClassDatas[USBD_CDC_CLASS_ID + port]);
+      pdev->pClassDatas[USBD_CDC_CLASS_ID + port] = NULL;
+    }
   }
 
   return (uint8_t)USBD_OK;
@@ -565,7 +624,7 @@ uint8_t USBD_CDC_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 
 /**
   * @brief  USBD_CDC_Setup
-  *         Handle the CDC specific requests
+  *         Handle the CDC specific requests of the first port
   * @param  pdev: instance
   * @param  req: usb requests
   * @retval status
@@ -573,12 +632,33 @@ uint8_t USBD_CDC_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 uint8_t USBD_CDC_Setup(USBD_HandleTypeDef *pdev,
                               USBD_SetupReqTypedef *req)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDatas[USBD_CDC_CLASS_ID];
+  return USBD_CDC_SetupPort(pdev, 0U, req);
+}
+
+/**
+  * @brief  USBD_CDC_SetupPort
+  *         Handle the CDC specific requests of a port
+  * @param  pdev: instance
+  * @param  port: CDC port addressed by the request
+  * @param  req: usb requests
+  * @retval status
+  */
+uint8_t USBD_CDC_SetupPort(USBD_HandleTypeDef *pdev, uint8_t port,
+                           USBD_SetupReqTypedef *req)
+{
+  USBD_CDC_HandleTypeDef *hcdc;
   uint16_t len;
   uint8_t ifalt = 0U;
   uint16_t status_info = 0U;
   USBD_StatusTypeDef ret = USBD_OK;
 
+  if (port >= USBD_CDC_PORT_NBR)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  hcdc = CDC_HANDLE(pdev, port);
+
   if (hcdc == NULL)
   {
     return (uint8_t)USBD_FAIL;
@@ -591,9 +671,9 @@ uint8_t USBD_CDC_Setup(USBD_HandleTypeDef *pdev,
       {
         if ((req->bmRequest & 0x80U) != 0U)
         {
-          ((USBD_CDC_ItfTypeDef *)pdev->pUserDatas[USBD_CDC_USERDATA_ID])->Control(req->bRequest,
-                                                            (uint8_t *)hcdc->data,
-                                                            req->wLength);
+          CDC_ITF(pdev)->Control(port, req->bRequest,
+                                 (uint8_t *)hcdc->data,
+                                 req->wLength);
 
           len = MIN(CDC_REQ_MAX_DATA_SIZE, req->wLength);
           (void)USBD_CtlSendData(pdev, (uint8_t *)hcdc->data, len);
@@ -608,8 +688,8 @@ uint8_t USBD_CDC_Setup(USBD_HandleTypeDef *pdev,
       }
       else
       {
-        ((USBD_CDC_ItfTypeDef *)pdev->pUserDatas[USBD_CDC_USERDATA_ID])->Control(req->bRequest,
-                                                          (uint8_t *)req, 0U);
+        CDC_ITF(pdev)->Control(port, req->bRequest,
+                               (uint8_t *)req, 0U);
       }
       break;
 
@@ -677,31 +757,57 @@ uint8_t USBD_CDC_Setup(USBD_HandleTypeDef *pdev,
 uint8_t USBD_CDC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
   USBD_CDC_HandleTypeDef *hcdc;
+  USBD_CDC_ItfTypeDef *itf = CDC_ITF(pdev);
   PCD_HandleTypeDef *hpcd = pdev->pData;
+  uint8_t port = USBD_CDC_GetPort(epnum);
 
-  if (pdev->pClassDatas[USBD_CDC_CLASS_ID] == NULL)
+  if (port >= USBD_CDC_PORT_NBR)
   {
     return (uint8_t)USBD_FAIL;
   }
 
-  hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDatas[USBD_CDC_CLASS_ID];
+  /* Nothing is sent on the command endpoint */
+  if ((epnum & 0x7FU) != (CDC_IN_EP_PORT(port) & 0x7FU))
+  {
+    return (uint8_t)USBD_OK;
+  }
+
+  hcdc = CDC_HANDLE(pdev, port);
+
+  if (hcdc == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
 
   if ((pdev->ep_in[epnum].total_length > 0U) &&
       ((pdev->ep_in[epnum].total_length % hpcd->IN_ep[epnum].maxpacket) == 0U))
   {
     /* Update the packet total length */
     pdev->ep_in[epnum].total_length = 0U;
+    hcdc->TxState = 0U;
+
+    /* The interface may chain the next transfer at once: the data goes on
+       and ends the host transfer, a ZLP is only needed if nothing follows */
+    if (itf->TransmitCplt != NULL)
+    {
+      itf->TransmitCplt(port, hcdc->TxBuffer, &hcdc->TxLength, epnum);
+    }
 
-    /* Send ZLP */
-    (void)USBD_LL_Transmit(pdev, epnum, NULL, 0U);
+    if (hcdc->TxState == 0U)
+    {
+      /* Send ZLP, its completion is reported with a zero length */
+      hcdc->TxState = 1U;
+      hcdc->TxLength = 0U;
+      (void)USBD_LL_Transmit(pdev, epnum, NULL, 0U);
+    }
   }
   else
   {
     hcdc->TxState = 0U;
 
-    if (((USBD_CDC_ItfTypeDef *)pdev->pUserDatas[USBD_CDC_USERDATA_ID])->TransmitCplt != NULL)
+    if (itf->TransmitCplt != NULL)
     {
-      ((USBD_CDC_ItfTypeDef *)pdev->pUserDatas[USBD_CDC_USERDATA_ID])->TransmitCplt(hcdc->TxBuffer, &hcdc->TxLength, epnum);
+      itf->TransmitCplt(port, hcdc->TxBuffer, &hcdc->TxLength, epnum);
     }
   }
 
@@ -717,9 +823,17 @@ uint8_t USBD_CDC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
   */
 uint8_t USBD_CDC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDatas[USBD_CDC_CLASS_ID];
+  USBD_CDC_HandleTypeDef *hcdc;
+  uint8_t port = USBD_CDC_GetPort(epnum);
+
+  if (port >= USBD_CDC_PORT_NBR)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  hcdc = CDC_HANDLE(pdev, port);
 
-  if (pdev->pClassDatas[USBD_CDC_CLASS_ID] == NULL)
+  if (hcdc == NULL)
   {
     return (uint8_t)USBD_FAIL;
   }
@@ -730,7 +844,7 @@ uint8_t USBD_CDC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
   /* USB data will be immediately processed, this allow next USB traffic being
   NAKed till the end of the application Xfer */
 
-  ((USBD_CDC_ItfTypeDef *)pdev->pUserDatas[USBD_CDC_USERDATA_ID])->Receive(hcdc->RxBuffer, &hcdc->RxLength);
+  CDC_ITF(pdev)->Receive(port, hcdc->RxBuffer, &hcdc->RxLength);
 
   return (uint8_t)USBD_OK;
 }
@@ -743,19 +857,53 @@ uint8_t USBD_CDC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
   */
 uint8_t USBD_CDC_EP0_RxReady(USBD_HandleTypeDef *pdev)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDatas[USBD_CDC_CLASS_ID];
+  USBD_CDC_HandleTypeDef *hcdc;
+  uint8_t port;
 
-  if (hcdc == NULL)
+  if (CDC_ITF(pdev) == NULL)
   {
     return (uint8_t)USBD_FAIL;
   }
 
-  if ((pdev->pUserDatas[USBD_CDC_USERDATA_ID] != NULL) && (hcdc->CmdOpCode != 0xFFU))
+  /* The data stage belongs to the port whose request is pending */
+  for (port = 0U; port < USBD_CDC_PORT_NBR; port++)
   {
-    ((USBD_CDC_ItfTypeDef *)pdev->pUserDatas[USBD_CDC_USERDATA_ID])->Control(hcdc->CmdOpCode,
-                                                      (uint8_t *)hcdc->data,
-                                                      (uint16_t)hcdc->CmdLength);
-    hcdc->CmdOpCode = 0xFFU;
+    hcdc = CDC_HANDLE(pdev, port);
+
+    if ((hcdc != NULL) && (hcdc->CmdOpCode != 0xFFU))
+    {
+      CDC_ITF(pdev)->Control(port, hcdc->CmdOpCode,
+                             (uint8_t *)hcdc->data,
+                             (uint16_t)hcdc->CmdLength);
+      hcdc->CmdOpCode = 0xFFU;
+    }
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_SOF
+  *         Handle SOF event, passed to the interface for its timeouts
+  * @param  pdev: device instance
+  * @retval status
+  */
+uint8_t USBD_CDC_SOF(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_ItfTypeDef *itf = CDC_ITF(pdev);
+  uint8_t port;
+
+  if ((itf == NULL) || (itf->SOF == NULL))
+  {
+    return (uint8_t)USBD_OK;
+  }
+
+  for (port = 0U; port < USBD_CDC_PORT_NBR; port++)
+  {
+    if (CDC_HANDLE(pdev, port) != NULL)
+    {
+      (void)itf->SOF(port);
+    }
   }
 
   return (uint8_t)USBD_OK;
@@ -838,13 +986,21 @@ uint8_t USBD_CDC_RegisterInterface(USBD_HandleTypeDef *pdev,
 /**
   * @brief  USBD_CDC_SetTxBuffer
   * @param  pdev: device instance
+  * @param  port: CDC port
   * @param  pbuff: Tx Buffer
   * @retval status
   */
-uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef *pdev,
+uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef *pdev, uint8_t port,
                              uint8_t *pbuff, uint32_t length)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDatas[USBD_CDC_CLASS_ID];
+  USBD_CDC_HandleTypeDef *hcdc;
+
+  if (port >= USBD_CDC_PORT_NBR)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  hcdc = CDC_HANDLE(pdev, port);
 
   if (hcdc == NULL)
   {
@@ -860,12 +1016,20 @@ uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef *pdev,
 /**
   * @brief  USBD_CDC_SetRxBuffer
   * @param  pdev: device instance
+  * @param  port: CDC port
   * @param  pbuff: Rx Buffer
   * @retval status
   */
-uint8_t USBD_CDC_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff)
+uint8_t USBD_CDC_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t port, uint8_t *pbuff)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDatas[USBD_CDC_CLASS_ID];
+  USBD_CDC_HandleTypeDef *hcdc;
+
+  if (port >= USBD_CDC_PORT_NBR)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  hcdc = CDC_HANDLE(pdev, port);
 
   if (hcdc == NULL)
   {
@@ -881,14 +1045,22 @@ uint8_t USBD_CDC_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff)
   * @brief  USBD_CDC_TransmitPacket
   *         Transmit packet on IN endpoint
   * @param  pdev: device instance
+  * @param  port: CDC port
   * @retval status
   */
-uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev)
+uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev, uint8_t port)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDatas[USBD_CDC_CLASS_ID];
+  USBD_CDC_HandleTypeDef *hcdc;
   USBD_StatusTypeDef ret = USBD_BUSY;
 
-  if (pdev->pClassDatas[USBD_CDC_CLASS_ID] == NULL)
+  if (port >= USBD_CDC_PORT_NBR)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  hcdc = CDC_HANDLE(pdev, port);
+
+  if (hcdc == NULL)
   {
     return (uint8_t)USBD_FAIL;
   }
@@ -899,10 +1071,10 @@ uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev)
     hcdc->TxState = 1U;
 
     /* Update the packet total length */
-    pdev->ep_in[CDC_IN_EP & 0xFU].total_length = hcdc->TxLength;
+    pdev->ep_in[CDC_IN_EP_PORT(port) & 0xFU].total_length = hcdc->TxLength;
 
     /* Transmit next packet */
-    (void)USBD_LL_Transmit(pdev, CDC_IN_EP, hcdc->TxBuffer, hcdc->TxLength);
+    (void)USBD_LL_Transmit(pdev, CDC_IN_EP_PORT(port), hcdc->TxBuffer, hcdc->TxLength);
 
     ret = USBD_OK;
   }
@@ -914,13 +1086,21 @@ uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev)
   * @brief  USBD_CDC_ReceivePacket
   *         prepare OUT Endpoint for reception
   * @param  pdev: device instance
+  * @param  port: CDC port
   * @retval status
   */
-uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev)
+uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev, uint8_t port)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDatas[USBD_CDC_CLASS_ID];
+  USBD_CDC_HandleTypeDef *hcdc;
 
-  if (pdev->pClassDatas[USBD_CDC_CLASS_ID] == NULL)
+  if (port >= USBD_CDC_PORT_NBR)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  hcdc = CDC_HANDLE(pdev, port);
+
+  if (hcdc == NULL)
   {
     return (uint8_t)USBD_FAIL;
   }
@@ -928,13 +1108,13 @@ uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev)
   if (pdev->dev_speed == USBD_SPEED_HIGH)
   {
     /* Prepare Out endpoint to receive next packet */
-    (void)USBD_LL_PrepareReceive(pdev, CDC_OUT_EP, hcdc->RxBuffer,
+    (void)USBD_LL_PrepareReceive(pdev, CDC_OUT_EP_PORT(port), hcdc->RxBuffer,
                                  CDC_DATA_HS_OUT_PACKET_SIZE);
   }
   else
   {
     /* Prepare Out endpoint to receive next packet */
-    (void)USBD_LL_PrepareReceive(pdev, CDC_OUT_EP, hcdc->RxBuffer,
+    (void)USBD_LL_PrepareReceive(pdev, CDC_OUT_EP_PORT(port), hcdc->RxBuffer,
                                  CDC_DATA_FS_OUT_PACKET_SIZE);
   }
 
@@ -61,11 +61,97 @@ extern "C" {
 // #define MSC_CDC_CFG_IDX 0x00
 // #define DFU_CFG_IDX     0x01
 
-#define USBD_INTERFACE_NUM      0x03U //使用的接口数量
+#define USBD_INTERFACE_NUM      (1U + 2U * USBD_CDC_PORT_NBR) //使用的接口数量
 #define USBD_MSC_INTERFACE_NUM  0x00U //MSC接口号
-#define USBD_CDC_INTERFACE_NUM  0x01U //CDC接口号
+#define USBD_CDC_INTERFACE_NUM  0x01U //第一个CDC口的接口号, 每个CDC口占通信和数据两个接口
 
-#define USB_CUD_CONFIG_DESC_SIZ (9 + 8 + (USB_MSC_CONFIG_DESC_SIZ - 9) + (USB_CDC_CONFIG_DESC_SIZ - 9))
+#define USBD_CDC_ITF_PORT(itf)  (((itf) - USBD_CDC_INTERFACE_NUM) / 2U) //接口所属的CDC口
+
+#if (USBD_INTERFACE_NUM > USBD_MAX_NUM_INTERFACES)
+#error "USBD_MAX_NUM_INTERFACES: too small for the MSC and the CDC ports"
+#endif
+
+#define USB_CUD_CDC_DESC_SIZ    (8 + (USB_CDC_CONFIG_DESC_SIZ - 9)) //每个CDC口: IAD + 接口和端点
+#define USB_CUD_CONFIG_DESC_SIZ (9 + (USB_MSC_CONFIG_DESC_SIZ - 9) + (USBD_CDC_PORT_NBR * USB_CUD_CDC_DESC_SIZ))
+
+// 第 n 个CDC口的描述符, pkt 为数据端点包长, binterval 为命令端点间隔
+#define USBD_CUD_CDC_DESC(n, pkt, binterval)                                                     \
+    /* IAD Descriptor */                                                                          \
+    0x08,                                  /* bLength: Interface Descriptor size */               \
+    0x0B,                                  /* bDescriptorType: IAD */                             \
+    USBD_CDC_INTERFACE_NUM + (2U * (n)),   /* bFirstInterface */                                  \
+    0x02,                                  /* bInterfaceCount */                                  \
+    0x02,                                  /* bFunctionClass: CDC */                              \
+    0x02,                                  /* bFunctionSubClass */                                \
+    0x01,                                  /* bFunctionProtocol */                                \
+    0x01,                                  /* iFunction */                                        \
+    /* Interface Descriptor */                                                                    \
+    0x09,                                  /* bLength: Interface Descriptor size */               \
+    USB_DESC_TYPE_INTERFACE,               /* bDescriptorType: Interface */                       \
+    USBD_CDC_INTERFACE_NUM + (2U * (n)),   /* bInterfaceNumber: Number of Interface */            \
+    0x00,                                  /* bAlternateSetting: Alternate setting */             \
+    0x01,                                  /* bNumEndpoints: One endpoints used */                \
+    0x02,                                  /* bInterfaceClass: Communication Interface Class */   \
+    0x02,                                  /* bInterfaceSubClass: Abstract Control Model */       \
+    0x01,                                  /* bInterfaceProtocol: Common AT commands */           \
+    0x00,                                  /* iInterface: */                                      \
+    /* Header Functional Descriptor */                                                            \
+    0x05,                                  /* bLength: Endpoint Descriptor size */                \
+    0x24,                                  /* bDescriptorType: CS_INTERFACE */                    \
+    0x00,                                  /* bDescriptorSubtype: Header Func Desc */             \
+    0x10,                                  /* bcdCDC: spec release number */                      \
+    0x01,                                                                                         \
+    /* Call Management Functional Descriptor */                                                   \
+    0x05,                                  /* bFunctionLength */                                  \
+    0x24,                                  /* bDescriptorType: CS_INTERFACE */                    \
+    0x01,                                  /* bDescriptorSubtype: Call Management Func Desc */    \
+    0x00,                                  /* bmCapabilities: D0+D1 */                            \
+    USBD_CDC_INTERFACE_NUM + (2U * (n)) + 1U, /* bDataInterface */                                \
+    /* ACM Functional Descriptor */                                                               \
+    0x04,                                  /* bFunctionLength */                                  \
+    0x24,                                  /* bDescriptorType: CS_INTERFACE */                    \
+    0x02,                                  /* bDescriptorSubtype: Abstract Control Management desc */ \
+    0x02,                                  /* bmCapabilities */                                   \
+    /* Union Functional Descriptor */                                                             \
+    0x05,                                  /* bFunctionLength */                                  \
+    0x24,                                  /* bDescriptorType: CS_INTERFACE */                    \
+    0x06,                                  /* bDescriptorSubtype: Union func desc */              \
+    USBD_CDC_INTERFACE_NUM + (2U * (n)),   /* bMasterInterface: Communication class interface */ \
+    USBD_CDC_INTERFACE_NUM + (2U * (n)) + 1U, /* bSlaveInterface0: Data Class Interface */        \
+    /* Command Endpoint Descriptor */                                                             \
+    0x07,                                  /* bLength: Endpoint Descriptor size */                \
+    USB_DESC_TYPE_ENDPOINT,                /* bDescriptorType: Endpoint */                        \
+    CDC_CMD_EP_PORT(n),                    /* bEndpointAddress */                                 \
+    0x03,                                  /* bmAttributes: Interrupt */                          \
+    LOBYTE(CDC_CMD_PACKET_SIZE),           /* wMaxPacketSize: */                                  \
+    HIBYTE(CDC_CMD_PACKET_SIZE),                                                                  \
+    (binterval),                           /* bInterval: */                                       \
+    /* Data class interface descriptor */                                                         \
+    0x09,                                  /* bLength: Endpoint Descriptor size */                \
+    USB_DESC_TYPE_INTERFACE,               /* bDescriptorType: */                                 \
+    USBD_CDC_INTERFACE_NUM + (2U * (n)) + 1U, /* bInterfaceNumber: Number of Interface */         \
+    0x00,                                  /* bAlternateSetting: Alternate setting */             \
+    0x02,                                  /* bNumEndpoints: Two endpoints used */                \
+    0x0A,                                  /* bInterfaceClass: CDC */                             \
+    0x00,                                  /* bInterfaceSubClass: */                              \
+    0x00,                                  /* bInterfaceProtocol: */                              \
+    0x00,                                  /* iInterface: */                                      \
+    /* Endpoint OUT Descriptor */                                                                 \
+    0x07,                                  /* bLength: Endpoint Descriptor size */                \
+    USB_DESC_TYPE_ENDPOINT,                /* bDescriptorType: Endpoint */                        \
+    CDC_OUT_EP_PORT(n),                    /* bEndpointAddress */                                 \
+    0x02,                                  /* bmAttributes: Bulk */                               \
+    LOBYTE(pkt),                           /* wMaxPacketSize: */                                  \
+    HIBYTE(pkt),                                                                                  \
+    0x00,                                  /* bInterval: ignore for Bulk transfer */              \
+    /* Endpoint IN Descriptor */                                                                  \
+    0x07,                                  /* bLength: Endpoint Descriptor size */                \
+    USB_DESC_TYPE_ENDPOINT,                /* bDescriptorType: Endpoint */                        \
+    CDC_IN_EP_PORT(n),                     /* bEndpointAddress */                                 \
+    0x02,                                  /* bmAttributes: Bulk */                               \
+    LOBYTE(pkt),                           /* wMaxPacketSize: */                                  \
+    HIBYTE(pkt),                                                                                  \
+    0x00                                   /* bInterval: ignore for Bulk transfer */
 
 /* Structure for CUD process */
 extern USBD_ClassTypeDef USBD_CUD;
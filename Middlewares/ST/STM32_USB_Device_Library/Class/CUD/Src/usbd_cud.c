@@ -92,7 +92,10 @@ uint8_t USBD_CUD_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum);
 uint8_t USBD_CUD_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum);
 static uint8_t USBD_CUD_SOF(USBD_HandleTypeDef *pdev)
 {
-    return USBD_DFU_SOF(pdev);
+#if ENBALE_DUF_CFGDESC
+    (void)USBD_DFU_SOF(pdev);
+#endif
+    return USBD_CDC_SOF(pdev);
 }
 #if (USBD_SUPPORT_USER_STRING_DESC == 1U)
 static uint8_t *USBD_CUD_GetUsrStringDesc(USBD_HandleTypeDef *pdev,
@@ -123,7 +126,7 @@ USBD_ClassTypeDef USBD_CUD =
         USBD_CUD_EP0_RxReady, /*EP0_RxReady*/
         USBD_CUD_DataIn,
         USBD_CUD_DataOut,
-        NULL, // USBD_CUD_SOF, /*SOF */
+        USBD_CUD_SOF, /*SOF */
         NULL,
         NULL,
         USBD_CUD_GetHSCfgDesc,
@@ -191,18 +194,36 @@ uint8_t USBD_CUD_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 uint8_t USBD_CUD_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
 {
     uint8_t res = USBD_OK;
-    switch (req->wIndex) {
-        case USBD_MSC_INTERFACE_NUM:
-            res = USBD_MSC_Setup(pdev, req);
-            break;
-
-        case USBD_CDC_INTERFACE_NUM:
-            res = USBD_CDC_Setup(pdev, req);
-            break;
-        default:
-            // 未识别的接口请求
+    uint8_t index = LOBYTE(req->wIndex);
+
+    // 端点请求的 wIndex 是端点地址, 按端点号找所属的接口
+    if ((req->bmRequest & 0x1FU) == USB_REQ_RECIPIENT_ENDPOINT) {
+        index &= 0x7FU;
+        if (index == (MSC_EPOUT_ADDR & 0x7FU)) {
+            return USBD_MSC_Setup(pdev, req);
+        } else if ((index >= (CDC_OUT_EP & 0x7FU)) &&
+                   (index <= (CDC_CMD_EP_PORT(USBD_CDC_PORT_NBR - 1U) & 0x7FU))) {
+            return USBD_CDC_SetupPort(pdev, CDC_EP_PORT(index), req);
+        } else if (index == 0U) {
+            // EP0 归内核管理, CLEAR_FEATURE 的状态阶段已由内核发出
+            return USBD_OK;
+        }
+        // 没有接口拥有该端点: 类/厂商请求在此 STALL EP0,
+        // 标准请求 (CLEAR_FEATURE) 的状态阶段已发出, 只返回失败
+        if ((req->bmRequest & USB_REQ_TYPE_MASK) != USB_REQ_TYPE_STANDARD) {
             USBD_CtlError(pdev, req);
-            break;
+        }
+        return USBD_FAIL;
+    }
+
+    if (index == USBD_MSC_INTERFACE_NUM) {
+        res = USBD_MSC_Setup(pdev, req);
+    } else if ((index >= USBD_CDC_INTERFACE_NUM) && (index < USBD_INTERFACE_NUM)) {
+        // 通信接口和数据接口都交给所属的CDC口
+        res = USBD_CDC_SetupPort(pdev, USBD_CDC_ITF_PORT(index), req);
+    } else {
+        // 未识别的接口请求
+        USBD_CtlError(pdev, req);
     }
 
     return res;
@@ -220,7 +241,7 @@ uint8_t USBD_CUD_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
     uint8_t ep_addr = epnum & 0x7F;
     if (ep_addr == MSC_EPOUT_ADDR) {
         return USBD_MSC_DataIn(pdev, epnum);
-    } else if (ep_addr == CDC_OUT_EP || ep_addr == (CDC_CMD_EP & 0x7F)) {
+    } else if (ep_addr >= CDC_OUT_EP && ep_addr <= (CDC_CMD_EP_PORT(USBD_CDC_PORT_NBR - 1U) & 0x7F)) {
         return USBD_CDC_DataIn(pdev, epnum);
     }
 
@@ -240,7 +261,7 @@ uint8_t USBD_CUD_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
     uint8_t ep_addr = epnum & 0x7F;
     if (ep_addr == MSC_EPOUT_ADDR) {
         return USBD_MSC_DataOut(pdev, epnum);
-    } else if (ep_addr == CDC_OUT_EP || ep_addr == (CDC_CMD_EP & 0x7F)) {
+    } else if (ep_addr >= CDC_OUT_EP && ep_addr <= (CDC_CMD_EP_PORT(USBD_CDC_PORT_NBR - 1U) & 0x7F)) {
         return USBD_CDC_DataOut(pdev, epnum);
     }
     return USBD_OK;
@@ -18,6 +18,11 @@ extern "C" {
 
 #include "usbd_cud.h"
 
+// DFU 描述符的接口号和长度只按单个CDC口的组合编排过
+#if ENBALE_DUF_CFGDESC && (USBD_CDC_PORT_NBR > 1U)
+#error "ENBALE_DUF_CFGDESC: DFU is only supported with USBD_CDC_PORT_NBR == 1"
+#endif
+
 __ALIGN_BEGIN static uint8_t USBD_CUD_DFU_CfgFSDesc[USB_DFU_CONFIG_DESC_SIZ] __ALIGN_END =
     {
         0x09,                        /* bLength: Configuration Descriptor size */
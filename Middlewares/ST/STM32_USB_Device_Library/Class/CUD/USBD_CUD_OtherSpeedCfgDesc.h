@@ -22,10 +22,9 @@ __ALIGN_BEGIN static uint8_t USBD_CUD_OtherSpeedCfgDesc[USB_CUD_CONFIG_DESC_SIZ]
     {
         0x09, /* bLength: Configuration Descriptor size */
         USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION,
-        USB_CUD_CONFIG_DESC_SIZ,
-
-        0x00,
-        USBD_INTERFACE_NUM, /* bNumInterfaces: 1 interface */
+        LOBYTE(USB_CUD_CONFIG_DESC_SIZ),
+        HIBYTE(USB_CUD_CONFIG_DESC_SIZ),
+        USBD_INTERFACE_NUM, /* bNumInterfaces: MSC + 2 per CDC port */
         0x01,               /* bConfigurationValue: */
         0x04,               /* iConfiguration: */
 #if (USBD_SELF_POWERED == 1U)
@@ -62,95 +61,17 @@ __ALIGN_BEGIN static uint8_t USBD_CUD_OtherSpeedCfgDesc[USB_CUD_CONFIG_DESC_SIZ]
         0x00,
         0x00, /* Polling interval in milliseconds */
 
-        /* IAD Descriptor */
-        0x08,                   /* bLength: Interface Descriptor size */
-        0x0B,                   /* bDescriptorType: IAD */
-        USBD_CDC_INTERFACE_NUM, /* bFirstInterface */
-        0x02,                   /* bInterfaceCount */
-        0x02,                   /* bFunctionClass: CDC */
-        0x02,                   /* bFunctionSubClass */
-        0x01,                   /* bFunctionProtocol */
-        0x01,                   /* iFunction */
-
-        /*-------------------------- CDC ------------------------*/
-        /* Interface Descriptor */
-        0x09,                    /* bLength: Interface Descriptor size */
-        USB_DESC_TYPE_INTERFACE, /* bDescriptorType: Interface */
-        /* Interface descriptor type */
-        USBD_CDC_INTERFACE_NUM, /* bInterfaceNumber: Number of Interface */
-        0x00,                   /* bAlternateSetting: Alternate setting */
-        0x01,                   /* bNumEndpoints: One endpoints used */
-        0x02,                   /* bInterfaceClass: Communication Interface Class */
-        0x02,                   /* bInterfaceSubClass: Abstract Control Model */
-        0x01,                   /* bInterfaceProtocol: Common AT commands */
-        0x00,                   /* iInterface: */
-
-        /* Header Functional Descriptor */
-        0x05, /* bLength: Endpoint Descriptor size */
-        0x24, /* bDescriptorType: CS_INTERFACE */
-        0x00, /* bDescriptorSubtype: Header Func Desc */
-        0x10, /* bcdCDC: spec release number */
-        0x01,
-
-        /*Call Management Functional Descriptor*/
-        0x05, /* bFunctionLength */
-        0x24, /* bDescriptorType: CS_INTERFACE */
-        0x01, /* bDescriptorSubtype: Call Management Func Desc */
-        0x00, /* bmCapabilities: D0+D1 */
-        0x01, /* bDataInterface: 1 */
-
-        /*ACM Functional Descriptor*/
-        0x04, /* bFunctionLength */
-        0x24, /* bDescriptorType: CS_INTERFACE */
-        0x02, /* bDescriptorSubtype: Abstract Control Management desc */
-        0x02, /* bmCapabilities */
-
-        /*Union Functional Descriptor*/
-        0x05, /* bFunctionLength */
-        0x24, /* bDescriptorType: CS_INTERFACE */
-        0x06, /* bDescriptorSubtype: Union func desc */
-        0x00, /* bMasterInterface: Communication class interface */
-        0x01, /* bSlaveInterface0: Data Class Interface */
-
-        /*Endpoint 2 Descriptor*/
-        0x07,                        /* bLength: Endpoint Descriptor size */
-        USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */
-        CDC_CMD_EP,                  /* bEndpointAddress */
-        0x03,                        /* bmAttributes: Interrupt */
-        LOBYTE(CDC_CMD_PACKET_SIZE), /* wMaxPacketSize: */
-        HIBYTE(CDC_CMD_PACKET_SIZE),
-        CDC_FS_BINTERVAL, /* bInterval: */
-
-        /*---------------------------------------------------------------------------*/
-
-        /*Data class interface descriptor*/
-        0x09,                          /* bLength: Endpoint Descriptor size */
-        USB_DESC_TYPE_INTERFACE,       /* bDescriptorType: */
-        USBD_CDC_INTERFACE_NUM + 0x01, /* bInterfaceNumber: Number of Interface */
-        0x00,                          /* bAlternateSetting: Alternate setting */
-        0x02,                          /* bNumEndpoints: Two endpoints used */
-        0x0A,                          /* bInterfaceClass: CDC */
-        0x00,                          /* bInterfaceSubClass: */
-        0x00,                          /* bInterfaceProtocol: */
-        0x00,                          /* iInterface: */
-
-        /*Endpoint OUT Descriptor*/
-        0x07,                   /* bLength: Endpoint Descriptor size */
-        USB_DESC_TYPE_ENDPOINT, /* bDescriptorType: Endpoint */
-        CDC_OUT_EP,             /* bEndpointAddress */
-        0x02,                   /* bmAttributes: Bulk */
-        0x40,                   /* wMaxPacketSize: */
-        0x00,
-        0x00, /* bInterval: ignore for Bulk transfer */
-
-        /*Endpoint IN Descriptor*/
-        0x07,                   /* bLength: Endpoint Descriptor size */
-        USB_DESC_TYPE_ENDPOINT, /* bDescriptorType: Endpoint */
-        CDC_IN_EP,              /* bEndpointAddress */
-        0x02,                   /* bmAttributes: Bulk */
-        0x40,                   /* wMaxPacketSize: */
-        0x00,
-        0x00 /* bInterval */
+        /********************  CDC ports ********************/
+        USBD_CUD_CDC_DESC(0U, CDC_DATA_FS_MAX_PACKET_SIZE, CDC_FS_BINTERVAL),
+#if (USBD_CDC_PORT_NBR > 1U)
+        USBD_CUD_CDC_DESC(1U, CDC_DATA_FS_MAX_PACKET_SIZE, CDC_FS_BINTERVAL),
+#endif /* (USBD_CDC_PORT_NBR > 1) */
+#if (USBD_CDC_PORT_NBR > 2U)
+        USBD_CUD_CDC_DESC(2U, CDC_DATA_FS_MAX_PACKET_SIZE, CDC_FS_BINTERVAL),
+#endif /* (USBD_CDC_PORT_NBR > 2) */
+#if (USBD_CDC_PORT_NBR > 3U)
+#error "ERROR: USBD_CUD_CfgDesc: Modify the file to support more CDC ports!"
+#endif /* (USBD_CDC_PORT_NBR > 3) */
 };
 
 #ifdef __cplusplus
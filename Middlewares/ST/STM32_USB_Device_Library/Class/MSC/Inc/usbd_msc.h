@@ -48,6 +48,10 @@ extern "C" {
 #define MSC_MEDIA_PACKET 512U
 #endif /* MSC_MEDIA_PACKET */
 
+#ifndef MSC_MAX_LUN
+#define MSC_MAX_LUN 4U
+#endif /* MSC_MAX_LUN */
+
 #define MSC_MAX_FS_PACKET       0x40U
 #define MSC_MAX_HS_PACKET       0x200U
 
@@ -58,6 +62,19 @@ extern "C" {
 #define MSC_EPIN_ADDR           0x81U
 #define MSC_EPOUT_ADDR          0x01U
 
+/* Storage Read/Write/Poll return value: transfer started, poll again later */
+#define MSC_MEDIA_BUSY          1
+
+/* Deferred media request states and operations */
+#define MSC_IO_IDLE             0U
+#define MSC_IO_PENDING          1U
+#define MSC_IO_ACTIVE           2U
+
+#define MSC_IO_READ             0U
+#define MSC_IO_WRITE            1U
+#define MSC_IO_FLUSH            2U
+#define MSC_IO_UNMAP            3U
+
 /**
  * @}
  */
@@ -75,8 +92,70 @@ typedef struct _USBD_STORAGE {
     int8_t (*GetMaxLun)(void);
     int8_t *pInquiry;
 
+    /* Optional zero-copy hooks, may be NULL. A memory-mapped backend returns
+       the address of blk_len contiguous blocks at blk_addr, or NULL to fall
+       back to Read/Write through bot_data. After a mapped OUT transfer Write
+       is still called with buf pointing at the block itself, so the backend
+       must not copy when buf is already its own storage. */
+    uint8_t *(*GetReadAddr)(uint8_t lun, uint32_t blk_addr, uint16_t blk_len);
+    uint8_t *(*GetWriteAddr)(uint8_t lun, uint32_t blk_addr, uint16_t blk_len);
+
+    /* Read and Write are called from USBD_MSC_Process, never from the USB
+       interrupt. A backend may start the transfer and return MSC_MEDIA_BUSY;
+       Poll is then called until it returns 0 (done) or <0 (error). May be
+       NULL for backends that always complete inside Read/Write. */
+    int8_t (*Poll)(uint8_t lun);
+
+    /* Optional, may be NULL. Commit anything the backend still buffers; called
+       from USBD_MSC_Process on SYNCHRONIZE CACHE, eject, suspend and idle. */
+    int8_t (*Flush)(uint8_t lun);
+
+    /* Optional, may be NULL. Deallocate blk_len blocks from blk_addr, data
+       read from them afterwards is unspecified. Called from USBD_MSC_Process;
+       the USB interrupt also calls it with blk_len 0 to find out whether the
+       LUN supports it, which must return 0 without side effects. */
+    int8_t (*Unmap)(uint8_t lun, uint32_t blk_addr, uint32_t blk_len);
+
 } USBD_StorageTypeDef;
 
+typedef struct
+{
+    uint32_t rd_cmds;   /* READ(10)/READ(12) data phases completed */
+    uint32_t rd_bytes;  /* bytes sent in READ data phases */
+    uint32_t rd_ticks;  /* time spent in READ data phases, in ms */
+    uint32_t rd_mapped; /* READ chunks sent straight from backend memory */
+    uint32_t wr_mapped; /* WRITE chunks received straight into backend memory */
+} USBD_MSC_StatsTypeDef;
+
+typedef struct
+{
+    __IO uint8_t state; /* MSC_IO_IDLE, MSC_IO_PENDING or MSC_IO_ACTIVE */
+    uint8_t op;         /* MSC_IO_READ, MSC_IO_WRITE, MSC_IO_FLUSH or MSC_IO_UNMAP */
+    uint8_t lun;
+    uint8_t idx;        /* READ ping-pong buffer being filled */
+    uint8_t *buf;
+    uint32_t blk_addr;
+    uint16_t blk_len;   /* MSC_IO_UNMAP: number of ranges in buf */
+} USBD_MSC_IoTypeDef;
+
+typedef struct
+{
+    uint32_t blk_addr;
+    uint32_t blk_len;
+} USBD_MSC_RangeTypeDef;
+
+typedef struct
+{
+    USBD_SCSI_SenseTypeDef sense[SENSE_LIST_DEEPTH];
+    uint8_t sense_head;
+    uint8_t sense_tail;
+    uint8_t medium_state;
+    uint8_t unit_attention; /* ASC of a pending UNIT ATTENTION, 0 if none */
+
+    uint16_t blk_size;
+    uint32_t blk_nbr;
+} USBD_MSC_LunTypeDef;
+
 typedef struct
 {
     uint32_t max_lun;
@@ -85,19 +164,27 @@ typedef struct
     uint8_t bot_status;
     uint32_t bot_data_length;
     uint8_t bot_data[MSC_MEDIA_PACKET];
+    uint8_t bot_data_pp[MSC_MEDIA_PACKET]; /* second buffer of the READ ping-pong pair */
     USBD_MSC_BOT_CBWTypeDef cbw;
     USBD_MSC_BOT_CSWTypeDef csw;
 
-    USBD_SCSI_SenseTypeDef scsi_sense[SENSE_LIST_DEEPTH];
-    uint8_t scsi_sense_head;
-    uint8_t scsi_sense_tail;
-    uint8_t scsi_medium_state;
-
-    uint16_t scsi_blk_size;
-    uint32_t scsi_blk_nbr;
+    USBD_MSC_LunTypeDef scsi_lun[MSC_MAX_LUN]; /* sense queue, medium state and geometry */
 
     uint32_t scsi_blk_addr;
     uint32_t scsi_blk_len;
+
+    uint8_t *rd_buf[2];  /* READ ping-pong buffers: bot_data and bot_data_pp */
+    uint8_t *rd_ptr[2];  /* staged data: rd_buf[] or mapped memory, NULL when empty */
+    uint32_t rd_len[2];  /* bytes staged in each slot */
+    uint8_t rd_tx;       /* index of the buffer currently on the wire */
+    uint32_t rd_start;   /* tick at which the current READ data phase started */
+    uint8_t *wr_ptr;     /* destination of the WRITE chunk being received */
+    uint32_t wr_len;     /* length of the WRITE chunk being received */
+    uint8_t rd_inflight; /* a READ chunk is on the wire, the next DataIn resumes */
+
+    USBD_MSC_IoTypeDef io; /* media request handed to USBD_MSC_Process */
+
+    USBD_MSC_StatsTypeDef stats;
 } USBD_MSC_BOT_HandleTypeDef;
 
 /* Structure for MSC process */
@@ -106,6 +193,9 @@ extern USBD_ClassTypeDef USBD_MSC;
 
 uint8_t USBD_MSC_RegisterStorage(USBD_HandleTypeDef *pdev,
                                  USBD_StorageTypeDef *fops);
+USBD_MSC_StatsTypeDef *USBD_MSC_GetStats(USBD_HandleTypeDef *pdev);
+void USBD_MSC_Process(USBD_HandleTypeDef *pdev);
+void USBD_MSC_RequestFlush(USBD_HandleTypeDef *pdev);
 
 uint8_t USBD_MSC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
 uint8_t USBD_MSC_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
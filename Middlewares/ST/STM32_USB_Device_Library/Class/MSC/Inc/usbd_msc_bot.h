@@ -47,6 +47,7 @@ extern "C" {
 #define USBD_BOT_LAST_DATA_IN              3U       /* Last Data In Last */
 #define USBD_BOT_SEND_DATA                 4U       /* Send Immediate data */
 #define USBD_BOT_NO_DATA                   5U       /* No data Stage */
+#define USBD_BOT_MEDIA_WAIT                6U       /* CSW held until a media request completes */
 
 #define USBD_BOT_CBW_SIGNATURE             0x43425355U
 #define USBD_BOT_CSW_SIGNATURE             0x53425355U
@@ -128,6 +129,9 @@ void MSC_BOT_DataOut(USBD_HandleTypeDef  *pdev,
 void MSC_BOT_SendCSW(USBD_HandleTypeDef  *pdev,
                      uint8_t CSW_Status);
 
+void MSC_BOT_MediaCplt(USBD_HandleTypeDef  *pdev,
+                       int8_t status);
+
 void  MSC_BOT_CplClrFeature(USBD_HandleTypeDef  *pdev,
                             uint8_t epnum);
 /**
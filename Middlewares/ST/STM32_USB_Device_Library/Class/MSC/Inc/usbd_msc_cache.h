@@ -0,0 +1,116 @@
+/**
+  ******************************************************************************
+  * @file    usbd_msc_cache.h
+  * @author  MCD Application Team
+  * @brief   Header for the usbd_msc_cache.c file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2015 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                      www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_MSC_CACHE_H
+#define __USBD_MSC_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_msc.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup MSC_CACHE
+  * @brief Write-back block cache in front of the storage backends
+  * @{
+  */
+
+/** @defgroup MSC_CACHE_Exported_Defines
+  * @{
+  */
+#ifndef MSC_CACHE_BLK_NBR
+#define MSC_CACHE_BLK_NBR                  8U      /* cached blocks */
+#endif /* MSC_CACHE_BLK_NBR */
+
+#ifndef MSC_CACHE_LUN_MASK
+#define MSC_CACHE_LUN_MASK                 0x00U   /* bit n set: LUN n is cached */
+#endif /* MSC_CACHE_LUN_MASK */
+
+#ifndef MSC_CACHE_IDLE_MS
+#define MSC_CACHE_IDLE_MS                  500U    /* flush after this much idle time */
+#endif /* MSC_CACHE_IDLE_MS */
+
+/* Cache lines hold one block; LUNs with larger blocks bypass the cache */
+#define MSC_CACHE_LINE_SIZE                MSC_MEDIA_PACKET
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_CACHE_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  uint32_t hits;        /* blocks served from or written into a cached line */
+  uint32_t misses;      /* blocks that needed a line to be filled or allocated */
+  uint32_t writebacks;  /* dirty blocks written to the backend */
+  uint32_t flushes;     /* flushes run: idle, SYNCHRONIZE CACHE, eject, suspend */
+} USBD_MSC_CacheStatsTypeDef;
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_CACHE_Exported_FunctionsPrototype
+  * @{
+  */
+uint8_t MSC_Cache_IsCached(uint8_t lun);
+uint8_t MSC_Cache_IsDirty(uint8_t lun);
+uint8_t MSC_Cache_IsDirtyRange(uint8_t lun, uint32_t blk_addr, uint32_t blk_len);
+uint8_t MSC_Cache_IsBusy(void);
+
+int8_t MSC_Cache_Read(USBD_StorageTypeDef *fops, uint8_t lun, uint8_t *buf,
+                      uint32_t blk_addr, uint16_t blk_len, uint16_t blk_size);
+int8_t MSC_Cache_Write(USBD_StorageTypeDef *fops, uint8_t lun, uint8_t *buf,
+                       uint32_t blk_addr, uint16_t blk_len, uint16_t blk_size);
+int8_t MSC_Cache_Flush(USBD_StorageTypeDef *fops, uint8_t lun);
+int8_t MSC_Cache_Unmap(USBD_StorageTypeDef *fops, uint8_t lun,
+                       uint8_t *ranges, uint16_t nbr);
+int8_t MSC_Cache_FlushAll(USBD_StorageTypeDef *fops);
+void MSC_Cache_Idle(USBD_StorageTypeDef *fops);
+int8_t MSC_Cache_Poll(USBD_StorageTypeDef *fops);
+void MSC_Cache_Cancel(void);
+
+USBD_MSC_CacheStatsTypeDef *USBD_MSC_GetCacheStats(void);
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_MSC_CACHE_H */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -40,10 +40,16 @@ extern "C" {
 /** @defgroup USB_INFO_Exported_Defines
   * @{
   */
-#define MODE_SENSE6_LEN                    0x17U
-#define MODE_SENSE10_LEN                   0x1BU
-#define LENGTH_INQUIRY_PAGE00              0x06U
+#define MODE_SENSE6_LEN                    0x18U   /* header + caching page */
+#define MODE_SENSE10_LEN                   0x1CU   /* header + caching page */
+#define MODE_PAGE_CACHING                  0x08U
+#define MODE_PAGE_ALL                      0x3FU
+#define MODE_CACHING_PAGE_LEN              0x14U
+#define MODE_CACHING_WCE                   0x04U   /* write cache enable */
+#define LENGTH_INQUIRY_PAGE00              0x08U
 #define LENGTH_INQUIRY_PAGE80              0x08U
+#define LENGTH_INQUIRY_PAGEB0              0x40U
+#define LENGTH_INQUIRY_PAGEB2              0x08U
 #define LENGTH_FORMAT_CAPACITIES           0x14U
 
 /**
@@ -0,0 +1,123 @@
+/**
+  ******************************************************************************
+  * @file    usbd_msc_profile.h
+  * @author  MCD Application Team
+  * @brief   Header for the usbd_msc_profile.c file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2015 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                      www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_MSC_PROFILE_H
+#define __USBD_MSC_PROFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_msc.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup MSC_PROFILE
+  * @brief Per-opcode SCSI command latency profile
+  * @{
+  */
+
+/** @defgroup MSC_PROFILE_Exported_Defines
+  * @{
+  */
+#ifndef MSC_PROF_ENABLE
+#define MSC_PROF_ENABLE                    1U
+#endif /* MSC_PROF_ENABLE */
+
+#ifndef MSC_PROF_SLOTS
+#define MSC_PROF_SLOTS                     12U     /* opcodes tracked, the last slot takes the rest */
+#endif /* MSC_PROF_SLOTS */
+
+#define MSC_PROF_BINS                      32U     /* bin n: CBW to CSW in [2^n, 2^(n+1)) cycles */
+#define MSC_PROF_OTHER                     0xFFU   /* opcode of the shared last slot */
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_PROFILE_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  uint8_t opcode;                 /* SCSI operation code, MSC_PROF_OTHER once the table is full */
+  uint32_t count;                 /* commands completed */
+  uint32_t failed;                /* commands that ended with a failed CSW */
+  uint64_t bytes;                 /* bytes moved in the data phases */
+  uint64_t cycles;                /* CBW to CSW */
+  uint64_t media_cycles;          /* part of it spent in the backend */
+  uint32_t max_cycles;
+  uint32_t hist[MSC_PROF_BINS];   /* log2 histogram of CBW to CSW */
+} USBD_MSC_ProfSlotTypeDef;
+
+typedef struct
+{
+  uint8_t used;                   /* slots assigned to an opcode */
+  uint64_t read_cycles;           /* backend Read, Poll included */
+  uint64_t write_cycles;          /* backend Write, Poll included */
+  uint64_t other_cycles;          /* backend Flush and Unmap */
+  uint64_t bus_cycles;            /* CBW to CSW outside the backend: USB transfers and host */
+  USBD_MSC_ProfSlotTypeDef slot[MSC_PROF_SLOTS];
+} USBD_MSC_ProfileTypeDef;
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_PROFILE_Exported_FunctionsPrototype
+  * @{
+  */
+#if (MSC_PROF_ENABLE == 1U)
+void MSC_Prof_Reset(void);
+void MSC_Prof_CmdStart(void);
+void MSC_Prof_CmdEnd(uint8_t opcode, uint32_t bytes, uint8_t status);
+void MSC_Prof_MediaStart(uint8_t op);
+void MSC_Prof_MediaEnd(void);
+
+uint8_t USBD_MSC_GetProfile(USBD_MSC_ProfileTypeDef *snapshot);
+#else
+#define MSC_Prof_Reset()
+#define MSC_Prof_CmdStart()
+#define MSC_Prof_CmdEnd(opcode, bytes, status)
+#define MSC_Prof_MediaStart(op)
+#define MSC_Prof_MediaEnd()
+#endif /* MSC_PROF_ENABLE */
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_MSC_PROFILE_H */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,105 @@
+/**
+  ******************************************************************************
+  * @file    usbd_msc_readahead.h
+  * @author  MCD Application Team
+  * @brief   Header for the usbd_msc_readahead.c file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2015 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                      www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_MSC_READAHEAD_H
+#define __USBD_MSC_READAHEAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_msc.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup MSC_READAHEAD
+  * @brief Sequential read-ahead for the READ commands
+  * @{
+  */
+
+/** @defgroup MSC_READAHEAD_Exported_Defines
+  * @{
+  */
+#ifndef MSC_RA_BLK_NBR
+#define MSC_RA_BLK_NBR                     8U      /* prefetch depth, in 512-byte blocks */
+#endif /* MSC_RA_BLK_NBR */
+
+#ifndef MSC_RA_MIN_RUN
+#define MSC_RA_MIN_RUN                     1U      /* back-to-back READs before prefetching */
+#endif /* MSC_RA_MIN_RUN */
+
+#ifndef MSC_RA_LUN_MASK
+#define MSC_RA_LUN_MASK                    0xFFU   /* bit n set: LUN n is prefetched */
+#endif /* MSC_RA_LUN_MASK */
+
+#define MSC_RA_BUF_SIZE                    (MSC_RA_BLK_NBR * MSC_MEDIA_PACKET)
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_READAHEAD_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  uint32_t blocks;      /* blocks requested by READ commands */
+  uint32_t hits;        /* blocks served from the prefetch buffer */
+  uint32_t prefetched;  /* blocks fetched ahead from the backend */
+} USBD_MSC_RAStatsTypeDef;
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_READAHEAD_Exported_FunctionsPrototype
+  * @{
+  */
+void MSC_RA_Track(uint8_t lun, uint32_t blk_addr, uint32_t blk_len);
+void MSC_RA_Invalidate(uint8_t lun);
+uint8_t *MSC_RA_Map(uint8_t lun, uint32_t blk_addr, uint32_t *blk_nbr, uint16_t blk_size);
+uint8_t MSC_RA_Copy(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len,
+                    uint16_t blk_size);
+void MSC_RA_Prefetch(USBD_HandleTypeDef *pdev, USBD_StorageTypeDef *fops);
+uint8_t MSC_RA_Poll(USBD_StorageTypeDef *fops);
+
+USBD_MSC_RAStatsTypeDef *USBD_MSC_GetReadAheadStats(void);
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_MSC_READAHEAD_H */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
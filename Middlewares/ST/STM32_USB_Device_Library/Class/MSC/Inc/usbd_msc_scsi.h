@@ -71,6 +71,10 @@ extern "C" {
 #define SCSI_VERIFY12                               0xAFU
 #define SCSI_VERIFY16                               0x8FU
 
+#define SCSI_SYNCHRONIZE_CACHE10                    0x35U
+#define SCSI_SYNCHRONIZE_CACHE16                    0x91U
+#define SCSI_UNMAP                                  0x42U
+
 #define SCSI_SEND_DIAGNOSTIC                        0x1DU
 #define SCSI_READ_FORMAT_CAPACITIES                 0x23U
 
@@ -100,11 +104,14 @@ extern "C" {
 #define WRITE_PROTECTED                             0x27U
 #define UNRECOVERED_READ_ERROR                      0x11U
 #define WRITE_FAULT                                 0x03U
+#define SAVING_PARAMETERS_NOT_SUPPORTED             0x39U
 
 #define READ_FORMAT_CAPACITY_DATA_LEN               0x0CU
 #define READ_CAPACITY10_DATA_LEN                    0x08U
+#define READ_CAPACITY16_DATA_LEN                    0x20U
 #define REQUEST_SENSE_DATA_LEN                      0x12U
 #define STANDARD_INQUIRY_DATA_LEN                   0x24U
+#define UNMAP_DESC_MAX                              ((MSC_MEDIA_PACKET - 8U) / 16U)
 #define BLKVFY                                      0x04U
 
 #define SCSI_MEDIUM_UNLOCKED                        0x00U
@@ -160,6 +167,10 @@ int8_t SCSI_ProcessCmd(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *cmd);
 void SCSI_SenseCode(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t sKey,
                     uint8_t ASC);
 
+void SCSI_UnitAttention(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t ASC);
+
+int8_t SCSI_MediaCplt(USBD_HandleTypeDef *pdev, uint8_t lun, int8_t status);
+
 /**
   * @}
   */
@@ -40,6 +40,9 @@ EndBSPDependencies */
 
 /* Includes ------------------------------------------------------------------*/
 #include "usbd_msc.h"
+#include "usbd_msc_cache.h"
+#include "usbd_msc_readahead.h"
+#include "usbd_msc_profile.h"
 
 
 /** @addtogroup STM32_USB_DEVICE_LIBRARY
@@ -91,6 +94,11 @@ EndBSPDependencies */
   * @{
   */
 
+/* The cache job of the current request is waiting for the backend */
+static uint8_t MSC_IoBusy = 0U;
+
+/* Flush everything at the next idle USBD_MSC_Process, set on USB suspend */
+static __IO uint8_t MSC_FlushRequest = 0U;
 
 USBD_ClassTypeDef  USBD_MSC =
 {
@@ -380,7 +388,8 @@ uint8_t USBD_MSC_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
           if ((req->wValue  == 0U) && (req->wLength == 1U) &&
               ((req->bmRequest & 0x80U) == 0x80U))
           {
-            hmsc->max_lun = (uint32_t)((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->GetMaxLun();
+            hmsc->max_lun = MIN((uint32_t)((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->GetMaxLun(),
+                                MSC_MAX_LUN - 1U);
             (void)USBD_CtlSendData(pdev, (uint8_t *)&hmsc->max_lun, 1U);
           }
           else
@@ -575,6 +584,165 @@ uint8_t USBD_MSC_RegisterStorage(USBD_HandleTypeDef *pdev, USBD_StorageTypeDef *
   return (uint8_t)USBD_OK;
 }
 
+/**
+  * @brief  USBD_MSC_GetStats
+  *         return the MSC transfer counters
+  * @param  pdev: device instance
+  * @retval pointer to the counters, NULL if the class is not initialized
+  */
+USBD_MSC_StatsTypeDef *USBD_MSC_GetStats(USBD_HandleTypeDef *pdev)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+
+  if (hmsc == NULL)
+  {
+    return NULL;
+  }
+
+  return &hmsc->stats;
+}
+
+/**
+  * @brief  USBD_MSC_Process
+  *         Run the pending media request. Call it from the main loop: the
+  *         BOT keeps its endpoints NAKing until the request completes here.
+  * @param  pdev: device instance
+  * @retval None
+  */
+void USBD_MSC_Process(USBD_HandleTypeDef *pdev)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+  USBD_StorageTypeDef *fops = (USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID];
+  USBD_MSC_IoTypeDef req;
+  uint16_t blk_size;
+  int8_t ret;
+
+  if (fops == NULL)
+  {
+    return;
+  }
+
+  /* A prefetch reading in the background owns the backend until it is done */
+  if (MSC_RA_Poll(fops) != 0U)
+  {
+    return;
+  }
+
+  /* A cache job waiting for the backend: a request, or a background flush */
+  if (MSC_Cache_IsBusy() != 0U)
+  {
+    USBD_ENTER_CRITICAL();
+
+    /* A bus reset or re-enumeration took the buffer of the request away */
+    if ((MSC_IoBusy != 0U) && ((hmsc == NULL) || (hmsc->io.state != MSC_IO_ACTIVE)))
+    {
+      MSC_Cache_Cancel();
+    }
+
+    USBD_EXIT_CRITICAL();
+
+    ret = MSC_Cache_Poll(fops);
+
+    if ((ret > 0) || (MSC_IoBusy == 0U))
+    {
+      return;
+    }
+
+    MSC_IoBusy = 0U;
+  }
+  else
+  {
+    USBD_ENTER_CRITICAL();
+
+    if ((hmsc == NULL) || (hmsc->io.state != MSC_IO_PENDING))
+    {
+      USBD_EXIT_CRITICAL();
+
+      /* Nothing queued: run the deferred flushes */
+      if (MSC_FlushRequest != 0U)
+      {
+        MSC_FlushRequest = 0U;
+        (void)MSC_Cache_FlushAll(fops);
+      }
+      else
+      {
+        MSC_Cache_Idle(fops);
+
+        if (MSC_Cache_IsBusy() == 0U)
+        {
+          MSC_RA_Prefetch(pdev, fops);
+        }
+      }
+      return;
+    }
+
+    hmsc->io.state = MSC_IO_ACTIVE;
+    req = hmsc->io;
+    blk_size = hmsc->scsi_lun[req.lun].blk_size;
+
+    USBD_EXIT_CRITICAL();
+
+    MSC_Prof_MediaStart(req.op);
+
+    if (req.op == MSC_IO_READ)
+    {
+      if (MSC_RA_Copy(req.lun, req.buf, req.blk_addr, req.blk_len, blk_size) != 0U)
+      {
+        ret = 0;
+      }
+      else
+      {
+        ret = MSC_Cache_Read(fops, req.lun, req.buf, req.blk_addr, req.blk_len, blk_size);
+      }
+    }
+    else if (req.op == MSC_IO_WRITE)
+    {
+      ret = MSC_Cache_Write(fops, req.lun, req.buf, req.blk_addr, req.blk_len, blk_size);
+    }
+    else if (req.op == MSC_IO_UNMAP)
+    {
+      ret = MSC_Cache_Unmap(fops, req.lun, req.buf, req.blk_len);
+    }
+    else
+    {
+      ret = MSC_Cache_Flush(fops, req.lun);
+    }
+
+    if (ret > 0)
+    {
+      MSC_IoBusy = 1U;
+      return;
+    }
+  }
+
+  USBD_ENTER_CRITICAL();
+
+  /* A bus reset or re-enumeration meanwhile cancels the request */
+  if ((hmsc != NULL) && (pdev->pClassDatas[USBD_MSC_CLASS_ID] == hmsc) &&
+      (hmsc->io.state == MSC_IO_ACTIVE))
+  {
+    hmsc->io.state = MSC_IO_IDLE;
+    MSC_Prof_MediaEnd();
+    MSC_BOT_MediaCplt(pdev, ret);
+  }
+
+  USBD_EXIT_CRITICAL();
+}
+
+/**
+  * @brief  USBD_MSC_RequestFlush
+  *         Ask USBD_MSC_Process to flush the cache and the backends once no
+  *         media request is in progress. Safe to call from the USB interrupt.
+  * @param  pdev: device instance
+  * @retval None
+  */
+void USBD_MSC_RequestFlush(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+
+  MSC_FlushRequest = 1U;
+}
+
 /**
   * @}
   */
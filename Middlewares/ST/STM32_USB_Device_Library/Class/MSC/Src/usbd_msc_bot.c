@@ -27,6 +27,7 @@ EndBSPDependencies */
 #include "usbd_msc_bot.h"
 #include "usbd_msc.h"
 #include "usbd_msc_scsi.h"
+#include "usbd_msc_profile.h"
 #include "usbd_ioreq.h"
 
 /** @addtogroup STM32_USB_DEVICE_LIBRARY
@@ -98,6 +99,9 @@ static void MSC_BOT_Abort(USBD_HandleTypeDef *pdev);
 void MSC_BOT_Init(USBD_HandleTypeDef *pdev)
 {
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+  USBD_StorageTypeDef *fops = (USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID];
+  USBD_MSC_LunTypeDef *plun;
+  uint8_t lun;
 
   if (hmsc == NULL)
   {
@@ -107,11 +111,35 @@ void MSC_BOT_Init(USBD_HandleTypeDef *pdev)
   hmsc->bot_state = USBD_BOT_IDLE;
   hmsc->bot_status = USBD_BOT_STATUS_NORMAL;
 
-  hmsc->scsi_sense_tail = 0U;
-  hmsc->scsi_sense_head = 0U;
-  hmsc->scsi_medium_state = SCSI_MEDIUM_UNLOCKED;
+  hmsc->max_lun = MIN((uint32_t)fops->GetMaxLun(), MSC_MAX_LUN - 1U);
 
-  ((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->Init(0U);
+  hmsc->rd_buf[0] = hmsc->bot_data;
+  hmsc->rd_buf[1] = hmsc->bot_data_pp;
+  hmsc->rd_ptr[0] = NULL;
+  hmsc->rd_ptr[1] = NULL;
+  hmsc->rd_tx = 0U;
+  hmsc->rd_inflight = 0U;
+  hmsc->io.state = MSC_IO_IDLE;
+  (void)USBD_memset(&hmsc->stats, 0, sizeof(hmsc->stats));
+  MSC_Prof_Reset();
+
+  for (lun = 0U; lun <= hmsc->max_lun; lun++)
+  {
+    plun = &hmsc->scsi_lun[lun];
+    plun->sense_tail = 0U;
+    plun->sense_head = 0U;
+    plun->medium_state = SCSI_MEDIUM_UNLOCKED;
+    plun->unit_attention = 0U;
+
+    (void)fops->Init(lun);
+
+    /* READ CAPACITY refreshes this, but a host may skip it for some LUNs */
+    if (fops->GetCapacity(lun, &plun->blk_nbr, &plun->blk_size) != 0)
+    {
+      plun->blk_nbr = 0U;
+      plun->blk_size = MSC_MEDIA_PACKET;
+    }
+  }
 
   (void)USBD_LL_FlushEP(pdev, MSC_EPOUT_ADDR);
   (void)USBD_LL_FlushEP(pdev, MSC_EPIN_ADDR);
@@ -138,6 +166,7 @@ void MSC_BOT_Reset(USBD_HandleTypeDef *pdev)
 
   hmsc->bot_state  = USBD_BOT_IDLE;
   hmsc->bot_status = USBD_BOT_STATUS_RECOVERY;
+  hmsc->io.state = MSC_IO_IDLE;
 
   (void)USBD_LL_ClearStallEP(pdev, MSC_EPIN_ADDR);
   (void)USBD_LL_ClearStallEP(pdev, MSC_EPOUT_ADDR);
@@ -160,6 +189,7 @@ void MSC_BOT_DeInit(USBD_HandleTypeDef  *pdev)
   if (hmsc != NULL)
   {
     hmsc->bot_state = USBD_BOT_IDLE;
+    hmsc->io.state = MSC_IO_IDLE;
   }
 }
 
@@ -190,8 +220,13 @@ void MSC_BOT_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
       }
       break;
 
-    case USBD_BOT_SEND_DATA:
     case USBD_BOT_LAST_DATA_IN:
+      hmsc->stats.rd_cmds++;
+      hmsc->stats.rd_ticks += USBD_GetTick() - hmsc->rd_start;
+      MSC_BOT_SendCSW(pdev, USBD_CSW_CMD_PASSED);
+      break;
+
+    case USBD_BOT_SEND_DATA:
       MSC_BOT_SendCSW(pdev, USBD_CSW_CMD_PASSED);
       break;
 
@@ -255,7 +290,7 @@ static void  MSC_BOT_CBW_Decode(USBD_HandleTypeDef *pdev)
 
   if ((USBD_LL_GetRxDataSize(pdev, MSC_EPOUT_ADDR) != USBD_BOT_CBW_LENGTH) ||
       (hmsc->cbw.dSignature != USBD_BOT_CBW_SIGNATURE) ||
-      (hmsc->cbw.bLUN > 1U) || (hmsc->cbw.bCBLength < 1U) ||
+      (hmsc->cbw.bLUN > hmsc->max_lun) || (hmsc->cbw.bCBLength < 1U) ||
       (hmsc->cbw.bCBLength > 16U))
   {
     SCSI_SenseCode(pdev, hmsc->cbw.bLUN, ILLEGAL_REQUEST, INVALID_CDB);
@@ -265,6 +300,8 @@ static void  MSC_BOT_CBW_Decode(USBD_HandleTypeDef *pdev)
   }
   else
   {
+    MSC_Prof_CmdStart();
+
     if (SCSI_ProcessCmd(pdev, hmsc->cbw.bLUN, &hmsc->cbw.CB[0]) < 0)
     {
       if (hmsc->bot_state == USBD_BOT_NO_DATA)
@@ -279,7 +316,8 @@ static void  MSC_BOT_CBW_Decode(USBD_HandleTypeDef *pdev)
     /* Burst xfer handled internally */
     else if ((hmsc->bot_state != USBD_BOT_DATA_IN) &&
              (hmsc->bot_state != USBD_BOT_DATA_OUT) &&
-             (hmsc->bot_state != USBD_BOT_LAST_DATA_IN))
+             (hmsc->bot_state != USBD_BOT_LAST_DATA_IN) &&
+             (hmsc->bot_state != USBD_BOT_MEDIA_WAIT))
     {
       if (hmsc->bot_data_length > 0U)
       {
@@ -347,6 +385,8 @@ void  MSC_BOT_SendCSW(USBD_HandleTypeDef *pdev, uint8_t CSW_Status)
   hmsc->csw.bStatus = CSW_Status;
   hmsc->bot_state = USBD_BOT_IDLE;
 
+  MSC_Prof_CmdEnd(hmsc->cbw.CB[0], hmsc->cbw.dDataLength - hmsc->csw.dDataResidue, CSW_Status);
+
   (void)USBD_LL_Transmit(pdev, MSC_EPIN_ADDR, (uint8_t *)&hmsc->csw,
                          USBD_BOT_CSW_LENGTH);
 
@@ -355,6 +395,44 @@ void  MSC_BOT_SendCSW(USBD_HandleTypeDef *pdev, uint8_t CSW_Status)
                                USBD_BOT_CBW_LENGTH);
 }
 
+/**
+  * @brief  MSC_BOT_MediaCplt
+  *         Resume the data phase held while a media request was running
+  * @param  pdev: device instance
+  * @param  status : media request status
+  * @retval None
+  */
+void  MSC_BOT_MediaCplt(USBD_HandleTypeDef *pdev, int8_t status)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+
+  if (hmsc == NULL)
+  {
+    return;
+  }
+
+  if ((hmsc->bot_state != USBD_BOT_DATA_IN) &&
+      (hmsc->bot_state != USBD_BOT_DATA_OUT) &&
+      (hmsc->bot_state != USBD_BOT_MEDIA_WAIT))
+  {
+    return;
+  }
+
+  if (SCSI_MediaCplt(pdev, hmsc->cbw.bLUN, status) < 0)
+  {
+    /* Nothing sent yet: fail the command the way MSC_BOT_CBW_Decode does */
+    if ((hmsc->bot_state == USBD_BOT_DATA_IN) &&
+        (hmsc->csw.dDataResidue == hmsc->cbw.dDataLength))
+    {
+      MSC_BOT_Abort(pdev);
+    }
+    else
+    {
+      MSC_BOT_SendCSW(pdev, USBD_CSW_CMD_FAILED);
+    }
+  }
+}
+
 /**
   * @brief  MSC_BOT_Abort
   *         Abort the current transfer
@@ -0,0 +1,913 @@
+/**
+  ******************************************************************************
+  * @file    usbd_msc_cache.c
+  * @author  MCD Application Team
+  * @brief   This file provides a write-back LRU block cache that sits between
+  *          the SCSI layer and the storage backends.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                MSC Block Cache
+  *          ===================================================================
+  *           Every block of a cached LUN goes through a small pool of lines:
+  *             - reads fill a line on miss, writes only mark it dirty
+  *             - the least recently used line is evicted, written back first
+  *               when dirty
+  *             - dirty lines are written back in ascending block order on
+  *               idle time, SYNCHRONIZE CACHE, eject and USB suspend
+  *           All functions run from USBD_MSC_Process, never from the USB
+  *           interrupt. Each request or flush is a job that goes through the
+  *           backend one access at a time: when the backend returns
+  *           MSC_MEDIA_BUSY the job keeps its line and stage and returns
+  *           MSC_MEDIA_BUSY too, USBD_MSC_Process then calls MSC_Cache_Poll
+  *           on its next runs until the job completes.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2015 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                      www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_msc_cache.h"
+
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+
+/** @defgroup MSC_CACHE
+  * @brief Mass storage block cache module
+  * @{
+  */
+
+/** @defgroup MSC_CACHE_Private_Defines
+  * @{
+  */
+#define MSC_CACHE_OP_NONE         0U
+#define MSC_CACHE_OP_READ         1U
+#define MSC_CACHE_OP_WRITE        2U
+#define MSC_CACHE_OP_FLUSH        3U
+#define MSC_CACHE_OP_UNMAP        4U
+#define MSC_CACHE_OP_FLUSH_ALL    5U
+
+#define MSC_CACHE_STAGE_NONE      0U   /* nothing in the backend */
+#define MSC_CACHE_STAGE_WRITEBACK 1U   /* a dirty line is being written */
+#define MSC_CACHE_STAGE_FILL      2U   /* a line is being read */
+#define MSC_CACHE_STAGE_LAST      3U   /* final access of the op, or of a range or LUN */
+#define MSC_CACHE_STAGE_DONE      4U   /* nothing left to do */
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_CACHE_Private_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  uint32_t blk_addr;
+  uint32_t stamp;       /* LRU clock at the last access */
+  uint8_t lun;
+  uint8_t valid;
+  uint8_t dirty;
+  uint8_t data[MSC_CACHE_LINE_SIZE];
+} MSC_CacheLineTypeDef;
+
+typedef struct
+{
+  uint8_t *buf;                 /* caller data, or the UNMAP ranges */
+  MSC_CacheLineTypeDef *line;   /* line of the access in flight */
+  uint32_t blk_addr;
+  uint32_t idx;                 /* blocks, ranges or LUNs done */
+  uint32_t nbr;                 /* blocks, ranges or LUNs to do */
+  uint16_t blk_size;
+  uint8_t op;                   /* MSC_CACHE_OP_NONE when no job runs */
+  uint8_t stage;
+  uint8_t lun;                  /* LUN of the request */
+  uint8_t io_lun;               /* LUN of the access in flight, for Poll */
+  uint8_t flushed;              /* the current LUN was counted as flushed */
+  uint8_t cancel;               /* buf is gone, stop after the access in flight */
+  uint8_t err;                  /* FLUSH ALL: some LUN failed */
+} MSC_CacheJobTypeDef;
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_CACHE_Private_Variables
+  * @{
+  */
+static MSC_CacheLineTypeDef MSC_CacheLines[MSC_CACHE_BLK_NBR];
+static MSC_CacheJobTypeDef MSC_CacheJob;
+static uint16_t MSC_CacheDirty[MSC_MAX_LUN];   /* dirty lines of each LUN */
+static uint32_t MSC_CacheClock = 0U;
+static uint32_t MSC_CacheLastTick = 0U;
+static uint8_t MSC_CachePending = 0U;          /* writes since the last flush */
+static USBD_MSC_CacheStatsTypeDef MSC_CacheStats;
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_CACHE_Private_FunctionPrototypes
+  * @{
+  */
+static uint8_t MSC_Cache_Bypass(uint8_t lun, uint16_t blk_size);
+static int8_t MSC_Cache_Run(USBD_StorageTypeDef *fops, int8_t status);
+static uint8_t MSC_Cache_Complete(void);
+static int8_t MSC_Cache_End(int8_t status);
+static int8_t MSC_Cache_Step(USBD_StorageTypeDef *fops);
+static int8_t MSC_Cache_StepRead(USBD_StorageTypeDef *fops);
+static int8_t MSC_Cache_StepWrite(USBD_StorageTypeDef *fops);
+static int8_t MSC_Cache_StepFlush(USBD_StorageTypeDef *fops, uint8_t lun);
+static int8_t MSC_Cache_StepUnmap(USBD_StorageTypeDef *fops);
+static int8_t MSC_Cache_Start(USBD_StorageTypeDef *fops, MSC_CacheLineTypeDef *line,
+                              uint8_t stage);
+static MSC_CacheLineTypeDef *MSC_Cache_Find(uint8_t lun, uint32_t blk_addr);
+static MSC_CacheLineTypeDef *MSC_Cache_Victim(void);
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_CACHE_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  MSC_Cache_IsCached
+  *         Tell whether a LUN goes through the cache
+  * @param  lun: Logical unit number
+  * @retval 1 if cached, 0 otherwise
+  */
+uint8_t MSC_Cache_IsCached(uint8_t lun)
+{
+  if ((lun >= MSC_MAX_LUN) || (((MSC_CACHE_LUN_MASK >> lun) & 1U) == 0U))
+  {
+    return 0U;
+  }
+
+  return 1U;
+}
+
+/**
+  * @brief  MSC_Cache_IsDirty
+  *         Tell whether the backend of a LUN is missing cached writes, in
+  *         which case its memory must not be mapped for reading
+  * @param  lun: Logical unit number
+  * @retval 1 if the LUN has dirty lines, 0 otherwise
+  */
+uint8_t MSC_Cache_IsDirty(uint8_t lun)
+{
+  if ((lun >= MSC_MAX_LUN) || (MSC_CacheDirty[lun] == 0U))
+  {
+    return 0U;
+  }
+
+  return 1U;
+}
+
+/**
+  * @brief  MSC_Cache_IsDirtyRange
+  *         Tell whether the backend is missing cached writes for some of the
+  *         blocks of a range
+  * @param  lun: Logical unit number
+  * @param  blk_addr: first block
+  * @param  blk_len: number of blocks
+  * @retval 1 if a dirty line falls in the range, 0 otherwise
+  */
+uint8_t MSC_Cache_IsDirtyRange(uint8_t lun, uint32_t blk_addr, uint32_t blk_len)
+{
+  uint32_t i;
+
+  if (MSC_Cache_IsDirty(lun) == 0U)
+  {
+    return 0U;
+  }
+
+  for (i = 0U; i < MSC_CACHE_BLK_NBR; i++)
+  {
+    if ((MSC_CacheLines[i].dirty != 0U) && (MSC_CacheLines[i].lun == lun) &&
+        (MSC_CacheLines[i].blk_addr >= blk_addr) &&
+        ((MSC_CacheLines[i].blk_addr - blk_addr) < blk_len))
+    {
+      return 1U;
+    }
+  }
+
+  return 0U;
+}
+
+/**
+  * @brief  MSC_Cache_IsBusy
+  *         Tell whether a job is waiting for the backend
+  * @retval 1 if MSC_Cache_Poll must be called, 0 otherwise
+  */
+uint8_t MSC_Cache_IsBusy(void)
+{
+  return (MSC_CacheJob.op != MSC_CACHE_OP_NONE) ? 1U : 0U;
+}
+
+/**
+  * @brief  MSC_Cache_Read
+  *         Read blocks through the cache
+  * @param  fops: storage backend
+  * @param  lun: Logical unit number
+  * @param  buf: destination
+  * @param  blk_addr: first block
+  * @param  blk_len: number of blocks
+  * @param  blk_size: block size of the LUN
+  * @retval status, MSC_MEDIA_BUSY while the job waits for the backend
+  */
+int8_t MSC_Cache_Read(USBD_StorageTypeDef *fops, uint8_t lun, uint8_t *buf,
+                      uint32_t blk_addr, uint16_t blk_len, uint16_t blk_size)
+{
+  MSC_CacheJobTypeDef *job = &MSC_CacheJob;
+
+  if (job->op != MSC_CACHE_OP_NONE)
+  {
+    return -1;
+  }
+
+  if (MSC_Cache_IsCached(lun) != 0U)
+  {
+    MSC_CacheLastTick = USBD_GetTick();
+  }
+
+  (void)USBD_memset(job, 0, sizeof(*job));
+  job->op = MSC_CACHE_OP_READ;
+  job->lun = lun;
+  job->buf = buf;
+  job->blk_addr = blk_addr;
+  job->nbr = blk_len;
+  job->blk_size = blk_size;
+
+  return MSC_Cache_Run(fops, 0);
+}
+
+/**
+  * @brief  MSC_Cache_Write
+  *         Write blocks into the cache, the backend is updated on eviction
+  *         or flush
+  * @param  fops: storage backend
+  * @param  lun: Logical unit number
+  * @param  buf: source
+  * @param  blk_addr: first block
+  * @param  blk_len: number of blocks
+  * @param  blk_size: block size of the LUN
+  * @retval status, MSC_MEDIA_BUSY while the job waits for the backend
+  */
+int8_t MSC_Cache_Write(USBD_StorageTypeDef *fops, uint8_t lun, uint8_t *buf,
+                       uint32_t blk_addr, uint16_t blk_len, uint16_t blk_size)
+{
+  MSC_CacheJobTypeDef *job = &MSC_CacheJob;
+
+  if (job->op != MSC_CACHE_OP_NONE)
+  {
+    return -1;
+  }
+
+  MSC_CacheLastTick = USBD_GetTick();
+  MSC_CachePending = 1U;
+
+  (void)USBD_memset(job, 0, sizeof(*job));
+  job->op = MSC_CACHE_OP_WRITE;
+  job->lun = lun;
+  job->buf = buf;
+  job->blk_addr = blk_addr;
+  job->nbr = blk_len;
+  job->blk_size = blk_size;
+
+  return MSC_Cache_Run(fops, 0);
+}
+
+/**
+  * @brief  MSC_Cache_Flush
+  *         Write back the dirty lines of a LUN, then flush the backend
+  * @param  fops: storage backend
+  * @param  lun: Logical unit number
+  * @retval status, MSC_MEDIA_BUSY while the job waits for the backend
+  */
+int8_t MSC_Cache_Flush(USBD_StorageTypeDef *fops, uint8_t lun)
+{
+  MSC_CacheJobTypeDef *job = &MSC_CacheJob;
+
+  if (job->op != MSC_CACHE_OP_NONE)
+  {
+    return -1;
+  }
+
+  (void)USBD_memset(job, 0, sizeof(*job));
+  job->op = MSC_CACHE_OP_FLUSH;
+  job->lun = lun;
+
+  return MSC_Cache_Run(fops, 0);
+}
+
+/**
+  * @brief  MSC_Cache_Unmap
+  *         Drop the cached blocks of each range, dirty ones included, then
+  *         unmap it in the backend
+  * @param  fops: storage backend
+  * @param  lun: Logical unit number
+  * @param  ranges: USBD_MSC_RangeTypeDef entries, may be unaligned
+  * @param  nbr: number of ranges
+  * @retval status, MSC_MEDIA_BUSY while the job waits for the backend
+  */
+int8_t MSC_Cache_Unmap(USBD_StorageTypeDef *fops, uint8_t lun,
+                       uint8_t *ranges, uint16_t nbr)
+{
+  MSC_CacheJobTypeDef *job = &MSC_CacheJob;
+
+  if (job->op != MSC_CACHE_OP_NONE)
+  {
+    return -1;
+  }
+
+  (void)USBD_memset(job, 0, sizeof(*job));
+  job->op = MSC_CACHE_OP_UNMAP;
+  job->lun = lun;
+  job->buf = ranges;
+  job->nbr = nbr;
+
+  return MSC_Cache_Run(fops, 0);
+}
+
+/**
+  * @brief  MSC_Cache_FlushAll
+  *         Flush every LUN of the backend
+  * @param  fops: storage backend
+  * @retval status, MSC_MEDIA_BUSY while the job waits for the backend
+  */
+int8_t MSC_Cache_FlushAll(USBD_StorageTypeDef *fops)
+{
+  MSC_CacheJobTypeDef *job = &MSC_CacheJob;
+
+  if (job->op != MSC_CACHE_OP_NONE)
+  {
+    return -1;
+  }
+
+  (void)USBD_memset(job, 0, sizeof(*job));
+  job->op = MSC_CACHE_OP_FLUSH_ALL;
+  job->nbr = MIN((uint32_t)fops->GetMaxLun(), MSC_MAX_LUN - 1U) + 1U;
+
+  return MSC_Cache_Run(fops, 0);
+}
+
+/**
+  * @brief  MSC_Cache_Idle
+  *         Start flushing everything once no media access happened for
+  *         MSC_CACHE_IDLE_MS
+  * @param  fops: storage backend
+  * @retval None
+  */
+void MSC_Cache_Idle(USBD_StorageTypeDef *fops)
+{
+  if ((MSC_CacheJob.op == MSC_CACHE_OP_NONE) && (MSC_CachePending != 0U) &&
+      ((USBD_GetTick() - MSC_CacheLastTick) >= MSC_CACHE_IDLE_MS))
+  {
+    (void)MSC_Cache_FlushAll(fops);
+  }
+}
+
+/**
+  * @brief  MSC_Cache_Poll
+  *         Continue the job once the backend access in flight completes
+  * @param  fops: storage backend
+  * @retval status of the job, MSC_MEDIA_BUSY while it waits for the backend
+  */
+int8_t MSC_Cache_Poll(USBD_StorageTypeDef *fops)
+{
+  MSC_CacheJobTypeDef *job = &MSC_CacheJob;
+
+  if (job->op == MSC_CACHE_OP_NONE)
+  {
+    return 0;
+  }
+
+  return MSC_Cache_Run(fops, (fops->Poll != NULL) ? fops->Poll(job->io_lun) : -1);
+}
+
+/**
+  * @brief  MSC_Cache_Cancel
+  *         Stop the job after the access in flight, its caller buffer is
+  *         no longer valid. Cache lines and dirty state stay consistent.
+  * @retval None
+  */
+void MSC_Cache_Cancel(void)
+{
+  if (MSC_CacheJob.op != MSC_CACHE_OP_NONE)
+  {
+    MSC_CacheJob.cancel = 1U;
+  }
+}
+
+/**
+  * @brief  USBD_MSC_GetCacheStats
+  *         return the cache counters
+  * @retval pointer to the counters
+  */
+USBD_MSC_CacheStatsTypeDef *USBD_MSC_GetCacheStats(void)
+{
+  return &MSC_CacheStats;
+}
+
+/**
+  * @brief  MSC_Cache_Bypass
+  *         Tell whether a request goes straight to the backend
+  * @param  lun: Logical unit number
+  * @param  blk_size: block size of the LUN
+  * @retval 1 if uncached, 0 otherwise
+  */
+static uint8_t MSC_Cache_Bypass(uint8_t lun, uint16_t blk_size)
+{
+  if ((MSC_Cache_IsCached(lun) == 0U) || (blk_size > MSC_CACHE_LINE_SIZE))
+  {
+    return 1U;
+  }
+
+  return 0U;
+}
+
+/**
+  * @brief  MSC_Cache_Run
+  *         Apply the result of the access in flight and start the next ones
+  *         until the backend is busy or the job is over
+  * @param  fops: storage backend
+  * @param  status: result of the access in flight, 0 when starting a job
+  * @retval status of the job, MSC_MEDIA_BUSY while it waits for the backend
+  */
+static int8_t MSC_Cache_Run(USBD_StorageTypeDef *fops, int8_t status)
+{
+  MSC_CacheJobTypeDef *job = &MSC_CacheJob;
+  int8_t ret = status;
+
+  for (;;)
+  {
+    if (ret > 0)
+    {
+      return MSC_MEDIA_BUSY;
+    }
+
+    if (ret < 0)
+    {
+      /* FLUSH ALL moves on to the next LUN, anything else fails */
+      if ((job->op != MSC_CACHE_OP_FLUSH_ALL) || (job->cancel != 0U))
+      {
+        return MSC_Cache_End(-1);
+      }
+
+      job->err = 1U;
+      job->flushed = 0U;
+      job->idx++;
+      job->stage = MSC_CACHE_STAGE_NONE;
+    }
+    else if (MSC_Cache_Complete() != 0U)
+    {
+      return MSC_Cache_End(0);
+    }
+
+    if (job->cancel != 0U)
+    {
+      return MSC_Cache_End(-1);
+    }
+
+    ret = MSC_Cache_Step(fops);
+  }
+}
+
+/**
+  * @brief  MSC_Cache_Complete
+  *         Account for the access in flight once it succeeded
+  * @retval 1 if the job is over, 0 otherwise
+  */
+static uint8_t MSC_Cache_Complete(void)
+{
+  MSC_CacheJobTypeDef *job = &MSC_CacheJob;
+  MSC_CacheLineTypeDef *line = job->line;
+
+  switch (job->stage)
+  {
+    case MSC_CACHE_STAGE_WRITEBACK:
+      line->dirty = 0U;
+      MSC_CacheDirty[line->lun]--;
+      MSC_CacheStats.writebacks++;
+      break;
+
+    case MSC_CACHE_STAGE_FILL:
+      line->valid = 1U;
+      line->stamp = ++MSC_CacheClock;
+
+      if (job->cancel == 0U)
+      {
+        (void)USBD_memcpy(&job->buf[job->idx * job->blk_size], line->data, job->blk_size);
+      }
+      job->idx++;
+      break;
+
+    case MSC_CACHE_STAGE_LAST:
+      if ((job->op != MSC_CACHE_OP_UNMAP) && (job->op != MSC_CACHE_OP_FLUSH_ALL))
+      {
+        return 1U;
+      }
+
+      /* Next range or LUN */
+      job->flushed = 0U;
+      job->idx++;
+      break;
+
+    case MSC_CACHE_STAGE_DONE:
+      return 1U;
+
+    default:
+      break;
+  }
+
+  job->stage = MSC_CACHE_STAGE_NONE;
+  job->line = NULL;
+
+  return 0U;
+}
+
+/**
+  * @brief  MSC_Cache_End
+  *         Close the job
+  * @param  status: job result
+  * @retval status
+  */
+static int8_t MSC_Cache_End(int8_t status)
+{
+  MSC_CacheJobTypeDef *job = &MSC_CacheJob;
+  int8_t ret = status;
+
+  if (job->op == MSC_CACHE_OP_FLUSH_ALL)
+  {
+    if (job->err != 0U)
+    {
+      ret = -1;
+    }
+
+    MSC_CacheLastTick = USBD_GetTick();
+
+    if (ret == 0)
+    {
+      MSC_CachePending = 0U;
+    }
+  }
+
+  job->op = MSC_CACHE_OP_NONE;
+  job->stage = MSC_CACHE_STAGE_NONE;
+  job->line = NULL;
+  job->buf = NULL;
+
+  return ret;
+}
+
+/**
+  * @brief  MSC_Cache_Step
+  *         Start the next backend access of the job
+  * @param  fops: storage backend
+  * @retval backend status; 0 with stage DONE when nothing is left
+  */
+static int8_t MSC_Cache_Step(USBD_StorageTypeDef *fops)
+{
+  MSC_CacheJobTypeDef *job = &MSC_CacheJob;
+
+  switch (job->op)
+  {
+    case MSC_CACHE_OP_READ:
+      return MSC_Cache_StepRead(fops);
+
+    case MSC_CACHE_OP_WRITE:
+      return MSC_Cache_StepWrite(fops);
+
+    case MSC_CACHE_OP_FLUSH:
+      return MSC_Cache_StepFlush(fops, job->lun);
+
+    case MSC_CACHE_OP_UNMAP:
+      return MSC_Cache_StepUnmap(fops);
+
+    case MSC_CACHE_OP_FLUSH_ALL:
+      if (job->idx >= job->nbr)
+      {
+        job->stage = MSC_CACHE_STAGE_DONE;
+        return 0;
+      }
+      return MSC_Cache_StepFlush(fops, (uint8_t)job->idx);
+
+    default:
+      return -1;
+  }
+}
+
+/**
+  * @brief  MSC_Cache_StepRead
+  *         Copy the cached blocks, stop at the first one that needs a line
+  *         written back or filled
+  * @param  fops: storage backend
+  * @retval backend status
+  */
+static int8_t MSC_Cache_StepRead(USBD_StorageTypeDef *fops)
+{
+  MSC_CacheJobTypeDef *job = &MSC_CacheJob;
+  MSC_CacheLineTypeDef *line;
+  uint32_t blk_addr;
+
+  if (MSC_Cache_Bypass(job->lun, job->blk_size) != 0U)
+  {
+    job->stage = MSC_CACHE_STAGE_LAST;
+    job->io_lun = job->lun;
+    return fops->Read(job->lun, job->buf, job->blk_addr, (uint16_t)job->nbr);
+  }
+
+  while (job->idx < job->nbr)
+  {
+    blk_addr = job->blk_addr + job->idx;
+    line = MSC_Cache_Find(job->lun, blk_addr);
+
+    if (line == NULL)
+    {
+      line = MSC_Cache_Victim();
+
+      if (line->dirty != 0U)
+      {
+        return MSC_Cache_Start(fops, line, MSC_CACHE_STAGE_WRITEBACK);
+      }
+
+      MSC_CacheStats.misses++;
+      line->valid = 0U;
+      line->lun = job->lun;
+      line->blk_addr = blk_addr;
+
+      return MSC_Cache_Start(fops, line, MSC_CACHE_STAGE_FILL);
+    }
+
+    MSC_CacheStats.hits++;
+    line->stamp = ++MSC_CacheClock;
+    (void)USBD_memcpy(&job->buf[job->idx * job->blk_size], line->data, job->blk_size);
+    job->idx++;
+  }
+
+  job->stage = MSC_CACHE_STAGE_DONE;
+
+  return 0;
+}
+
+/**
+  * @brief  MSC_Cache_StepWrite
+  *         Copy blocks into lines, stop at the first victim that must be
+  *         written back
+  * @param  fops: storage backend
+  * @retval backend status
+  */
+static int8_t MSC_Cache_StepWrite(USBD_StorageTypeDef *fops)
+{
+  MSC_CacheJobTypeDef *job = &MSC_CacheJob;
+  MSC_CacheLineTypeDef *line;
+  uint32_t blk_addr;
+
+  if (MSC_Cache_Bypass(job->lun, job->blk_size) != 0U)
+  {
+    job->stage = MSC_CACHE_STAGE_LAST;
+    job->io_lun = job->lun;
+    return fops->Write(job->lun, job->buf, job->blk_addr, (uint16_t)job->nbr);
+  }
+
+  while (job->idx < job->nbr)
+  {
+    blk_addr = job->blk_addr + job->idx;
+    line = MSC_Cache_Find(job->lun, blk_addr);
+
+    if (line != NULL)
+    {
+      MSC_CacheStats.hits++;
+    }
+    else
+    {
+      line = MSC_Cache_Victim();
+
+      if (line->dirty != 0U)
+      {
+        return MSC_Cache_Start(fops, line, MSC_CACHE_STAGE_WRITEBACK);
+      }
+
+      MSC_CacheStats.misses++;
+      line->valid = 1U;
+      line->lun = job->lun;
+      line->blk_addr = blk_addr;
+    }
+
+    line->stamp = ++MSC_CacheClock;
+    (void)USBD_memcpy(line->data, &job->buf[job->idx * job->blk_size], job->blk_size);
+
+    if (line->dirty == 0U)
+    {
+      line->dirty = 1U;
+      MSC_CacheDirty[job->lun]++;
+    }
+
+    job->idx++;
+  }
+
+  job->stage = MSC_CACHE_STAGE_DONE;
+
+  return 0;
+}
+
+/**
+  * @brief  MSC_Cache_StepFlush
+  *         Write back the lowest dirty line of a LUN, so the backend sees
+  *         sequential writes, then flush the backend
+  * @param  fops: storage backend
+  * @param  lun: Logical unit number
+  * @retval backend status
+  */
+static int8_t MSC_Cache_StepFlush(USBD_StorageTypeDef *fops, uint8_t lun)
+{
+  MSC_CacheJobTypeDef *job = &MSC_CacheJob;
+  MSC_CacheLineTypeDef *line = NULL;
+  uint32_t i;
+
+  if (MSC_Cache_IsDirty(lun) != 0U)
+  {
+    for (i = 0U; i < MSC_CACHE_BLK_NBR; i++)
+    {
+      if ((MSC_CacheLines[i].dirty != 0U) && (MSC_CacheLines[i].lun == lun) &&
+          ((line == NULL) || (MSC_CacheLines[i].blk_addr < line->blk_addr)))
+      {
+        line = &MSC_CacheLines[i];
+      }
+    }
+
+    if (line == NULL)
+    {
+      return -1;
+    }
+
+    if (job->flushed == 0U)
+    {
+      job->flushed = 1U;
+      MSC_CacheStats.flushes++;
+    }
+
+    return MSC_Cache_Start(fops, line, MSC_CACHE_STAGE_WRITEBACK);
+  }
+
+  job->stage = MSC_CACHE_STAGE_LAST;
+  job->io_lun = lun;
+
+  return (fops->Flush != NULL) ? fops->Flush(lun) : 0;
+}
+
+/**
+  * @brief  MSC_Cache_StepUnmap
+  *         Drop the cached blocks of the next range and unmap it
+  * @param  fops: storage backend
+  * @retval backend status
+  */
+static int8_t MSC_Cache_StepUnmap(USBD_StorageTypeDef *fops)
+{
+  MSC_CacheJobTypeDef *job = &MSC_CacheJob;
+  MSC_CacheLineTypeDef *line;
+  USBD_MSC_RangeTypeDef range;
+  uint32_t i;
+
+  if (job->idx >= job->nbr)
+  {
+    job->stage = MSC_CACHE_STAGE_DONE;
+    return 0;
+  }
+
+  (void)USBD_memcpy(&range, &job->buf[job->idx * sizeof(range)], sizeof(range));
+
+  for (i = 0U; i < MSC_CACHE_BLK_NBR; i++)
+  {
+    line = &MSC_CacheLines[i];
+
+    if ((line->valid != 0U) && (line->lun == job->lun) &&
+        (line->blk_addr >= range.blk_addr) && ((line->blk_addr - range.blk_addr) < range.blk_len))
+    {
+      if (line->dirty != 0U)
+      {
+        line->dirty = 0U;
+        MSC_CacheDirty[job->lun]--;
+      }
+
+      line->valid = 0U;
+    }
+  }
+
+  if (fops->Unmap == NULL)
+  {
+    return -1;
+  }
+
+  job->stage = MSC_CACHE_STAGE_LAST;
+  job->io_lun = job->lun;
+
+  return fops->Unmap(job->lun, range.blk_addr, range.blk_len);
+}
+
+/**
+  * @brief  MSC_Cache_Start
+  *         Hand one line to the backend
+  * @param  fops: storage backend
+  * @param  line: line to write back or fill
+  * @param  stage: MSC_CACHE_STAGE_WRITEBACK or MSC_CACHE_STAGE_FILL
+  * @retval backend status
+  */
+static int8_t MSC_Cache_Start(USBD_StorageTypeDef *fops, MSC_CacheLineTypeDef *line,
+                              uint8_t stage)
+{
+  MSC_CacheJobTypeDef *job = &MSC_CacheJob;
+
+  job->line = line;
+  job->stage = stage;
+  job->io_lun = line->lun;
+
+  if (stage == MSC_CACHE_STAGE_WRITEBACK)
+  {
+    return fops->Write(line->lun, line->data, line->blk_addr, 1U);
+  }
+
+  return fops->Read(line->lun, line->data, line->blk_addr, 1U);
+}
+
+/**
+  * @brief  MSC_Cache_Find
+  *         Look up the line holding a block
+  * @param  lun: Logical unit number
+  * @param  blk_addr: block address
+  * @retval line, NULL on miss
+  */
+static MSC_CacheLineTypeDef *MSC_Cache_Find(uint8_t lun, uint32_t blk_addr)
+{
+  uint32_t i;
+
+  for (i = 0U; i < MSC_CACHE_BLK_NBR; i++)
+  {
+    if ((MSC_CacheLines[i].valid != 0U) && (MSC_CacheLines[i].lun == lun) &&
+        (MSC_CacheLines[i].blk_addr == blk_addr))
+    {
+      return &MSC_CacheLines[i];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  * @brief  MSC_Cache_Victim
+  *         Pick a free line, or the least recently used one. A dirty victim
+  *         must be written back before it is reused.
+  * @retval line
+  */
+static MSC_CacheLineTypeDef *MSC_Cache_Victim(void)
+{
+  MSC_CacheLineTypeDef *line = &MSC_CacheLines[0];
+  uint32_t i;
+
+  for (i = 0U; i < MSC_CACHE_BLK_NBR; i++)
+  {
+    if (MSC_CacheLines[i].valid == 0U)
+    {
+      return &MSC_CacheLines[i];
+    }
+
+    if ((MSC_CacheClock - MSC_CacheLines[i].stamp) > (MSC_CacheClock - line->stamp))
+    {
+      line = &MSC_CacheLines[i];
+    }
+  }
+
+  return line;
+}
+/**
+  * @}
+  */
+
+
+/**
+  * @}
+  */
+
+
+/**
+  * @}
+  */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
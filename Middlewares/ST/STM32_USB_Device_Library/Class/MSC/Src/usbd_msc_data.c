@@ -73,7 +73,9 @@ uint8_t MSC_Page00_Inquiry_Data[LENGTH_INQUIRY_PAGE00] =
   0x00,
   (LENGTH_INQUIRY_PAGE00 - 4U),
   0x00,
-  0x80
+  0x80,
+  0xB0,     /* Block Limits */
+  0xB2      /* Logical Block Provisioning */
 };
 
 /* USB Mass storage VPD Page 0x80 Inquiry Data for Unit Serial Number */
@@ -89,15 +91,16 @@ uint8_t MSC_Page80_Inquiry_Data[LENGTH_INQUIRY_PAGE80] =
   0x20
 };
 
-/* USB Mass storage sense 6 Data */
+/* USB Mass storage sense 6 Data: mode parameter header and caching page */
 uint8_t MSC_Mode_Sense6_data[MODE_SENSE6_LEN] =
 {
-  0x22,
+  0x17,                      /* mode data length */
   0x00,
   0x00,
   0x00,
-  0x08,
+  0x08,                      /* caching page */
   0x12,
+  0x00,                      /* WCE set at run time for writable LUNs */
   0x00,
   0x00,
   0x00,
@@ -118,19 +121,20 @@ uint8_t MSC_Mode_Sense6_data[MODE_SENSE6_LEN] =
 };
 
 
-/* USB Mass storage sense 10  Data */
+/* USB Mass storage sense 10 Data: mode parameter header and caching page */
 uint8_t MSC_Mode_Sense10_data[MODE_SENSE10_LEN] =
 {
-  0x00,
-  0x26,
+  0x00,                      /* mode data length */
+  0x1A,
   0x00,
   0x00,
   0x00,
   0x00,
   0x00,
   0x00,
-  0x08,
+  0x08,                      /* caching page */
   0x12,
+  0x00,                      /* WCE set at run time for writable LUNs */
   0x00,
   0x00,
   0x00,
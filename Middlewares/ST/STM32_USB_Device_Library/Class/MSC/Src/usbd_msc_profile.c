@@ -0,0 +1,254 @@
+/**
+  ******************************************************************************
+  * @file    usbd_msc_profile.c
+  * @author  MCD Application Team
+  * @brief   This file records where the time of each SCSI command goes,
+  *          per operation code, in CPU cycles.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                MSC Command Profile
+  *          ===================================================================
+  *           The BOT marks the arrival of each CBW and the sending of its
+  *           CSW; USBD_MSC_Process marks the media request it runs for the
+  *           command. For every opcode this gives:
+  *             - the number of commands and of bytes moved
+  *             - a log2 histogram and the maximum of the CBW to CSW latency
+  *             - the part of it spent in the backend, the rest being USB
+  *               transfers and the host
+  *           Cycles come from USBD_GetCycles, the DWT cycle counter.
+  *           The recorders run in the USB interrupt, or in thread mode with
+  *           the USB interrupt masked. USBD_MSC_GetProfile copies the table
+  *           under a sequence counter, retrying when an update came in, so
+  *           reading it never masks the interrupt nor delays a transfer.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2015 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                      www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_msc_profile.h"
+#include "usbd_msc_bot.h"
+
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+
+/** @defgroup MSC_PROFILE
+  * @brief Mass storage command profile module
+  * @{
+  */
+
+#if (MSC_PROF_ENABLE == 1U)
+
+/** @defgroup MSC_PROFILE_Private_Variables
+  * @{
+  */
+static USBD_MSC_ProfileTypeDef MSC_Prof;
+static __IO uint32_t MSC_ProfSeq = 0U;  /* odd while MSC_Prof is being updated */
+
+static uint8_t MSC_ProfCmd = 0U;        /* a CBW is being profiled */
+static uint32_t MSC_ProfCmdStart = 0U;
+static uint32_t MSC_ProfCmdMedia = 0U;  /* backend cycles of the current command */
+static uint8_t MSC_ProfMediaOp = 0U;
+static uint32_t MSC_ProfMediaStart = 0U;
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_PROFILE_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  MSC_Prof_Reset
+  *         Clear the profile and start the cycle counter
+  * @retval None
+  */
+void MSC_Prof_Reset(void)
+{
+  USBD_CyclesInit();
+
+  MSC_ProfSeq++;
+  (void)USBD_memset(&MSC_Prof, 0, sizeof(MSC_Prof));
+  MSC_ProfSeq++;
+
+  MSC_ProfCmd = 0U;
+}
+
+/**
+  * @brief  MSC_Prof_CmdStart
+  *         Mark the arrival of a valid CBW. Called from the USB interrupt.
+  * @retval None
+  */
+void MSC_Prof_CmdStart(void)
+{
+  MSC_ProfCmd = 1U;
+  MSC_ProfCmdStart = USBD_GetCycles();
+  MSC_ProfCmdMedia = 0U;
+}
+
+/**
+  * @brief  MSC_Prof_CmdEnd
+  *         Account the command whose CSW is being sent
+  * @param  opcode: SCSI operation code of the CBW
+  * @param  bytes: bytes moved in the data phase
+  * @param  status: CSW status
+  * @retval None
+  */
+void MSC_Prof_CmdEnd(uint8_t opcode, uint32_t bytes, uint8_t status)
+{
+  USBD_MSC_ProfSlotTypeDef *slot;
+  uint32_t cycles;
+  uint32_t bin;
+  uint8_t i;
+
+  if (MSC_ProfCmd == 0U)
+  {
+    return;
+  }
+
+  MSC_ProfCmd = 0U;
+  cycles = USBD_GetCycles() - MSC_ProfCmdStart;
+
+  MSC_ProfSeq++;
+
+  for (i = 0U; (i < MSC_Prof.used) && (MSC_Prof.slot[i].opcode != opcode); i++)
+  {
+  }
+
+  if (i == MSC_Prof.used)
+  {
+    if (MSC_Prof.used < (MSC_PROF_SLOTS - 1U))
+    {
+      MSC_Prof.used++;
+      MSC_Prof.slot[i].opcode = opcode;
+    }
+    else
+    {
+      i = MSC_PROF_SLOTS - 1U;
+      MSC_Prof.used = MSC_PROF_SLOTS;
+      MSC_Prof.slot[i].opcode = MSC_PROF_OTHER;
+    }
+  }
+
+  slot = &MSC_Prof.slot[i];
+  slot->count++;
+  slot->bytes += bytes;
+  slot->cycles += cycles;
+  slot->media_cycles += MSC_ProfCmdMedia;
+  slot->max_cycles = MAX(slot->max_cycles, cycles);
+
+  if (status != USBD_CSW_CMD_PASSED)
+  {
+    slot->failed++;
+  }
+
+  for (bin = 0U; (cycles >> (bin + 1U)) != 0U; bin++)
+  {
+  }
+  slot->hist[bin]++;
+
+  if (cycles > MSC_ProfCmdMedia)
+  {
+    MSC_Prof.bus_cycles += cycles - MSC_ProfCmdMedia;
+  }
+
+  MSC_ProfSeq++;
+}
+
+/**
+  * @brief  MSC_Prof_MediaStart
+  *         Mark the start of a media request in USBD_MSC_Process
+  * @param  op: MSC_IO_READ, MSC_IO_WRITE, MSC_IO_FLUSH or MSC_IO_UNMAP
+  * @retval None
+  */
+void MSC_Prof_MediaStart(uint8_t op)
+{
+  MSC_ProfMediaOp = op;
+  MSC_ProfMediaStart = USBD_GetCycles();
+}
+
+/**
+  * @brief  MSC_Prof_MediaEnd
+  *         Account the media request that just completed. Called with the
+  *         USB interrupt masked, before the command is resumed.
+  * @retval None
+  */
+void MSC_Prof_MediaEnd(void)
+{
+  uint32_t cycles = USBD_GetCycles() - MSC_ProfMediaStart;
+
+  MSC_ProfCmdMedia += cycles;
+
+  MSC_ProfSeq++;
+
+  if (MSC_ProfMediaOp == MSC_IO_READ)
+  {
+    MSC_Prof.read_cycles += cycles;
+  }
+  else if (MSC_ProfMediaOp == MSC_IO_WRITE)
+  {
+    MSC_Prof.write_cycles += cycles;
+  }
+  else
+  {
+    MSC_Prof.other_cycles += cycles;
+  }
+
+  MSC_ProfSeq++;
+}
+
+/**
+  * @brief  USBD_MSC_GetProfile
+  *         Take a consistent copy of the profile. Call it from thread mode.
+  * @param  snapshot: destination of the copy
+  * @retval number of slots in use
+  */
+uint8_t USBD_MSC_GetProfile(USBD_MSC_ProfileTypeDef *snapshot)
+{
+  uint32_t seq;
+
+  do
+  {
+    seq = MSC_ProfSeq;
+    __DMB();
+    (void)USBD_memcpy(snapshot, &MSC_Prof, sizeof(MSC_Prof));
+    __DMB();
+  } while (((seq & 1U) != 0U) || (seq != MSC_ProfSeq));
+
+  return snapshot->used;
+}
+/**
+  * @}
+  */
+
+#endif /* MSC_PROF_ENABLE */
+
+
+/**
+  * @}
+  */
+
+
+/**
+  * @}
+  */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
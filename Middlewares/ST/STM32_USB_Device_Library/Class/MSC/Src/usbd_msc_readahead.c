@@ -0,0 +1,396 @@
+/**
+  ******************************************************************************
+  * @file    usbd_msc_readahead.c
+  * @author  MCD Application Team
+  * @brief   This file provides a sequential read-ahead for the READ commands
+  *          of backends that cannot be memory-mapped.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                MSC Read-Ahead
+  *          ===================================================================
+  *           Every READ command is tracked against the end of the previous
+  *           one. Once MSC_RA_MIN_RUN commands in a row continue the same
+  *           run, USBD_MSC_Process uses the CSW/CBW round-trip to read the
+  *           next MSC_RA_BLK_NBR blocks into a prefetch window:
+  *             - a READ starting inside the window is sent straight from it
+  *               by the USB interrupt, without waiting for the worker
+  *             - a queued Read covered by the window is copied from it
+  *             - once the host has used half of the window, the rest slides
+  *               to the front and the following blocks are read behind it,
+  *               so a stream stays ahead of the host
+  *             - any WRITE to the LUN drops the window, and cancels a fill
+  *               in progress
+  *           Only the LUNs of MSC_RA_LUN_MASK are prefetched: a backend whose
+  *           content changes without a WRITE (generated or reflashed) must be
+  *           left out. A backend returning MSC_MEDIA_BUSY is polled by
+  *           MSC_RA_Poll on the next USBD_MSC_Process calls.
+  *           The hit rate is hits / blocks of USBD_MSC_GetReadAheadStats.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2015 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                      www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_msc_readahead.h"
+#include "usbd_msc_cache.h"
+#include "usbd_msc_bot.h"
+#include "usbd_msc_scsi.h"
+
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+
+/** @defgroup MSC_READAHEAD
+  * @brief Mass storage read-ahead module
+  * @{
+  */
+
+/** @defgroup MSC_READAHEAD_Private_Variables
+  * @{
+  */
+static uint8_t MSC_RA_Buf[MSC_RA_BUF_SIZE];
+
+/* Prefetch window, only read by the interrupt while MSC_RA_Valid is set */
+static uint8_t MSC_RA_Valid = 0U;
+static uint8_t MSC_RA_Lun = 0U;
+static uint16_t MSC_RA_BlkSize = 0U;
+static uint32_t MSC_RA_Addr = 0U;
+static uint32_t MSC_RA_Cnt = 0U;
+static uint32_t MSC_RA_Gen = 0U;        /* bumped by every invalidation */
+
+/* Stream detector, updated at the start of each READ */
+static uint8_t MSC_RA_StreamLun = 0U;
+static uint8_t MSC_RA_Run = 0U;         /* READs in a row continuing the run */
+static uint32_t MSC_RA_Next = 0U;       /* first block after the last READ */
+static uint32_t MSC_RA_Tried = 0xFFFFFFFFU; /* MSC_RA_Next of the last attempt */
+
+/* Fill started by MSC_RA_Prefetch and completed by MSC_RA_Poll */
+static uint8_t MSC_RA_Busy = 0U;
+static uint8_t MSC_RA_FillLun = 0U;
+static uint16_t MSC_RA_FillBlkSize = 0U;
+static uint32_t MSC_RA_FillAddr = 0U;
+static uint32_t MSC_RA_FillCnt = 0U;    /* whole window, kept blocks included */
+static uint32_t MSC_RA_FillNew = 0U;    /* blocks read from the backend */
+static uint32_t MSC_RA_FillGen = 0U;
+
+static USBD_MSC_RAStatsTypeDef MSC_RA_Stats;
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_READAHEAD_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  MSC_RA_Track
+  *         Account a new READ command and follow the sequential run.
+  *         Called from the USB interrupt.
+  * @param  lun: Logical unit number
+  * @param  blk_addr: first block of the command
+  * @param  blk_len: number of blocks of the command
+  * @retval None
+  */
+void MSC_RA_Track(uint8_t lun, uint32_t blk_addr, uint32_t blk_len)
+{
+  MSC_RA_Stats.blocks += blk_len;
+
+  if ((lun == MSC_RA_StreamLun) && (blk_addr == MSC_RA_Next))
+  {
+    if (MSC_RA_Run < 0xFFU)
+    {
+      MSC_RA_Run++;
+    }
+  }
+  else
+  {
+    MSC_RA_Run = 0U;
+  }
+
+  MSC_RA_StreamLun = lun;
+  MSC_RA_Next = blk_addr + blk_len;
+}
+
+/**
+  * @brief  MSC_RA_Complete
+  *         Publish the window once its fill has completed, unless a write
+  *         came in meanwhile
+  * @param  ret: backend status
+  * @retval None
+  */
+static void MSC_RA_Complete(int8_t ret)
+{
+  USBD_ENTER_CRITICAL();
+
+  if ((ret == 0) && (MSC_RA_FillGen == MSC_RA_Gen))
+  {
+    MSC_RA_Lun = MSC_RA_FillLun;
+    MSC_RA_BlkSize = MSC_RA_FillBlkSize;
+    MSC_RA_Addr = MSC_RA_FillAddr;
+    MSC_RA_Cnt = MSC_RA_FillCnt;
+    MSC_RA_Valid = 1U;
+    MSC_RA_Stats.prefetched += MSC_RA_FillNew;
+  }
+
+  USBD_EXIT_CRITICAL();
+}
+
+/**
+  * @brief  MSC_RA_Invalidate
+  *         Drop the prefetched data of a LUN before it is written
+  * @param  lun: Logical unit number
+  * @retval None
+  */
+void MSC_RA_Invalidate(uint8_t lun)
+{
+  if (MSC_RA_Lun == lun)
+  {
+    MSC_RA_Valid = 0U;
+  }
+
+  /* A fill running in USBD_MSC_Process may be for this LUN too */
+  MSC_RA_Gen++;
+}
+
+/**
+  * @brief  MSC_RA_Map
+  *         Look up the first blocks of a READ chunk in the prefetch window.
+  *         Called from the USB interrupt.
+  * @param  lun: Logical unit number
+  * @param  blk_addr: first block
+  * @param  blk_nbr: in, blocks wanted; out, blocks available from the window
+  * @param  blk_size: block size of the LUN
+  * @retval pointer into the window, NULL on miss
+  */
+uint8_t *MSC_RA_Map(uint8_t lun, uint32_t blk_addr, uint32_t *blk_nbr, uint16_t blk_size)
+{
+  if ((MSC_RA_Valid == 0U) || (MSC_RA_Lun != lun) || (MSC_RA_BlkSize != blk_size) ||
+      (blk_addr < MSC_RA_Addr) || ((blk_addr - MSC_RA_Addr) >= MSC_RA_Cnt))
+  {
+    return NULL;
+  }
+
+  *blk_nbr = MIN(*blk_nbr, MSC_RA_Cnt - (blk_addr - MSC_RA_Addr));
+  MSC_RA_Stats.hits += *blk_nbr;
+
+  return &MSC_RA_Buf[(blk_addr - MSC_RA_Addr) * blk_size];
+}
+
+/**
+  * @brief  MSC_RA_Copy
+  *         Serve a queued Read from the prefetch window when it covers all
+  *         of it. Called from USBD_MSC_Process.
+  * @param  lun: Logical unit number
+  * @param  buf: destination
+  * @param  blk_addr: first block
+  * @param  blk_len: number of blocks
+  * @param  blk_size: block size of the LUN
+  * @retval 1 if the blocks were copied, 0 otherwise
+  */
+uint8_t MSC_RA_Copy(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len,
+                    uint16_t blk_size)
+{
+  if ((MSC_RA_Valid == 0U) || (MSC_RA_Lun != lun) || (MSC_RA_BlkSize != blk_size) ||
+      (blk_addr < MSC_RA_Addr) || ((blk_addr - MSC_RA_Addr) >= MSC_RA_Cnt) ||
+      (blk_len > (MSC_RA_Cnt - (blk_addr - MSC_RA_Addr))))
+  {
+    return 0U;
+  }
+
+  (void)USBD_memcpy(buf, &MSC_RA_Buf[(blk_addr - MSC_RA_Addr) * blk_size],
+                    (uint32_t)blk_len * blk_size);
+  MSC_RA_Stats.hits += blk_len;
+
+  return 1U;
+}
+
+/**
+  * @brief  MSC_RA_Prefetch
+  *         Fill the window with the blocks following a sequential run, while
+  *         the BOT waits for the next CBW. Called from USBD_MSC_Process when
+  *         no request is pending.
+  * @param  pdev: device instance
+  * @param  fops: storage backend
+  * @retval None
+  */
+void MSC_RA_Prefetch(USBD_HandleTypeDef *pdev, USBD_StorageTypeDef *fops)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc;
+  uint32_t blk_addr;
+  uint32_t blk_nbr;
+  uint32_t keep = 0U;
+  uint32_t cnt;
+  uint32_t gen;
+  uint16_t blk_size;
+  uint8_t lun;
+  int8_t ret;
+
+  if (MSC_RA_Busy != 0U)
+  {
+    return;
+  }
+
+  USBD_ENTER_CRITICAL();
+
+  hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+
+  /* The window may still be on the wire until the CSW went out */
+  if ((hmsc == NULL) || (hmsc->bot_state != USBD_BOT_IDLE) ||
+      (hmsc->io.state != MSC_IO_IDLE) || (MSC_RA_Run < MSC_RA_MIN_RUN) ||
+      (MSC_RA_StreamLun > hmsc->max_lun) ||
+      (((MSC_RA_LUN_MASK >> MSC_RA_StreamLun) & 1U) == 0U))
+  {
+    USBD_EXIT_CRITICAL();
+    return;
+  }
+
+  lun = MSC_RA_StreamLun;
+  blk_addr = MSC_RA_Next;
+  blk_size = hmsc->scsi_lun[lun].blk_size;
+  blk_nbr = hmsc->scsi_lun[lun].blk_nbr;
+
+  /* One attempt per position of the stream, whatever the outcome */
+  if ((blk_addr == MSC_RA_Tried) || (blk_size == 0U) || (blk_size > MSC_RA_BUF_SIZE) ||
+      (blk_addr >= blk_nbr) || (hmsc->scsi_lun[lun].medium_state == SCSI_MEDIUM_EJECTED))
+  {
+    USBD_EXIT_CRITICAL();
+    return;
+  }
+
+  cnt = MIN(MSC_RA_BUF_SIZE / blk_size, blk_nbr - blk_addr);
+
+  if ((MSC_RA_Valid != 0U) && (MSC_RA_Lun == lun) && (MSC_RA_BlkSize == blk_size) &&
+      (blk_addr >= MSC_RA_Addr) && ((blk_addr - MSC_RA_Addr) < MSC_RA_Cnt))
+  {
+    keep = MSC_RA_Cnt - (blk_addr - MSC_RA_Addr);
+
+    /* Still well ahead of the host, or nothing left to read behind it */
+    if (((keep * 2U) > MSC_RA_Cnt) || (keep >= cnt))
+    {
+      USBD_EXIT_CRITICAL();
+      return;
+    }
+  }
+
+  MSC_RA_Tried = blk_addr;
+  gen = MSC_RA_Gen;
+
+  USBD_EXIT_CRITICAL();
+
+  /* Mapped media are already sent without a copy, one packet at a time at
+     worst, and the backend is stale where a cached line is dirty */
+  if (((fops->GetReadAddr != NULL) &&
+       (fops->GetReadAddr(lun, blk_addr, (uint16_t)MIN(cnt, MSC_MEDIA_PACKET / blk_size)) != NULL)) ||
+      (MSC_Cache_IsDirtyRange(lun, blk_addr + keep, cnt - keep) != 0U))
+  {
+    return;
+  }
+
+  USBD_ENTER_CRITICAL();
+
+  /* A command may have started meanwhile, and may be sending from the window */
+  if ((gen != MSC_RA_Gen) || (hmsc != pdev->pClassDatas[USBD_MSC_CLASS_ID]) ||
+      (hmsc->bot_state != USBD_BOT_IDLE) || (hmsc->io.state != MSC_IO_IDLE))
+  {
+    USBD_EXIT_CRITICAL();
+    return;
+  }
+
+  MSC_RA_Valid = 0U;
+
+  MSC_RA_FillLun = lun;
+  MSC_RA_FillBlkSize = blk_size;
+  MSC_RA_FillAddr = blk_addr;
+  MSC_RA_FillCnt = cnt;
+  MSC_RA_FillNew = cnt - keep;
+  MSC_RA_FillGen = gen;
+
+  USBD_EXIT_CRITICAL();
+
+  /* The unread end of the old window moves to the front */
+  if (keep != 0U)
+  {
+    (void)memmove(MSC_RA_Buf, &MSC_RA_Buf[(blk_addr - MSC_RA_Addr) * blk_size], keep * blk_size);
+  }
+
+  ret = fops->Read(lun, &MSC_RA_Buf[keep * blk_size], blk_addr + keep, (uint16_t)(cnt - keep));
+
+  if (ret > 0)
+  {
+    MSC_RA_Busy = 1U;
+    return;
+  }
+
+  MSC_RA_Complete(ret);
+}
+
+/**
+  * @brief  MSC_RA_Poll
+  *         Carry on with a fill that the backend runs in the background.
+  *         Called from USBD_MSC_Process before any other backend access.
+  * @param  fops: storage backend
+  * @retval 1 while the fill owns the backend, 0 otherwise
+  */
+uint8_t MSC_RA_Poll(USBD_StorageTypeDef *fops)
+{
+  int8_t ret;
+
+  if (MSC_RA_Busy == 0U)
+  {
+    return 0U;
+  }
+
+  ret = (fops->Poll != NULL) ? fops->Poll(MSC_RA_FillLun) : -1;
+
+  if (ret > 0)
+  {
+    return 1U;
+  }
+
+  MSC_RA_Busy = 0U;
+  MSC_RA_Complete(ret);
+
+  return 0U;
+}
+
+/**
+  * @brief  USBD_MSC_GetReadAheadStats
+  *         return the read-ahead counters
+  * @retval pointer to the counters
+  */
+USBD_MSC_RAStatsTypeDef *USBD_MSC_GetReadAheadStats(void)
+{
+  return &MSC_RA_Stats;
+}
+/**
+  * @}
+  */
+
+
+/**
+  * @}
+  */
+
+
+/**
+  * @}
+  */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
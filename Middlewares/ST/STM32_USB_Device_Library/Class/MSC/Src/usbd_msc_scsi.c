@@ -28,6 +28,8 @@ EndBSPDependencies */
 #include "usbd_msc_scsi.h"
 #include "usbd_msc.h"
 #include "usbd_msc_data.h"
+#include "usbd_msc_cache.h"
+#include "usbd_msc_readahead.h"
 
 
 /** @addtogroup STM32_USB_DEVICE_LIBRARY
@@ -87,16 +89,30 @@ static int8_t SCSI_StartStopUnit(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t
 static int8_t SCSI_AllowPreventRemovable(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
 static int8_t SCSI_ModeSense6(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
 static int8_t SCSI_ModeSense10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
+static int16_t SCSI_ModeSensePages(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params,
+                                   uint16_t hdr_len);
 static int8_t SCSI_Write10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
 static int8_t SCSI_Write12(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
+static int8_t SCSI_Write16(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
 static int8_t SCSI_Read10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
 static int8_t SCSI_Read12(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
+static int8_t SCSI_Read16(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
 static int8_t SCSI_Verify10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
+static int8_t SCSI_SynchronizeCache10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
+static int8_t SCSI_Unmap(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
+static uint8_t SCSI_CanUnmap(USBD_HandleTypeDef *pdev, uint8_t lun);
 static int8_t SCSI_CheckAddressRange(USBD_HandleTypeDef *pdev, uint8_t lun,
-                                     uint32_t blk_offset, uint32_t blk_nbr);
+                                     uint64_t blk_offset, uint32_t blk_nbr);
+static uint64_t SCSI_GetLba64(const uint8_t *p);
 
+static int8_t SCSI_StartRead(USBD_HandleTypeDef *pdev, uint8_t lun);
+static int8_t SCSI_StageRead(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t idx);
 static int8_t SCSI_ProcessRead(USBD_HandleTypeDef *pdev, uint8_t lun);
+static void SCSI_PrepareWrite(USBD_HandleTypeDef *pdev, uint8_t lun);
 static int8_t SCSI_ProcessWrite(USBD_HandleTypeDef *pdev, uint8_t lun);
+static int8_t SCSI_WriteCplt(USBD_HandleTypeDef *pdev, uint8_t lun);
+static void SCSI_QueueIo(USBD_MSC_BOT_HandleTypeDef *hmsc, uint8_t lun, uint8_t op,
+                         uint8_t *pbuf, uint32_t blk_nbr);
 
 static int8_t SCSI_UpdateBotData(USBD_MSC_BOT_HandleTypeDef *hmsc,
                                  uint8_t *pBuff, uint16_t length);
@@ -128,6 +144,21 @@ int8_t SCSI_ProcessCmd(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *cmd)
     return -1;
   }
 
+  /* A pending UNIT ATTENTION fails the next command but INQUIRY and REQUEST SENSE */
+  if ((hmsc->scsi_lun[lun].unit_attention != 0U) &&
+      (cmd[0] != SCSI_INQUIRY) && (cmd[0] != SCSI_REQUEST_SENSE))
+  {
+    SCSI_SenseCode(pdev, lun, UNIT_ATTENTION, hmsc->scsi_lun[lun].unit_attention);
+    hmsc->scsi_lun[lun].unit_attention = 0U;
+
+    if (hmsc->cbw.dDataLength == 0U)
+    {
+      hmsc->bot_state = USBD_BOT_NO_DATA;
+    }
+
+    return -1;
+  }
+
   switch (cmd[0])
   {
     case SCSI_TEST_UNIT_READY:
@@ -178,6 +209,10 @@ int8_t SCSI_ProcessCmd(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *cmd)
       ret = SCSI_Read12(pdev, lun, cmd);
       break;
 
+    case SCSI_READ16:
+      ret = SCSI_Read16(pdev, lun, cmd);
+      break;
+
     case SCSI_WRITE10:
       ret = SCSI_Write10(pdev, lun, cmd);
       break;
@@ -186,10 +221,23 @@ int8_t SCSI_ProcessCmd(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *cmd)
       ret = SCSI_Write12(pdev, lun, cmd);
       break;
 
+    case SCSI_WRITE16:
+      ret = SCSI_Write16(pdev, lun, cmd);
+      break;
+
     case SCSI_VERIFY10:
       ret = SCSI_Verify10(pdev, lun, cmd);
       break;
 
+    case SCSI_SYNCHRONIZE_CACHE10:
+    case SCSI_SYNCHRONIZE_CACHE16:
+      ret = SCSI_SynchronizeCache10(pdev, lun, cmd);
+      break;
+
+    case SCSI_UNMAP:
+      ret = SCSI_Unmap(pdev, lun, cmd);
+      break;
+
     default:
       SCSI_SenseCode(pdev, lun, ILLEGAL_REQUEST, INVALID_CDB);
       hmsc->bot_status = USBD_BOT_STATUS_ERROR;
@@ -226,7 +274,7 @@ static int8_t SCSI_TestUnitReady(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t
     return -1;
   }
 
-  if (hmsc->scsi_medium_state == SCSI_MEDIUM_EJECTED)
+  if (hmsc->scsi_lun[lun].medium_state == SCSI_MEDIUM_EJECTED)
   {
     SCSI_SenseCode(pdev, lun, NOT_READY, MEDIUM_NOT_PRESENT);
     hmsc->bot_state = USBD_BOT_NO_DATA;
@@ -280,6 +328,43 @@ static int8_t SCSI_Inquiry(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *param
     {
       (void)SCSI_UpdateBotData(hmsc, MSC_Page80_Inquiry_Data, LENGTH_INQUIRY_PAGE80);
     }
+    else if (params[2] == 0xB0U) /* Request for VPD page 0xB0 Block Limits */
+    {
+      (void)USBD_memset(hmsc->bot_data, 0, LENGTH_INQUIRY_PAGEB0);
+      hmsc->bot_data[1] = 0xB0U;
+      hmsc->bot_data[3] = LENGTH_INQUIRY_PAGEB0 - 4U;
+
+      if (SCSI_CanUnmap(pdev, lun) != 0U)
+      {
+        /* MAXIMUM UNMAP LBA COUNT: no limit */
+        hmsc->bot_data[20] = 0xFFU;
+        hmsc->bot_data[21] = 0xFFU;
+        hmsc->bot_data[22] = 0xFFU;
+        hmsc->bot_data[23] = 0xFFU;
+
+        /* MAXIMUM UNMAP BLOCK DESCRIPTOR COUNT: the list must fit bot_data */
+        hmsc->bot_data[27] = (uint8_t)UNMAP_DESC_MAX;
+
+        /* OPTIMAL UNMAP GRANULARITY: one block */
+        hmsc->bot_data[31] = 1U;
+      }
+
+      hmsc->bot_data_length = LENGTH_INQUIRY_PAGEB0;
+    }
+    else if (params[2] == 0xB2U) /* Request for VPD page 0xB2 Logical Block Provisioning */
+    {
+      (void)USBD_memset(hmsc->bot_data, 0, LENGTH_INQUIRY_PAGEB2);
+      hmsc->bot_data[1] = 0xB2U;
+      hmsc->bot_data[3] = LENGTH_INQUIRY_PAGEB2 - 4U;
+
+      if (SCSI_CanUnmap(pdev, lun) != 0U)
+      {
+        hmsc->bot_data[5] = 0x80U; /* LBPU */
+        hmsc->bot_data[6] = 0x02U; /* thin provisioned */
+      }
+
+      hmsc->bot_data_length = LENGTH_INQUIRY_PAGEB2;
+    }
     else /* Request Not supported */
     {
       SCSI_SenseCode(pdev, hmsc->cbw.bLUN, ILLEGAL_REQUEST,
@@ -323,23 +408,23 @@ static int8_t SCSI_ReadCapacity10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t
     return -1;
   }
 
-  ret = ((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->GetCapacity(lun, &hmsc->scsi_blk_nbr, &hmsc->scsi_blk_size);
+  ret = ((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->GetCapacity(lun, &hmsc->scsi_lun[lun].blk_nbr, &hmsc->scsi_lun[lun].blk_size);
 
-  if ((ret != 0) || (hmsc->scsi_medium_state == SCSI_MEDIUM_EJECTED))
+  if ((ret != 0) || (hmsc->scsi_lun[lun].medium_state == SCSI_MEDIUM_EJECTED))
   {
     SCSI_SenseCode(pdev, lun, NOT_READY, MEDIUM_NOT_PRESENT);
     return -1;
   }
 
-  hmsc->bot_data[0] = (uint8_t)((hmsc->scsi_blk_nbr - 1U) >> 24);
-  hmsc->bot_data[1] = (uint8_t)((hmsc->scsi_blk_nbr - 1U) >> 16);
-  hmsc->bot_data[2] = (uint8_t)((hmsc->scsi_blk_nbr - 1U) >>  8);
-  hmsc->bot_data[3] = (uint8_t)(hmsc->scsi_blk_nbr - 1U);
+  hmsc->bot_data[0] = (uint8_t)((hmsc->scsi_lun[lun].blk_nbr - 1U) >> 24);
+  hmsc->bot_data[1] = (uint8_t)((hmsc->scsi_lun[lun].blk_nbr - 1U) >> 16);
+  hmsc->bot_data[2] = (uint8_t)((hmsc->scsi_lun[lun].blk_nbr - 1U) >>  8);
+  hmsc->bot_data[3] = (uint8_t)(hmsc->scsi_lun[lun].blk_nbr - 1U);
 
-  hmsc->bot_data[4] = (uint8_t)(hmsc->scsi_blk_size >>  24);
-  hmsc->bot_data[5] = (uint8_t)(hmsc->scsi_blk_size >>  16);
-  hmsc->bot_data[6] = (uint8_t)(hmsc->scsi_blk_size >>  8);
-  hmsc->bot_data[7] = (uint8_t)(hmsc->scsi_blk_size);
+  hmsc->bot_data[4] = (uint8_t)(hmsc->scsi_lun[lun].blk_size >>  24);
+  hmsc->bot_data[5] = (uint8_t)(hmsc->scsi_lun[lun].blk_size >>  16);
+  hmsc->bot_data[6] = (uint8_t)(hmsc->scsi_lun[lun].blk_size >>  8);
+  hmsc->bot_data[7] = (uint8_t)(hmsc->scsi_lun[lun].blk_size);
 
   hmsc->bot_data_length = 8U;
 
@@ -357,8 +442,7 @@ static int8_t SCSI_ReadCapacity10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t
   */
 static int8_t SCSI_ReadCapacity16(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
 {
-  UNUSED(params);
-  uint8_t idx;
+  uint32_t idx;
   int8_t ret;
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
 
@@ -367,9 +451,9 @@ static int8_t SCSI_ReadCapacity16(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t
     return -1;
   }
 
-  ret = ((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->GetCapacity(lun, &hmsc->scsi_blk_nbr, &hmsc->scsi_blk_size);
+  ret = ((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->GetCapacity(lun, &hmsc->scsi_lun[lun].blk_nbr, &hmsc->scsi_lun[lun].blk_size);
 
-  if ((ret != 0) || (hmsc->scsi_medium_state == SCSI_MEDIUM_EJECTED))
+  if ((ret != 0) || (hmsc->scsi_lun[lun].medium_state == SCSI_MEDIUM_EJECTED))
   {
     SCSI_SenseCode(pdev, lun, NOT_READY, MEDIUM_NOT_PRESENT);
     return -1;
@@ -380,25 +464,31 @@ static int8_t SCSI_ReadCapacity16(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t
                           ((uint32_t)params[12] <<  8) |
                           (uint32_t)params[13];
 
-  for (idx = 0U; idx < hmsc->bot_data_length; idx++)
+  /* The host allocation length can exceed the parameter data */
+  if (hmsc->bot_data_length > READ_CAPACITY16_DATA_LEN)
+  {
+    hmsc->bot_data_length = READ_CAPACITY16_DATA_LEN;
+  }
+
+  for (idx = 0U; idx < READ_CAPACITY16_DATA_LEN; idx++)
   {
     hmsc->bot_data[idx] = 0U;
   }
 
-  hmsc->bot_data[4] = (uint8_t)((hmsc->scsi_blk_nbr - 1U) >> 24);
-  hmsc->bot_data[5] = (uint8_t)((hmsc->scsi_blk_nbr - 1U) >> 16);
-  hmsc->bot_data[6] = (uint8_t)((hmsc->scsi_blk_nbr - 1U) >>  8);
-  hmsc->bot_data[7] = (uint8_t)(hmsc->scsi_blk_nbr - 1U);
+  hmsc->bot_data[4] = (uint8_t)((hmsc->scsi_lun[lun].blk_nbr - 1U) >> 24);
+  hmsc->bot_data[5] = (uint8_t)((hmsc->scsi_lun[lun].blk_nbr - 1U) >> 16);
+  hmsc->bot_data[6] = (uint8_t)((hmsc->scsi_lun[lun].blk_nbr - 1U) >>  8);
+  hmsc->bot_data[7] = (uint8_t)(hmsc->scsi_lun[lun].blk_nbr - 1U);
 
-  hmsc->bot_data[8] = (uint8_t)(hmsc->scsi_blk_size >>  24);
-  hmsc->bot_data[9] = (uint8_t)(hmsc->scsi_blk_size >>  16);
-  hmsc->bot_data[10] = (uint8_t)(hmsc->scsi_blk_size >>  8);
-  hmsc->bot_data[11] = (uint8_t)(hmsc->scsi_blk_size);
+  hmsc->bot_data[8] = (uint8_t)(hmsc->scsi_lun[lun].blk_size >>  24);
+  hmsc->bot_data[9] = (uint8_t)(hmsc->scsi_lun[lun].blk_size >>  16);
+  hmsc->bot_data[10] = (uint8_t)(hmsc->scsi_lun[lun].blk_size >>  8);
+  hmsc->bot_data[11] = (uint8_t)(hmsc->scsi_lun[lun].blk_size);
 
-  hmsc->bot_data_length = ((uint32_t)params[10] << 24) |
-                          ((uint32_t)params[11] << 16) |
-                          ((uint32_t)params[12] <<  8) |
-                          (uint32_t)params[13];
+  if (SCSI_CanUnmap(pdev, lun) != 0U)
+  {
+    hmsc->bot_data[14] = 0x80U; /* LBPME */
+  }
 
   return 0;
 }
@@ -427,7 +517,7 @@ static int8_t SCSI_ReadFormatCapacity(USBD_HandleTypeDef *pdev, uint8_t lun, uin
 
   ret = ((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->GetCapacity(lun, &blk_nbr, &blk_size);
 
-  if ((ret != 0) || (hmsc->scsi_medium_state == SCSI_MEDIUM_EJECTED))
+  if ((ret != 0) || (hmsc->scsi_lun[lun].medium_state == SCSI_MEDIUM_EJECTED))
   {
     SCSI_SenseCode(pdev, lun, NOT_READY, MEDIUM_NOT_PRESENT);
     return -1;
@@ -464,21 +554,31 @@ static int8_t SCSI_ReadFormatCapacity(USBD_HandleTypeDef *pdev, uint8_t lun, uin
   */
 static int8_t SCSI_ModeSense6(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
 {
-  UNUSED(lun);
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
-  uint16_t len = MODE_SENSE6_LEN;
+  int16_t len;
 
   if (hmsc == NULL)
   {
     return -1;
   }
 
-  if (params[4] <= len)
+  (void)SCSI_UpdateBotData(hmsc, MSC_Mode_Sense6_data, MODE_SENSE6_LEN);
+
+  len = SCSI_ModeSensePages(pdev, lun, params, 4U);
+  if (len < 0)
+  {
+    return -1;
+  }
+
+  hmsc->bot_data[0] = (uint8_t)(len - 1);
+
+  /* Device-specific parameter: WP, so hosts mount read-only media read-only */
+  if (((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->IsWriteProtected(lun) != 0)
   {
-    len = params[4];
+    hmsc->bot_data[2] |= 0x80U;
   }
 
-  (void)SCSI_UpdateBotData(hmsc, MSC_Mode_Sense6_data, len);
+  hmsc->bot_data_length = MIN((uint16_t)len, (uint16_t)params[4]);
 
   return 0;
 }
@@ -493,26 +593,78 @@ static int8_t SCSI_ModeSense6(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *pa
   */
 static int8_t SCSI_ModeSense10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
 {
-  UNUSED(lun);
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
-  uint16_t len = MODE_SENSE10_LEN;
+  int16_t len;
 
   if (hmsc == NULL)
   {
     return -1;
   }
 
-  if (params[8] <= len)
+  (void)SCSI_UpdateBotData(hmsc, MSC_Mode_Sense10_data, MODE_SENSE10_LEN);
+
+  len = SCSI_ModeSensePages(pdev, lun, params, 8U);
+  if (len < 0)
+  {
+    return -1;
+  }
+
+  hmsc->bot_data[0] = 0U;
+  hmsc->bot_data[1] = (uint8_t)(len - 2);
+
+  if (((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->IsWriteProtected(lun) != 0)
   {
-    len = params[8];
+    hmsc->bot_data[3] |= 0x80U;
   }
 
-  (void)SCSI_UpdateBotData(hmsc, MSC_Mode_Sense10_data, len);
+  hmsc->bot_data_length = MIN((uint16_t)len, ((uint16_t)params[7] << 8) | (uint16_t)params[8]);
 
   return 0;
 }
 
 
+/**
+  * @brief  SCSI_ModeSensePages
+  *         Select the mode pages following the header already in bot_data.
+  *         Only the caching page exists; writable LUNs report WCE so the
+  *         host keeps its own write cache and sends SYNCHRONIZE CACHE, which
+  *         flushes the block cache and the backend. Other page codes get the
+  *         header alone.
+  * @param  lun: Logical unit number
+  * @param  params: Command parameters
+  * @param  hdr_len: Mode parameter header length
+  * @retval length of the mode parameter list, -1 on error
+  */
+static int16_t SCSI_ModeSensePages(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params,
+                                   uint16_t hdr_len)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+  uint8_t page_code = params[2] & 0x3FU;
+  uint8_t page_ctrl = params[2] >> 6;
+
+  /* Saved values */
+  if (page_ctrl == 3U)
+  {
+    SCSI_SenseCode(pdev, lun, ILLEGAL_REQUEST, SAVING_PARAMETERS_NOT_SUPPORTED);
+    return -1;
+  }
+
+  if ((page_code != MODE_PAGE_CACHING) && (page_code != MODE_PAGE_ALL))
+  {
+    return (int16_t)hdr_len;
+  }
+
+  /* Changeable values: none, MODE SELECT is not supported */
+  if ((page_ctrl != 1U) &&
+      (((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->IsWriteProtected(lun) == 0))
+  {
+    hmsc->bot_data[hdr_len + 2U] |= MODE_CACHING_WCE;
+  }
+
+  return (int16_t)(hdr_len + MODE_CACHING_PAGE_LEN);
+}
+
+
 /**
   * @brief  SCSI_RequestSense
   *         Process Request Sense command
@@ -522,9 +674,9 @@ static int8_t SCSI_ModeSense10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *p
   */
 static int8_t SCSI_RequestSense(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
 {
-  UNUSED(lun);
   uint8_t i;
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+  USBD_MSC_LunTypeDef *plun;
 
   if (hmsc == NULL)
   {
@@ -545,16 +697,18 @@ static int8_t SCSI_RequestSense(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *
   hmsc->bot_data[0] = 0x70U;
   hmsc->bot_data[7] = REQUEST_SENSE_DATA_LEN - 6U;
 
-  if ((hmsc->scsi_sense_head != hmsc->scsi_sense_tail))
+  plun = &hmsc->scsi_lun[lun];
+
+  if ((plun->sense_head != plun->sense_tail))
   {
-    hmsc->bot_data[2] = (uint8_t)hmsc->scsi_sense[hmsc->scsi_sense_head].Skey;
-    hmsc->bot_data[12] = (uint8_t)hmsc->scsi_sense[hmsc->scsi_sense_head].w.b.ASC;
-    hmsc->bot_data[13] = (uint8_t)hmsc->scsi_sense[hmsc->scsi_sense_head].w.b.ASCQ;
-    hmsc->scsi_sense_head++;
+    hmsc->bot_data[2] = (uint8_t)plun->sense[plun->sense_head].Skey;
+    hmsc->bot_data[12] = (uint8_t)plun->sense[plun->sense_head].w.b.ASC;
+    hmsc->bot_data[13] = (uint8_t)plun->sense[plun->sense_head].w.b.ASCQ;
+    plun->sense_head++;
 
-    if (hmsc->scsi_sense_head == SENSE_LIST_DEEPTH)
+    if (plun->sense_head == SENSE_LIST_DEEPTH)
     {
-      hmsc->scsi_sense_head = 0U;
+      plun->sense_head = 0U;
     }
   }
 
@@ -580,23 +734,53 @@ static int8_t SCSI_RequestSense(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *
   */
 void SCSI_SenseCode(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t sKey, uint8_t ASC)
 {
-  UNUSED(lun);
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+  USBD_MSC_LunTypeDef *plun;
 
   if (hmsc == NULL)
   {
     return;
   }
 
-  hmsc->scsi_sense[hmsc->scsi_sense_tail].Skey = sKey;
-  hmsc->scsi_sense[hmsc->scsi_sense_tail].w.b.ASC = ASC;
-  hmsc->scsi_sense[hmsc->scsi_sense_tail].w.b.ASCQ = 0U;
-  hmsc->scsi_sense_tail++;
+  /* An invalid CBW may carry any LUN: queue its sense on LUN 0 */
+  if (lun >= MSC_MAX_LUN)
+  {
+    lun = 0U;
+  }
+
+  plun = &hmsc->scsi_lun[lun];
+
+  plun->sense[plun->sense_tail].Skey = sKey;
+  plun->sense[plun->sense_tail].w.b.ASC = ASC;
+  plun->sense[plun->sense_tail].w.b.ASCQ = 0U;
+  plun->sense_tail++;
+
+  if (plun->sense_tail == SENSE_LIST_DEEPTH)
+  {
+    plun->sense_tail = 0U;
+  }
+}
+
+
+/**
+  * @brief  SCSI_UnitAttention
+  *         Make the next command of the LUN fail with UNIT ATTENTION, so that
+  *         the host drops what it cached of the medium
+  * @param  lun: Logical unit number
+  * @param  ASC: Additional Sense Code
+  * @retval none
+  */
+void SCSI_UnitAttention(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t ASC)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
 
-  if (hmsc->scsi_sense_tail == SENSE_LIST_DEEPTH)
+  /* Not configured: the host has nothing cached yet */
+  if ((hmsc == NULL) || (lun >= MSC_MAX_LUN))
   {
-    hmsc->scsi_sense_tail = 0U;
+    return;
   }
+
+  hmsc->scsi_lun[lun].unit_attention = ASC;
 }
 
 
@@ -609,7 +793,6 @@ void SCSI_SenseCode(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t sKey, uint8_t
   */
 static int8_t SCSI_StartStopUnit(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
 {
-  UNUSED(lun);
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
 
   if (hmsc == NULL)
@@ -617,7 +800,7 @@ static int8_t SCSI_StartStopUnit(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t
     return -1;
   }
 
-  if ((hmsc->scsi_medium_state == SCSI_MEDIUM_LOCKED) && ((params[4] & 0x3U) == 2U))
+  if ((hmsc->scsi_lun[lun].medium_state == SCSI_MEDIUM_LOCKED) && ((params[4] & 0x3U) == 2U))
   {
     SCSI_SenseCode(pdev, lun, ILLEGAL_REQUEST, INVALID_FIELED_IN_COMMAND);
 
@@ -626,15 +809,19 @@ static int8_t SCSI_StartStopUnit(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t
 
   if ((params[4] & 0x3U) == 0x1U) /* START=1 */
   {
-    hmsc->scsi_medium_state = SCSI_MEDIUM_UNLOCKED;
+    hmsc->scsi_lun[lun].medium_state = SCSI_MEDIUM_UNLOCKED;
   }
   else if ((params[4] & 0x3U) == 0x2U) /* START=0 and LOEJ Load Eject=1 */
   {
-    hmsc->scsi_medium_state = SCSI_MEDIUM_EJECTED;
+    hmsc->scsi_lun[lun].medium_state = SCSI_MEDIUM_EJECTED;
+
+    /* Hold the CSW until cached data is on the medium */
+    hmsc->bot_state = USBD_BOT_MEDIA_WAIT;
+    SCSI_QueueIo(hmsc, lun, MSC_IO_FLUSH, NULL, 0U);
   }
   else if ((params[4] & 0x3U) == 0x3U) /* START=1 and LOEJ Load Eject=1 */
   {
-    hmsc->scsi_medium_state = SCSI_MEDIUM_UNLOCKED;
+    hmsc->scsi_lun[lun].medium_state = SCSI_MEDIUM_UNLOCKED;
   }
   else
   {
@@ -655,7 +842,6 @@ static int8_t SCSI_StartStopUnit(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t
   */
 static int8_t SCSI_AllowPreventRemovable(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
 {
-  UNUSED(lun);
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
 
   if (hmsc == NULL)
@@ -665,11 +851,11 @@ static int8_t SCSI_AllowPreventRemovable(USBD_HandleTypeDef *pdev, uint8_t lun,
 
   if (params[4] == 0U)
   {
-    hmsc->scsi_medium_state = SCSI_MEDIUM_UNLOCKED;
+    hmsc->scsi_lun[lun].medium_state = SCSI_MEDIUM_UNLOCKED;
   }
   else
   {
-    hmsc->scsi_medium_state = SCSI_MEDIUM_LOCKED;
+    hmsc->scsi_lun[lun].medium_state = SCSI_MEDIUM_LOCKED;
   }
 
   hmsc->bot_data_length = 0U;
@@ -703,7 +889,7 @@ static int8_t SCSI_Read10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params
       return -1;
     }
 
-    if (hmsc->scsi_medium_state == SCSI_MEDIUM_EJECTED)
+    if (hmsc->scsi_lun[lun].medium_state == SCSI_MEDIUM_EJECTED)
     {
       SCSI_SenseCode(pdev, lun, NOT_READY, MEDIUM_NOT_PRESENT);
 
@@ -730,13 +916,18 @@ static int8_t SCSI_Read10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params
     }
 
     /* cases 4,5 : Hi <> Dn */
-    if (hmsc->cbw.dDataLength != (hmsc->scsi_blk_len * hmsc->scsi_blk_size))
+    if ((uint64_t)hmsc->cbw.dDataLength != ((uint64_t)hmsc->scsi_blk_len * hmsc->scsi_lun[lun].blk_size))
     {
       SCSI_SenseCode(pdev, hmsc->cbw.bLUN, ILLEGAL_REQUEST, INVALID_CDB);
       return -1;
     }
 
     hmsc->bot_state = USBD_BOT_DATA_IN;
+
+    if (SCSI_StartRead(pdev, lun) < 0)
+    {
+      return -1; /* error */
+    }
   }
   hmsc->bot_data_length = MSC_MEDIA_PACKET;
 
@@ -769,7 +960,7 @@ static int8_t SCSI_Read12(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params
       return -1;
     }
 
-    if (hmsc->scsi_medium_state == SCSI_MEDIUM_EJECTED)
+    if (hmsc->scsi_lun[lun].medium_state == SCSI_MEDIUM_EJECTED)
     {
       SCSI_SenseCode(pdev, lun, NOT_READY, MEDIUM_NOT_PRESENT);
       return -1;
@@ -798,13 +989,91 @@ static int8_t SCSI_Read12(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params
     }
 
     /* cases 4,5 : Hi <> Dn */
-    if (hmsc->cbw.dDataLength != (hmsc->scsi_blk_len * hmsc->scsi_blk_size))
+    if ((uint64_t)hmsc->cbw.dDataLength != ((uint64_t)hmsc->scsi_blk_len * hmsc->scsi_lun[lun].blk_size))
+    {
+      SCSI_SenseCode(pdev, hmsc->cbw.bLUN, ILLEGAL_REQUEST, INVALID_CDB);
+      return -1;
+    }
+
+    hmsc->bot_state = USBD_BOT_DATA_IN;
+
+    if (SCSI_StartRead(pdev, lun) < 0)
+    {
+      return -1; /* error */
+    }
+  }
+  hmsc->bot_data_length = MSC_MEDIA_PACKET;
+
+  return SCSI_ProcessRead(pdev, lun);
+}
+
+
+/**
+  * @brief  SCSI_Read16
+  *         Process Read16 command
+  * @param  lun: Logical unit number
+  * @param  params: Command parameters
+  * @retval status
+  */
+static int8_t SCSI_Read16(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+  uint64_t blk_addr;
+
+  if (hmsc == NULL)
+  {
+    return -1;
+  }
+
+  if (hmsc->bot_state == USBD_BOT_IDLE) /* Idle */
+  {
+    /* case 10 : Ho <> Di */
+    if ((hmsc->cbw.bmFlags & 0x80U) != 0x80U)
+    {
+      SCSI_SenseCode(pdev, hmsc->cbw.bLUN, ILLEGAL_REQUEST, INVALID_CDB);
+      return -1;
+    }
+
+    if (hmsc->scsi_lun[lun].medium_state == SCSI_MEDIUM_EJECTED)
+    {
+      SCSI_SenseCode(pdev, lun, NOT_READY, MEDIUM_NOT_PRESENT);
+      return -1;
+    }
+
+    if (((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->IsReady(lun) != 0)
+    {
+      SCSI_SenseCode(pdev, lun, NOT_READY, MEDIUM_NOT_PRESENT);
+      return -1;
+    }
+
+    blk_addr = SCSI_GetLba64(&params[2]);
+
+    hmsc->scsi_blk_len = ((uint32_t)params[10] << 24) |
+                         ((uint32_t)params[11] << 16) |
+                         ((uint32_t)params[12] << 8) |
+                         (uint32_t)params[13];
+
+    if (SCSI_CheckAddressRange(pdev, lun, blk_addr, hmsc->scsi_blk_len) < 0)
+    {
+      return -1; /* error */
+    }
+
+    /* In range, so it fits the 32-bit block count of the backends */
+    hmsc->scsi_blk_addr = (uint32_t)blk_addr;
+
+    /* cases 4,5 : Hi <> Dn */
+    if ((uint64_t)hmsc->cbw.dDataLength != ((uint64_t)hmsc->scsi_blk_len * hmsc->scsi_lun[lun].blk_size))
     {
       SCSI_SenseCode(pdev, hmsc->cbw.bLUN, ILLEGAL_REQUEST, INVALID_CDB);
       return -1;
     }
 
     hmsc->bot_state = USBD_BOT_DATA_IN;
+
+    if (SCSI_StartRead(pdev, lun) < 0)
+    {
+      return -1; /* error */
+    }
   }
   hmsc->bot_data_length = MSC_MEDIA_PACKET;
 
@@ -822,7 +1091,7 @@ static int8_t SCSI_Read12(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params
 static int8_t SCSI_Write10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
 {
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
-  uint32_t len;
+  uint64_t len;
 
   if (hmsc == NULL)
   {
@@ -848,6 +1117,7 @@ static int8_t SCSI_Write10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *param
     if (((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->IsReady(lun) != 0)
     {
       SCSI_SenseCode(pdev, lun, NOT_READY, MEDIUM_NOT_PRESENT);
+      hmsc->bot_state = USBD_BOT_NO_DATA;
       return -1;
     }
 
@@ -855,6 +1125,7 @@ static int8_t SCSI_Write10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *param
     if (((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->IsWriteProtected(lun) != 0)
     {
       SCSI_SenseCode(pdev, lun, NOT_READY, WRITE_PROTECTED);
+      hmsc->bot_state = USBD_BOT_NO_DATA;
       return -1;
     }
 
@@ -873,20 +1144,20 @@ static int8_t SCSI_Write10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *param
       return -1; /* error */
     }
 
-    len = hmsc->scsi_blk_len * hmsc->scsi_blk_size;
+    len = (uint64_t)hmsc->scsi_blk_len * hmsc->scsi_lun[lun].blk_size;
 
     /* cases 3,11,13 : Hn,Ho <> D0 */
-    if (hmsc->cbw.dDataLength != len)
+    if ((uint64_t)hmsc->cbw.dDataLength != len)
     {
       SCSI_SenseCode(pdev, hmsc->cbw.bLUN, ILLEGAL_REQUEST, INVALID_CDB);
       return -1;
     }
 
-    len = MIN(len, MSC_MEDIA_PACKET);
+    MSC_RA_Invalidate(lun);
 
     /* Prepare EP to receive first data packet */
     hmsc->bot_state = USBD_BOT_DATA_OUT;
-    (void)USBD_LL_PrepareReceive(pdev, MSC_EPOUT_ADDR, hmsc->bot_data, len);
+    SCSI_PrepareWrite(pdev, lun);
   }
   else /* Write Process ongoing */
   {
@@ -907,7 +1178,7 @@ static int8_t SCSI_Write10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *param
 static int8_t SCSI_Write12(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
 {
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
-  uint32_t len;
+  uint64_t len;
 
   if (hmsc == NULL)
   {
@@ -962,20 +1233,108 @@ static int8_t SCSI_Write12(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *param
       return -1; /* error */
     }
 
-    len = hmsc->scsi_blk_len * hmsc->scsi_blk_size;
+    len = (uint64_t)hmsc->scsi_blk_len * hmsc->scsi_lun[lun].blk_size;
 
     /* cases 3,11,13 : Hn,Ho <> D0 */
-    if (hmsc->cbw.dDataLength != len)
+    if ((uint64_t)hmsc->cbw.dDataLength != len)
     {
       SCSI_SenseCode(pdev, hmsc->cbw.bLUN, ILLEGAL_REQUEST, INVALID_CDB);
       return -1;
     }
 
-    len = MIN(len, MSC_MEDIA_PACKET);
+    MSC_RA_Invalidate(lun);
 
     /* Prepare EP to receive first data packet */
     hmsc->bot_state = USBD_BOT_DATA_OUT;
-    (void)USBD_LL_PrepareReceive(pdev, MSC_EPOUT_ADDR, hmsc->bot_data, len);
+    SCSI_PrepareWrite(pdev, lun);
+  }
+  else /* Write Process ongoing */
+  {
+    return SCSI_ProcessWrite(pdev, lun);
+  }
+
+  return 0;
+}
+
+
+/**
+  * @brief  SCSI_Write16
+  *         Process Write16 command
+  * @param  lun: Logical unit number
+  * @param  params: Command parameters
+  * @retval status
+  */
+static int8_t SCSI_Write16(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+  uint64_t blk_addr;
+  uint64_t len;
+
+  if (hmsc == NULL)
+  {
+    return -1;
+  }
+
+  if (hmsc->bot_state == USBD_BOT_IDLE) /* Idle */
+  {
+    if (hmsc->cbw.dDataLength == 0U)
+    {
+      SCSI_SenseCode(pdev, hmsc->cbw.bLUN, ILLEGAL_REQUEST, INVALID_CDB);
+      return -1;
+    }
+
+    /* case 8 : Hi <> Do */
+    if ((hmsc->cbw.bmFlags & 0x80U) == 0x80U)
+    {
+      SCSI_SenseCode(pdev, hmsc->cbw.bLUN, ILLEGAL_REQUEST, INVALID_CDB);
+      return -1;
+    }
+
+    /* Check whether Media is ready */
+    if (((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->IsReady(lun) != 0)
+    {
+      SCSI_SenseCode(pdev, lun, NOT_READY, MEDIUM_NOT_PRESENT);
+      hmsc->bot_state = USBD_BOT_NO_DATA;
+      return -1;
+    }
+
+    /* Check If media is write-protected */
+    if (((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->IsWriteProtected(lun) != 0)
+    {
+      SCSI_SenseCode(pdev, lun, NOT_READY, WRITE_PROTECTED);
+      hmsc->bot_state = USBD_BOT_NO_DATA;
+      return -1;
+    }
+
+    blk_addr = SCSI_GetLba64(&params[2]);
+
+    hmsc->scsi_blk_len = ((uint32_t)params[10] << 24) |
+                         ((uint32_t)params[11] << 16) |
+                         ((uint32_t)params[12] << 8) |
+                         (uint32_t)params[13];
+
+    /* check if LBA address is in the right range */
+    if (SCSI_CheckAddressRange(pdev, lun, blk_addr, hmsc->scsi_blk_len) < 0)
+    {
+      return -1; /* error */
+    }
+
+    hmsc->scsi_blk_addr = (uint32_t)blk_addr;
+
+    len = (uint64_t)hmsc->scsi_blk_len * hmsc->scsi_lun[lun].blk_size;
+
+    /* cases 3,11,13 : Hn,Ho <> D0 */
+    if ((uint64_t)hmsc->cbw.dDataLength != len)
+    {
+      SCSI_SenseCode(pdev, hmsc->cbw.bLUN, ILLEGAL_REQUEST, INVALID_CDB);
+      return -1;
+    }
+
+    MSC_RA_Invalidate(lun);
+
+    /* Prepare EP to receive first data packet */
+    hmsc->bot_state = USBD_BOT_DATA_OUT;
+    SCSI_PrepareWrite(pdev, lun);
   }
   else /* Write Process ongoing */
   {
@@ -996,6 +1355,8 @@ static int8_t SCSI_Write12(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *param
 static int8_t SCSI_Verify10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
 {
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+  uint32_t blk_addr;
+  uint32_t blk_len;
 
   if (hmsc == NULL)
   {
@@ -1008,7 +1369,15 @@ static int8_t SCSI_Verify10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *para
     return -1; /* Error, Verify Mode Not supported*/
   }
 
-  if (SCSI_CheckAddressRange(pdev, lun, hmsc->scsi_blk_addr, hmsc->scsi_blk_len) < 0)
+  blk_addr = ((uint32_t)params[2] << 24) |
+             ((uint32_t)params[3] << 16) |
+             ((uint32_t)params[4] << 8) |
+             (uint32_t)params[5];
+
+  blk_len = ((uint32_t)params[7] << 8) |
+            (uint32_t)params[8];
+
+  if (SCSI_CheckAddressRange(pdev, lun, blk_addr, blk_len) < 0)
   {
     return -1; /* error */
   }
@@ -1018,16 +1387,181 @@ static int8_t SCSI_Verify10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *para
   return 0;
 }
 
+/**
+  * @brief  SCSI_SynchronizeCache10
+  *         Process Synchronize Cache10 and Synchronize Cache16 commands. The
+  *         whole LUN is flushed whatever the range, and the CSW is held until
+  *         USBD_MSC_Process has done it, also when IMMED is set.
+  * @param  lun: Logical unit number
+  * @param  params: Command parameters
+  * @retval status
+  */
+static int8_t SCSI_SynchronizeCache10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
+{
+  UNUSED(params);
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+
+  if (hmsc == NULL)
+  {
+    return -1;
+  }
+
+  /* case 9 : Hi > D0 */
+  if (hmsc->cbw.dDataLength != 0U)
+  {
+    SCSI_SenseCode(pdev, hmsc->cbw.bLUN, ILLEGAL_REQUEST, INVALID_CDB);
+    return -1;
+  }
+
+  hmsc->bot_state = USBD_BOT_MEDIA_WAIT;
+  hmsc->bot_data_length = 0U;
+  SCSI_QueueIo(hmsc, lun, MSC_IO_FLUSH, NULL, 0U);
+
+  return 0;
+}
+
+/**
+  * @brief  SCSI_Unmap
+  *         Process Unmap command: receive the parameter list into bot_data,
+  *         then hand its ranges to USBD_MSC_Process
+  * @param  lun: Logical unit number
+  * @param  params: Command parameters
+  * @retval status
+  */
+static int8_t SCSI_Unmap(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+  USBD_MSC_RangeTypeDef range;
+  uint64_t blk_addr;
+  uint8_t *desc;
+  uint32_t len;
+  uint32_t nbr;
+  uint32_t i;
+
+  if (hmsc == NULL)
+  {
+    return -1;
+  }
+
+  len = ((uint32_t)params[7] << 8) | (uint32_t)params[8];
+
+  if (hmsc->bot_state == USBD_BOT_IDLE) /* Idle */
+  {
+    if (SCSI_CanUnmap(pdev, lun) == 0U)
+    {
+      SCSI_SenseCode(pdev, lun, ILLEGAL_REQUEST, INVALID_CDB);
+      return -1;
+    }
+
+    /* Check If media is write-protected */
+    if (((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->IsWriteProtected(lun) != 0)
+    {
+      SCSI_SenseCode(pdev, lun, NOT_READY, WRITE_PROTECTED);
+      return -1;
+    }
+
+    /* cases 3,8,11,13 : Hn,Hi,Ho <> D0 */
+    if ((hmsc->cbw.dDataLength != len) ||
+        ((len != 0U) && ((hmsc->cbw.bmFlags & 0x80U) == 0x80U)))
+    {
+      SCSI_SenseCode(pdev, hmsc->cbw.bLUN, ILLEGAL_REQUEST, INVALID_CDB);
+      return -1;
+    }
+
+    /* No parameter list: nothing to unmap */
+    if (len == 0U)
+    {
+      hmsc->bot_data_length = 0U;
+      return 0;
+    }
+
+    if ((len < 8U) || (len > MSC_MEDIA_PACKET))
+    {
+      SCSI_SenseCode(pdev, lun, ILLEGAL_REQUEST, PARAMETER_LIST_LENGTH_ERROR);
+      return -1;
+    }
+
+    hmsc->bot_state = USBD_BOT_DATA_OUT;
+    (void)USBD_LL_PrepareReceive(pdev, MSC_EPOUT_ADDR, hmsc->bot_data, len);
+
+    return 0;
+  }
+
+  /* Parameter list received */
+  hmsc->csw.dDataResidue -= len;
+
+  nbr = ((uint32_t)hmsc->bot_data[2] << 8) | (uint32_t)hmsc->bot_data[3];
+
+  if (((nbr % 16U) != 0U) || ((8U + nbr) > len))
+  {
+    SCSI_SenseCode(pdev, lun, ILLEGAL_REQUEST, INVALID_FIELD_IN_PARAMETER_LIST);
+    return -1;
+  }
+
+  nbr /= 16U;
+
+  for (i = 0U; i < nbr; i++)
+  {
+    desc = &hmsc->bot_data[8U + (i * 16U)];
+
+    blk_addr = SCSI_GetLba64(&desc[0]);
+    range.blk_len = ((uint32_t)desc[8] << 24) | ((uint32_t)desc[9] << 16) |
+                    ((uint32_t)desc[10] << 8) | (uint32_t)desc[11];
+
+    if (SCSI_CheckAddressRange(pdev, lun, blk_addr, range.blk_len) < 0)
+    {
+      return -1;
+    }
+
+    range.blk_addr = (uint32_t)blk_addr;
+
+    /* Compact the ranges at the start of bot_data, behind the descriptors
+       still to be parsed */
+    (void)USBD_memcpy(&hmsc->bot_data[i * sizeof(range)], &range, sizeof(range));
+  }
+
+  if (nbr == 0U)
+  {
+    MSC_BOT_SendCSW(pdev, USBD_CSW_CMD_PASSED);
+    return 0;
+  }
+
+  MSC_RA_Invalidate(lun);
+
+  hmsc->bot_state = USBD_BOT_MEDIA_WAIT;
+  SCSI_QueueIo(hmsc, lun, MSC_IO_UNMAP, hmsc->bot_data, nbr);
+
+  return 0;
+}
+
+/**
+  * @brief  SCSI_CanUnmap
+  *         Tell whether the backend of a LUN takes UNMAP
+  * @param  lun: Logical unit number
+  * @retval 1 if supported, 0 otherwise
+  */
+static uint8_t SCSI_CanUnmap(USBD_HandleTypeDef *pdev, uint8_t lun)
+{
+  USBD_StorageTypeDef *fops = (USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID];
+
+  if ((fops->Unmap == NULL) || (fops->Unmap(lun, 0U, 0U) != 0))
+  {
+    return 0U;
+  }
+
+  return 1U;
+}
+
 /**
   * @brief  SCSI_CheckAddressRange
   *         Check address range
   * @param  lun: Logical unit number
-  * @param  blk_offset: first block address
+  * @param  blk_offset: first block address, 64-bit for the 16-byte CDBs
   * @param  blk_nbr: number of block to be processed
   * @retval status
   */
 static int8_t SCSI_CheckAddressRange(USBD_HandleTypeDef *pdev, uint8_t lun,
-                                     uint32_t blk_offset, uint32_t blk_nbr)
+                                     uint64_t blk_offset, uint32_t blk_nbr)
 {
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
 
@@ -1036,7 +1570,9 @@ static int8_t SCSI_CheckAddressRange(USBD_HandleTypeDef *pdev, uint8_t lun,
     return -1;
   }
 
-  if ((blk_offset + blk_nbr) > hmsc->scsi_blk_nbr)
+  /* Written so that blk_offset + blk_nbr cannot wrap */
+  if ((blk_nbr > hmsc->scsi_lun[lun].blk_nbr) ||
+      (blk_offset > (uint64_t)(hmsc->scsi_lun[lun].blk_nbr - blk_nbr)))
   {
     SCSI_SenseCode(pdev, lun, ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE);
     return -1;
@@ -1045,76 +1581,273 @@ static int8_t SCSI_CheckAddressRange(USBD_HandleTypeDef *pdev, uint8_t lun,
   return 0;
 }
 
+/**
+  * @brief  SCSI_GetLba64
+  *         Read a big-endian 64-bit LBA from a CDB or descriptor
+  * @param  p: first byte of the LBA
+  * @retval LBA
+  */
+static uint64_t SCSI_GetLba64(const uint8_t *p)
+{
+  uint64_t lba = 0U;
+  uint8_t i;
+
+  for (i = 0U; i < 8U; i++)
+  {
+    lba = (lba << 8) | (uint64_t)p[i];
+  }
+
+  return lba;
+}
+
+/**
+  * @brief  SCSI_StartRead
+  *         Prime the READ ping-pong pipeline with the first chunk
+  * @param  lun: Logical unit number
+  * @retval status
+  */
+static int8_t SCSI_StartRead(USBD_HandleTypeDef *pdev, uint8_t lun)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+
+  if (hmsc == NULL)
+  {
+    return -1;
+  }
+
+  hmsc->rd_start = USBD_GetTick();
+  hmsc->rd_ptr[0] = NULL;
+  hmsc->rd_ptr[1] = NULL;
+  hmsc->rd_inflight = 0U;
+
+  /* Buffer 0 is staged, so SCSI_ProcessRead sees buffer 1 as the last one sent */
+  hmsc->rd_tx = 1U;
+
+  MSC_RA_Track(lun, hmsc->scsi_blk_addr, hmsc->scsi_blk_len);
+
+  return SCSI_StageRead(pdev, lun, 0U);
+}
+
+/**
+  * @brief  SCSI_StageRead
+  *         Stage the next chunk of the current command: map it directly or
+  *         queue a Read into a ping-pong buffer for USBD_MSC_Process
+  * @param  lun: Logical unit number
+  * @param  idx: ping-pong buffer index
+  * @retval status
+  */
+static int8_t SCSI_StageRead(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t idx)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+  USBD_StorageTypeDef *fops = (USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID];
+  uint8_t *pbuf = NULL;
+  uint32_t blk_nbr;
+  uint32_t chunk;
+
+  if (hmsc == NULL)
+  {
+    return -1;
+  }
+
+  chunk = MIN(hmsc->scsi_blk_len * hmsc->scsi_lun[lun].blk_size, MSC_MEDIA_PACKET) / hmsc->scsi_lun[lun].blk_size;
+
+  /* Memory-mapped backend: send the rest of the command straight from it,
+     unless newer data for it is still in the cache */
+  if ((fops->GetReadAddr != NULL) && (MSC_Cache_IsDirty(lun) == 0U))
+  {
+    blk_nbr = MIN(hmsc->scsi_blk_len, 0xFFFFU);
+    pbuf = fops->GetReadAddr(lun, hmsc->scsi_blk_addr, (uint16_t)blk_nbr);
+
+    /* Scattered backends can still map one packet at a time */
+    if ((pbuf == NULL) && (blk_nbr > chunk))
+    {
+      blk_nbr = chunk;
+      pbuf = fops->GetReadAddr(lun, hmsc->scsi_blk_addr, (uint16_t)blk_nbr);
+    }
+
+    if (pbuf != NULL)
+    {
+      hmsc->stats.rd_mapped++;
+    }
+  }
+
+  /* Prefetched by the read-ahead during the last CSW/CBW round-trip */
+  if (pbuf == NULL)
+  {
+    blk_nbr = hmsc->scsi_blk_len;
+    pbuf = MSC_RA_Map(lun, hmsc->scsi_blk_addr, &blk_nbr, hmsc->scsi_lun[lun].blk_size);
+  }
+
+  if (pbuf == NULL)
+  {
+    blk_nbr = chunk;
+
+    hmsc->io.idx = idx;
+    SCSI_QueueIo(hmsc, lun, MSC_IO_READ, hmsc->rd_buf[idx], blk_nbr);
+  }
+  else
+  {
+    hmsc->rd_ptr[idx] = pbuf;
+    hmsc->rd_len[idx] = blk_nbr * hmsc->scsi_lun[lun].blk_size;
+  }
+
+  hmsc->scsi_blk_addr += blk_nbr;
+  hmsc->scsi_blk_len -= blk_nbr;
+
+  return 0;
+}
+
 /**
   * @brief  SCSI_ProcessRead
-  *         Handle Read Process
+  *         Handle Read Process: send the staged buffer and fetch the next
+  *         chunk into the other one while the first is on the wire. Called
+  *         on DataIn and, when the IN endpoint is idle, once a queued Read
+  *         completes.
   * @param  lun: Logical unit number
   * @retval status
   */
 static int8_t SCSI_ProcessRead(USBD_HandleTypeDef *pdev, uint8_t lun)
 {
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
-  uint32_t len = hmsc->scsi_blk_len * hmsc->scsi_blk_size;
+  uint32_t len;
+  uint8_t idx;
 
   if (hmsc == NULL)
   {
     return -1;
   }
 
-  len = MIN(len, MSC_MEDIA_PACKET);
+  idx = hmsc->rd_tx ^ 1U;
+  hmsc->rd_inflight = 0U;
 
-  if (((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->Read(lun, hmsc->bot_data,
-                                                     hmsc->scsi_blk_addr,
-                                                     (len / hmsc->scsi_blk_size)) < 0)
+  if (hmsc->rd_ptr[idx] == NULL)
   {
-    SCSI_SenseCode(pdev, lun, HARDWARE_ERROR, UNRECOVERED_READ_ERROR);
+    /* Still being read: the IN endpoint NAKs until SCSI_MediaCplt */
+    if (hmsc->io.state != MSC_IO_IDLE)
+    {
+      return 0;
+    }
+
+    /* Staging failed, sense is already set */
     return -1;
   }
 
-  (void)USBD_LL_Transmit(pdev, MSC_EPIN_ADDR, hmsc->bot_data, len);
+  len = hmsc->rd_len[idx];
+  hmsc->rd_tx = idx;
 
-  hmsc->scsi_blk_addr += (len / hmsc->scsi_blk_size);
-  hmsc->scsi_blk_len -= (len / hmsc->scsi_blk_size);
+  (void)USBD_LL_Transmit(pdev, MSC_EPIN_ADDR, hmsc->rd_ptr[idx], len);
+  hmsc->rd_ptr[idx] = NULL;
+  hmsc->rd_inflight = 1U;
 
   /* case 6 : Hi = Di */
   hmsc->csw.dDataResidue -= len;
+  hmsc->stats.rd_bytes += len;
 
   if (hmsc->scsi_blk_len == 0U)
   {
     hmsc->bot_state = USBD_BOT_LAST_DATA_IN;
   }
+  else
+  {
+    /* A failed Read is reported on the next DataIn, once this chunk is out */
+    (void)SCSI_StageRead(pdev, lun, idx ^ 1U);
+  }
 
   return 0;
 }
 
+/**
+  * @brief  SCSI_PrepareWrite
+  *         Arm the OUT endpoint for the next chunk of the current command,
+  *         straight into backend memory when it is mapped
+  * @param  lun: Logical unit number
+  * @retval None
+  */
+static void SCSI_PrepareWrite(USBD_HandleTypeDef *pdev, uint8_t lun)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+  USBD_StorageTypeDef *fops = (USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID];
+  uint8_t *pbuf = NULL;
+  uint32_t blk_nbr;
+  uint32_t chunk;
+
+  if (hmsc == NULL)
+  {
+    return;
+  }
+
+  chunk = MIN(hmsc->scsi_blk_len * hmsc->scsi_lun[lun].blk_size, MSC_MEDIA_PACKET) / hmsc->scsi_lun[lun].blk_size;
+
+  if ((fops->GetWriteAddr != NULL) && (MSC_Cache_IsCached(lun) == 0U))
+  {
+    blk_nbr = MIN(hmsc->scsi_blk_len, 0xFFFFU);
+    pbuf = fops->GetWriteAddr(lun, hmsc->scsi_blk_addr, (uint16_t)blk_nbr);
+
+    if ((pbuf == NULL) && (blk_nbr > chunk))
+    {
+      blk_nbr = chunk;
+      pbuf = fops->GetWriteAddr(lun, hmsc->scsi_blk_addr, (uint16_t)blk_nbr);
+    }
+
+    if (pbuf != NULL)
+    {
+      hmsc->stats.wr_mapped++;
+    }
+  }
+
+  if (pbuf == NULL)
+  {
+    blk_nbr = chunk;
+    pbuf = hmsc->bot_data;
+  }
+
+  hmsc->wr_ptr = pbuf;
+  hmsc->wr_len = blk_nbr * hmsc->scsi_lun[lun].blk_size;
+
+  (void)USBD_LL_PrepareReceive(pdev, MSC_EPOUT_ADDR, hmsc->wr_ptr, hmsc->wr_len);
+}
+
 /**
   * @brief  SCSI_ProcessWrite
-  *         Handle Write Process
+  *         Handle Write Process: hand the received chunk to USBD_MSC_Process.
+  *         The OUT endpoint is left unarmed, so the host is NAKed meanwhile.
   * @param  lun: Logical unit number
   * @retval status
   */
 static int8_t SCSI_ProcessWrite(USBD_HandleTypeDef *pdev, uint8_t lun)
 {
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
-  uint32_t len = hmsc->scsi_blk_len * hmsc->scsi_blk_size;
 
   if (hmsc == NULL)
   {
     return -1;
   }
 
-  len = MIN(len, MSC_MEDIA_PACKET);
+  SCSI_QueueIo(hmsc, lun, MSC_IO_WRITE, hmsc->wr_ptr, hmsc->wr_len / hmsc->scsi_lun[lun].blk_size);
 
-  if (((USBD_StorageTypeDef *)pdev->pUserDatas[USBD_MSC_USERDATA_ID])->Write(lun, hmsc->bot_data,
-                                                      hmsc->scsi_blk_addr,
-                                                      (len / hmsc->scsi_blk_size)) < 0)
+  return 0;
+}
+
+/**
+  * @brief  SCSI_WriteCplt
+  *         Account for a written chunk, then arm the next one or send the CSW
+  * @param  lun: Logical unit number
+  * @retval status
+  */
+static int8_t SCSI_WriteCplt(USBD_HandleTypeDef *pdev, uint8_t lun)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+  uint32_t len;
+
+  if (hmsc == NULL)
   {
-    SCSI_SenseCode(pdev, lun, HARDWARE_ERROR, WRITE_FAULT);
     return -1;
   }
 
-  hmsc->scsi_blk_addr += (len / hmsc->scsi_blk_size);
-  hmsc->scsi_blk_len -= (len / hmsc->scsi_blk_size);
+  len = hmsc->wr_len;
+
+  hmsc->scsi_blk_addr += (len / hmsc->scsi_lun[lun].blk_size);
+  hmsc->scsi_blk_len -= (len / hmsc->scsi_lun[lun].blk_size);
 
   /* case 12 : Ho = Do */
   hmsc->csw.dDataResidue -= len;
@@ -1125,15 +1858,96 @@ static int8_t SCSI_ProcessWrite(USBD_HandleTypeDef *pdev, uint8_t lun)
   }
   else
   {
-    len = MIN((hmsc->scsi_blk_len * hmsc->scsi_blk_size), MSC_MEDIA_PACKET);
-
     /* Prepare EP to Receive next packet */
-    (void)USBD_LL_PrepareReceive(pdev, MSC_EPOUT_ADDR, hmsc->bot_data, len);
+    SCSI_PrepareWrite(pdev, lun);
   }
 
   return 0;
 }
 
+/**
+  * @brief  SCSI_QueueIo
+  *         Queue a media request at the current block address
+  * @param  hmsc handler
+  * @param  lun: Logical unit number
+  * @param  op: MSC_IO_READ or MSC_IO_WRITE
+  * @param  pbuf: data buffer
+  * @param  blk_nbr: number of blocks
+  * @retval None
+  */
+static void SCSI_QueueIo(USBD_MSC_BOT_HandleTypeDef *hmsc, uint8_t lun, uint8_t op,
+                         uint8_t *pbuf, uint32_t blk_nbr)
+{
+  hmsc->io.op = op;
+  hmsc->io.lun = lun;
+  hmsc->io.buf = pbuf;
+  hmsc->io.blk_addr = hmsc->scsi_blk_addr;
+  hmsc->io.blk_len = (uint16_t)blk_nbr;
+  hmsc->io.state = MSC_IO_PENDING;
+}
+
+/**
+  * @brief  SCSI_MediaCplt
+  *         Complete the media request run by USBD_MSC_Process and resume
+  *         the data phase. Called with the USB interrupt masked.
+  * @param  lun: Logical unit number
+  * @param  status: result of the storage Read/Write/Poll
+  * @retval status
+  */
+int8_t SCSI_MediaCplt(USBD_HandleTypeDef *pdev, uint8_t lun, int8_t status)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDatas[USBD_MSC_CLASS_ID];
+  uint8_t idx;
+
+  if (hmsc == NULL)
+  {
+    return -1;
+  }
+
+  if ((hmsc->io.op == MSC_IO_FLUSH) || (hmsc->io.op == MSC_IO_UNMAP))
+  {
+    if (status < 0)
+    {
+      SCSI_SenseCode(pdev, lun, HARDWARE_ERROR, WRITE_FAULT);
+      return -1;
+    }
+
+    MSC_BOT_SendCSW(pdev, USBD_CSW_CMD_PASSED);
+    return 0;
+  }
+
+  if (hmsc->io.op == MSC_IO_WRITE)
+  {
+    if (status < 0)
+    {
+      SCSI_SenseCode(pdev, lun, HARDWARE_ERROR, WRITE_FAULT);
+      return -1;
+    }
+
+    return SCSI_WriteCplt(pdev, lun);
+  }
+
+  idx = hmsc->io.idx;
+
+  if (status < 0)
+  {
+    SCSI_SenseCode(pdev, lun, HARDWARE_ERROR, UNRECOVERED_READ_ERROR);
+  }
+  else
+  {
+    hmsc->rd_ptr[idx] = hmsc->io.buf;
+    hmsc->rd_len[idx] = (uint32_t)hmsc->io.blk_len * hmsc->scsi_lun[lun].blk_size;
+  }
+
+  /* The chunk on the wire picks this one up on its DataIn */
+  if (hmsc->rd_inflight != 0U)
+  {
+    return 0;
+  }
+
+  return SCSI_ProcessRead(pdev, lun);
+}
+
 
 /**
   * @brief  SCSI_UpdateBotData
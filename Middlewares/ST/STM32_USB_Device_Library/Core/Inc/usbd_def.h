@@ -281,7 +281,7 @@ typedef struct
   uint16_t bInterval;
 } USBD_EndpointTypeDef;
 
-#define USBD_CLASS_DATA_CAPACITY 4
+#define USBD_CLASS_DATA_CAPACITY 5  /* DFU, MSC and up to 3 CDC ports, see usbd_composite.h */
 #define USBD_USER_DATA_CAPACITY 4
 /* USB Device handle structure */
 typedef struct _USBD_HandleTypeDef
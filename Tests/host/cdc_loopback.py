@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""
+@file cdc_loopback.py
+@author Liu Yuanlin (liuyuanlins@outlook.com)
+@brief Loopback and throughput check of the CDC ports against the board.
+@version 0.1
+@date 2026-10-17
+@last modified 2026-10-17
+
+@copyright Copyright (c) 2024 Liu Yuanlin Personal.
+
+main.c 把每个 CDC 口收到的数据原样发回. 这个脚本按不同长度写入再读回,
+重点是 64 的整数倍: 这种传输要靠结尾的 ZLP 结束, 设备漏发时主机的读会
+一直挂着, 这里表现为超时. 然后双向同时跑满, 报告吞吐.
+
+需要 pyserial:  pip install pyserial
+    python3 cdc_loopback.py /dev/ttyACM1
+    python3 cdc_loopback.py COM5 --sizes 64 4096 --bulk 4194304
+
+第一个口每秒还会发 "Hello World\\n", 所以负载只用 0x80-0xFF 的字节,
+读回时丢掉 ASCII.
+"""
+import argparse
+import sys
+import threading
+import time
+
+try:
+    import serial
+except ImportError:
+    sys.exit("pyserial is missing: pip install pyserial")
+
+EP_SIZE = 64  # CDC_DATA_FS_MAX_PACKET_SIZE
+ASCII = bytes(range(0x80))
+DEFAULT_SIZES = [1, 63, 64, 65, 127, 128, 129, 512, 1024, 2048, 4096, 8192, 65536]
+
+
+def payload(size, seed):
+    return bytes(0x80 | ((i * 7 + seed) & 0x7F) for i in range(size))
+
+
+def read_exact(port, size, timeout):
+    """Read size payload bytes, ASCII from the hello line is dropped."""
+    data = bytearray()
+    deadline = time.monotonic() + timeout
+
+    while len(data) < size and time.monotonic() < deadline:
+        chunk = port.read(max(1, min(port.in_waiting, size - len(data))))
+        data += chunk.translate(None, ASCII)
+
+    return bytes(data)
+
+
+def check_sizes(port, sizes, repeat, timeout):
+    """Echo each size and compare, a missing ZLP shows up as a timeout."""
+    failed = 0
+
+    for size in sizes:
+        for n in range(repeat):
+            tx = payload(size, size + n)
+            # 边写边读, 否则设备的发送缓冲满了就不再收
+            th = threading.Thread(target=port.write, args=(tx,))
+            th.start()
+            rx = read_exact(port, size, timeout + size / 100000.0)
+            th.join()
+            # 多出来的字节说明上一次的数据没读完或者重复发了
+            extra = read_exact(port, 1, 0.05)
+
+            if rx != tx or extra:
+                how = "timeout after %d bytes" % len(rx) if len(rx) < size else "data differs"
+                if extra:
+                    how = "extra bytes"
+                print("FAIL size %6d (%s)  %s" % (size, packets(size), how))
+                failed += 1
+                break
+        else:
+            print("ok   size %6d (%s)" % (size, packets(size)))
+
+    return failed
+
+
+def packets(size):
+    full, rest = divmod(size, EP_SIZE)
+    if rest == 0:
+        return "%d x %d + ZLP" % (full, EP_SIZE)
+    return "%d x %d + %d" % (full, EP_SIZE, rest)
+
+
+def throughput(port, chunk, total, timeout):
+    """Write total bytes in chunk sized writes while another thread reads them back."""
+    tx = payload(chunk, chunk)
+    result = {"rx": 0, "ok": True}
+
+    def reader():
+        deadline = time.monotonic() + timeout
+        while result["rx"] < total and time.monotonic() < deadline:
+            data = port.read(max(1, port.in_waiting)).translate(None, ASCII)
+            if not data:
+                continue
+            # 读回的是 tx 的重复, 从 rx % chunk 处接上
+            pos = result["rx"] % chunk
+            want = tx * ((pos + len(data)) // chunk + 1)
+            if data != want[pos:pos + len(data)]:
+                result["ok"] = False
+            result["rx"] += len(data)
+            deadline = time.monotonic() + timeout
+
+    th = threading.Thread(target=reader)
+    start = time.monotonic()
+    th.start()
+    sent = 0
+    while sent < total:
+        port.write(tx)
+        sent += chunk
+    port.flush()
+    th.join()
+    elapsed = time.monotonic() - start
+
+    ok = result["ok"] and result["rx"] == sent
+    print("%s chunk %6d  %8d bytes each way  %.1f s  %.1f KB/s" %
+          ("ok  " if ok else "FAIL", chunk, result["rx"], elapsed, result["rx"] / elapsed / 1024.0))
+    return 0 if ok else 1
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Loopback and throughput check of the CDC ports.")
+    ap.add_argument("port", help="serial device of a CDC port, e.g. /dev/ttyACM1 or COM5")
+    ap.add_argument("--sizes", type=int, nargs="+", default=DEFAULT_SIZES, help="echo sizes in bytes")
+    ap.add_argument("--repeat", type=int, default=4, help="echoes per size")
+    ap.add_argument("--bulk", type=int, default=1 << 20, help="bytes per throughput run")
+    ap.add_argument("--timeout", type=float, default=2.0, help="seconds without data before failing")
+    args = ap.parse_args()
+
+    with serial.Serial(args.port, 115200, timeout=0.05) as port:
+        port.reset_input_buffer()
+        failed = check_sizes(port, args.sizes, args.repeat, args.timeout)
+
+        for chunk in sorted({s for s in args.sizes if s % EP_SIZE == 0}):
+            total = args.bulk - args.bulk % chunk
+            if total:
+                read_exact(port, 1 << 20, 0.2)
+                failed += throughput(port, chunk, total, args.timeout)
+
+    print("cdc_loopback: %s" % ("PASS" if failed == 0 else "FAIL"))
+    return 0 if failed == 0 else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
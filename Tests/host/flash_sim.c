@@ -0,0 +1,130 @@
+/**
+ * @file flash_sim.c
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Internal flash model behind the HAL flash API, for the host tests.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ */
+#define _GNU_SOURCE
+#include "flash_sim.h"
+#include "host.h"
+#include <string.h>
+#include <sys/mman.h>
+
+FLASH_SIM_StatsTypeDef flash_sim;
+jmp_buf flash_sim_cut;
+
+static uint8_t *flash_mem      = NULL;
+static uint8_t flash_locked    = 1U;
+static uint32_t flash_cut_left = 0U;
+
+int FLASH_SIM_Init(void)
+{
+    void *p;
+
+    if (flash_mem == NULL) {
+        // 后端把地址当 uint32_t, 必须映射到原地址
+        p = mmap((void *)(uintptr_t)FLASH_SIM_BASE, FLASH_SIM_SIZE, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        if ((p == MAP_FAILED) || (p != (void *)(uintptr_t)FLASH_SIM_BASE)) {
+            printf("flash_sim: cannot map 0x%08X\n", (unsigned)FLASH_SIM_BASE);
+            return -1;
+        }
+        flash_mem = p;
+    }
+
+    memset(flash_mem, 0xFF, FLASH_SIM_SIZE);
+    memset(&flash_sim, 0, sizeof(flash_sim));
+    flash_locked   = 1U;
+    flash_cut_left = 0U;
+
+    return 0;
+}
+
+void FLASH_SIM_CutAfter(uint32_t ops)
+{
+    flash_cut_left = ops;
+    // 上电后闪存是锁住的
+    flash_locked = 1U;
+}
+
+// 到了掉电点就不执行这次擦写
+static void FLASH_SIM_Op(void)
+{
+    if (flash_cut_left == 0U) {
+        return;
+    }
+
+    if (--flash_cut_left == 0U) {
+        longjmp(flash_sim_cut, 1);
+    }
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+    flash_locked = 0U;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+    flash_locked = 1U;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+    uint64_t cur;
+
+    if ((TypeProgram != FLASH_TYPEPROGRAM_DOUBLEWORD) || (flash_locked != 0U) || ((Address & 7U) != 0U) ||
+        (Address < FLASH_SIM_BASE) || (Address >= (FLASH_SIM_BASE + FLASH_SIM_SIZE))) {
+        flash_sim.errors++;
+        return HAL_ERROR;
+    }
+
+    // 和芯片一样, 只能编程已擦除的双字
+    memcpy(&cur, flash_mem + (Address - FLASH_SIM_BASE), sizeof(cur));
+    if (cur != UINT64_MAX) {
+        flash_sim.errors++;
+        return HAL_ERROR;
+    }
+
+    FLASH_SIM_Op();
+
+    memcpy(flash_mem + (Address - FLASH_SIM_BASE), &Data, sizeof(Data));
+    flash_sim.programs++;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError)
+{
+    uint32_t bank_pages = FLASH_SIM_BANK_SIZE / FLASH_PAGE_SIZE;
+    uint32_t page;
+    uint32_t i;
+
+    *PageError = 0xFFFFFFFFU;
+
+    if ((flash_locked != 0U) || (pEraseInit->TypeErase != FLASH_TYPEERASE_PAGES) ||
+        ((pEraseInit->Banks != FLASH_BANK_1) && (pEraseInit->Banks != FLASH_BANK_2)) ||
+        (pEraseInit->Page + pEraseInit->NbPages > bank_pages)) {
+        flash_sim.errors++;
+        return HAL_ERROR;
+    }
+
+    for (i = 0U; i < pEraseInit->NbPages; i++) {
+        page = pEraseInit->Page + i + ((pEraseInit->Banks == FLASH_BANK_2) ? bank_pages : 0U);
+
+        FLASH_SIM_Op();
+
+        memset(flash_mem + page * FLASH_PAGE_SIZE, 0xFF, FLASH_PAGE_SIZE);
+        flash_sim.page_erase[page]++;
+        flash_sim.erases++;
+    }
+
+    return HAL_OK;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file flash_sim.h
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Internal flash model behind the HAL flash API, for the host tests.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ * 在 0x08000000 映射 512KB 双 bank 闪存 (DBANK=1, 2KB 页), 后端照常用
+ * 绝对地址读, 通过下面的 HAL 函数擦写. 编程必须解锁, 双字对齐, 目标已擦除.
+ * FLASH_SIM_CutAfter 设定再执行多少次擦写后掉电, 掉电时那一次不执行,
+ * longjmp 回 flash_sim_cut.
+ */
+#ifndef FLASH_SIM_H
+#define FLASH_SIM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <setjmp.h>
+
+#define FLASH_SIM_BASE              0x08000000U
+#define FLASH_SIM_SIZE              0x80000U
+#define FLASH_SIM_BANK_SIZE         0x40000U
+
+#define FLASH_PAGE_SIZE             0x800U
+#define FLASH_SIM_PAGE_NBR          (FLASH_SIM_SIZE / FLASH_PAGE_SIZE)
+
+#define FLASH_BANK_1                0x00000001U
+#define FLASH_BANK_2                0x00000002U
+#define FLASH_TYPEERASE_PAGES       0x00U
+#define FLASH_TYPEPROGRAM_DOUBLEWORD 0x00U
+#define FLASH_FLAG_ALL_ERRORS       0x0000C3FAU
+
+#define __HAL_FLASH_CLEAR_FLAG(f)   ((void)(f))
+
+typedef enum {
+    HAL_OK    = 0x00U,
+    HAL_ERROR = 0x01U
+} HAL_StatusTypeDef;
+
+typedef struct {
+    uint32_t TypeErase;
+    uint32_t Banks;
+    uint32_t Page;
+    uint32_t NbPages;
+} FLASH_EraseInitTypeDef;
+
+typedef struct {
+    uint32_t page_erase[FLASH_SIM_PAGE_NBR]; // 每页擦除次数
+    uint32_t erases;                         // 页擦除总数
+    uint32_t programs;                       // 双字编程总数
+    uint32_t errors;                         // 违规擦写: 未解锁, 未对齐, 覆盖已编程的双字
+} FLASH_SIM_StatsTypeDef;
+
+extern FLASH_SIM_StatsTypeDef flash_sim;
+extern jmp_buf flash_sim_cut;
+
+// 映射闪存并全部擦除, 失败返回 -1
+int FLASH_SIM_Init(void);
+// 再执行 ops 次擦写后掉电, 0 关闭
+void FLASH_SIM_CutAfter(uint32_t ops);
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //! FLASH_SIM_H
@@ -0,0 +1,56 @@
+/**
+ * @file host.c
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Shared helpers of the host-side tests.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ */
+#include "host.h"
+#include <time.h>
+
+uint32_t host_fail = 0U;
+uint32_t host_tick = 0U;
+
+static uint32_t host_seed = 1U;
+
+// 模拟器按操作耗时推进 host_tick, HOST_Delay 直接跳过等待
+uint32_t HOST_GetTick(void)
+{
+    return host_tick;
+}
+
+void HOST_Delay(uint32_t ms)
+{
+    host_tick += ms;
+}
+
+uint32_t HOST_Rand(void)
+{
+    host_seed = host_seed * 1103515245U + 12345U;
+    return host_seed >> 8;
+}
+
+void HOST_Fill(uint8_t *buf, uint32_t len, uint32_t seed)
+{
+    uint32_t i;
+
+    for (i = 0U; i < len; i++) {
+        seed   = seed * 1103515245U + 12345U;
+        buf[i] = (uint8_t)(seed >> 16);
+    }
+}
+
+double HOST_Seconds(void)
+{
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+int HOST_Result(const char *name)
+{
+    printf("%s: %s\n", name, (host_fail == 0U) ? "PASS" : "FAIL");
+    return (host_fail == 0U) ? 0 : 1;
+}
@@ -0,0 +1,42 @@
+/**
+ * @file host.h
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Shared helpers of the host-side tests.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ */
+#ifndef HOST_H
+#define HOST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
+extern uint32_t host_fail;
+extern uint32_t host_tick;
+
+// 失败只计数, 跑完所有用例后由 main 返回
+#define HOST_CHECK(cond)                                                         \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);               \
+            host_fail++;                                                         \
+        }                                                                        \
+    } while (0)
+
+uint32_t HOST_Rand(void);
+void HOST_Fill(uint8_t *buf, uint32_t len, uint32_t seed);
+double HOST_Seconds(void);
+int HOST_Result(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //! HOST_H
@@ -0,0 +1,79 @@
+/**
+ * @file usbd_conf.h
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Host build of the USB device configuration, for the tests in Tests/host.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ * 取代 USB_Device/Target/usbd_conf.h, 让存储后端不带 HAL 在 PC 上编译.
+ * 参数和目标板保持一致, 周期计数换成 clock(), 临界区为空.
+ */
+#ifndef __USBD_CONF__H__
+#define __USBD_CONF__H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+// 平时由 CMSIS 和 HAL 提供
+#define __IO            volatile
+#define __STATIC_INLINE static inline
+#define UNUSED(X)       (void)(X)
+
+#define USBD_CDC_PORT_NBR             2U
+#define USBD_MAX_NUM_INTERFACES       (1U + 2U * USBD_CDC_PORT_NBR)
+#define USBD_MAX_NUM_CONFIGURATION    1U
+#define USBD_MAX_STR_DESC_SIZ         512U
+#define USBD_SUPPORT_USER_STRING_DESC 1U
+#define USBD_DEBUG_LEVEL              0U
+#define USBD_LPM_ENABLED              1U
+#define USBD_SELF_POWERED             1U
+#define MSC_MEDIA_PACKET              512U
+#define MSC_MAX_LUN                   8U
+#define MSC_CACHE_BLK_NBR             8U
+#define MSC_CACHE_LUN_MASK            0x06U
+#define MSC_CACHE_IDLE_MS             500U
+#define MSC_RA_BLK_NBR                8U
+#define MSC_RA_LUN_MASK               0xCFU
+#define USBD_DFU_MAX_ITF_NUM          1U
+#define USBD_DFU_XFER_SIZE            1024U
+#define USBD_DFU_APP_DEFAULT_ADD      0x08010000U
+
+#define DEVICE_FS 0
+
+#define USBD_malloc (void *)malloc
+#define USBD_free   free
+#define USBD_memset memset
+#define USBD_memcpy memcpy
+
+// 由测试提供, 模拟器用它推进时间
+uint32_t HOST_GetTick(void);
+void HOST_Delay(uint32_t ms);
+
+#define USBD_Delay   HOST_Delay
+#define USBD_GetTick HOST_GetTick
+
+#define USBD_GetCycles()  ((uint32_t)clock())
+#define USBD_CyclesInit() do { } while (0)
+
+#define USBD_ENTER_CRITICAL() do { } while (0)
+#define USBD_EXIT_CRITICAL()  do { } while (0)
+
+#define USBD_UsrLog(...)
+#define USBD_ErrLog(...)
+#define USBD_DbgLog(...)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_CONF__H__ */
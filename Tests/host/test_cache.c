@@ -0,0 +1,227 @@
+/**
+ * @file test_cache.c
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Write-back cache against a backend that finishes every access in Poll.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ * 直接编译 usbd_msc_cache.c, 后端每次访问都先返回 MSC_MEDIA_BUSY, 随机若干次
+ * Poll 后才完成. 检查缓存不会自己循环等待 (每次 MSC_Cache_Poll 只调一次 Poll),
+ * 同一时间只有一个后端访问, 随机读写/UNMAP/FLUSH 的结果和参考模型一致.
+ */
+#include "host.h"
+#include "usbd_msc_cache.c"
+
+#define FAKE_LUN_NBR  3U
+#define FAKE_BLK_NBR  64U
+#define FAKE_BLK_SIZ  512U
+#define FAKE_ROUNDS   20000U
+
+static uint8_t fake_disk[FAKE_LUN_NBR][FAKE_BLK_NBR][FAKE_BLK_SIZ];
+static uint8_t fake_ref[FAKE_LUN_NBR][FAKE_BLK_NBR][FAKE_BLK_SIZ];
+
+// 进行中的访问, 完成时才把数据读出来
+static uint8_t *fake_buf;
+static uint32_t fake_addr;
+static uint16_t fake_len;
+static uint8_t fake_lun;
+static uint8_t fake_read;
+static uint8_t fake_active;
+static uint32_t fake_left;     // 还要几次 Poll
+static uint32_t fake_polls;
+static uint32_t fake_accesses;
+static uint32_t fake_overlap;
+static uint32_t fake_fail_at;  // 第几次访问失败, 0 不失败
+
+static int8_t Fake_Start(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len, uint8_t rd)
+{
+    if (fake_active != 0U) {
+        fake_overlap++;
+    }
+    fake_accesses++;
+    if ((fake_fail_at != 0U) && (fake_accesses == fake_fail_at)) {
+        return -1;
+    }
+    if ((lun >= FAKE_LUN_NBR) || (blk_addr + blk_len > FAKE_BLK_NBR)) {
+        return -1;
+    }
+    if (rd == 0U) {
+        memcpy(fake_disk[lun][blk_addr], buf, (size_t)blk_len * FAKE_BLK_SIZ);
+    }
+    fake_buf    = buf;
+    fake_addr   = blk_addr;
+    fake_len    = blk_len;
+    fake_lun    = lun;
+    fake_read   = rd;
+    fake_active = 1U;
+    fake_left   = HOST_Rand() % 4U;
+    return MSC_MEDIA_BUSY;
+}
+
+static int8_t Fake_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    return Fake_Start(lun, buf, blk_addr, blk_len, 1U);
+}
+
+static int8_t Fake_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    return Fake_Start(lun, buf, blk_addr, blk_len, 0U);
+}
+
+static int8_t Fake_Poll(uint8_t lun)
+{
+    fake_polls++;
+    HOST_CHECK(fake_active != 0U);
+    HOST_CHECK(lun == fake_lun);
+    if (fake_left != 0U) {
+        fake_left--;
+        return MSC_MEDIA_BUSY;
+    }
+    if (fake_read != 0U) {
+        memcpy(fake_buf, fake_disk[fake_lun][fake_addr], (size_t)fake_len * FAKE_BLK_SIZ);
+    }
+    fake_active = 0U;
+    return 0;
+}
+
+static int8_t Fake_Flush(uint8_t lun)
+{
+    return Fake_Start(lun, NULL, 0U, 0U, 1U);
+}
+
+static int8_t Fake_Unmap(uint8_t lun, uint32_t blk_addr, uint32_t blk_len)
+{
+    // 解除映射后读回全 0
+    if (blk_addr + blk_len <= FAKE_BLK_NBR) {
+        memset(fake_disk[lun][blk_addr], 0, blk_len * FAKE_BLK_SIZ);
+    }
+    return Fake_Start(lun, NULL, 0U, 0U, 1U);
+}
+
+static int8_t Fake_GetMaxLun(void)
+{
+    return (int8_t)(FAKE_LUN_NBR - 1U);
+}
+
+static USBD_StorageTypeDef fake_fops = {
+    .Read      = Fake_Read,
+    .Write     = Fake_Write,
+    .GetMaxLun = Fake_GetMaxLun,
+    .Poll      = Fake_Poll,
+    .Flush     = Fake_Flush,
+    .Unmap     = Fake_Unmap,
+};
+
+// 主循环的角色: 每轮只调一次 MSC_Cache_Poll
+static int8_t Cache_Wait(int8_t ret, uint32_t *calls)
+{
+    uint32_t polls;
+
+    while (ret > 0) {
+        HOST_CHECK(MSC_Cache_IsBusy() != 0U);
+        polls = fake_polls;
+        ret   = MSC_Cache_Poll(&fake_fops);
+        HOST_CHECK(fake_polls - polls == 1U);
+        (*calls)++;
+    }
+    HOST_CHECK(MSC_Cache_IsBusy() == 0U);
+    return ret;
+}
+
+static void Cache_Random(void)
+{
+    static uint8_t buf[4U * FAKE_BLK_SIZ];
+    USBD_MSC_RangeTypeDef range[2];
+    uint32_t calls = 0U;
+    uint32_t r;
+    uint32_t i;
+    uint32_t op;
+    uint8_t lun;
+    uint32_t addr;
+    uint16_t len;
+
+    for (r = 0U; r < FAKE_ROUNDS; r++) {
+        op   = HOST_Rand() % 16U;
+        lun  = (uint8_t)(HOST_Rand() % FAKE_LUN_NBR);
+        len  = (uint16_t)(1U + HOST_Rand() % 4U);
+        addr = HOST_Rand() % (FAKE_BLK_NBR - len + 1U);
+
+        if (op < 7U) {
+            HOST_CHECK(Cache_Wait(MSC_Cache_Read(&fake_fops, lun, buf, addr, len, FAKE_BLK_SIZ), &calls) == 0);
+            HOST_CHECK(memcmp(buf, fake_ref[lun][addr], (size_t)len * FAKE_BLK_SIZ) == 0);
+        } else if (op < 14U) {
+            HOST_Fill(buf, (uint32_t)len * FAKE_BLK_SIZ, r);
+            HOST_CHECK(Cache_Wait(MSC_Cache_Write(&fake_fops, lun, buf, addr, len, FAKE_BLK_SIZ), &calls) == 0);
+            memcpy(fake_ref[lun][addr], buf, (size_t)len * FAKE_BLK_SIZ);
+        } else if (op == 14U) {
+            range[0].blk_addr = addr;
+            range[0].blk_len  = len;
+            range[1].blk_addr = (addr + 7U) % (FAKE_BLK_NBR - 1U);
+            range[1].blk_len  = 1U;
+            HOST_CHECK(Cache_Wait(MSC_Cache_Unmap(&fake_fops, lun, (uint8_t *)range, 2U), &calls) == 0);
+            for (i = 0U; i < 2U; i++) {
+                memset(fake_ref[lun][range[i].blk_addr], 0, range[i].blk_len * FAKE_BLK_SIZ);
+            }
+        } else {
+            HOST_CHECK(Cache_Wait(MSC_Cache_Flush(&fake_fops, lun), &calls) == 0);
+            if (MSC_Cache_IsCached(lun) != 0U) {
+                HOST_CHECK(MSC_Cache_IsDirty(lun) == 0U);
+            }
+            HOST_CHECK(memcmp(fake_disk[lun], fake_ref[lun], sizeof(fake_ref[lun])) == 0);
+        }
+    }
+
+    // 空闲刷写在后台进行, 完成后后端和参考模型一致
+    host_tick += MSC_CACHE_IDLE_MS;
+    MSC_Cache_Idle(&fake_fops);
+    HOST_CHECK(Cache_Wait(MSC_Cache_IsBusy() != 0U ? MSC_MEDIA_BUSY : 0, &calls) == 0);
+    HOST_CHECK(MSC_CachePending == 0U);
+    HOST_CHECK(memcmp(fake_disk, fake_ref, sizeof(fake_ref)) == 0);
+    HOST_CHECK(fake_overlap == 0U);
+
+    printf("random   rounds %u  backend accesses %u  main loop calls %u  "
+           "hits %u  misses %u  writebacks %u  flushes %u\n",
+           (unsigned)FAKE_ROUNDS, (unsigned)fake_accesses, (unsigned)calls,
+           (unsigned)MSC_CacheStats.hits, (unsigned)MSC_CacheStats.misses,
+           (unsigned)MSC_CacheStats.writebacks, (unsigned)MSC_CacheStats.flushes);
+}
+
+// 请求被取消后不再碰调用者的缓冲区, 行状态保持一致
+static void Cache_Cancel(void)
+{
+    static uint8_t buf[2U * FAKE_BLK_SIZ];
+    uint32_t calls = 0U;
+    int8_t ret;
+
+    HOST_CHECK(Cache_Wait(MSC_Cache_Unmap(&fake_fops, 1U, (uint8_t *)&(USBD_MSC_RangeTypeDef){ 0U, FAKE_BLK_NBR }, 1U), &calls) == 0);
+    memset(fake_ref[1], 0, sizeof(fake_ref[1]));
+
+    memset(buf, 0x5A, sizeof(buf));
+    ret = MSC_Cache_Read(&fake_fops, 1U, buf, 10U, 2U, FAKE_BLK_SIZ);
+    HOST_CHECK(ret == MSC_MEDIA_BUSY);
+    MSC_Cache_Cancel();
+    HOST_CHECK(Cache_Wait(ret, &calls) < 0);
+    HOST_CHECK((buf[0] == 0x5AU) && (buf[sizeof(buf) - 1U] == 0x5AU));
+
+    // 写回失败: 请求报错, 行仍然是脏的, 之后的 FLUSH 能把它写下去
+    HOST_Fill(buf, FAKE_BLK_SIZ, 99U);
+    HOST_CHECK(Cache_Wait(MSC_Cache_Write(&fake_fops, 1U, buf, 3U, 1U, FAKE_BLK_SIZ), &calls) == 0);
+    memcpy(fake_ref[1][3], buf, FAKE_BLK_SIZ);
+    fake_fail_at = fake_accesses + 1U;
+    HOST_CHECK(Cache_Wait(MSC_Cache_Flush(&fake_fops, 1U), &calls) < 0);
+    HOST_CHECK(MSC_Cache_IsDirtyRange(1U, 3U, 1U) != 0U);
+    fake_fail_at = 0U;
+    HOST_CHECK(Cache_Wait(MSC_Cache_Flush(&fake_fops, 1U), &calls) == 0);
+    HOST_CHECK(memcmp(fake_disk[1], fake_ref[1], sizeof(fake_ref[1])) == 0);
+}
+
+int main(void)
+{
+    Cache_Random();
+    Cache_Cancel();
+
+    return HOST_Result("test_cache");
+}
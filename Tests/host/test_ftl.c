@@ -0,0 +1,294 @@
+/**
+ * @file test_ftl.c
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Write amplification, wear, trim and power loss of the FTL backend
+ *        on the flash model.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ * 直接编译 usbd_storage_ftl.c, 擦写走 flash_sim. 冷热数据随机写并和参考
+ * 模型比较, 报告写放大和每页擦除次数; 检查 UNMAP 在重新上电和垃圾回收
+ * 之后仍然有效; 在随机的擦写点掉电, 重新挂载后每个扇区只能是旧值或新值.
+ * 两次掉电之间至少完成一次垃圾回收, 见 usbd_storage_ftl.c 开头的说明.
+ */
+#include "host.h"
+#include "flash_sim.h"
+#include "usbd_storage_ftl.c"
+
+#define TEST_LUN      2U
+#define TEST_ROUNDS   30000U
+#define TEST_HOT_NBR  (STORAGE_FTL_BLK_NBR / 10U) // 80% 的写落在这些扇区
+#define TEST_CUTS     300U
+#define TEST_SETTLE   (2U * STORAGE_FTL_SLOT_NBR) // 掉电后先正常写这么多扇区
+#define TEST_MAX_LEN  8U
+
+static uint8_t ref[STORAGE_FTL_BLK_NBR][STORAGE_FTL_BLK_SIZ];
+static uint8_t old[TEST_MAX_LEN][STORAGE_FTL_BLK_SIZ];
+static const uint8_t zero[STORAGE_FTL_BLK_SIZ];
+static uint8_t buf[TEST_MAX_LEN * STORAGE_FTL_BLK_SIZ];
+static uint32_t seed_next = 1U;
+
+/**
+ * @brief Drop the RAM state as a reset would and mount again.
+ */
+static void TEST_Reboot(void)
+{
+    FLASH_SIM_CutAfter(0U);
+    ftl_mounted = 0U;
+    ftl_gc_busy = 0U;
+    HOST_CHECK(STORAGE_FTL_Init(TEST_LUN) == 0);
+}
+
+static void TEST_Verify(void)
+{
+    uint32_t lba;
+
+    for (lba = 0U; lba < STORAGE_FTL_BLK_NBR; lba++) {
+        HOST_CHECK(STORAGE_FTL_Read(TEST_LUN, buf, lba, 1U) == 0);
+        HOST_CHECK(memcmp(buf, ref[lba], STORAGE_FTL_BLK_SIZ) == 0);
+    }
+}
+
+static void TEST_Pick(uint32_t *lba, uint32_t *len)
+{
+    *len = 1U + HOST_Rand() % TEST_MAX_LEN;
+
+    if ((HOST_Rand() % 10U) < 8U) {
+        *lba = HOST_Rand() % TEST_HOT_NBR;
+    } else {
+        *lba = HOST_Rand() % STORAGE_FTL_BLK_NBR;
+    }
+
+    *len = MIN(*len, STORAGE_FTL_BLK_NBR - *lba);
+}
+
+static int8_t TEST_Write(uint32_t lba, uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0U; i < len; i++) {
+        HOST_Fill(buf + i * STORAGE_FTL_BLK_SIZ, STORAGE_FTL_BLK_SIZ, seed_next++);
+    }
+
+    return STORAGE_FTL_Write(TEST_LUN, buf, lba, (uint16_t)len);
+}
+
+static void TEST_Report(const char *name, uint32_t host0, uint32_t flash0)
+{
+    uint32_t base = (STORAGE_FTL_ADDR - FLASH_SIM_BASE) / FLASH_PAGE_SIZE;
+    uint32_t pages = STORAGE_FTL_SIZE / FLASH_PAGE_SIZE;
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0U;
+    uint32_t sum = 0U;
+    uint32_t i;
+    uint32_t host  = ftl_stats.host_writes - host0;
+    uint32_t flash = ftl_stats.flash_writes - flash0;
+
+    for (i = base; i < base + pages; i++) {
+        min = MIN(min, flash_sim.page_erase[i]);
+        max = MAX(max, flash_sim.page_erase[i]);
+        sum += flash_sim.page_erase[i];
+    }
+
+    printf("%-8s host %u  flash %u  WA %.2f  page erases min %u avg %.1f max %u  gc %u  wl %u\n",
+           name, (unsigned)host, (unsigned)flash, (host != 0U) ? (double)flash / host : 0.0,
+           (unsigned)min, (double)sum / pages, (unsigned)max, (unsigned)ftl_stats.gc_runs,
+           (unsigned)ftl_stats.wl_moves);
+}
+
+/**
+ * @brief Hot/cold random writes and trims against the reference, with a
+ *        remount now and then.
+ */
+static void TEST_Random(void)
+{
+    uint32_t host0 = ftl_stats.host_writes;
+    uint32_t flash0 = ftl_stats.flash_writes;
+    uint32_t lba;
+    uint32_t len;
+    uint32_t n;
+
+    // 先写满, 冷数据也占着空间
+    for (lba = 0U; lba < STORAGE_FTL_BLK_NBR; lba += len) {
+        len = MIN(TEST_MAX_LEN, STORAGE_FTL_BLK_NBR - lba);
+        HOST_CHECK(TEST_Write(lba, len) == 0);
+        memcpy(ref[lba], buf, len * STORAGE_FTL_BLK_SIZ);
+    }
+
+    for (n = 0U; n < TEST_ROUNDS; n++) {
+        TEST_Pick(&lba, &len);
+
+        if ((HOST_Rand() % 32U) == 0U) {
+            HOST_CHECK(STORAGE_FTL_Unmap(TEST_LUN, lba, len) == 0);
+            memset(ref[lba], 0, len * STORAGE_FTL_BLK_SIZ);
+        } else {
+            HOST_CHECK(TEST_Write(lba, len) == 0);
+            memcpy(ref[lba], buf, len * STORAGE_FTL_BLK_SIZ);
+        }
+
+        if ((n % 5000U) == 4999U) {
+            TEST_Reboot();
+        }
+    }
+
+    TEST_Verify();
+    TEST_Report("random", host0, flash0);
+}
+
+/**
+ * @brief A trimmed range stays zero after a remount, and after the garbage
+ *        collector has erased the segment that held the trim tag.
+ */
+static void TEST_Trim(void)
+{
+    uint32_t first = STORAGE_FTL_BLK_NBR / 2U;
+    uint32_t len   = 24U;
+    uint32_t erase0;
+    uint32_t gc0;
+    uint32_t lba;
+    uint32_t seg;
+    uint32_t n;
+
+    for (lba = first; lba < first + len; lba += TEST_MAX_LEN) {
+        HOST_CHECK(TEST_Write(lba, TEST_MAX_LEN) == 0);
+        memcpy(ref[lba], buf, TEST_MAX_LEN * STORAGE_FTL_BLK_SIZ);
+    }
+
+    // 没有映射的区间不写标签
+    n = flash_sim.programs;
+    HOST_CHECK(STORAGE_FTL_Unmap(TEST_LUN, first, 0U) == 0);
+    HOST_CHECK(flash_sim.programs == n);
+
+    HOST_CHECK(STORAGE_FTL_Unmap(TEST_LUN, first, len) == 0);
+    HOST_CHECK(flash_sim.programs > n);
+    memset(ref[first], 0, len * STORAGE_FTL_BLK_SIZ);
+    seg    = ftl_active;
+    erase0 = ftl_erase[seg];
+
+    n = flash_sim.programs;
+    HOST_CHECK(STORAGE_FTL_Unmap(TEST_LUN, first, len) == 0);
+    HOST_CHECK(flash_sim.programs == n);
+    HOST_CHECK(STORAGE_FTL_Unmap(TEST_LUN, STORAGE_FTL_BLK_NBR - 1U, 2U) != 0);
+
+    TEST_Reboot();
+    TEST_Verify();
+
+    // 写别处直到标签所在的段被回收
+    gc0 = ftl_stats.gc_runs;
+    for (n = 0U; (n < 20000U) && ((ftl_stats.gc_runs - gc0) < 4U * STORAGE_FTL_SEG_NBR); n++) {
+        lba = HOST_Rand() % first;
+        HOST_CHECK(TEST_Write(lba, 1U) == 0);
+        memcpy(ref[lba], buf, STORAGE_FTL_BLK_SIZ);
+    }
+    HOST_CHECK(ftl_erase[seg] > erase0);
+
+    TEST_Reboot();
+    TEST_Verify();
+    printf("trim     %u sectors still zero after %u gc runs and remount\n", (unsigned)len,
+           (unsigned)(ftl_stats.gc_runs - gc0));
+}
+
+static void TEST_Settle(void)
+{
+    uint32_t lba;
+    uint32_t n;
+
+    for (n = 0U; n < TEST_SETTLE; n++) {
+        lba = HOST_Rand() % STORAGE_FTL_BLK_NBR;
+        HOST_CHECK(TEST_Write(lba, 1U) == 0);
+        memcpy(ref[lba], buf, STORAGE_FTL_BLK_SIZ);
+    }
+}
+
+/**
+ * @brief Cut the power at a random program or erase. After the remount the
+ *        sectors of the interrupted request hold the old or the new data,
+ *        every other sector is untouched.
+ */
+static void TEST_PowerCut(void)
+{
+    // longjmp 之后还要用
+    static volatile uint32_t lba;
+    static volatile uint32_t len;
+    static volatile uint8_t trim;
+    uint32_t pick_lba;
+    uint32_t pick_len;
+    uint32_t cuts = 0U;
+    uint32_t n;
+    uint32_t i;
+    int8_t ret;
+
+    for (n = 0U; n < TEST_CUTS; n++) {
+        FLASH_SIM_CutAfter(1U + HOST_Rand() % 600U);
+
+        if (setjmp(flash_sim_cut) != 0) {
+            cuts++;
+            TEST_Reboot();
+
+            for (i = 0U; i < len; i++) {
+                HOST_CHECK(STORAGE_FTL_Read(TEST_LUN, buf, lba + i, 1U) == 0);
+
+                if (trim != 0U) {
+                    HOST_CHECK((memcmp(buf, old[i], STORAGE_FTL_BLK_SIZ) == 0) ||
+                               (memcmp(buf, zero, STORAGE_FTL_BLK_SIZ) == 0));
+                } else {
+                    HOST_CHECK((memcmp(buf, old[i], STORAGE_FTL_BLK_SIZ) == 0) ||
+                               (memcmp(buf, ref[lba + i], STORAGE_FTL_BLK_SIZ) == 0));
+                }
+                memcpy(ref[lba + i], buf, STORAGE_FTL_BLK_SIZ);
+            }
+
+            TEST_Verify();
+            TEST_Settle();
+            continue;
+        }
+
+        // 一直写到掉电
+        for (;;) {
+            TEST_Pick(&pick_lba, &pick_len);
+            lba  = pick_lba;
+            len  = pick_len;
+            trim = ((HOST_Rand() % 16U) == 0U) ? 1U : 0U;
+            memcpy(old, ref[lba], len * STORAGE_FTL_BLK_SIZ);
+
+            if (trim != 0U) {
+                memset(ref[lba], 0, len * STORAGE_FTL_BLK_SIZ);
+                ret = STORAGE_FTL_Unmap(TEST_LUN, lba, len);
+            } else {
+                for (i = 0U; i < len; i++) {
+                    HOST_Fill(buf + i * STORAGE_FTL_BLK_SIZ, STORAGE_FTL_BLK_SIZ, seed_next++);
+                }
+                memcpy(ref[lba], buf, len * STORAGE_FTL_BLK_SIZ);
+                ret = STORAGE_FTL_Write(TEST_LUN, buf, lba, (uint16_t)len);
+            }
+
+            // 失败时不再擦写, 等不到掉电
+            if (ret != 0) {
+                HOST_CHECK(ret == 0);
+                FLASH_SIM_CutAfter(0U);
+                return;
+            }
+        }
+    }
+
+    printf("cut      %u power losses, every sector old or new after remount\n", (unsigned)cuts);
+}
+
+int main(void)
+{
+    if (FLASH_SIM_Init() != 0) {
+        return 1;
+    }
+
+    TEST_Reboot();
+    TEST_Random();
+    TEST_Trim();
+    TEST_PowerCut();
+
+    HOST_CHECK(flash_sim.errors == 0U);
+
+    return HOST_Result("test_ftl");
+}
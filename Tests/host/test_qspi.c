@@ -0,0 +1,345 @@
+/**
+ * @file test_qspi.c
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Chip probe and 4KB read-modify-write of the QSPI backend on a NOR model.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ * 直接编译 usbd_storage_qspi.c, 用 NOR 模型实现 usbd_storage_qspi_ll.h:
+ * 编程只能把 1 变 0 且不能跨页, 擦除按 4KB, 都要先写使能, 忙的时候不接受命令,
+ * 擦除/编程/DMA 都要查询若干次才完成. 检查探测不阻塞, 随机读写和参考模型一致,
+ * 报告写放大和擦除次数.
+ */
+#include "host.h"
+#include "usbd_storage_qspi.c"
+
+#define NOR_JEDEC       0xEF4017U // W25Q64
+#define NOR_SIZE_LOG2   23U
+#define NOR_SIZE        (1UL << NOR_SIZE_LOG2)
+#define NOR_SECTOR_NBR  (NOR_SIZE / STORAGE_QSPI_SECTOR_SIZ)
+#define NOR_BUSY_PROG   2U
+#define NOR_BUSY_ERASE  20U
+#define NOR_BUSY_WRSR   5U
+#define NOR_BUSY_DMA    2U
+
+#define TEST_LUN        6U
+#define TEST_BLK_NBR    512U // 前 64 个扇区
+#define TEST_ROUNDS     20000U
+
+static uint8_t nor[NOR_SIZE];
+static uint8_t nor_sr2;
+static uint8_t nor_wel;
+static uint32_t nor_busy;
+static uint32_t nor_calls;
+static uint32_t nor_erase_cnt[NOR_SECTOR_NBR];
+static uint32_t nor_erases;
+static uint32_t nor_prog_bytes;
+static const STORAGE_QSPI_ChipTypeDef *nor_chip;
+
+static uint8_t *dma_dst;
+static uint32_t dma_addr;
+static uint32_t dma_len;
+static uint32_t dma_left;
+static uint8_t dma_active;
+
+int8_t QSPI_LL_Init(void)
+{
+    nor_calls++;
+    return 0;
+}
+
+void QSPI_LL_SetChip(const STORAGE_QSPI_ChipTypeDef *chip)
+{
+    nor_calls++;
+    nor_chip = chip;
+}
+
+void QSPI_LL_ReadReg(uint8_t cmd, uint8_t *dst, uint32_t len)
+{
+    uint8_t id[3] = {(uint8_t)(NOR_JEDEC >> 16), (uint8_t)(NOR_JEDEC >> 8), (uint8_t)NOR_JEDEC};
+
+    nor_calls++;
+    if (cmd == QSPI_CMD_RDID) {
+        memcpy(dst, id, MIN(len, 3U));
+    } else if (cmd == QSPI_CMD_RDSR1) {
+        dst[0] = (uint8_t)((nor_busy != 0U) ? 0x01U : 0x00U) | (uint8_t)(nor_wel << 1);
+    } else if (cmd == QSPI_CMD_RDSR2) {
+        dst[0] = nor_sr2;
+    } else {
+        HOST_CHECK(0);
+    }
+}
+
+void QSPI_LL_WriteReg(uint8_t cmd, const uint8_t *src, uint32_t len)
+{
+    nor_calls++;
+    HOST_CHECK(nor_busy == 0U);
+    if (cmd == QSPI_CMD_WREN) {
+        nor_wel = 1U;
+    } else if (cmd == QSPI_CMD_WRSR2) {
+        HOST_CHECK((nor_wel != 0U) && (len == 1U));
+        nor_sr2  = src[0];
+        nor_wel  = 0U;
+        nor_busy = NOR_BUSY_WRSR;
+    } else {
+        HOST_CHECK(0);
+    }
+}
+
+void QSPI_LL_Read(uint32_t addr, uint8_t *dst, uint32_t len)
+{
+    nor_calls++;
+    HOST_CHECK(nor_busy == 0U);
+    HOST_CHECK((nor_sr2 & 0x02U) != 0U); // 四线读要先设 QE
+    HOST_CHECK(addr + len <= NOR_SIZE);
+    memcpy(dst, &nor[addr], len);
+}
+
+void QSPI_LL_Program(uint32_t addr, const uint8_t *src, uint32_t len)
+{
+    uint32_t i;
+
+    nor_calls++;
+    HOST_CHECK(nor_busy == 0U);
+    HOST_CHECK((addr % STORAGE_QSPI_PAGE_SIZ) + len <= STORAGE_QSPI_PAGE_SIZ);
+    HOST_CHECK(addr + len <= NOR_SIZE);
+    for (i = 0U; i < len; i++) {
+        nor[addr + i] &= src[i];
+    }
+    nor_wel  = 0U;
+    nor_busy = NOR_BUSY_PROG;
+    nor_prog_bytes += len;
+}
+
+void QSPI_LL_Erase(uint32_t addr)
+{
+    nor_calls++;
+    HOST_CHECK(nor_busy == 0U);
+    HOST_CHECK((addr % STORAGE_QSPI_SECTOR_SIZ) == 0U);
+    memset(&nor[addr], 0xFF, STORAGE_QSPI_SECTOR_SIZ);
+    nor_erase_cnt[addr / STORAGE_QSPI_SECTOR_SIZ]++;
+    nor_erases++;
+    nor_wel  = 0U;
+    nor_busy = NOR_BUSY_ERASE;
+}
+
+void QSPI_LL_StartWaitReady(void)
+{
+    nor_calls++;
+}
+
+uint8_t QSPI_LL_IsReady(void)
+{
+    nor_calls++;
+    if (nor_busy != 0U) {
+        nor_busy--;
+        return 0U;
+    }
+    return 1U;
+}
+
+int8_t QSPI_LL_StartDmaRead(uint32_t addr, uint8_t *dst, uint32_t len)
+{
+    nor_calls++;
+    HOST_CHECK(nor_busy == 0U);
+    HOST_CHECK(dma_active == 0U);
+    HOST_CHECK(addr + len <= NOR_SIZE);
+    dma_dst    = dst;
+    dma_addr   = addr;
+    dma_len    = len;
+    dma_left   = NOR_BUSY_DMA;
+    dma_active = 1U;
+    return 0;
+}
+
+uint8_t QSPI_LL_DmaDone(void)
+{
+    nor_calls++;
+    HOST_CHECK(dma_active != 0U);
+    if (dma_left != 0U) {
+        dma_left--;
+        return 0U;
+    }
+    memcpy(dma_dst, &nor[dma_addr], dma_len);
+    return 1U;
+}
+
+void QSPI_LL_StopDma(void)
+{
+    nor_calls++;
+    dma_active = 0U;
+}
+
+void QSPI_LL_Abort(void)
+{
+    nor_calls++;
+    HOST_CHECK(0);
+}
+
+static int8_t Qspi_Wait(int8_t ret)
+{
+    while (ret > 0) {
+        ret = USBD_Storage_QSPI_fops.Poll(TEST_LUN);
+    }
+    return ret;
+}
+
+static void Qspi_Probe(void)
+{
+    static const STORAGE_QSPI_ChipTypeDef other[] = {
+        {0xC22018U, "MX25L128", 24U, 0x6BU, 8U, 0x02U, 0U, STORAGE_QSPI_QE_SR1_BIT6},
+    };
+    uint32_t block_num;
+    uint16_t block_size;
+    uint32_t calls;
+    uint32_t n;
+
+    // Init 在 USB 中断里, 不能碰芯片
+    STORAGE_QSPI_SetChipTable(other, 1U);
+    HOST_CHECK(USBD_Storage_QSPI_fops.Init(TEST_LUN) == 0);
+    HOST_CHECK(nor_calls == 0U);
+    HOST_CHECK(USBD_Storage_QSPI_fops.IsReady(TEST_LUN) != 0);
+
+    // 表里没有这颗芯片: 一直 NOT READY, 重新枚举时再试
+    STORAGE_QSPI_Process();
+    HOST_CHECK(qspi_probe == QSPI_PROBE_FAILED);
+    HOST_CHECK(USBD_Storage_QSPI_fops.IsReady(TEST_LUN) != 0);
+    HOST_CHECK(USBD_Storage_QSPI_fops.Read(TEST_LUN, nor, 0U, 1U) < 0);
+
+    STORAGE_QSPI_SetChipTable(qspi_default_chips, sizeof(qspi_default_chips) / sizeof(qspi_default_chips[0]));
+    HOST_CHECK(USBD_Storage_QSPI_fops.Init(TEST_LUN) == 0);
+
+    // 写 QE 位要等芯片, 每次 Process 只查询一次
+    for (n = 0U; (n < 100U) && (qspi_probe != QSPI_PROBE_DONE); n++) {
+        HOST_CHECK(USBD_Storage_QSPI_fops.IsReady(TEST_LUN) != 0);
+        STORAGE_QSPI_Process();
+    }
+    HOST_CHECK(n > NOR_BUSY_WRSR);
+    calls = n;
+    HOST_CHECK(USBD_Storage_QSPI_fops.IsReady(TEST_LUN) == 0);
+    HOST_CHECK((nor_sr2 & 0x02U) != 0U);
+    HOST_CHECK((nor_chip != NULL) && (nor_chip->jedec_id == NOR_JEDEC));
+
+    USBD_Storage_QSPI_fops.GetCapacity(TEST_LUN, &block_num, &block_size);
+    HOST_CHECK((block_num == NOR_SIZE / STORAGE_QSPI_BLK_SIZ) && (block_size == STORAGE_QSPI_BLK_SIZ));
+
+    // 已探测过, 重新枚举不再访问芯片
+    n = nor_calls;
+    HOST_CHECK(USBD_Storage_QSPI_fops.Init(TEST_LUN) == 0);
+    STORAGE_QSPI_Process();
+    HOST_CHECK(nor_calls == n);
+
+    printf("probe    %s after %u main loop calls\n", qspi_chip->name, (unsigned)calls);
+}
+
+// 一个扇区的三种提交: 内容不变, 只清零位, 需要擦除
+static void Qspi_Commit(void)
+{
+    static uint8_t blk[STORAGE_QSPI_BLK_SIZ];
+    static uint8_t out[STORAGE_QSPI_BLK_SIZ];
+    uint32_t sec_blk = (STORAGE_QSPI_SECTOR_SIZ / STORAGE_QSPI_BLK_SIZ) * 100U;
+    uint32_t erases;
+    uint32_t pages;
+
+    erases = qspi_stats.erases;
+    memset(blk, 0x5A, sizeof(blk));
+    HOST_CHECK(Qspi_Wait(USBD_Storage_QSPI_fops.Write(TEST_LUN, blk, sec_blk + 1U, 1U)) == 0);
+    HOST_CHECK(Qspi_Wait(USBD_Storage_QSPI_fops.Flush(TEST_LUN)) == 0);
+    HOST_CHECK(qspi_stats.erases == erases);
+    HOST_CHECK(memcmp(&nor[(sec_blk + 1U) * STORAGE_QSPI_BLK_SIZ], blk, sizeof(blk)) == 0);
+
+    pages = qspi_stats.pages;
+    HOST_CHECK(Qspi_Wait(USBD_Storage_QSPI_fops.Write(TEST_LUN, blk, sec_blk + 1U, 1U)) == 0);
+    HOST_CHECK(Qspi_Wait(USBD_Storage_QSPI_fops.Flush(TEST_LUN)) == 0);
+    HOST_CHECK((qspi_stats.pages == pages) && (qspi_stats.erases == erases));
+
+    memset(blk, 0x50, sizeof(blk));
+    HOST_CHECK(Qspi_Wait(USBD_Storage_QSPI_fops.Write(TEST_LUN, blk, sec_blk + 1U, 1U)) == 0);
+    HOST_CHECK(Qspi_Wait(USBD_Storage_QSPI_fops.Flush(TEST_LUN)) == 0);
+    HOST_CHECK(qspi_stats.erases == erases);
+    HOST_CHECK(qspi_stats.pages == pages + 2U);
+
+    // 0x50 -> 0xA5 要把 0 变回 1, 同扇区其他块必须保留
+    memset(blk, 0xA5, sizeof(blk));
+    HOST_CHECK(Qspi_Wait(USBD_Storage_QSPI_fops.Write(TEST_LUN, blk, sec_blk + 2U, 1U)) == 0);
+    HOST_CHECK(Qspi_Wait(USBD_Storage_QSPI_fops.Write(TEST_LUN, blk, sec_blk + 1U, 1U)) == 0);
+    HOST_CHECK(Qspi_Wait(USBD_Storage_QSPI_fops.Flush(TEST_LUN)) == 0);
+    HOST_CHECK(qspi_stats.erases == erases + 1U);
+    HOST_CHECK(Qspi_Wait(USBD_Storage_QSPI_fops.Read(TEST_LUN, out, sec_blk + 1U, 1U)) == 0);
+    HOST_CHECK(memcmp(out, blk, sizeof(blk)) == 0);
+    HOST_CHECK(nor[sec_blk * STORAGE_QSPI_BLK_SIZ] == 0xFFU);
+}
+
+static void Qspi_Random(void)
+{
+    static uint8_t ref[TEST_BLK_NBR * STORAGE_QSPI_BLK_SIZ];
+    static uint8_t buf[8U * STORAGE_QSPI_BLK_SIZ];
+    STORAGE_QSPI_StatsTypeDef start = qspi_stats;
+    uint32_t erases = nor_erases;
+    uint32_t prog = nor_prog_bytes;
+    uint32_t wear_max = 0U;
+    uint32_t r;
+    uint32_t i;
+    uint32_t op;
+    uint32_t addr;
+    uint16_t len;
+
+    memcpy(ref, nor, sizeof(ref));
+
+    for (r = 0U; r < TEST_ROUNDS; r++) {
+        op   = HOST_Rand() % 16U;
+        len  = (uint16_t)(1U + HOST_Rand() % 8U);
+        // 大多数写落在少数几个扇区里, 像文件系统元数据
+        addr = ((HOST_Rand() % 4U) == 0U) ? (HOST_Rand() % 24U) : (HOST_Rand() % (TEST_BLK_NBR - len + 1U));
+
+        if (op < 7U) {
+            HOST_CHECK(Qspi_Wait(USBD_Storage_QSPI_fops.Read(TEST_LUN, buf, addr, len)) == 0);
+            HOST_CHECK(memcmp(buf, &ref[addr * STORAGE_QSPI_BLK_SIZ], (size_t)len * STORAGE_QSPI_BLK_SIZ) == 0);
+        } else if (op < 15U) {
+            HOST_Fill(buf, (uint32_t)len * STORAGE_QSPI_BLK_SIZ, r);
+            // 一部分块只清零位
+            if ((r % 3U) == 0U) {
+                for (i = 0U; i < (uint32_t)len * STORAGE_QSPI_BLK_SIZ; i++) {
+                    buf[i] &= ref[addr * STORAGE_QSPI_BLK_SIZ + i];
+                }
+            }
+            HOST_CHECK(Qspi_Wait(USBD_Storage_QSPI_fops.Write(TEST_LUN, buf, addr, len)) == 0);
+            memcpy(&ref[addr * STORAGE_QSPI_BLK_SIZ], buf, (size_t)len * STORAGE_QSPI_BLK_SIZ);
+        } else {
+            HOST_CHECK(Qspi_Wait(USBD_Storage_QSPI_fops.Flush(TEST_LUN)) == 0);
+            HOST_CHECK(memcmp(nor, ref, sizeof(ref)) == 0);
+        }
+    }
+
+    HOST_CHECK(Qspi_Wait(USBD_Storage_QSPI_fops.Flush(TEST_LUN)) == 0);
+    HOST_CHECK(memcmp(nor, ref, sizeof(ref)) == 0);
+    HOST_CHECK(qspi_stats.errors == 0U);
+    HOST_CHECK(qspi_stats.erases - start.erases == nor_erases - erases);
+
+    for (i = 0U; i < NOR_SECTOR_NBR; i++) {
+        wear_max = MAX(wear_max, nor_erase_cnt[i]);
+    }
+
+    printf("random   host %u KB  programmed %u KB  WA %.2f  commits %u  erases %u  "
+           "pages %u skipped %u  max erases/sector %u\n",
+           (unsigned)((qspi_stats.wr_bytes - start.wr_bytes) / 1024U),
+           (unsigned)((nor_prog_bytes - prog) / 1024U),
+           (double)(nor_prog_bytes - prog) / (double)(qspi_stats.wr_bytes - start.wr_bytes),
+           (unsigned)(qspi_stats.commits - start.commits), (unsigned)(nor_erases - erases),
+           (unsigned)(qspi_stats.pages - start.pages), (unsigned)(qspi_stats.pages_skipped - start.pages_skipped),
+           (unsigned)wear_max);
+}
+
+int main(void)
+{
+    memset(nor, 0xFF, sizeof(nor));
+
+    Qspi_Probe();
+    Qspi_Commit();
+    Qspi_Random();
+
+    return HOST_Result("test_qspi");
+}
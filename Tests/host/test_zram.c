@@ -0,0 +1,186 @@
+/**
+ * @file test_zram.c
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Round trip, compression ratio and codec speed of the ZRAM backend.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ * 直接编译 usbd_storage_zram.c, 通过 fops 写满整个盘再读回比较,
+ * 按数据类型报告压缩比 (扇区 * 512 / 压缩后字节) 和编解码吞吐.
+ */
+#include "host.h"
+#include "usbd_storage_zram.c"
+
+#define ZRAM_TEST_ROUNDS 20U
+
+typedef void (*ZRAM_GenTypeDef)(uint8_t *buf, uint32_t blk);
+
+static void Gen_Zero(uint8_t *buf, uint32_t blk)
+{
+    (void)blk;
+    memset(buf, 0, STORAGE_ZRAM_BLK_SIZ);
+}
+
+// 类似 LOG.TXT 的文本行
+static void Gen_Log(uint8_t *buf, uint32_t blk)
+{
+    uint32_t n = 0U;
+    uint32_t line = blk * 16U;
+    char tmp[64];
+    int len;
+
+    while (n < STORAGE_ZRAM_BLK_SIZ) {
+        len = snprintf(tmp, sizeof(tmp), "[%08u] msc: lun %u read %u blk ok\r\n",
+                       (unsigned)(line * 37U), (unsigned)(line % 8U), (unsigned)(line % 64U));
+        if ((uint32_t)len > (STORAGE_ZRAM_BLK_SIZ - n)) {
+            len = (int)(STORAGE_ZRAM_BLK_SIZ - n);
+        }
+        memcpy(&buf[n], tmp, (size_t)len);
+        n += (uint32_t)len;
+        line++;
+    }
+}
+
+// 结构体数组, 大部分字段相同
+static void Gen_Table(uint8_t *buf, uint32_t blk)
+{
+    uint32_t i;
+
+    for (i = 0U; i < STORAGE_ZRAM_BLK_SIZ; i += 16U) {
+        memset(&buf[i], 0, 16U);
+        buf[i]      = (uint8_t)(blk + i / 16U);
+        buf[i + 4U] = 0x55U;
+        buf[i + 8U] = 0xAAU;
+    }
+}
+
+static void Gen_Random(uint8_t *buf, uint32_t blk)
+{
+    HOST_Fill(buf, STORAGE_ZRAM_BLK_SIZ, blk * 7919U + 1U);
+}
+
+// 一半文本一半随机
+static void Gen_Mixed(uint8_t *buf, uint32_t blk)
+{
+    uint8_t tmp[STORAGE_ZRAM_BLK_SIZ];
+
+    Gen_Log(buf, blk);
+    Gen_Random(tmp, blk);
+    memcpy(&buf[STORAGE_ZRAM_BLK_SIZ / 2U], tmp, STORAGE_ZRAM_BLK_SIZ / 2U);
+}
+
+static void Zram_Reset(void)
+{
+    (void)STORAGE_ZRAM_Unmap(0U, 0U, STORAGE_ZRAM_BLK_NBR);
+    memset(&zram_stats, 0, sizeof(zram_stats));
+}
+
+static void Zram_Case(const char *name, ZRAM_GenTypeDef gen)
+{
+    static uint8_t in[STORAGE_ZRAM_BLK_SIZ];
+    static uint8_t out[STORAGE_ZRAM_BLK_SIZ];
+    uint32_t blk_nbr = 0U;
+    uint32_t blk;
+    uint32_t r;
+    double t_wr;
+    double t_rd;
+    double t0;
+
+    Zram_Reset();
+
+    // 写到池满为止, 记录实际放下的扇区数
+    t0 = HOST_Seconds();
+    for (blk = 0U; blk < STORAGE_ZRAM_BLK_NBR; blk++) {
+        gen(in, blk);
+        if (STORAGE_ZRAM_Write(0U, in, blk, 1U) != 0) {
+            break;
+        }
+        blk_nbr++;
+    }
+    for (r = 1U; r < ZRAM_TEST_ROUNDS; r++) {
+        for (blk = 0U; blk < blk_nbr; blk++) {
+            gen(in, blk);
+            HOST_CHECK(STORAGE_ZRAM_Write(0U, in, blk, 1U) == 0);
+        }
+    }
+    t_wr = HOST_Seconds() - t0;
+
+    t0 = HOST_Seconds();
+    for (r = 0U; r < ZRAM_TEST_ROUNDS; r++) {
+        for (blk = 0U; blk < blk_nbr; blk++) {
+            HOST_CHECK(STORAGE_ZRAM_Read(0U, out, blk, 1U) == 0);
+        }
+    }
+    t_rd = HOST_Seconds() - t0;
+
+    for (blk = 0U; blk < blk_nbr; blk++) {
+        gen(in, blk);
+        HOST_CHECK(STORAGE_ZRAM_Read(0U, out, blk, 1U) == 0);
+        HOST_CHECK(memcmp(in, out, STORAGE_ZRAM_BLK_SIZ) == 0);
+    }
+
+    printf("%-8s blocks %3u/%u  ratio %6.2f  raw %3u  chunks %3u/%u  "
+           "write %7.1f MB/s  read %7.1f MB/s\n",
+           name, (unsigned)blk_nbr, (unsigned)STORAGE_ZRAM_BLK_NBR,
+           (zram_stats.packed_bytes != 0U) ?
+               (double)zram_stats.sectors * STORAGE_ZRAM_BLK_SIZ / zram_stats.packed_bytes : 0.0,
+           (unsigned)zram_stats.raw_sectors, (unsigned)zram_stats.chunks_used,
+           (unsigned)STORAGE_ZRAM_CHUNK_NBR,
+           (t_wr > 0.0) ? (double)blk_nbr * ZRAM_TEST_ROUNDS * STORAGE_ZRAM_BLK_SIZ / t_wr / 1e6 : 0.0,
+           (t_rd > 0.0) ? (double)blk_nbr * ZRAM_TEST_ROUNDS * STORAGE_ZRAM_BLK_SIZ / t_rd / 1e6 : 0.0);
+}
+
+// 解码器必须拒绝截断和越界的数据, 不能写出 512 字节之外
+static void Zram_Corrupt(void)
+{
+    static uint8_t in[STORAGE_ZRAM_BLK_SIZ];
+    static uint8_t enc[STORAGE_ZRAM_BLK_SIZ];
+    static uint8_t out[STORAGE_ZRAM_BLK_SIZ + 16U];
+    uint32_t len;
+    uint32_t cut;
+    uint32_t i;
+
+    Gen_Log(in, 3U);
+    len = ZRAM_Encode(in, enc, STORAGE_ZRAM_BLK_SIZ);
+    HOST_CHECK(len != 0U);
+    HOST_CHECK(ZRAM_Decode(enc, len, out) == 0);
+    HOST_CHECK(memcmp(in, out, STORAGE_ZRAM_BLK_SIZ) == 0);
+
+    for (cut = 0U; cut < len; cut++) {
+        HOST_CHECK(ZRAM_Decode(enc, cut, out) != 0);
+    }
+
+    memset(&out[STORAGE_ZRAM_BLK_SIZ], 0xA5, 16U);
+    for (i = 0U; i < 2000U; i++) {
+        HOST_Fill(enc, len, i);
+        (void)ZRAM_Decode(enc, len, out);
+    }
+    for (i = 0U; i < 16U; i++) {
+        HOST_CHECK(out[STORAGE_ZRAM_BLK_SIZ + i] == 0xA5U);
+    }
+
+    // 压不下去的数据在 cap 内报告 0
+    Gen_Random(in, 1U);
+    HOST_CHECK(ZRAM_Encode(in, enc, STORAGE_ZRAM_BLK_SIZ - STORAGE_ZRAM_CHUNK_SIZ) == 0U);
+}
+
+int main(void)
+{
+    HOST_CHECK(STORAGE_ZRAM_Init(0U) == 0);
+
+    Zram_Case("zero", Gen_Zero);
+    Zram_Case("log", Gen_Log);
+    Zram_Case("table", Gen_Table);
+    Zram_Case("mixed", Gen_Mixed);
+    Zram_Case("random", Gen_Random);
+    Zram_Corrupt();
+
+    // 全部释放后池应完整归还
+    Zram_Reset();
+    HOST_CHECK(zram_free_nbr == STORAGE_ZRAM_CHUNK_NBR);
+
+    return HOST_Result("test_zram");
+}
@@ -49,6 +49,36 @@
   */
 
 /* USER CODE BEGIN PRIVATE_TYPES */
+/* State of one port. UserTxBufferFS[port] is a single producer / single
+   consumer ring: the producer (CDC_TransmitPort_FS, thread mode) only moves
+   TxHead, the consumer (the IN transfer chain, USB interrupt) only moves
+   TxTail. Both run free and are masked with CDC_TX_MASK on access.
+   UserRxBufferFS[port] is the receive ring: the OUT interrupt moves RxHead,
+   CDC_Read_FS moves RxTail. The endpoint is armed only while the ring has
+   room for a full packet, otherwise the host is NAKed. */
+typedef struct
+{
+  /* Coalescing: below TxBatch queued bytes the owner holds the data back,
+     until TxTimeout frames pass without a transfer. The SOF then moves
+     TxFlushTo to the head and everything before it goes out. */
+  uint32_t TxBatch;
+  uint8_t TxTimeout;
+  uint8_t TxAge;
+  __IO uint32_t TxFlushTo;
+
+  __IO uint32_t TxHead;
+  __IO uint32_t TxTail;
+  uint32_t TxSpan;                 /* bytes of the transfer in flight */
+  __IO uint8_t TxActive;           /* owner of the IN endpoint holds 1 */
+
+  __IO uint32_t RxHead;
+  __IO uint32_t RxTail;
+  __IO uint8_t RxArmed;
+  /* A packet lands here when the ring has not 64 contiguous bytes before the end */
+  uint8_t RxSpill[CDC_DATA_FS_MAX_PACKET_SIZE];
+
+  CDC_StatsTypeDef Stats;
+} CDC_PortTypeDef;
 
 /* USER CODE END PRIVATE_TYPES */
 
@@ -62,6 +92,18 @@
   */
 
 /* USER CODE BEGIN PRIVATE_DEFINES */
+#if (APP_TX_DATA_SIZE & (APP_TX_DATA_SIZE - 1)) != 0
+#error "APP_TX_DATA_SIZE must be a power of two"
+#endif
+
+#if (APP_RX_DATA_SIZE & (APP_RX_DATA_SIZE - 1)) != 0
+#error "APP_RX_DATA_SIZE must be a power of two"
+#endif
+
+#define CDC_TX_MASK                      (APP_TX_DATA_SIZE - 1U)
+#define CDC_RX_MASK                      (APP_RX_DATA_SIZE - 1U)
+
+#define CDC_PORT_INIT                    { CDC_TX_BATCH_SIZE, CDC_TX_TIMEOUT_SOF }
 /* USER CODE END PRIVATE_DEFINES */
 
 /**
@@ -88,12 +130,22 @@
 /* Create buffer for reception and transmission           */
 /* It's up to user to redefine and/or remove those define */
 /** Received data over USB are stored in this buffer      */
-uint8_t UserRxBufferFS[APP_RX_DATA_SIZE];
+uint8_t UserRxBufferFS[USBD_CDC_PORT_NBR][APP_RX_DATA_SIZE];
 
 /** Data to send over USB CDC are stored in this buffer   */
-uint8_t UserTxBufferFS[APP_TX_DATA_SIZE];
+uint8_t UserTxBufferFS[USBD_CDC_PORT_NBR][APP_TX_DATA_SIZE];
 
 /* USER CODE BEGIN PRIVATE_VARIABLES */
+static CDC_PortTypeDef CDC_Ports[USBD_CDC_PORT_NBR] =
+{
+  CDC_PORT_INIT,
+#if (USBD_CDC_PORT_NBR > 1U)
+  CDC_PORT_INIT,
+#endif
+#if (USBD_CDC_PORT_NBR > 2U)
+  CDC_PORT_INIT,
+#endif
+};
 
 /* USER CODE END PRIVATE_VARIABLES */
 
@@ -121,13 +173,17 @@ extern USBD_HandleTypeDef hUsbDeviceFS;
   * @{
   */
 
-static int8_t CDC_Init_FS(void);
-static int8_t CDC_DeInit_FS(void);
-static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length);
-static int8_t CDC_Receive_FS(uint8_t* pbuf, uint32_t *Len);
-static int8_t CDC_TransmitCplt_FS(uint8_t *pbuf, uint32_t *Len, uint8_t epnum);
+static int8_t CDC_Init_FS(uint8_t port);
+static int8_t CDC_DeInit_FS(uint8_t port);
+static int8_t CDC_Control_FS(uint8_t port, uint8_t cmd, uint8_t* pbuf, uint16_t length);
+static int8_t CDC_Receive_FS(uint8_t port, uint8_t* pbuf, uint32_t *Len);
+static int8_t CDC_TransmitCplt_FS(uint8_t port, uint8_t *pbuf, uint32_t *Len, uint8_t epnum);
+static int8_t CDC_SOF_FS(uint8_t port);
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
+static uint8_t CDC_TxClaim(CDC_PortTypeDef *p);
+static void CDC_TxStart(uint8_t port);
+static uint8_t CDC_RxArm(uint8_t port);
 
 /* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
 
@@ -141,45 +197,73 @@ USBD_CDC_ItfTypeDef USBD_Interface_fops_FS =
   CDC_DeInit_FS,
   CDC_Control_FS,
   CDC_Receive_FS,
-  CDC_TransmitCplt_FS
+  CDC_TransmitCplt_FS,
+  CDC_SOF_FS
 };
 
 /* Private functions ---------------------------------------------------------*/
 /**
   * @brief  Initializes the CDC media low layer over the FS USB IP
+  * @param  port: CDC port
   * @retval USBD_OK if all operations are OK else USBD_FAIL
   */
-static int8_t CDC_Init_FS(void)
+static int8_t CDC_Init_FS(uint8_t port)
 {
   /* USER CODE BEGIN 3 */
+  CDC_PortTypeDef *p = &CDC_Ports[port];
+  uint32_t pos = p->RxHead & CDC_RX_MASK;
+
   /* Set Application Buffers */
-  USBD_CDC_SetTxBuffer(&hUsbDeviceFS, UserTxBufferFS, 0);
-  USBD_CDC_SetRxBuffer(&hUsbDeviceFS, UserRxBufferFS);
+  USBD_CDC_SetTxBuffer(&hUsbDeviceFS, port, UserTxBufferFS[port], 0);
+
+  /* The class arms the OUT endpoint itself after this, whatever the room */
+  if ((APP_RX_DATA_SIZE - pos) >= CDC_DATA_FS_MAX_PACKET_SIZE)
+  {
+    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, port, &UserRxBufferFS[port][pos]);
+  }
+  else
+  {
+    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, port, p->RxSpill);
+  }
+  p->RxArmed = 1U;
+
+  /* Send what was queued before the host configured the device */
+  if (CDC_TxClaim(p) != 0U)
+  {
+    CDC_TxStart(port);
+  }
   return (USBD_OK);
   /* USER CODE END 3 */
 }
 
 /**
   * @brief  DeInitializes the CDC media low layer
+  * @param  port: CDC port
   * @retval USBD_OK if all operations are OK else USBD_FAIL
   */
-static int8_t CDC_DeInit_FS(void)
+static int8_t CDC_DeInit_FS(uint8_t port)
 {
   /* USER CODE BEGIN 4 */
+  /* A transfer cut by the reset never completes: its span stays queued and
+     is sent again after the next configuration */
+  CDC_Ports[port].TxSpan = 0U;
+  CDC_Ports[port].TxActive = 0U;
   return (USBD_OK);
   /* USER CODE END 4 */
 }
 
 /**
   * @brief  Manage the CDC class requests
+  * @param  port: CDC port
   * @param  cmd: Command code
   * @param  pbuf: Buffer containing command data (request parameters)
   * @param  length: Number of data to be sent (in bytes)
   * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
   */
-static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length)
+static int8_t CDC_Control_FS(uint8_t port, uint8_t cmd, uint8_t* pbuf, uint16_t length)
 {
   /* USER CODE BEGIN 5 */
+  UNUSED(port);
   switch(cmd)
   {
     case CDC_SEND_ENCAPSULATED_COMMAND:
@@ -254,17 +338,47 @@ static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length)
   *         it will result in receiving more data while previous ones are still
   *         not sent.
   *
+  * @param  port: CDC port
   * @param  Buf: Buffer of data to be received
   * @param  Len: Number of data received (in bytes)
   * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
   */
-static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
+static int8_t CDC_Receive_FS(uint8_t port, uint8_t* Buf, uint32_t *Len)
 {
   /* USER CODE BEGIN 6 */
-  USBD_CDC_SetRxBuffer(&hUsbDeviceFS, &Buf[0]);
-  //echo 
-  CDC_Transmit_FS(Buf,*Len);
-  USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+  CDC_PortTypeDef *p = &CDC_Ports[port];
+  uint8_t *ring = UserRxBufferFS[port];
+  uint32_t head = p->RxHead;
+  uint32_t pos = head & CDC_RX_MASK;
+  uint32_t len = *Len;
+  uint32_t part;
+
+  p->Stats.rx_packets++;
+
+  /* Only after a re-configuration with a full ring */
+  if (len > (APP_RX_DATA_SIZE - (head - p->RxTail)))
+  {
+    p->Stats.rx_overruns += len;
+    len = 0U;
+  }
+
+  if ((Buf == p->RxSpill) && (len != 0U))
+  {
+    part = MIN(len, APP_RX_DATA_SIZE - pos);
+    (void)memcpy(&ring[pos], p->RxSpill, part);
+    (void)memcpy(ring, &p->RxSpill[part], len - part);
+  }
+
+  p->Stats.rx_bytes += len;
+
+  /* Publish the bytes before the new head */
+  __DMB();
+  p->RxHead = head + len;
+
+  if (CDC_RxArm(port) == 0U)
+  {
+    p->Stats.rx_throttled++;
+  }
   return (USBD_OK);
   /* USER CODE END 6 */
 }
@@ -274,22 +388,18 @@ static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
   *         Data to send over USB IN endpoint are sent over CDC interface
   *         through this function.
   *         @note
-  *
+  *         Sends on the first port, see CDC_TransmitPort_FS.
   *
   * @param  Buf: Buffer of data to be sent
   * @param  Len: Number of data to be sent (in bytes)
-  * @retval USBD_OK if all operations are OK else USBD_FAIL or USBD_BUSY
+  * @retval USBD_OK if all the data is queued, USBD_BUSY if the ring has not
+  *         room for all of it (nothing is queued), USBD_FAIL if it never will
   */
 uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
 {
   uint8_t result = USBD_OK;
   /* USER CODE BEGIN 7 */
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassDatas[USBD_CDC_CLASS_ID];
-  if (hcdc->TxState != 0){
-    return USBD_BUSY;
-  }
-  USBD_CDC_SetTxBuffer(&hUsbDeviceFS, Buf, Len);
-  result = USBD_CDC_TransmitPacket(&hUsbDeviceFS);
+  result = CDC_TransmitPort_FS(0U, Buf, Len);
   /* USER CODE END 7 */
   return result;
 }
@@ -301,23 +411,376 @@ uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
   *         @note
   *         This function is IN transfer complete callback used to inform user that
   *         the submitted Data is successfully sent over USB.
+  *         A transfer of whole packets is reported before its ZLP: starting
+  *         the next one here makes the ZLP unneeded. If none is started, the
+  *         end of the ZLP is reported again with *Len = 0.
   *
+  * @param  port: CDC port
   * @param  Buf: Buffer of data to be received
   * @param  Len: Number of data received (in bytes)
   * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
   */
-static int8_t CDC_TransmitCplt_FS(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
+static int8_t CDC_TransmitCplt_FS(uint8_t port, uint8_t *Buf, uint32_t *Len, uint8_t epnum)
 {
   uint8_t result = USBD_OK;
   /* USER CODE BEGIN 13 */
+  CDC_PortTypeDef *p = &CDC_Ports[port];
+
   UNUSED(Buf);
-  UNUSED(Len);
   UNUSED(epnum);
+
+  /* End of a ZLP: the endpoint was given up before it, take it again */
+  if (*Len == 0U)
+  {
+    p->Stats.tx_zlps++;
+    if (CDC_TxClaim(p) != 0U)
+    {
+      CDC_TxStart(port);
+    }
+    return result;
+  }
+
+  /* Still the owner of the endpoint: release the span and chain the next */
+  p->TxTail = p->TxTail + p->TxSpan;
+  p->TxSpan = 0U;
+  CDC_TxStart(port);
   /* USER CODE END 13 */
   return result;
 }
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
+/**
+  * @brief  CDC_SOF_FS
+  *         Start of frame: send the bytes held back for coalescing once they
+  *         waited TxTimeout frames with no transfer running.
+  * @param  port: CDC port
+  * @retval USBD_OK
+  */
+static int8_t CDC_SOF_FS(uint8_t port)
+{
+  CDC_PortTypeDef *p = &CDC_Ports[port];
+
+  if ((p->TxActive != 0U) || (p->TxHead == p->TxTail))
+  {
+    p->TxAge = 0U;
+    return (USBD_OK);
+  }
+
+  if (++p->TxAge < p->TxTimeout)
+  {
+    return (USBD_OK);
+  }
+
+  p->TxAge = 0U;
+  p->TxFlushTo = p->TxHead;
+
+  if (CDC_TxClaim(p) != 0U)
+  {
+    CDC_TxStart(port);
+  }
+  return (USBD_OK);
+}
+
+/**
+  * @brief  CDC_TransmitPort_FS
+  *         Data to send over the IN endpoint of a port.
+  *         @note
+  *         The data is copied into the transmit ring of the port and the
+  *         call returns at once; the IN transfers are chained from the
+  *         completion interrupt. Call it from thread mode only, it is the
+  *         single producer of the ring.
+  * @param  port: CDC port
+  * @param  Buf: Buffer of data to be sent
+  * @param  Len: Number of data to be sent (in bytes)
+  * @retval USBD_OK if all the data is queued, USBD_BUSY if the ring has not
+  *         room for all of it (nothing is queued), USBD_FAIL if it never will
+  */
+uint8_t CDC_TransmitPort_FS(uint8_t port, uint8_t* Buf, uint16_t Len)
+{
+  CDC_PortTypeDef *p;
+  uint8_t *ring;
+  uint32_t head;
+  uint32_t pos;
+  uint32_t part;
+
+  if ((port >= USBD_CDC_PORT_NBR) || (Len > APP_TX_DATA_SIZE))
+  {
+    return USBD_FAIL;
+  }
+
+  p = &CDC_Ports[port];
+  ring = UserTxBufferFS[port];
+  head = p->TxHead;
+  pos = head & CDC_TX_MASK;
+
+  if (Len > CDC_TxFree_FS(port))
+  {
+    p->Stats.tx_refused++;
+    return USBD_BUSY;
+  }
+
+  part = MIN((uint32_t)Len, APP_TX_DATA_SIZE - pos);
+  (void)memcpy(&ring[pos], Buf, part);
+  (void)memcpy(ring, &Buf[part], Len - part);
+
+  /* Publish the bytes before the new head */
+  __DMB();
+  p->TxHead = head + Len;
+  p->Stats.tx_bytes += Len;
+
+  if (CDC_TxClaim(p) != 0U)
+  {
+    CDC_TxStart(port);
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  CDC_SetCoalescing_FS
+  *         Set the transmit coalescing of a port: a span goes out once batch
+  *         bytes are queued, or after timeout_sof frames. batch 0 sends every
+  *         call at once.
+  * @param  port: CDC port
+  * @param  batch: Bytes that start a transfer
+  * @param  timeout_sof: Frames (ms) the last bytes wait at most
+  * @retval None
+  */
+void CDC_SetCoalescing_FS(uint8_t port, uint32_t batch, uint8_t timeout_sof)
+{
+  CDC_PortTypeDef *p;
+
+  if (port >= USBD_CDC_PORT_NBR)
+  {
+    return;
+  }
+
+  p = &CDC_Ports[port];
+  p->TxBatch = MIN(batch, (uint32_t)APP_TX_DATA_SIZE);
+  p->TxTimeout = MAX(timeout_sof, 1U);
+
+  /* A smaller batch may release what is queued now */
+  if (CDC_TxClaim(p) != 0U)
+  {
+    CDC_TxStart(port);
+  }
+}
+
+/**
+  * @brief  CDC_TxFree_FS
+  *         Room left in the transmit ring of a port
+  * @param  port: CDC port
+  * @retval Number of bytes CDC_TransmitPort_FS can take now
+  */
+uint32_t CDC_TxFree_FS(uint8_t port)
+{
+  if (port >= USBD_CDC_PORT_NBR)
+  {
+    return 0U;
+  }
+
+  return APP_TX_DATA_SIZE - (CDC_Ports[port].TxHead - CDC_Ports[port].TxTail);
+}
+
+/**
+  * @brief  CDC_RxAvailable_FS
+  *         Received bytes waiting in the ring of a port
+  * @param  port: CDC port
+  * @retval Number of bytes CDC_Read_FS can return now
+  */
+uint32_t CDC_RxAvailable_FS(uint8_t port)
+{
+  if (port >= USBD_CDC_PORT_NBR)
+  {
+    return 0U;
+  }
+
+  return CDC_Ports[port].RxHead - CDC_Ports[port].RxTail;
+}
+
+/**
+  * @brief  CDC_Read_FS
+  *         Take received data of a port without waiting. Freeing room for a
+  *         packet re-arms the OUT endpoint if the ring had throttled the host.
+  * @param  port: CDC port
+  * @param  Buf: Buffer to fill
+  * @param  Len: Size of Buf (in bytes)
+  * @retval Number of bytes copied, 0 if nothing was received
+  */
+uint16_t CDC_Read_FS(uint8_t port, uint8_t* Buf, uint16_t Len)
+{
+  CDC_PortTypeDef *p;
+  uint8_t *ring;
+  uint32_t tail;
+  uint32_t pos;
+  uint32_t n;
+  uint32_t part;
+
+  if (port >= USBD_CDC_PORT_NBR)
+  {
+    return 0U;
+  }
+
+  p = &CDC_Ports[port];
+  ring = UserRxBufferFS[port];
+  tail = p->RxTail;
+  pos = tail & CDC_RX_MASK;
+  n = MIN(p->RxHead - tail, (uint32_t)Len);
+
+  /* Read the head before the bytes it publishes */
+  __DMB();
+
+  part = MIN(n, APP_RX_DATA_SIZE - pos);
+  (void)memcpy(Buf, &ring[pos], part);
+  (void)memcpy(&Buf[part], ring, n - part);
+
+  __DMB();
+  p->RxTail = tail + n;
+
+  /* While unarmed no OUT interrupt comes, so arming here does not race */
+  if (p->RxArmed == 0U)
+  {
+    (void)CDC_RxArm(port);
+  }
+
+  return (uint16_t)n;
+}
+
+/**
+  * @brief  CDC_GetStats_FS
+  * @param  port: CDC port
+  * @retval Counters of the port, NULL if there is no such port
+  */
+CDC_StatsTypeDef *CDC_GetStats_FS(uint8_t port)
+{
+  if (port >= USBD_CDC_PORT_NBR)
+  {
+    return NULL;
+  }
+
+  return &CDC_Ports[port].Stats;
+}
+
+/**
+  * @brief  CDC_RxArm
+  *         Arm the OUT endpoint of a port at the ring head if a full packet fits.
+  * @param  port: CDC port
+  * @retval 1 if armed, 0 if the host is left NAKing
+  */
+static uint8_t CDC_RxArm(uint8_t port)
+{
+  CDC_PortTypeDef *p = &CDC_Ports[port];
+  uint32_t head = p->RxHead;
+  uint32_t pos = head & CDC_RX_MASK;
+
+  if ((APP_RX_DATA_SIZE - (head - p->RxTail)) < CDC_DATA_FS_MAX_PACKET_SIZE)
+  {
+    p->RxArmed = 0U;
+    return 0U;
+  }
+
+  p->RxArmed = 1U;
+
+  if ((APP_RX_DATA_SIZE - pos) >= CDC_DATA_FS_MAX_PACKET_SIZE)
+  {
+    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, port, &UserRxBufferFS[port][pos]);
+  }
+  else
+  {
+    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, port, p->RxSpill);
+  }
+  USBD_CDC_ReceivePacket(&hUsbDeviceFS, port);
+  return 1U;
+}
+
+/**
+  * @brief  CDC_TxClaim
+  *         Take the ownership of the IN endpoint of a port, without locking:
+  *         whoever moves TxActive from 0 to 1 starts the next transfer.
+  * @param  p: Port state
+  * @retval 1 if the caller is the owner now, 0 if a transfer is running
+  */
+static uint8_t CDC_TxClaim(CDC_PortTypeDef *p)
+{
+  do
+  {
+    if (__LDREXB(&p->TxActive) != 0U)
+    {
+      __CLREX();
+      return 0U;
+    }
+  } while (__STREXB(1U, &p->TxActive) != 0U);
+
+  __DMB();
+  return 1U;
+}
+
+/**
+  * @brief  CDC_TxStart
+  *         Called by the owner of the IN endpoint: send the contiguous span
+  *         at the tail of the ring, or give the endpoint up when it is empty.
+  * @param  port: CDC port
+  * @retval None
+  */
+static void CDC_TxStart(uint8_t port)
+{
+  CDC_PortTypeDef *p = &CDC_Ports[port];
+  uint32_t head;
+  uint32_t tail;
+  uint32_t flush;
+  uint32_t span;
+  uint8_t hold;
+
+  do
+  {
+    head = p->TxHead;
+    tail = p->TxTail;
+    flush = p->TxFlushTo;
+    span = head - tail;
+    hold = ((p->TxBatch != 0U) && ((int32_t)(flush - tail) <= 0)) ? 1U : 0U;
+
+    /* Coalescing: wait for a batch, the SOF timeout moves flush */
+    if ((hold != 0U) && (span < p->TxBatch))
+    {
+      span = 0U;
+    }
+
+    if (span != 0U)
+    {
+      span = MIN(span, APP_TX_DATA_SIZE - (tail & CDC_TX_MASK));
+      span = MIN(span, CDC_TX_MAX_XFER);
+
+      /* Whole packets only, the rest joins the next batch */
+      if ((hold != 0U) && (span > CDC_DATA_FS_MAX_PACKET_SIZE))
+      {
+        span -= span % CDC_DATA_FS_MAX_PACKET_SIZE;
+      }
+
+      p->TxSpan = span;
+      p->TxAge = 0U;
+
+      if ((USBD_CDC_SetTxBuffer(&hUsbDeviceFS, port, &UserTxBufferFS[port][tail & CDC_TX_MASK], span) == USBD_OK) &&
+          (USBD_CDC_TransmitPacket(&hUsbDeviceFS, port) == USBD_OK))
+      {
+        p->Stats.tx_xfers++;
+        return;
+      }
+
+      /* Not configured: the data waits for CDC_Init_FS. Or the class is
+         still sending the ZLP of the last transfer (TxState busy): its
+         completion comes back with *Len = 0 and CDC_TransmitCplt_FS starts
+         the data then. Either way giving the endpoint up is the recovery. */
+      p->TxSpan = 0U;
+      p->TxActive = 0U;
+      return;
+    }
+
+    p->TxActive = 0U;
+    __DMB();
+
+    /* A producer or the SOF may have changed the state after the check and
+       seen us active */
+  } while (((p->TxHead != head) || (p->TxFlushTo != flush)) && (CDC_TxClaim(p) != 0U));
+}
 
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
@@ -51,6 +51,16 @@
 #define APP_RX_DATA_SIZE  2048
 #define APP_TX_DATA_SIZE  2048
 /* USER CODE BEGIN EXPORTED_DEFINES */
+/* Each of the USBD_CDC_PORT_NBR ports (usbd_conf.h) has its own receive and
+   transmit ring of the sizes above */
+
+/* Transmit coalescing defaults, see CDC_SetCoalescing_FS */
+#define CDC_TX_BATCH_SIZE  256U
+#define CDC_TX_TIMEOUT_SOF 2U
+
+/* Bytes per USBD_CDC_TransmitPacket, the PCD splits them into 64-byte
+   packets. CDC_DATA_FS_MAX_PACKET_SIZE gives single-packet transfers. */
+#define CDC_TX_MAX_XFER    APP_TX_DATA_SIZE
 
 /* USER CODE END EXPORTED_DEFINES */
 
@@ -64,6 +74,18 @@
   */
 
 /* USER CODE BEGIN EXPORTED_TYPES */
+/** Counters of one CDC port. */
+typedef struct
+{
+  uint32_t rx_packets;    /* OUT packets received */
+  uint32_t rx_bytes;      /* bytes put in the receive ring */
+  uint32_t rx_throttled;  /* times the ring left the host NAKed */
+  uint32_t rx_overruns;   /* bytes dropped, the ring was full */
+  uint32_t tx_bytes;      /* bytes queued by CDC_TransmitPort_FS */
+  uint32_t tx_refused;    /* CDC_TransmitPort_FS calls refused, the ring was full */
+  uint32_t tx_xfers;      /* IN transfers, tx_bytes / tx_xfers is the mean size */
+  uint32_t tx_zlps;       /* ZLPs that ended a transfer of whole packets */
+} CDC_StatsTypeDef;
 
 /* USER CODE END EXPORTED_TYPES */
 
@@ -108,6 +130,12 @@ extern USBD_CDC_ItfTypeDef USBD_Interface_fops_FS;
 uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len);
 
 /* USER CODE BEGIN EXPORTED_FUNCTIONS */
+uint8_t CDC_TransmitPort_FS(uint8_t port, uint8_t* Buf, uint16_t Len);
+uint32_t CDC_TxFree_FS(uint8_t port);
+uint32_t CDC_RxAvailable_FS(uint8_t port);
+uint16_t CDC_Read_FS(uint8_t port, uint8_t* Buf, uint16_t Len);
+CDC_StatsTypeDef *CDC_GetStats_FS(uint8_t port);
+void CDC_SetCoalescing_FS(uint8_t port, uint32_t batch, uint8_t timeout_sof);
 
 /* USER CODE END EXPORTED_FUNCTIONS */
 
@@ -0,0 +1,249 @@
+/**
+ * @file usbd_storage_flash.c
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Internal flash disk backend for the MSC LUN table.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ */
+#include "usbd_storage_flash.h"
+
+static int8_t STORAGE_Flash_Init(uint8_t lun);
+static int8_t STORAGE_Flash_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size);
+static int8_t STORAGE_Flash_IsReady(uint8_t lun);
+static int8_t STORAGE_Flash_IsWriteProtected(uint8_t lun);
+static int8_t STORAGE_Flash_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_Flash_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_Flash_GetMaxLun(void);
+static uint8_t *STORAGE_Flash_GetReadAddr(uint8_t lun, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_Flash_Flush(uint8_t lun);
+static int8_t STORAGE_Flash_Commit(void);
+static int8_t STORAGE_Flash_ProgramPage(uint32_t page_addr, const uint64_t *data);
+
+static const int8_t STORAGE_Flash_Inquirydata[STANDARD_INQUIRY_DATA_LEN] = {
+    0x00,
+    0x80,
+    0x02,
+    0x02,
+    (STANDARD_INQUIRY_DATA_LEN - 5),
+    0x00,
+    0x00,
+    0x00,
+    'S', 'T', 'M', ' ', ' ', ' ', ' ', ' ', /* Manufacturer : 8 bytes */
+    'F', 'l', 'a', 's', 'h', ' ', 'D', 'i', /* Product      : 16 Bytes */
+    's', 'k', ' ', ' ', ' ', ' ', ' ', ' ',
+    '0', '.', '0', '1'                      /* Version      : 4 Bytes */
+};
+
+// 页缓冲, 按双字对齐方便编程
+static uint64_t page_buf[FLASH_PAGE_SIZE / sizeof(uint64_t)];
+// page_buf 里还没写进 flash 的页, 中断里映射读时也要检查
+static __IO uint32_t page_pending = STORAGE_FLASH_NO_PAGE;
+
+USBD_StorageTypeDef USBD_Storage_Flash_fops = {
+    STORAGE_Flash_Init,
+    STORAGE_Flash_GetCapacity,
+    STORAGE_Flash_IsReady,
+    STORAGE_Flash_IsWriteProtected,
+    STORAGE_Flash_Read,
+    STORAGE_Flash_Write,
+    STORAGE_Flash_GetMaxLun,
+    (int8_t *)STORAGE_Flash_Inquirydata,
+    STORAGE_Flash_GetReadAddr,
+    NULL,
+    NULL,
+    STORAGE_Flash_Flush,
+    NULL
+};
+
+static int8_t STORAGE_Flash_Init(uint8_t lun)
+{
+    UNUSED(lun);
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_Flash_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size)
+{
+    UNUSED(lun);
+    *block_num  = STORAGE_FLASH_BLK_NBR;
+    *block_size = STORAGE_FLASH_BLK_SIZ;
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_Flash_IsReady(uint8_t lun)
+{
+    UNUSED(lun);
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_Flash_IsWriteProtected(uint8_t lun)
+{
+    UNUSED(lun);
+    return (USBD_OK);
+}
+
+/**
+ * @brief Read from flash, then overlay the page still held in page_buf.
+ */
+static int8_t STORAGE_Flash_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    uint32_t addr = STORAGE_FLASH_ADDR + blk_addr * STORAGE_FLASH_BLK_SIZ;
+    uint32_t len  = (uint32_t)blk_len * STORAGE_FLASH_BLK_SIZ;
+    uint32_t start;
+    uint32_t end;
+
+    UNUSED(lun);
+
+    memcpy(buf, (uint8_t *)addr, len);
+
+    if ((page_pending != STORAGE_FLASH_NO_PAGE) &&
+        (page_pending < addr + len) && (addr < page_pending + FLASH_PAGE_SIZE)) {
+        start = MAX(addr, page_pending);
+        end   = MIN(addr + len, page_pending + FLASH_PAGE_SIZE);
+        memcpy(buf + (start - addr), (uint8_t *)page_buf + (start - page_pending), end - start);
+    }
+
+    return (USBD_OK);
+}
+
+/**
+ * @brief Gather the blocks into page_buf. A page is only erased and
+ *        programmed once the writes move on to another page or the LUN is
+ *        flushed, so consecutive 512-byte chunks cost one erase per page.
+ */
+static int8_t STORAGE_Flash_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    uint32_t addr = STORAGE_FLASH_ADDR + blk_addr * STORAGE_FLASH_BLK_SIZ;
+    uint32_t len  = (uint32_t)blk_len * STORAGE_FLASH_BLK_SIZ;
+    uint32_t page_addr;
+    uint32_t offset;
+    uint32_t n;
+
+    UNUSED(lun);
+
+    while (len > 0U) {
+        page_addr = addr & ~(FLASH_PAGE_SIZE - 1U);
+        offset    = addr - page_addr;
+        n         = MIN(len, FLASH_PAGE_SIZE - offset);
+
+        if (page_addr != page_pending) {
+            if (STORAGE_Flash_Commit() != 0) {
+                return -1;
+            }
+
+            // 整页覆盖时不用读回旧内容
+            if (n != FLASH_PAGE_SIZE) {
+                memcpy(page_buf, (uint8_t *)page_addr, FLASH_PAGE_SIZE);
+            }
+            page_pending = page_addr;
+        }
+
+        memcpy((uint8_t *)page_buf + offset, buf, n);
+
+        addr += n;
+        buf += n;
+        len -= n;
+    }
+
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_Flash_GetMaxLun(void)
+{
+    return 0;
+}
+
+/**
+ * @brief Flash is memory-mapped, so reads are sent straight from it,
+ *        except for the page not written back yet.
+ */
+static uint8_t *STORAGE_Flash_GetReadAddr(uint8_t lun, uint32_t blk_addr, uint16_t blk_len)
+{
+    uint32_t addr;
+
+    UNUSED(lun);
+
+    if ((blk_addr >= STORAGE_FLASH_BLK_NBR) || (blk_len > (STORAGE_FLASH_BLK_NBR - blk_addr))) {
+        return NULL;
+    }
+
+    addr = STORAGE_FLASH_ADDR + blk_addr * STORAGE_FLASH_BLK_SIZ;
+
+    // 还在 page_buf 里的页不能直接从 flash 发
+    if ((page_pending != STORAGE_FLASH_NO_PAGE) &&
+        (page_pending < addr + (uint32_t)blk_len * STORAGE_FLASH_BLK_SIZ) &&
+        (addr < page_pending + FLASH_PAGE_SIZE)) {
+        return NULL;
+    }
+
+    return (uint8_t *)addr;
+}
+
+/**
+ * @brief Program the page gathered in page_buf.
+ */
+static int8_t STORAGE_Flash_Flush(uint8_t lun)
+{
+    UNUSED(lun);
+    return STORAGE_Flash_Commit();
+}
+
+/**
+ * @brief Write page_buf back to flash, skipping the erase when the page
+ *        content did not change.
+ * @return 0 on success, -1 on a flash error
+ */
+static int8_t STORAGE_Flash_Commit(void)
+{
+    int8_t ret = 0;
+
+    if (page_pending == STORAGE_FLASH_NO_PAGE) {
+        return 0;
+    }
+
+    if (memcmp((uint8_t *)page_pending, page_buf, FLASH_PAGE_SIZE) != 0) {
+        ret = STORAGE_Flash_ProgramPage(page_pending, page_buf);
+    }
+
+    // 出错也丢弃, 错误已经报给了这次写或 flush
+    page_pending = STORAGE_FLASH_NO_PAGE;
+
+    return ret;
+}
+
+/**
+ * @brief Erase one page and program it with FLASH_PAGE_SIZE bytes.
+ * @return 0 on success, -1 on a flash error
+ */
+static int8_t STORAGE_Flash_ProgramPage(uint32_t page_addr, const uint64_t *data)
+{
+    FLASH_EraseInitTypeDef erase;
+    uint32_t page_error = 0U;
+    uint32_t i;
+    int8_t ret = 0;
+
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.Banks     = STORAGE_FLASH_BANK;
+    erase.Page      = (page_addr - STORAGE_FLASH_BANK_ADDR) / FLASH_PAGE_SIZE;
+    erase.NbPages   = 1U;
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+
+    if (HAL_FLASHEx_Erase(&erase, &page_error) != HAL_OK) {
+        ret = -1;
+    }
+
+    for (i = 0U; (ret == 0) && (i < FLASH_PAGE_SIZE / sizeof(uint64_t)); i++) {
+        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, page_addr + i * sizeof(uint64_t), data[i]) != HAL_OK) {
+            ret = -1;
+        }
+    }
+
+    HAL_FLASH_Lock();
+
+    return ret;
+}
@@ -0,0 +1,35 @@
+/**
+ * @file usbd_storage_flash.h
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Internal flash disk backend for the MSC LUN table.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ */
+#ifndef USBD_STORAGE_FLASH_H
+#define USBD_STORAGE_FLASH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "usbd_msc.h"
+
+// 需要双 bank 模式(DBANK=1, 2KB 页), 区域不能和固件重叠
+#define STORAGE_FLASH_BANK      FLASH_BANK_2
+#define STORAGE_FLASH_BANK_ADDR 0x08040000U
+#define STORAGE_FLASH_ADDR      0x08060000U
+#define STORAGE_FLASH_SIZE      0x8000U
+#define STORAGE_FLASH_BLK_SIZ   0x200U
+#define STORAGE_FLASH_BLK_NBR   (STORAGE_FLASH_SIZE / STORAGE_FLASH_BLK_SIZ)
+#define STORAGE_FLASH_NO_PAGE   0xFFFFFFFFU
+
+extern USBD_StorageTypeDef USBD_Storage_Flash_fops;
+
+#ifdef __cplusplus
+}
+#endif
+#endif //! USBD_STORAGE_FLASH_H
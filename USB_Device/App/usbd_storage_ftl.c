@@ -0,0 +1,753 @@
+/**
+ * @file usbd_storage_ftl.c
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Log-structured flash translation layer over internal flash, so a
+ *        FAT host can rewrite the same sectors without wearing out a page.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ * 段布局 (STORAGE_FTL_SEG_SIZE):
+ *   扇区 0: 段头双字 {magic, 擦除次数}, 然后每个数据槽一个标签双字
+ *   扇区 1..STORAGE_FTL_SLOT_NBR: 数据槽
+ * 每次写扇区都追加到活动段的下一个槽: 先编程数据, 再编程标签
+ * {lba, ~lba, seq}. 上电时扫描所有标签, 每个 lba 取 seq 最大的槽, 所以
+ * 断电只会丢掉没写完标签的那一个扇区, 映射表不需要单独保存.
+ * UNMAP 写一个只有标签的槽 {first, ~last, seq | FTL_SEQ_TRIM}, 上电时它
+ * 比旧数据新, 区间内的 lba 读回 0. 垃圾回收时只要别的段里还有这些 lba
+ * 的旧数据就保留原 seq 搬走它.
+ * 垃圾回收中掉电, 上电后的第一次回收会把它做完; 这次回收再掉电可能没有
+ * 空间继续, 只保证两次掉电之间完成过一次回收.
+ */
+#include "usbd_storage_ftl.h"
+
+#if (STORAGE_FTL_SLOT_NBR + 1U) * 8U > STORAGE_FTL_BLK_SIZ
+#error "STORAGE_FTL: slot tags do not fit in the first sector of a segment"
+#endif
+
+#if (STORAGE_FTL_SEG_NBR >= 0xFFU) || (STORAGE_FTL_SEG_NBR * STORAGE_FTL_SLOT_NBR >= 0xFFFFU)
+#error "STORAGE_FTL: too many segments or slots"
+#endif
+
+#define FTL_MAGIC      0x4C54464DU // "MFTL"
+#define FTL_NO_SLOT    0xFFFFU
+#define FTL_NO_SEG     0xFFU
+#define FTL_SEQ_TRIM   0x80000000U // UNMAP 标签, 低 31 位是 seq
+
+#define FTL_SEG_FREE   0U // 已擦除, 段头已写, 没有数据
+#define FTL_SEG_DIRTY  1U // 需要擦除
+#define FTL_SEG_USED   2U
+#define FTL_SEG_ACTIVE 3U
+
+#define FTL_SEG_ADDR(seg)        (STORAGE_FTL_ADDR + (uint32_t)(seg) * STORAGE_FTL_SEG_SIZE)
+#define FTL_TAG_ADDR(seg, slot)  (FTL_SEG_ADDR(seg) + 8U + (uint32_t)(slot) * 8U)
+#define FTL_DATA_ADDR(seg, slot) (FTL_SEG_ADDR(seg) + ((uint32_t)(slot) + 1U) * STORAGE_FTL_BLK_SIZ)
+
+typedef struct {
+    uint16_t lba;
+    uint16_t lba_inv;
+    uint32_t seq;
+} FTL_TagTypeDef;
+
+static int8_t STORAGE_FTL_Init(uint8_t lun);
+static int8_t STORAGE_FTL_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size);
+static int8_t STORAGE_FTL_IsReady(uint8_t lun);
+static int8_t STORAGE_FTL_IsWriteProtected(uint8_t lun);
+static int8_t STORAGE_FTL_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_FTL_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_FTL_GetMaxLun(void);
+static int8_t STORAGE_FTL_Unmap(uint8_t lun, uint32_t blk_addr, uint32_t blk_len);
+
+static void FTL_Mount(void);
+static uint32_t FTL_TagSeq(uint16_t phys);
+static int8_t FTL_Reserve(void);
+static int8_t FTL_WriteSector(uint16_t lba, const uint8_t *data);
+static int8_t FTL_WriteTrim(uint16_t first, uint16_t last, uint32_t seq);
+static uint8_t FTL_TrimNeeded(uint8_t seg, const FTL_TagTypeDef *trim);
+static uint32_t FTL_Live(uint8_t seg);
+static int8_t FTL_OpenActive(void);
+static int8_t FTL_Collect(uint8_t allow_wl);
+static int8_t FTL_EraseSeg(uint8_t seg);
+static int8_t FTL_Program(uint32_t addr, const uint8_t *data, uint32_t len);
+static uint8_t FTL_IsErased(uint32_t addr, uint32_t len);
+
+static const int8_t STORAGE_FTL_Inquirydata[STANDARD_INQUIRY_DATA_LEN] = {
+    0x00,
+    0x80,
+    0x02,
+    0x02,
+    (STANDARD_INQUIRY_DATA_LEN - 5),
+    0x00,
+    0x00,
+    0x00,
+    'S', 'T', 'M', ' ', ' ', ' ', ' ', ' ', /* Manufacturer : 8 bytes */
+    'F', 'T', 'L', ' ', 'D', 'i', 's', 'k', /* Product      : 16 Bytes */
+    ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ',
+    '0', '.', '0', '1'                      /* Version      : 4 Bytes */
+};
+
+static uint16_t ftl_map[STORAGE_FTL_BLK_NBR]; // lba -> seg * STORAGE_FTL_SLOT_NBR + slot
+static uint32_t ftl_erase[STORAGE_FTL_SEG_NBR];
+static uint8_t ftl_valid[STORAGE_FTL_SEG_NBR];
+static uint8_t ftl_state[STORAGE_FTL_SEG_NBR];
+static uint8_t ftl_active = FTL_NO_SEG;
+static uint8_t ftl_fill  = 0U; // 活动段下一个空槽
+static uint8_t ftl_free  = 0U; // FREE + DIRTY 段数
+static uint8_t ftl_mounted = 0U;
+static uint8_t ftl_gc_busy = 0U;
+static uint32_t ftl_seq    = 0U;
+static STORAGE_FTL_StatsTypeDef ftl_stats;
+
+USBD_StorageTypeDef USBD_Storage_FTL_fops = {
+    STORAGE_FTL_Init,
+    STORAGE_FTL_GetCapacity,
+    STORAGE_FTL_IsReady,
+    STORAGE_FTL_IsWriteProtected,
+    STORAGE_FTL_Read,
+    STORAGE_FTL_Write,
+    STORAGE_FTL_GetMaxLun,
+    (int8_t *)STORAGE_FTL_Inquirydata,
+    NULL, // 垃圾回收会擦掉正在发送的段, 不映射
+    NULL,
+    NULL,
+    NULL,
+    STORAGE_FTL_Unmap
+};
+
+/**
+ * @brief Rebuild the mapping from flash the first time the LUN is started.
+ */
+static int8_t STORAGE_FTL_Init(uint8_t lun)
+{
+    UNUSED(lun);
+
+    if (ftl_mounted == 0U) {
+        FTL_Mount();
+        ftl_mounted = 1U;
+    }
+
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_FTL_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size)
+{
+    UNUSED(lun);
+    *block_num  = STORAGE_FTL_BLK_NBR;
+    *block_size = STORAGE_FTL_BLK_SIZ;
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_FTL_IsReady(uint8_t lun)
+{
+    UNUSED(lun);
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_FTL_IsWriteProtected(uint8_t lun)
+{
+    UNUSED(lun);
+    return (USBD_OK);
+}
+
+/**
+ * @brief Sectors never written read as zeros.
+ */
+static int8_t STORAGE_FTL_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    uint16_t phys;
+    uint16_t i;
+
+    UNUSED(lun);
+
+    for (i = 0U; i < blk_len; i++) {
+        phys = ftl_map[blk_addr + i];
+
+        if (phys == FTL_NO_SLOT) {
+            memset(buf, 0, STORAGE_FTL_BLK_SIZ);
+        } else {
+            memcpy(buf, (uint8_t *)FTL_DATA_ADDR(phys / STORAGE_FTL_SLOT_NBR, phys % STORAGE_FTL_SLOT_NBR),
+                   STORAGE_FTL_BLK_SIZ);
+        }
+
+        buf += STORAGE_FTL_BLK_SIZ;
+    }
+
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_FTL_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    uint16_t phys;
+    uint16_t i;
+
+    UNUSED(lun);
+
+    for (i = 0U; i < blk_len; i++) {
+        ftl_stats.host_writes++;
+        phys = ftl_map[blk_addr + i];
+
+        // 内容没变就不占新槽
+        if ((phys == FTL_NO_SLOT) ||
+            (memcmp((uint8_t *)FTL_DATA_ADDR(phys / STORAGE_FTL_SLOT_NBR, phys % STORAGE_FTL_SLOT_NBR),
+                    buf, STORAGE_FTL_BLK_SIZ) != 0)) {
+            if (FTL_WriteSector((uint16_t)(blk_addr + i), buf) != 0) {
+                return -1;
+            }
+        }
+
+        buf += STORAGE_FTL_BLK_SIZ;
+    }
+
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_FTL_GetMaxLun(void)
+{
+    return 0;
+}
+
+/**
+ * @brief Forget the sectors and log a trim tag, so they still read as zeros
+ *        after a reset. Nothing is logged when none of them is mapped.
+ */
+static int8_t STORAGE_FTL_Unmap(uint8_t lun, uint32_t blk_addr, uint32_t blk_len)
+{
+    uint16_t phys;
+    uint32_t mapped = 0U;
+    uint32_t i;
+
+    UNUSED(lun);
+
+    if (blk_len == 0U) {
+        return (USBD_OK);
+    }
+
+    if ((blk_addr >= STORAGE_FTL_BLK_NBR) || (blk_len > (STORAGE_FTL_BLK_NBR - blk_addr))) {
+        return -1;
+    }
+
+    for (i = 0U; i < blk_len; i++) {
+        if (ftl_map[blk_addr + i] != FTL_NO_SLOT) {
+            mapped++;
+        }
+    }
+
+    if (mapped == 0U) {
+        return (USBD_OK);
+    }
+
+    // 先写标签再改映射, 写失败时数据还在
+    if (FTL_WriteTrim((uint16_t)blk_addr, (uint16_t)(blk_addr + blk_len - 1U), ftl_seq + 1U) != 0) {
+        return -1;
+    }
+
+    for (i = 0U; i < blk_len; i++) {
+        phys = ftl_map[blk_addr + i];
+
+        if (phys != FTL_NO_SLOT) {
+            ftl_valid[phys / STORAGE_FTL_SLOT_NBR]--;
+            ftl_map[blk_addr + i] = FTL_NO_SLOT;
+            ftl_stats.unmapped++;
+        }
+    }
+
+    return (USBD_OK);
+}
+
+/**
+ * @brief Return the write amplification and wear counters.
+ */
+STORAGE_FTL_StatsTypeDef *STORAGE_FTL_GetStats(void)
+{
+    return &ftl_stats;
+}
+
+/**
+ * @brief Scan every segment, keep the newest copy of each sector and pick
+ *        the partly written segment with the newest data as active one.
+ */
+static void FTL_Mount(void)
+{
+    const uint32_t *hdr;
+    const FTL_TagTypeDef *tag;
+    uint32_t max_erase = 0U;
+    uint32_t best_seq  = 0U;
+    uint32_t top;
+    uint32_t seq;
+    uint16_t phys;
+    uint16_t last;
+    uint16_t lba;
+    uint8_t fill;
+    uint8_t seg;
+    uint8_t i;
+
+    memset(ftl_map, 0xFF, sizeof(ftl_map));
+    memset(ftl_valid, 0, sizeof(ftl_valid));
+    ftl_active = FTL_NO_SEG;
+    ftl_free   = 0U;
+    ftl_seq    = 0U;
+
+    for (seg = 0U; seg < STORAGE_FTL_SEG_NBR; seg++) {
+        hdr = (const uint32_t *)FTL_SEG_ADDR(seg);
+
+        // 段头无效: 从没用过或擦除时断电
+        if (hdr[0] != FTL_MAGIC) {
+            ftl_state[seg] = FTL_SEG_DIRTY;
+            ftl_free++;
+            continue;
+        }
+
+        ftl_erase[seg] = hdr[1];
+        max_erase      = MAX(max_erase, hdr[1]);
+        fill           = 0U;
+        top            = 0U;
+
+        for (i = 0U; i < STORAGE_FTL_SLOT_NBR; i++) {
+            tag = (const FTL_TagTypeDef *)FTL_TAG_ADDR(seg, i);
+
+            if ((tag->lba == 0xFFFFU) && (tag->lba_inv == 0xFFFFU) && (tag->seq == 0xFFFFFFFFU)) {
+                // 数据写了一半标签没写, 这个槽不能再编程
+                if (FTL_IsErased(FTL_DATA_ADDR(seg, i), STORAGE_FTL_BLK_SIZ) == 0U) {
+                    fill = i + 1U;
+                }
+                continue;
+            }
+
+            fill = i + 1U;
+            lba  = tag->lba;
+            seq  = tag->seq & ~FTL_SEQ_TRIM;
+
+            // 数据标签 lba_inv == ~lba, 裁剪标签 lba_inv == ~last
+            if ((tag->seq & FTL_SEQ_TRIM) != 0U) {
+                last = (uint16_t)(tag->lba_inv ^ 0xFFFFU);
+            } else if ((uint16_t)(tag->lba_inv ^ lba) == 0xFFFFU) {
+                last = lba;
+            } else {
+                continue;
+            }
+
+            if ((lba > last) || (last >= STORAGE_FTL_BLK_NBR)) {
+                continue;
+            }
+
+            top = MAX(top, seq);
+
+            // 裁剪标签先占住映射, 扫描完再清掉
+            for (; lba <= last; lba++) {
+                phys = ftl_map[lba];
+
+                if ((phys == FTL_NO_SLOT) || (seq > FTL_TagSeq(phys))) {
+                    ftl_map[lba] = (uint16_t)(seg * STORAGE_FTL_SLOT_NBR + i);
+                }
+            }
+        }
+
+        ftl_seq = MAX(ftl_seq, top);
+
+        if (fill == 0U) {
+            ftl_state[seg] = FTL_SEG_FREE;
+            ftl_free++;
+        } else if ((fill < STORAGE_FTL_SLOT_NBR) && ((ftl_active == FTL_NO_SEG) || (top >= best_seq))) {
+            // 只续写最新的半满段, 其余的当作已满
+            if (ftl_active != FTL_NO_SEG) {
+                ftl_state[ftl_active] = FTL_SEG_USED;
+            }
+            ftl_state[seg] = FTL_SEG_ACTIVE;
+            ftl_active     = seg;
+            ftl_fill       = fill;
+            best_seq       = top;
+        } else {
+            ftl_state[seg] = FTL_SEG_USED;
+        }
+    }
+
+    // 段头丢了的段按最坏情况算擦除次数
+    for (seg = 0U; seg < STORAGE_FTL_SEG_NBR; seg++) {
+        if (ftl_state[seg] == FTL_SEG_DIRTY) {
+            ftl_erase[seg] = max_erase;
+        }
+    }
+
+    for (lba = 0U; lba < STORAGE_FTL_BLK_NBR; lba++) {
+        phys = ftl_map[lba];
+
+        if (phys == FTL_NO_SLOT) {
+            continue;
+        }
+
+        tag = (const FTL_TagTypeDef *)FTL_TAG_ADDR(phys / STORAGE_FTL_SLOT_NBR, phys % STORAGE_FTL_SLOT_NBR);
+
+        if ((tag->seq & FTL_SEQ_TRIM) != 0U) {
+            ftl_map[lba] = FTL_NO_SLOT;
+        } else {
+            ftl_valid[phys / STORAGE_FTL_SLOT_NBR]++;
+        }
+    }
+}
+
+/**
+ * @brief Sequence number of the tag of a slot, trim flag removed.
+ */
+static uint32_t FTL_TagSeq(uint16_t phys)
+{
+    return ((const FTL_TagTypeDef *)FTL_TAG_ADDR(phys / STORAGE_FTL_SLOT_NBR, phys % STORAGE_FTL_SLOT_NBR))->seq &
+           ~FTL_SEQ_TRIM;
+}
+
+/**
+ * @brief Make sure the active segment has a free slot.
+ *        One segment is kept free for the garbage collector.
+ */
+static int8_t FTL_Reserve(void)
+{
+    uint8_t allow_wl = 1U;
+
+    while ((ftl_gc_busy == 0U) &&
+           ((ftl_free == 0U) ||
+            ((ftl_free == 1U) && ((ftl_active == FTL_NO_SEG) || (ftl_fill >= STORAGE_FTL_SLOT_NBR))))) {
+        if (FTL_Collect(allow_wl) != 0) {
+            return -1;
+        }
+        allow_wl = 0U;
+    }
+
+    if ((ftl_active == FTL_NO_SEG) || (ftl_fill >= STORAGE_FTL_SLOT_NBR)) {
+        if (FTL_OpenActive() != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Append one sector to the log and remap it.
+ */
+static int8_t FTL_WriteSector(uint16_t lba, const uint8_t *data)
+{
+    FTL_TagTypeDef tag;
+    uint16_t phys;
+
+    if (FTL_Reserve() != 0) {
+        return -1;
+    }
+
+    // 编程失败也跳过这个槽
+    phys = (uint16_t)(ftl_active * STORAGE_FTL_SLOT_NBR + ftl_fill);
+    ftl_fill++;
+
+    tag.lba     = lba;
+    tag.lba_inv = (uint16_t)~lba;
+    tag.seq     = ftl_seq + 1U;
+
+    if ((FTL_Program(FTL_DATA_ADDR(ftl_active, phys % STORAGE_FTL_SLOT_NBR), data, STORAGE_FTL_BLK_SIZ) != 0) ||
+        (FTL_Program(FTL_TAG_ADDR(ftl_active, phys % STORAGE_FTL_SLOT_NBR), (const uint8_t *)&tag, sizeof(tag)) != 0)) {
+        return -1;
+    }
+
+    ftl_seq = tag.seq;
+
+    if (ftl_map[lba] != FTL_NO_SLOT) {
+        ftl_valid[ftl_map[lba] / STORAGE_FTL_SLOT_NBR]--;
+    }
+    ftl_map[lba] = phys;
+    ftl_valid[ftl_active]++;
+    ftl_stats.flash_writes++;
+
+    return 0;
+}
+
+/**
+ * @brief Append a trim tag for first..last, the data slot stays erased.
+ *        seq is ftl_seq + 1 for a new trim, the original one when the
+ *        garbage collector moves it.
+ */
+static int8_t FTL_WriteTrim(uint16_t first, uint16_t last, uint32_t seq)
+{
+    FTL_TagTypeDef tag;
+    uint8_t slot;
+
+    if (FTL_Reserve() != 0) {
+        return -1;
+    }
+
+    // 垃圾回收可能已经用掉了 seq, 新的裁剪要排在它们后面
+    if (ftl_gc_busy == 0U) {
+        seq = ftl_seq + 1U;
+    }
+
+    slot = ftl_fill;
+    ftl_fill++;
+
+    tag.lba     = first;
+    tag.lba_inv = (uint16_t)~last;
+    tag.seq     = seq | FTL_SEQ_TRIM;
+
+    if (FTL_Program(FTL_TAG_ADDR(ftl_active, slot), (const uint8_t *)&tag, sizeof(tag)) != 0) {
+        return -1;
+    }
+
+    ftl_seq = MAX(ftl_seq, seq);
+
+    return 0;
+}
+
+/**
+ * @brief A trim tag must survive while another segment still holds an
+ *        older copy of a sector it covers that has not been rewritten,
+ *        unless a copy of the tag itself (an interrupted move) survives.
+ */
+static uint8_t FTL_TrimNeeded(uint8_t seg, const FTL_TagTypeDef *trim)
+{
+    const FTL_TagTypeDef *tag;
+    uint32_t seq   = trim->seq & ~FTL_SEQ_TRIM;
+    uint16_t first = trim->lba;
+    uint16_t last  = (uint16_t)(trim->lba_inv ^ 0xFFFFU);
+    uint8_t i;
+    uint8_t s;
+
+    for (s = 0U; s < STORAGE_FTL_SEG_NBR; s++) {
+        // 待擦除的段上电时不会被扫描
+        if ((s == seg) || (ftl_state[s] == FTL_SEG_FREE) || (ftl_state[s] == FTL_SEG_DIRTY)) {
+            continue;
+        }
+
+        for (i = 0U; i < STORAGE_FTL_SLOT_NBR; i++) {
+            tag = (const FTL_TagTypeDef *)FTL_TAG_ADDR(s, i);
+
+            if ((tag->seq == trim->seq) && (tag->lba == trim->lba) && (tag->lba_inv == trim->lba_inv)) {
+                return 0U;
+            }
+
+            if (((tag->seq & FTL_SEQ_TRIM) == 0U) && (tag->seq < seq) &&
+                (tag->lba >= first) && (tag->lba <= last) && (ftl_map[tag->lba] == FTL_NO_SLOT)) {
+                return 1U;
+            }
+        }
+    }
+
+    return 0U;
+}
+
+/**
+ * @brief Slots the garbage collector has to move out of a segment.
+ */
+static uint32_t FTL_Live(uint8_t seg)
+{
+    const FTL_TagTypeDef *tag;
+    uint32_t live = ftl_valid[seg];
+    uint8_t i;
+
+    for (i = 0U; i < STORAGE_FTL_SLOT_NBR; i++) {
+        tag = (const FTL_TagTypeDef *)FTL_TAG_ADDR(seg, i);
+
+        if (((tag->seq & FTL_SEQ_TRIM) != 0U) && (tag->seq != 0xFFFFFFFFU) && (FTL_TrimNeeded(seg, tag) != 0U)) {
+            live++;
+        }
+    }
+
+    return live;
+}
+
+/**
+ * @brief Close the active segment and open the free one with the fewest
+ *        erases (dynamic wear levelling).
+ */
+static int8_t FTL_OpenActive(void)
+{
+    uint8_t seg = FTL_NO_SEG;
+    uint8_t i;
+
+    for (i = 0U; i < STORAGE_FTL_SEG_NBR; i++) {
+        if (((ftl_state[i] == FTL_SEG_FREE) || (ftl_state[i] == FTL_SEG_DIRTY)) &&
+            ((seg == FTL_NO_SEG) || (ftl_erase[i] < ftl_erase[seg]))) {
+            seg = i;
+        }
+    }
+
+    if (seg == FTL_NO_SEG) {
+        return -1;
+    }
+
+    if ((ftl_state[seg] == FTL_SEG_DIRTY) && (FTL_EraseSeg(seg) != 0)) {
+        return -1;
+    }
+
+    if (ftl_active != FTL_NO_SEG) {
+        ftl_state[ftl_active] = FTL_SEG_USED;
+    }
+
+    ftl_state[seg] = FTL_SEG_ACTIVE;
+    ftl_active     = seg;
+    ftl_fill       = 0U;
+    ftl_free--;
+
+    return 0;
+}
+
+/**
+ * @brief Move the live sectors out of one segment and erase it.
+ *        The victim is the segment with the fewest live sectors, or, once
+ *        the erase counts drift apart by STORAGE_FTL_WL_DELTA, the least
+ *        erased one, whose data is cold (static wear levelling).
+ */
+static int8_t FTL_Collect(uint8_t allow_wl)
+{
+    const FTL_TagTypeDef *tag;
+    uint32_t live[STORAGE_FTL_SEG_NBR];
+    uint32_t max_erase = 0U;
+    uint32_t room;
+    uint8_t victim = FTL_NO_SEG;
+    uint8_t cold   = FTL_NO_SEG;
+    uint8_t i;
+    int8_t ret = 0;
+
+    room = (uint32_t)ftl_free * STORAGE_FTL_SLOT_NBR;
+    if (ftl_active != FTL_NO_SEG) {
+        room += STORAGE_FTL_SLOT_NBR - ftl_fill;
+    }
+
+    // 搬移中掉电会浪费一个写了一半的槽, 留出来, 上电后才能把这个段搬完
+    if (ftl_free != 0U) {
+        room--;
+    }
+
+    for (i = 0U; i < STORAGE_FTL_SEG_NBR; i++) {
+        max_erase = MAX(max_erase, ftl_erase[i]);
+
+        if (ftl_state[i] != FTL_SEG_USED) {
+            continue;
+        }
+
+        live[i] = FTL_Live(i);
+
+        if ((victim == FTL_NO_SEG) || (live[i] < live[victim])) {
+            victim = i;
+        }
+        if ((cold == FTL_NO_SEG) || (ftl_erase[i] < ftl_erase[cold])) {
+            cold = i;
+        }
+    }
+
+    if ((allow_wl != 0U) && (cold != FTL_NO_SEG) &&
+        ((max_erase - ftl_erase[cold]) > STORAGE_FTL_WL_DELTA) && (live[cold] <= room)) {
+        victim = cold;
+        ftl_stats.wl_moves++;
+    } else if ((victim == FTL_NO_SEG) || (live[victim] >= STORAGE_FTL_SLOT_NBR) || (live[victim] > room)) {
+        return -1;
+    }
+
+    ftl_gc_busy = 1U;
+    ftl_stats.gc_runs++;
+
+    for (i = 0U; (ret == 0) && (i < STORAGE_FTL_SLOT_NBR); i++) {
+        tag = (const FTL_TagTypeDef *)FTL_TAG_ADDR(victim, i);
+
+        if (tag->seq == 0xFFFFFFFFU) {
+            continue;
+        }
+
+        if ((tag->seq & FTL_SEQ_TRIM) != 0U) {
+            if (FTL_TrimNeeded(victim, tag) != 0U) {
+                ret = FTL_WriteTrim(tag->lba, (uint16_t)(tag->lba_inv ^ 0xFFFFU), tag->seq & ~FTL_SEQ_TRIM);
+            }
+        } else if ((tag->lba < STORAGE_FTL_BLK_NBR) &&
+                   (ftl_map[tag->lba] == (uint16_t)(victim * STORAGE_FTL_SLOT_NBR + i))) {
+            ret = FTL_WriteSector(tag->lba, (const uint8_t *)FTL_DATA_ADDR(victim, i));
+        }
+    }
+
+    ftl_gc_busy = 0U;
+
+    if (ret != 0) {
+        return ret;
+    }
+
+    // 擦除失败就留给 FTL_OpenActive 再擦
+    ftl_state[victim] = FTL_SEG_DIRTY;
+    ftl_free++;
+    (void)FTL_EraseSeg(victim);
+
+    return 0;
+}
+
+/**
+ * @brief Erase a segment and stamp it with its new erase count.
+ */
+static int8_t FTL_EraseSeg(uint8_t seg)
+{
+    FLASH_EraseInitTypeDef erase;
+    uint32_t page_error = 0U;
+    uint32_t hdr[2];
+    int8_t ret = 0;
+
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.Banks     = STORAGE_FTL_BANK;
+    erase.Page      = (FTL_SEG_ADDR(seg) - STORAGE_FTL_BANK_ADDR) / FLASH_PAGE_SIZE;
+    erase.NbPages   = STORAGE_FTL_SEG_PAGES;
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+
+    if (HAL_FLASHEx_Erase(&erase, &page_error) != HAL_OK) {
+        ret = -1;
+    }
+
+    HAL_FLASH_Lock();
+
+    ftl_erase[seg]++;
+    ftl_stats.erases++;
+
+    hdr[0] = FTL_MAGIC;
+    hdr[1] = ftl_erase[seg];
+
+    if ((ret != 0) || (FTL_Program(FTL_SEG_ADDR(seg), (const uint8_t *)hdr, sizeof(hdr)) != 0)) {
+        return -1;
+    }
+
+    ftl_state[seg] = FTL_SEG_FREE;
+
+    return 0;
+}
+
+/**
+ * @brief Program len bytes (a multiple of 8) one doubleword at a time.
+ *        data may be unaligned or point into flash.
+ */
+static int8_t FTL_Program(uint32_t addr, const uint8_t *data, uint32_t len)
+{
+    uint64_t dw;
+    uint32_t i;
+    int8_t ret = 0;
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+
+    for (i = 0U; (ret == 0) && (i < len); i += sizeof(uint64_t)) {
+        memcpy(&dw, data + i, sizeof(uint64_t));
+
+        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, addr + i, dw) != HAL_OK) {
+            ret = -1;
+        }
+    }
+
+    HAL_FLASH_Lock();
+
+    return ret;
+}
+
+static uint8_t FTL_IsErased(uint32_t addr, uint32_t len)
+{
+    const uint32_t *p = (const uint32_t *)addr;
+    uint32_t i;
+
+    for (i = 0U; i < len / sizeof(uint32_t); i++) {
+        if (p[i] != 0xFFFFFFFFU) {
+            return 0U;
+        }
+    }
+
+    return 1U;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file usbd_storage_ftl.h
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Wear-levelled internal flash disk backend for the MSC LUN table.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ */
+#ifndef USBD_STORAGE_FTL_H
+#define USBD_STORAGE_FTL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "usbd_msc.h"
+
+// 需要双 bank 模式(DBANK=1, 2KB 页), 用 bank 2 前半部分, 不能和其他 LUN 重叠
+#define STORAGE_FTL_BANK        FLASH_BANK_2
+#define STORAGE_FTL_BANK_ADDR   0x08040000U
+#define STORAGE_FTL_ADDR        0x08040000U
+#define STORAGE_FTL_SIZE        0x20000U
+
+// 擦除单位: 段, 第一个扇区放段头和每个数据槽的标签
+#define STORAGE_FTL_SEG_PAGES   4U
+#define STORAGE_FTL_SEG_SIZE    (STORAGE_FTL_SEG_PAGES * FLASH_PAGE_SIZE)
+#define STORAGE_FTL_SEG_NBR     (STORAGE_FTL_SIZE / STORAGE_FTL_SEG_SIZE)
+#define STORAGE_FTL_BLK_SIZ     0x200U
+#define STORAGE_FTL_SLOT_NBR    (STORAGE_FTL_SEG_SIZE / STORAGE_FTL_BLK_SIZ - 1U)
+
+// 留两个段给垃圾回收, 其余给主机
+#define STORAGE_FTL_SPARE_SEG   2U
+#define STORAGE_FTL_BLK_NBR     ((STORAGE_FTL_SEG_NBR - STORAGE_FTL_SPARE_SEG) * STORAGE_FTL_SLOT_NBR)
+
+// 擦除次数相差超过这个值时, 把冷数据段搬走
+#define STORAGE_FTL_WL_DELTA    16U
+
+typedef struct {
+    uint32_t host_writes;  // 主机写入的扇区
+    uint32_t flash_writes; // 实际编程的扇区, 含垃圾回收搬移
+    uint32_t erases;       // 段擦除次数
+    uint32_t gc_runs;      // 垃圾回收次数
+    uint32_t wl_moves;     // 静态磨损均衡搬移的段
+    uint32_t unmapped;     // UNMAP 释放的扇区
+} STORAGE_FTL_StatsTypeDef;
+
+extern USBD_StorageTypeDef USBD_Storage_FTL_fops;
+
+STORAGE_FTL_StatsTypeDef *STORAGE_FTL_GetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //! USBD_STORAGE_FTL_H
@@ -22,6 +22,14 @@
 #include "usbd_storage_if.h"
 
 /* USER CODE BEGIN INCLUDE */
+#include "usbd_storage_ram.h"
+#include "usbd_storage_flash.h"
+#include "usbd_storage_ftl.h"
+#include "usbd_storage_zram.h"
+#include "usbd_storage_vfat.h"
+#include "usbd_storage_xip.h"
+#include "usbd_storage_qspi.h"
+#include "usbd_storage_snap.h"
 
 /* USER CODE END INCLUDE */
 
@@ -62,11 +70,12 @@
   * @{
   */
 
-#define STORAGE_LUN_NBR                  1
-#define STORAGE_BLK_NBR                  80
-#define STORAGE_BLK_SIZ                  0x200
+#define STORAGE_LUN_NBR                  8
 
 /* USER CODE BEGIN PRIVATE_DEFINES */
+#if STORAGE_LUN_NBR > MSC_MAX_LUN
+#error "STORAGE_LUN_NBR exceeds MSC_MAX_LUN"
+#endif
 
 /* USER CODE END PRIVATE_DEFINES */
 
@@ -93,26 +102,22 @@
   */
 
 /* USER CODE BEGIN INQUIRY_DATA_FS */
-/** USB Mass storage Standard Inquiry Data. */
-const int8_t STORAGE_Inquirydata_FS[] = {/* 36 */
-
-  /* LUN 0 */
-  0x00,
-  0x80,
-  0x02,
-  0x02,
-  (STANDARD_INQUIRY_DATA_LEN - 5),
-  0x00,
-  0x00,
-  0x00,
-  'S', 'T', 'M', ' ', ' ', ' ', ' ', ' ', /* Manufacturer : 8 bytes */
-  'P', 'r', 'o', 'd', 'u', 'c', 't', ' ', /* Product      : 16 Bytes */
-  ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ',
-  '0', '.', '0' ,'1'                      /* Version      : 4 Bytes */
-};
+/** USB Mass storage Standard Inquiry Data, filled from each LUN backend. */
+int8_t STORAGE_Inquirydata_FS[STORAGE_LUN_NBR * STANDARD_INQUIRY_DATA_LEN];
 /* USER CODE END INQUIRY_DATA_FS */
 
 /* USER CODE BEGIN PRIVATE_VARIABLES */
+/** Backend of each LUN. */
+static USBD_StorageTypeDef *const STORAGE_Lun_Table[STORAGE_LUN_NBR] = {
+  &USBD_Storage_RAM_fops,     /* LUN 0: RAM scratch disk */
+  &USBD_Storage_Flash_fops,   /* LUN 1: internal flash disk */
+  &USBD_Storage_Snap_fops,    /* LUN 2: wear-levelled internal flash disk, with snapshots */
+  &USBD_Storage_ZRAM_fops,    /* LUN 3: compressed RAM disk */
+  &USBD_Storage_VFAT_fops,    /* LUN 4: synthesised FAT volume with device state */
+  &USBD_Storage_XIP_fops,     /* LUN 5: read-only reference data in internal flash */
+  &USBD_Storage_QSPI_fops,    /* LUN 6: external QUADSPI NOR flash */
+  &USBD_Storage_SnapView_fops /* LUN 7: read-only view of a LUN 2 snapshot */
+};
 
 /* USER CODE END PRIVATE_VARIABLES */
 
@@ -149,6 +154,11 @@ static int8_t STORAGE_Write_FS(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uin
 static int8_t STORAGE_GetMaxLun_FS(void);
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
+static uint8_t *STORAGE_GetReadAddr_FS(uint8_t lun, uint32_t blk_addr, uint16_t blk_len);
+static uint8_t *STORAGE_GetWriteAddr_FS(uint8_t lun, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_Poll_FS(uint8_t lun);
+static int8_t STORAGE_Flush_FS(uint8_t lun);
+static int8_t STORAGE_Unmap_FS(uint8_t lun, uint32_t blk_addr, uint32_t blk_len);
 
 /* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
 
@@ -165,7 +175,12 @@ USBD_StorageTypeDef USBD_Storage_Interface_fops_FS =
   STORAGE_Read_FS,
   STORAGE_Write_FS,
   STORAGE_GetMaxLun_FS,
-  (int8_t *)STORAGE_Inquirydata_FS
+  (int8_t *)STORAGE_Inquirydata_FS,
+  STORAGE_GetReadAddr_FS,
+  STORAGE_GetWriteAddr_FS,
+  STORAGE_Poll_FS,
+  STORAGE_Flush_FS,
+  STORAGE_Unmap_FS
 };
 
 /* Private functions ---------------------------------------------------------*/
@@ -177,7 +192,15 @@ USBD_StorageTypeDef USBD_Storage_Interface_fops_FS =
 int8_t STORAGE_Init_FS(uint8_t lun)
 {
   /* USER CODE BEGIN 2 */
-  return (USBD_OK);
+  if (lun >= STORAGE_LUN_NBR)
+  {
+    return (USBD_FAIL);
+  }
+
+  memcpy(&STORAGE_Inquirydata_FS[lun * STANDARD_INQUIRY_DATA_LEN],
+         STORAGE_Lun_Table[lun]->pInquiry, STANDARD_INQUIRY_DATA_LEN);
+
+  return STORAGE_Lun_Table[lun]->Init(lun);
   /* USER CODE END 2 */
 }
 
@@ -191,9 +214,12 @@ int8_t STORAGE_Init_FS(uint8_t lun)
 int8_t STORAGE_GetCapacity_FS(uint8_t lun, uint32_t *block_num, uint16_t *block_size)
 {
   /* USER CODE BEGIN 3 */
-  *block_num  = STORAGE_BLK_NBR;
-  *block_size = STORAGE_BLK_SIZ;
-  return (USBD_OK);
+  if (lun >= STORAGE_LUN_NBR)
+  {
+    return (USBD_FAIL);
+  }
+
+  return STORAGE_Lun_Table[lun]->GetCapacity(lun, block_num, block_size);
   /* USER CODE END 3 */
 }
 
@@ -205,7 +231,12 @@ int8_t STORAGE_GetCapacity_FS(uint8_t lun, uint32_t *block_num, uint16_t *block_
 int8_t STORAGE_IsReady_FS(uint8_t lun)
 {
   /* USER CODE BEGIN 4 */
-  return (USBD_OK);
+  if (lun >= STORAGE_LUN_NBR)
+  {
+    return (USBD_FAIL);
+  }
+
+  return STORAGE_Lun_Table[lun]->IsReady(lun);
   /* USER CODE END 4 */
 }
 
@@ -217,11 +248,15 @@ int8_t STORAGE_IsReady_FS(uint8_t lun)
 int8_t STORAGE_IsWriteProtected_FS(uint8_t lun)
 {
   /* USER CODE BEGIN 5 */
-  return (USBD_OK);
+  if (lun >= STORAGE_LUN_NBR)
+  {
+    return (USBD_FAIL);
+  }
+
+  return STORAGE_Lun_Table[lun]->IsWriteProtected(lun);
   /* USER CODE END 5 */
 }
 
-static uint8_t sim_buf[STORAGE_BLK_SIZ*STORAGE_BLK_NBR] = {0};
 /**
   * @brief  .
   * @param  lun: .
@@ -230,8 +265,12 @@ static uint8_t sim_buf[STORAGE_BLK_SIZ*STORAGE_BLK_NBR] = {0};
 int8_t STORAGE_Read_FS(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
 {
   /* USER CODE BEGIN 6 */
-  memcpy(buf, sim_buf + blk_addr*STORAGE_BLK_SIZ, blk_len*STORAGE_BLK_SIZ);
-  return (USBD_OK);
+  if (lun >= STORAGE_LUN_NBR)
+  {
+    return -1;
+  }
+
+  return STORAGE_Lun_Table[lun]->Read(lun, buf, blk_addr, blk_len);
   /* USER CODE END 6 */
 }
 
@@ -243,8 +282,12 @@ int8_t STORAGE_Read_FS(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t bl
 int8_t STORAGE_Write_FS(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
 {
   /* USER CODE BEGIN 7 */
-  memcpy(sim_buf + blk_addr*STORAGE_BLK_SIZ, buf, blk_len*STORAGE_BLK_SIZ);
-  return (USBD_OK);
+  if (lun >= STORAGE_LUN_NBR)
+  {
+    return -1;
+  }
+
+  return STORAGE_Lun_Table[lun]->Write(lun, buf, blk_addr, blk_len);
   /* USER CODE END 7 */
 }
 
@@ -261,6 +304,89 @@ int8_t STORAGE_GetMaxLun_FS(void)
 }
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
+/**
+  * @brief  Direct address of blocks to read, for backends with memory-mapped storage.
+  * @param  lun: .
+  * @param  blk_addr: first block.
+  * @param  blk_len: number of blocks.
+  * @retval Pointer to the blocks, NULL to go through Read
+  */
+static uint8_t *STORAGE_GetReadAddr_FS(uint8_t lun, uint32_t blk_addr, uint16_t blk_len)
+{
+  if ((lun >= STORAGE_LUN_NBR) || (STORAGE_Lun_Table[lun]->GetReadAddr == NULL))
+  {
+    return NULL;
+  }
+
+  return STORAGE_Lun_Table[lun]->GetReadAddr(lun, blk_addr, blk_len);
+}
+
+/**
+  * @brief  Direct address of blocks to write, for backends with memory-mapped storage.
+  * @param  lun: .
+  * @param  blk_addr: first block.
+  * @param  blk_len: number of blocks.
+  * @retval Pointer to the blocks, NULL to go through Write
+  */
+static uint8_t *STORAGE_GetWriteAddr_FS(uint8_t lun, uint32_t blk_addr, uint16_t blk_len)
+{
+  if ((lun >= STORAGE_LUN_NBR) || (STORAGE_Lun_Table[lun]->GetWriteAddr == NULL))
+  {
+    return NULL;
+  }
+
+  return STORAGE_Lun_Table[lun]->GetWriteAddr(lun, blk_addr, blk_len);
+}
+
+/**
+  * @brief  Progress of a transfer the backend started asynchronously.
+  * @param  lun: .
+  * @retval >0 still busy, 0 done, <0 error
+  */
+static int8_t STORAGE_Poll_FS(uint8_t lun)
+{
+  if ((lun >= STORAGE_LUN_NBR) || (STORAGE_Lun_Table[lun]->Poll == NULL))
+  {
+    return -1;
+  }
+
+  return STORAGE_Lun_Table[lun]->Poll(lun);
+}
+
+/**
+  * @brief  Commit the data a backend still buffers.
+  * @param  lun: .
+  * @retval >0 still busy, 0 done, <0 error
+  */
+static int8_t STORAGE_Flush_FS(uint8_t lun)
+{
+  if (lun >= STORAGE_LUN_NBR)
+  {
+    return -1;
+  }
+
+  if (STORAGE_Lun_Table[lun]->Flush == NULL)
+  {
+    return (USBD_OK);
+  }
+
+  return STORAGE_Lun_Table[lun]->Flush(lun);
+}
+
+/**
+  * @brief  Deallocate blocks of backends that support it.
+  * @param  lun: .
+  * @retval USBD_OK if all operations are OK, -1 if the LUN cannot unmap
+  */
+static int8_t STORAGE_Unmap_FS(uint8_t lun, uint32_t blk_addr, uint32_t blk_len)
+{
+  if ((lun >= STORAGE_LUN_NBR) || (STORAGE_Lun_Table[lun]->Unmap == NULL))
+  {
+    return -1;
+  }
+
+  return STORAGE_Lun_Table[lun]->Unmap(lun, blk_addr, blk_len);
+}
 
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
@@ -0,0 +1,539 @@
+/**
+ * @file usbd_storage_qspi.c
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief External QUADSPI NOR flash disk backend for the MSC LUN table.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ * 寄存器操作在 usbd_storage_qspi_ll.c, 这里只有磁盘逻辑:
+ *   读: 1-1-4 快速读, DMA 直接搬到请求的缓冲区
+ *   写: 一个 4KB 擦除扇区的写回缓冲, 主机写到别的扇区, SYNCHRONIZE CACHE
+ *       或空闲时提交. 提交时逐页和 flash 比较: 没变的页跳过, 只把 1 变 0
+ *       的页直接编程, 否则擦除整个扇区再编程非空页.
+ * 擦除和编程的等待用 QUADSPI 自动轮询 WIP, DMA 读也不阻塞: Read/Write/Flush
+ * 返回 MSC_MEDIA_BUSY, 由 USBD_MSC_Process 调 Poll 推进状态机.
+ * Init 在 USB 中断里调用, 只登记探测; 读 ID 和设置 QE 位由主循环里的
+ * STORAGE_QSPI_Process 完成, 在此之前 IsReady 报告 NOT READY.
+ */
+#include "usbd_storage_qspi_ll.h"
+
+#if (STORAGE_QSPI_SECTOR_SIZ / STORAGE_QSPI_PAGE_SIZ) > 16U
+#error "STORAGE_QSPI: qspi_prog_mask holds 16 pages"
+#endif
+
+#define QSPI_NO_SECTOR  0xFFFFFFFFU
+
+typedef enum {
+    QSPI_OP_NONE = 0,
+    QSPI_OP_READ,
+    QSPI_OP_WRITE,
+    QSPI_OP_FLUSH
+} QSPI_OpTypeDef;
+
+typedef enum {
+    QSPI_PROBE_NONE = 0, // Init 还没调用
+    QSPI_PROBE_START,    // 等主循环读 ID
+    QSPI_PROBE_QE,       // 等 QE 位写完
+    QSPI_PROBE_DONE,
+    QSPI_PROBE_FAILED
+} QSPI_ProbeTypeDef;
+
+typedef enum {
+    QSPI_WAIT_NONE = 0,
+    QSPI_WAIT_FLASH, // 自动轮询 WIP
+    QSPI_WAIT_DMA
+} QSPI_WaitTypeDef;
+
+static int8_t STORAGE_QSPI_Init(uint8_t lun);
+static int8_t STORAGE_QSPI_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size);
+static int8_t STORAGE_QSPI_IsReady(uint8_t lun);
+static int8_t STORAGE_QSPI_IsWriteProtected(uint8_t lun);
+static int8_t STORAGE_QSPI_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_QSPI_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_QSPI_GetMaxLun(void);
+static int8_t STORAGE_QSPI_Poll(uint8_t lun);
+static int8_t STORAGE_QSPI_Flush(uint8_t lun);
+
+static const int8_t STORAGE_QSPI_Inquirydata[STANDARD_INQUIRY_DATA_LEN] = {
+    0x00,
+    0x80,
+    0x02,
+    0x02,
+    (STANDARD_INQUIRY_DATA_LEN - 5),
+    0x00,
+    0x00,
+    0x00,
+    'S', 'T', 'M', ' ', ' ', ' ', ' ', ' ', /* Manufacturer : 8 bytes */
+    'Q', 'S', 'P', 'I', ' ', 'N', 'O', 'R', /* Product      : 16 Bytes */
+    ' ', 'F', 'l', 'a', 's', 'h', ' ', ' ',
+    '0', '.', '0', '1'                      /* Version      : 4 Bytes */
+};
+
+static const STORAGE_QSPI_ChipTypeDef qspi_default_chips[] = {
+    {0xEF4018U, "W25Q128", 24U, 0x6BU, 8U, 0x32U, 1U, STORAGE_QSPI_QE_SR2_BIT1},
+    {0xEF4017U, "W25Q64", 23U, 0x6BU, 8U, 0x32U, 1U, STORAGE_QSPI_QE_SR2_BIT1},
+    {0xEF4016U, "W25Q32", 22U, 0x6BU, 8U, 0x32U, 1U, STORAGE_QSPI_QE_SR2_BIT1},
+    {0xC84018U, "GD25Q128", 24U, 0x6BU, 8U, 0x32U, 1U, STORAGE_QSPI_QE_SR2_BIT1},
+    {0xC22018U, "MX25L128", 24U, 0x6BU, 8U, 0x02U, 0U, STORAGE_QSPI_QE_SR1_BIT6},
+    {0xC22017U, "MX25L64", 23U, 0x6BU, 8U, 0x02U, 0U, STORAGE_QSPI_QE_SR1_BIT6},
+    {0x9D6018U, "IS25LP128", 24U, 0x6BU, 8U, 0x32U, 1U, STORAGE_QSPI_QE_SR1_BIT6},
+};
+
+static const STORAGE_QSPI_ChipTypeDef *qspi_chips = qspi_default_chips;
+static uint32_t qspi_chip_nbr                     = sizeof(qspi_default_chips) / sizeof(qspi_default_chips[0]);
+static const STORAGE_QSPI_ChipTypeDef *qspi_chip  = NULL; // 探测完成后才设置
+
+static __IO QSPI_ProbeTypeDef qspi_probe          = QSPI_PROBE_NONE;
+static const STORAGE_QSPI_ChipTypeDef *qspi_found = NULL;
+static uint32_t qspi_probe_start                  = 0U;
+
+// 写回缓冲: 一个擦除扇区
+static uint32_t qspi_sec_buf[STORAGE_QSPI_SECTOR_SIZ / 4U];
+static uint8_t qspi_page_buf[STORAGE_QSPI_PAGE_SIZ];
+static uint32_t qspi_sector   = QSPI_NO_SECTOR;
+static uint8_t qspi_dirty     = 0U;
+static uint8_t qspi_commit    = 0U; // 提交进行中
+static uint16_t qspi_prog_mask = 0U; // 提交中还要编程的页
+
+// 当前请求
+static QSPI_OpTypeDef qspi_op     = QSPI_OP_NONE;
+static uint8_t *qspi_buf          = NULL;
+static uint32_t qspi_addr         = 0U;
+static uint32_t qspi_len          = 0U;
+static uint32_t qspi_start        = 0U;
+static QSPI_WaitTypeDef qspi_wait = QSPI_WAIT_NONE;
+static uint32_t qspi_wait_start   = 0U;
+static uint32_t qspi_dma_blocks   = 0U; // DMA 直接读进请求缓冲区的块, 0 表示在装载扇区缓冲
+
+static STORAGE_QSPI_StatsTypeDef qspi_stats;
+
+USBD_StorageTypeDef USBD_Storage_QSPI_fops = {
+    STORAGE_QSPI_Init,
+    STORAGE_QSPI_GetCapacity,
+    STORAGE_QSPI_IsReady,
+    STORAGE_QSPI_IsWriteProtected,
+    STORAGE_QSPI_Read,
+    STORAGE_QSPI_Write,
+    STORAGE_QSPI_GetMaxLun,
+    (int8_t *)STORAGE_QSPI_Inquirydata,
+    NULL,
+    NULL,
+    STORAGE_QSPI_Poll,
+    STORAGE_QSPI_Flush,
+    NULL
+};
+
+/**
+ * @brief Start a DMA read straight into dst, done when the DMA and QUADSPI both finished.
+ */
+static int8_t QSPI_StartDmaRead(uint32_t addr, uint8_t *dst, uint32_t len)
+{
+    if (QSPI_LL_StartDmaRead(addr, dst, len) != 0) {
+        return -1;
+    }
+
+    qspi_wait       = QSPI_WAIT_DMA;
+    qspi_wait_start = USBD_GetTick();
+    qspi_stats.rd_bytes += len;
+
+    return 0;
+}
+
+/**
+ * @brief Abort whatever is running, the dirty sector stays buffered for a retry.
+ */
+static int8_t QSPI_Fail(void)
+{
+    QSPI_LL_Abort();
+
+    if (qspi_wait == QSPI_WAIT_DMA) {
+        QSPI_LL_StopDma();
+
+        // 扇区缓冲没装载完
+        if (qspi_dma_blocks == 0U) {
+            qspi_sector = QSPI_NO_SECTOR;
+            qspi_dirty  = 0U;
+        }
+    }
+
+    qspi_wait       = QSPI_WAIT_NONE;
+    qspi_dma_blocks = 0U;
+    qspi_commit     = 0U;
+    qspi_prog_mask = 0U;
+    qspi_op        = QSPI_OP_NONE;
+    qspi_stats.errors++;
+
+    return -1;
+}
+
+/**
+ * @brief Compare the buffered sector with flash and start writing it back.
+ */
+static void QSPI_StartCommit(void)
+{
+    const uint8_t *sec = (const uint8_t *)qspi_sec_buf;
+    uint32_t base      = qspi_sector * STORAGE_QSPI_SECTOR_SIZ;
+    uint16_t mask      = 0U;
+    uint8_t erase      = 0U;
+    uint32_t p;
+    uint32_t i;
+
+    for (p = 0U; p < (STORAGE_QSPI_SECTOR_SIZ / STORAGE_QSPI_PAGE_SIZ); p++) {
+        QSPI_LL_Read(base + p * STORAGE_QSPI_PAGE_SIZ, qspi_page_buf, STORAGE_QSPI_PAGE_SIZ);
+
+        if (memcmp(qspi_page_buf, &sec[p * STORAGE_QSPI_PAGE_SIZ], STORAGE_QSPI_PAGE_SIZ) == 0) {
+            qspi_stats.pages_skipped++;
+            continue;
+        }
+
+        mask |= (uint16_t)(1U << p);
+
+        // 编程只能把 1 变成 0
+        for (i = 0U; (erase == 0U) && (i < STORAGE_QSPI_PAGE_SIZ); i++) {
+            if ((sec[p * STORAGE_QSPI_PAGE_SIZ + i] & ~qspi_page_buf[i]) != 0U) {
+                erase = 1U;
+            }
+        }
+    }
+
+    qspi_commit = 1U;
+    qspi_stats.commits++;
+
+    if (erase != 0U) {
+        mask = 0U;
+        for (p = 0U; p < (STORAGE_QSPI_SECTOR_SIZ / STORAGE_QSPI_PAGE_SIZ); p++) {
+            for (i = 0U; i < STORAGE_QSPI_PAGE_SIZ; i++) {
+                if (sec[p * STORAGE_QSPI_PAGE_SIZ + i] != 0xFFU) {
+                    mask |= (uint16_t)(1U << p);
+                    break;
+                }
+            }
+        }
+
+        QSPI_LL_Erase(base);
+        qspi_wait       = QSPI_WAIT_FLASH;
+        qspi_wait_start = USBD_GetTick();
+        qspi_stats.erases++;
+    }
+
+    qspi_prog_mask = mask;
+}
+
+static void QSPI_ProgramPage(uint32_t p)
+{
+    QSPI_LL_Program(qspi_sector * STORAGE_QSPI_SECTOR_SIZ + p * STORAGE_QSPI_PAGE_SIZ,
+                    &((const uint8_t *)qspi_sec_buf)[p * STORAGE_QSPI_PAGE_SIZ], STORAGE_QSPI_PAGE_SIZ);
+    qspi_wait       = QSPI_WAIT_FLASH;
+    qspi_wait_start = USBD_GetTick();
+    qspi_stats.pages++;
+}
+
+static void QSPI_Advance(uint32_t blocks)
+{
+    qspi_buf += blocks * STORAGE_QSPI_BLK_SIZ;
+    qspi_addr += blocks;
+    qspi_len -= blocks;
+}
+
+/**
+ * @brief Run the request until it has to wait for the chip or the DMA.
+ * @return 0 when done, MSC_MEDIA_BUSY while waiting, -1 on error
+ */
+static int8_t QSPI_Run(void)
+{
+    uint32_t blk_per_sec = STORAGE_QSPI_SECTOR_SIZ / STORAGE_QSPI_BLK_SIZ;
+    uint32_t sector;
+    uint32_t n;
+    uint32_t p;
+
+    for (;;) {
+        if (qspi_wait == QSPI_WAIT_FLASH) {
+            if (QSPI_LL_IsReady() == 0U) {
+                return ((USBD_GetTick() - qspi_wait_start) > STORAGE_QSPI_TIMEOUT_MS) ? QSPI_Fail() : MSC_MEDIA_BUSY;
+            }
+            qspi_wait = QSPI_WAIT_NONE;
+        } else if (qspi_wait == QSPI_WAIT_DMA) {
+            if (QSPI_LL_DmaDone() == 0U) {
+                return ((USBD_GetTick() - qspi_wait_start) > STORAGE_QSPI_TIMEOUT_MS) ? QSPI_Fail() : MSC_MEDIA_BUSY;
+            }
+            QSPI_LL_StopDma();
+            qspi_wait = QSPI_WAIT_NONE;
+            QSPI_Advance(qspi_dma_blocks);
+            qspi_dma_blocks = 0U;
+        }
+
+        // 先把提交做完
+        if (qspi_prog_mask != 0U) {
+            for (p = 0U; (qspi_prog_mask & (1U << p)) == 0U; p++) {
+            }
+            qspi_prog_mask &= (uint16_t)~(1U << p);
+            QSPI_ProgramPage(p);
+            continue;
+        }
+        if (qspi_commit != 0U) {
+            qspi_commit = 0U;
+            qspi_dirty  = 0U;
+        }
+
+        if ((qspi_op == QSPI_OP_FLUSH) && (qspi_dirty != 0U)) {
+            QSPI_StartCommit();
+            continue;
+        }
+
+        if ((qspi_op == QSPI_OP_FLUSH) || (qspi_len == 0U)) {
+            if (qspi_op == QSPI_OP_READ) {
+                qspi_stats.rd_ms += USBD_GetTick() - qspi_start;
+            } else {
+                qspi_stats.wr_ms += USBD_GetTick() - qspi_start;
+            }
+            qspi_op = QSPI_OP_NONE;
+            return 0;
+        }
+
+        sector = qspi_addr / blk_per_sec;
+
+        if (qspi_op == QSPI_OP_READ) {
+            // 扇区缓冲里的数据比 flash 新
+            if (sector == qspi_sector) {
+                memcpy(qspi_buf, &((const uint8_t *)qspi_sec_buf)[(qspi_addr % blk_per_sec) * STORAGE_QSPI_BLK_SIZ],
+                       STORAGE_QSPI_BLK_SIZ);
+                QSPI_Advance(1U);
+                continue;
+            }
+
+            for (n = 1U; (n < qspi_len) && (((qspi_addr + n) / blk_per_sec) != qspi_sector); n++) {
+            }
+            if (QSPI_StartDmaRead(qspi_addr * STORAGE_QSPI_BLK_SIZ, qspi_buf, n * STORAGE_QSPI_BLK_SIZ) != 0) {
+                return QSPI_Fail();
+            }
+            qspi_dma_blocks = n;
+            continue;
+        }
+
+        if (sector != qspi_sector) {
+            if (qspi_dirty != 0U) {
+                QSPI_StartCommit();
+                continue;
+            }
+
+            qspi_sector = sector;
+            if (QSPI_StartDmaRead(sector * STORAGE_QSPI_SECTOR_SIZ, (uint8_t *)qspi_sec_buf, STORAGE_QSPI_SECTOR_SIZ) != 0) {
+                qspi_sector = QSPI_NO_SECTOR;
+                return QSPI_Fail();
+            }
+            qspi_dma_blocks = 0U;
+            continue;
+        }
+
+        memcpy(&((uint8_t *)qspi_sec_buf)[(qspi_addr % blk_per_sec) * STORAGE_QSPI_BLK_SIZ], qspi_buf,
+               STORAGE_QSPI_BLK_SIZ);
+        qspi_dirty = 1U;
+        qspi_stats.wr_bytes += STORAGE_QSPI_BLK_SIZ;
+        QSPI_Advance(1U);
+    }
+}
+
+static int8_t QSPI_Start(QSPI_OpTypeDef op, uint8_t *buf, uint32_t blk_addr, uint32_t blk_len)
+{
+    if ((qspi_chip == NULL) || (qspi_op != QSPI_OP_NONE)) {
+        return -1;
+    }
+
+    qspi_op    = op;
+    qspi_buf   = buf;
+    qspi_addr  = blk_addr;
+    qspi_len   = blk_len;
+    qspi_start = USBD_GetTick();
+
+    return QSPI_Run();
+}
+
+/**
+ * @brief Set the quad enable bit if the chip needs it.
+ * @return 1 if the status register is being written, 0 if nothing to do
+ */
+static uint8_t QSPI_QuadEnable(const STORAGE_QSPI_ChipTypeDef *chip)
+{
+    uint8_t rd_cmd;
+    uint8_t wr_cmd;
+    uint8_t bit;
+    uint8_t sr;
+
+    if (chip->qe_method == STORAGE_QSPI_QE_SR2_BIT1) {
+        rd_cmd = QSPI_CMD_RDSR2;
+        wr_cmd = QSPI_CMD_WRSR2;
+        bit    = 0x02U;
+    } else if (chip->qe_method == STORAGE_QSPI_QE_SR1_BIT6) {
+        rd_cmd = QSPI_CMD_RDSR1;
+        wr_cmd = QSPI_CMD_WRSR1;
+        bit    = 0x40U;
+    } else {
+        return 0U;
+    }
+
+    QSPI_LL_ReadReg(rd_cmd, &sr, 1U);
+    if ((sr & bit) != 0U) {
+        return 0U;
+    }
+
+    sr |= bit;
+    QSPI_LL_WriteReg(QSPI_CMD_WREN, NULL, 0U);
+    QSPI_LL_WriteReg(wr_cmd, &sr, 1U);
+    QSPI_LL_StartWaitReady();
+
+    return 1U;
+}
+
+/**
+ * @brief Only schedule the probe: Init runs in the USB interrupt and the chip
+ * may still be busy, STORAGE_QSPI_Process talks to it from the main loop.
+ */
+static int8_t STORAGE_QSPI_Init(uint8_t lun)
+{
+    UNUSED(lun);
+
+    // 重新枚举时保留扇区缓冲, 正在探测的也不重来
+    if ((qspi_probe == QSPI_PROBE_NONE) || (qspi_probe == QSPI_PROBE_FAILED)) {
+        qspi_probe = QSPI_PROBE_START;
+    }
+
+    return (USBD_OK);
+}
+
+/**
+ * @brief Run the chip probe, call it from the main loop next to USBD_MSC_Process.
+ */
+void STORAGE_QSPI_Process(void)
+{
+    uint8_t id[3];
+    uint32_t jedec;
+    uint32_t i;
+
+    if (qspi_probe == QSPI_PROBE_START) {
+        qspi_found = NULL;
+
+        if (QSPI_LL_Init() != 0) {
+            qspi_probe = QSPI_PROBE_FAILED;
+            return;
+        }
+
+        QSPI_LL_ReadReg(QSPI_CMD_RDID, id, 3U);
+        jedec = ((uint32_t)id[0] << 16) | ((uint32_t)id[1] << 8) | id[2];
+
+        for (i = 0U; i < qspi_chip_nbr; i++) {
+            if (qspi_chips[i].jedec_id == jedec) {
+                qspi_found = &qspi_chips[i];
+                break;
+            }
+        }
+
+        if (qspi_found == NULL) {
+            qspi_probe = QSPI_PROBE_FAILED;
+            return;
+        }
+
+        QSPI_LL_SetChip(qspi_found);
+
+        if (QSPI_QuadEnable(qspi_found) != 0U) {
+            qspi_probe_start = USBD_GetTick();
+            qspi_probe       = QSPI_PROBE_QE;
+            return;
+        }
+    } else if (qspi_probe == QSPI_PROBE_QE) {
+        if (QSPI_LL_IsReady() == 0U) {
+            if ((USBD_GetTick() - qspi_probe_start) > STORAGE_QSPI_TIMEOUT_MS) {
+                QSPI_LL_Abort();
+                qspi_probe = QSPI_PROBE_FAILED;
+            }
+            return;
+        }
+    } else {
+        return;
+    }
+
+    // 最后才发布芯片, IsReady 从这里开始报告就绪
+    qspi_chip  = qspi_found;
+    qspi_probe = QSPI_PROBE_DONE;
+}
+
+static int8_t STORAGE_QSPI_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size)
+{
+    UNUSED(lun);
+    *block_num  = (qspi_chip != NULL) ? ((1UL << qspi_chip->size_log2) / STORAGE_QSPI_BLK_SIZ) : 0U;
+    *block_size = STORAGE_QSPI_BLK_SIZ;
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_QSPI_IsReady(uint8_t lun)
+{
+    UNUSED(lun);
+    return (qspi_chip != NULL) ? (USBD_OK) : -1;
+}
+
+static int8_t STORAGE_QSPI_IsWriteProtected(uint8_t lun)
+{
+    UNUSED(lun);
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_QSPI_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    UNUSED(lun);
+    return QSPI_Start(QSPI_OP_READ, buf, blk_addr, blk_len);
+}
+
+static int8_t STORAGE_QSPI_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    UNUSED(lun);
+    return QSPI_Start(QSPI_OP_WRITE, buf, blk_addr, blk_len);
+}
+
+static int8_t STORAGE_QSPI_GetMaxLun(void)
+{
+    return 0;
+}
+
+static int8_t STORAGE_QSPI_Poll(uint8_t lun)
+{
+    UNUSED(lun);
+    return (qspi_op != QSPI_OP_NONE) ? QSPI_Run() : 0;
+}
+
+/**
+ * @brief Write the buffered sector back, called on SYNCHRONIZE CACHE and when idle.
+ */
+static int8_t STORAGE_QSPI_Flush(uint8_t lun)
+{
+    UNUSED(lun);
+
+    if (qspi_dirty == 0U) {
+        return (USBD_OK);
+    }
+
+    return QSPI_Start(QSPI_OP_FLUSH, NULL, 0U, 0U);
+}
+
+void STORAGE_QSPI_SetChipTable(const STORAGE_QSPI_ChipTypeDef *table, uint32_t nbr)
+{
+    qspi_chips    = table;
+    qspi_chip_nbr = nbr;
+}
+
+/**
+ * @brief Return the detected chip, NULL if none matched the table.
+ */
+const STORAGE_QSPI_ChipTypeDef *STORAGE_QSPI_GetChip(void)
+{
+    return qspi_chip;
+}
+
+/**
+ * @brief Return the throughput and erase counters.
+ */
+STORAGE_QSPI_StatsTypeDef *STORAGE_QSPI_GetStats(void)
+{
+    return &qspi_stats;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file usbd_storage_qspi.h
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief External QUADSPI NOR flash disk backend for the MSC LUN table.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ */
+#ifndef USBD_STORAGE_QSPI_H
+#define USBD_STORAGE_QSPI_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "usbd_msc.h"
+
+// QUADSPI 时钟 = SYSCLK / (PRESCALER + 1), 170MHz 时约 42.5MHz
+#define STORAGE_QSPI_PRESCALER   3U
+#define STORAGE_QSPI_DMA         DMA2_Channel1
+
+// 常见 NOR 的擦除扇区和编程页
+#define STORAGE_QSPI_BLK_SIZ     0x200U
+#define STORAGE_QSPI_SECTOR_SIZ  0x1000U
+#define STORAGE_QSPI_PAGE_SIZ    0x100U
+
+// 擦除扇区最长等待时间
+#define STORAGE_QSPI_TIMEOUT_MS  3000U
+
+// 四线模式使能位的位置
+#define STORAGE_QSPI_QE_NONE     0U // 不需要设置, 或出厂已设置
+#define STORAGE_QSPI_QE_SR2_BIT1 1U // Winbond, GigaDevice: 0x35 读, 0x31 写
+#define STORAGE_QSPI_QE_SR1_BIT6 2U // Macronix, ISSI: 0x05 读, 0x01 写
+
+typedef struct {
+    uint32_t jedec_id;   // 0x9F 读出的三个字节: 厂商, 类型, 容量
+    const char *name;
+    uint8_t size_log2;   // 容量 = 2^size_log2 字节, 最大 24 (3 字节地址)
+    uint8_t read_cmd;    // 1-1-4 快速读命令
+    uint8_t read_dummy;  // 快速读的空周期
+    uint8_t prog_cmd;    // 页编程命令
+    uint8_t prog_quad;   // 1: 页编程数据用四线 (1-1-4)
+    uint8_t qe_method;   // STORAGE_QSPI_QE_xxx
+} STORAGE_QSPI_ChipTypeDef;
+
+typedef struct {
+    uint32_t rd_bytes;      // 从 flash 读出的字节, 不含扇区缓冲命中
+    uint32_t rd_ms;         // 读请求耗时
+    uint32_t wr_bytes;      // 主机写入的字节
+    uint32_t wr_ms;         // 写请求耗时, 含扇区提交
+    uint32_t commits;       // 提交的扇区
+    uint32_t erases;        // 擦除的扇区, 只清零位的提交不擦除
+    uint32_t pages;         // 编程的页
+    uint32_t pages_skipped; // 内容没变, 跳过的页
+    uint32_t errors;        // 超时或 DMA 错误
+} STORAGE_QSPI_StatsTypeDef;
+
+extern USBD_StorageTypeDef USBD_Storage_QSPI_fops;
+
+// 替换内置的芯片表, 要在 USB 初始化之前调用
+void STORAGE_QSPI_SetChipTable(const STORAGE_QSPI_ChipTypeDef *table, uint32_t nbr);
+const STORAGE_QSPI_ChipTypeDef *STORAGE_QSPI_GetChip(void);
+STORAGE_QSPI_StatsTypeDef *STORAGE_QSPI_GetStats(void);
+
+// 在主循环里和 USBD_MSC_Process 一起调用, 完成芯片探测前 LUN 报告 NOT READY
+void STORAGE_QSPI_Process(void);
+
+// 时钟和引脚, 默认 PE10 CLK, PE11 NCS, PE12..PE15 IO0..IO3
+void STORAGE_QSPI_MspInit(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //! USBD_STORAGE_QSPI_H
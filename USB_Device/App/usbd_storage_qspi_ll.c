@@ -0,0 +1,232 @@
+/**
+ * @file usbd_storage_qspi_ll.c
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief QUADSPI register layer under the QSPI NOR disk backend.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ * 直接操作 QUADSPI 寄存器 (工程里没有 HAL QSPI 驱动), 间接模式.
+ */
+#include "usbd_storage_qspi_ll.h"
+
+#define QSPI_CCR_INSTR(c) ((uint32_t)(c) | QUADSPI_CCR_IMODE_0)
+#define QSPI_CCR_ADDR     (QUADSPI_CCR_ADMODE_0 | QUADSPI_CCR_ADSIZE_1)
+#define QSPI_CCR_DATA1    QUADSPI_CCR_DMODE_0
+#define QSPI_CCR_DATA4    (QUADSPI_CCR_DMODE_0 | QUADSPI_CCR_DMODE_1)
+#define QSPI_CCR_READ     QUADSPI_CCR_FMODE_0
+#define QSPI_CCR_POLL     QUADSPI_CCR_FMODE_1
+
+static DMA_HandleTypeDef qspi_hdma;
+static const STORAGE_QSPI_ChipTypeDef *qspi_ll_chip = NULL;
+
+/**
+ * @brief Start an indirect command once the previous one is over.
+ */
+static void QSPI_Command(uint32_t ccr, uint32_t addr, uint32_t len)
+{
+    while ((QUADSPI->SR & QUADSPI_SR_BUSY) != 0U) {
+    }
+
+    QUADSPI->FCR = QUADSPI_FCR_CTCF | QUADSPI_FCR_CSMF | QUADSPI_FCR_CTEF;
+
+    if (len != 0U) {
+        QUADSPI->DLR = len - 1U;
+    }
+    QUADSPI->CCR = ccr;
+
+    if ((ccr & QUADSPI_CCR_ADMODE) != 0U) {
+        QUADSPI->AR = addr;
+    }
+}
+
+static void QSPI_WaitTransfer(void)
+{
+    while ((QUADSPI->SR & QUADSPI_SR_TCF) == 0U) {
+    }
+    QUADSPI->FCR = QUADSPI_FCR_CTCF;
+}
+
+/**
+ * @brief Short read through the FIFO: ID, status registers, page compare.
+ */
+static void QSPI_ReadPoll(uint32_t ccr, uint32_t addr, uint8_t *dst, uint32_t len)
+{
+    uint32_t i;
+
+    QSPI_Command(ccr | QSPI_CCR_READ, addr, len);
+
+    for (i = 0U; i < len; i++) {
+        while ((QUADSPI->SR & QUADSPI_SR_FLEVEL) == 0U) {
+        }
+        dst[i] = *(__IO uint8_t *)&QUADSPI->DR;
+    }
+
+    QSPI_WaitTransfer();
+}
+
+/**
+ * @brief Instruction with optional address and data written through the FIFO.
+ */
+static void QSPI_WritePoll(uint32_t ccr, uint32_t addr, const uint8_t *src, uint32_t len)
+{
+    uint32_t i;
+
+    QSPI_Command(ccr, addr, len);
+
+    for (i = 0U; i < len; i++) {
+        while ((QUADSPI->SR & QUADSPI_SR_FTF) == 0U) {
+        }
+        *(__IO uint8_t *)&QUADSPI->DR = src[i];
+    }
+
+    QSPI_WaitTransfer();
+}
+
+static uint32_t QSPI_ReadCcr(void)
+{
+    return QSPI_CCR_INSTR(qspi_ll_chip->read_cmd) | QSPI_CCR_ADDR | QSPI_CCR_DATA4 |
+           ((uint32_t)qspi_ll_chip->read_dummy << QUADSPI_CCR_DCYC_Pos);
+}
+
+int8_t QSPI_LL_Init(void)
+{
+    STORAGE_QSPI_MspInit();
+
+    qspi_hdma.Instance                 = STORAGE_QSPI_DMA;
+    qspi_hdma.Init.Request             = DMA_REQUEST_QUADSPI;
+    qspi_hdma.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+    qspi_hdma.Init.PeriphInc           = DMA_PINC_DISABLE;
+    qspi_hdma.Init.MemInc              = DMA_MINC_ENABLE;
+    qspi_hdma.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    qspi_hdma.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    qspi_hdma.Init.Mode                = DMA_NORMAL;
+    qspi_hdma.Init.Priority            = DMA_PRIORITY_HIGH;
+    if (HAL_DMA_Init(&qspi_hdma) != HAL_OK) {
+        return -1;
+    }
+
+    // 先按最大容量配置, 识别芯片后再改
+    QUADSPI->CR  = 0U;
+    QUADSPI->DCR = (23U << QUADSPI_DCR_FSIZE_Pos) | QUADSPI_DCR_CSHT_0;
+    QUADSPI->CR  = (STORAGE_QSPI_PRESCALER << QUADSPI_CR_PRESCALER_Pos) | QUADSPI_CR_EN;
+
+    return 0;
+}
+
+void QSPI_LL_SetChip(const STORAGE_QSPI_ChipTypeDef *chip)
+{
+    qspi_ll_chip = chip;
+    QUADSPI->DCR = ((uint32_t)(chip->size_log2 - 1U) << QUADSPI_DCR_FSIZE_Pos) | QUADSPI_DCR_CSHT_0;
+}
+
+void QSPI_LL_ReadReg(uint8_t cmd, uint8_t *dst, uint32_t len)
+{
+    QSPI_ReadPoll(QSPI_CCR_INSTR(cmd) | QSPI_CCR_DATA1, 0U, dst, len);
+}
+
+void QSPI_LL_WriteReg(uint8_t cmd, const uint8_t *src, uint32_t len)
+{
+    QSPI_WritePoll(QSPI_CCR_INSTR(cmd) | ((len != 0U) ? QSPI_CCR_DATA1 : 0U), 0U, src, len);
+}
+
+void QSPI_LL_Read(uint32_t addr, uint8_t *dst, uint32_t len)
+{
+    QSPI_ReadPoll(QSPI_ReadCcr(), addr, dst, len);
+}
+
+void QSPI_LL_Program(uint32_t addr, const uint8_t *src, uint32_t len)
+{
+    uint32_t ccr = QSPI_CCR_INSTR(qspi_ll_chip->prog_cmd) | QSPI_CCR_ADDR |
+                   ((qspi_ll_chip->prog_quad != 0U) ? QSPI_CCR_DATA4 : QSPI_CCR_DATA1);
+
+    QSPI_LL_WriteReg(QSPI_CMD_WREN, NULL, 0U);
+    QSPI_WritePoll(ccr, addr, src, len);
+    QSPI_LL_StartWaitReady();
+}
+
+void QSPI_LL_Erase(uint32_t addr)
+{
+    QSPI_LL_WriteReg(QSPI_CMD_WREN, NULL, 0U);
+    QSPI_WritePoll(QSPI_CCR_INSTR(QSPI_CMD_SE) | QSPI_CCR_ADDR, addr, NULL, 0U);
+    QSPI_LL_StartWaitReady();
+}
+
+/**
+ * @brief Let the controller poll WIP until the chip is ready, SMF is set then.
+ */
+void QSPI_LL_StartWaitReady(void)
+{
+    QUADSPI->PSMKR = 0x01U;
+    QUADSPI->PSMAR = 0x00U;
+    QUADSPI->PIR   = 0x10U;
+    QUADSPI->CR |= QUADSPI_CR_APMS;
+
+    QSPI_Command(QSPI_CCR_POLL | QSPI_CCR_INSTR(QSPI_CMD_RDSR1) | QSPI_CCR_DATA1, 0U, 1U);
+}
+
+uint8_t QSPI_LL_IsReady(void)
+{
+    if ((QUADSPI->SR & QUADSPI_SR_SMF) == 0U) {
+        return 0U;
+    }
+
+    QUADSPI->FCR = QUADSPI_FCR_CSMF;
+    return 1U;
+}
+
+/**
+ * @brief Start a DMA read straight into dst.
+ */
+int8_t QSPI_LL_StartDmaRead(uint32_t addr, uint8_t *dst, uint32_t len)
+{
+    if (HAL_DMA_Start(&qspi_hdma, (uint32_t)&QUADSPI->DR, (uint32_t)dst, len) != HAL_OK) {
+        return -1;
+    }
+
+    QUADSPI->CR |= QUADSPI_CR_DMAEN;
+    QSPI_Command(QSPI_ReadCcr() | QSPI_CCR_READ, addr, len);
+
+    return 0;
+}
+
+uint8_t QSPI_LL_DmaDone(void)
+{
+    return (((QUADSPI->SR & QUADSPI_SR_TCF) != 0U) && (__HAL_DMA_GET_COUNTER(&qspi_hdma) == 0U)) ? 1U : 0U;
+}
+
+void QSPI_LL_StopDma(void)
+{
+    (void)HAL_DMA_Abort(&qspi_hdma);
+    QUADSPI->CR &= ~QUADSPI_CR_DMAEN;
+    QUADSPI->FCR = QUADSPI_FCR_CTCF;
+}
+
+void QSPI_LL_Abort(void)
+{
+    QUADSPI->CR |= QUADSPI_CR_ABORT;
+    while ((QUADSPI->CR & QUADSPI_CR_ABORT) != 0U) {
+    }
+}
+
+/**
+ * @brief Default clocks and pins, override it for another board.
+ */
+__weak void STORAGE_QSPI_MspInit(void)
+{
+    GPIO_InitTypeDef gpio = {0};
+
+    __HAL_RCC_QSPI_CLK_ENABLE();
+    __HAL_RCC_DMAMUX1_CLK_ENABLE();
+    __HAL_RCC_DMA2_CLK_ENABLE();
+    __HAL_RCC_GPIOE_CLK_ENABLE();
+
+    gpio.Pin       = GPIO_PIN_10 | GPIO_PIN_11 | GPIO_PIN_12 | GPIO_PIN_13 | GPIO_PIN_14 | GPIO_PIN_15;
+    gpio.Mode      = GPIO_MODE_AF_PP;
+    gpio.Pull      = GPIO_NOPULL;
+    gpio.Speed     = GPIO_SPEED_FREQ_VERY_HIGH;
+    gpio.Alternate = GPIO_AF10_QUADSPI;
+    HAL_GPIO_Init(GPIOE, &gpio);
+}
@@ -0,0 +1,62 @@
+/**
+ * @file usbd_storage_qspi_ll.h
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief QUADSPI register layer under the QSPI NOR disk backend.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ * usbd_storage_qspi.c 只通过这里访问芯片, Tests/host 用 flash 模型替换这一层.
+ * 除 Read 和寄存器读写 (几个字节到一页, 微秒级) 外都不等待:
+ * 擦除和编程之后用 IsReady 查询, DMA 读用 DmaDone 查询.
+ */
+#ifndef USBD_STORAGE_QSPI_LL_H
+#define USBD_STORAGE_QSPI_LL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "usbd_storage_qspi.h"
+
+#define QSPI_CMD_WREN   0x06U
+#define QSPI_CMD_RDSR1  0x05U
+#define QSPI_CMD_WRSR1  0x01U
+#define QSPI_CMD_RDSR2  0x35U
+#define QSPI_CMD_WRSR2  0x31U
+#define QSPI_CMD_RDID   0x9FU
+#define QSPI_CMD_SE     0x20U
+
+// 时钟, 引脚, DMA, 控制器按 16MB 配置, 识别芯片前就能读 ID
+int8_t QSPI_LL_Init(void);
+// 按识别出的芯片设置容量和读写命令
+void QSPI_LL_SetChip(const STORAGE_QSPI_ChipTypeDef *chip);
+
+// 单线的寄存器命令: ID, 状态寄存器, 写使能
+void QSPI_LL_ReadReg(uint8_t cmd, uint8_t *dst, uint32_t len);
+void QSPI_LL_WriteReg(uint8_t cmd, const uint8_t *src, uint32_t len);
+
+// 四线快速读, 经 FIFO, 用于提交前逐页比较
+void QSPI_LL_Read(uint32_t addr, uint8_t *dst, uint32_t len);
+// 写使能后编程一页或擦除一个扇区, 然后开始自动轮询 WIP
+void QSPI_LL_Program(uint32_t addr, const uint8_t *src, uint32_t len);
+void QSPI_LL_Erase(uint32_t addr);
+
+void QSPI_LL_StartWaitReady(void);
+// 1: 自动轮询看到 WIP 清零
+uint8_t QSPI_LL_IsReady(void);
+
+int8_t QSPI_LL_StartDmaRead(uint32_t addr, uint8_t *dst, uint32_t len);
+// 1: DMA 和 QUADSPI 都传完了
+uint8_t QSPI_LL_DmaDone(void);
+void QSPI_LL_StopDma(void);
+
+// 中止正在执行的命令
+void QSPI_LL_Abort(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //! USBD_STORAGE_QSPI_LL_H
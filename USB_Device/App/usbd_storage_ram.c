@@ -0,0 +1,605 @@
+/**
+ * @file usbd_storage_ram.c
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Sparse RAM scratch disk backend for the MSC LUN table.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ * 日志半区布局 (STORAGE_RAM_JNL_HALF):
+ *   双字 0: {magic, 代数}, 半区写完整个盘之后最后编程, 代数大的半区有效
+ *   然后是记录: 8 字节记录头 {lba, 类型, 校验}, DATA 记录后面跟扇区数据.
+ *   先编程数据再编程记录头, 记录头不对就是断电时写了一半.
+ * 每次 Flush 先写变成全零的扇区, 再写有数据的扇区, 最后一个 COMMIT 记录;
+ * 上电时只重放到最后一个 COMMIT, 一批改动要么全部恢复要么全部丢弃.
+ */
+#include "usbd_storage_ram.h"
+#include "usbd_storage_flash.h"
+
+#if (STORAGE_RAM_JNL_ADDR < (STORAGE_FLASH_ADDR + STORAGE_FLASH_SIZE)) || \
+    ((STORAGE_RAM_JNL_ADDR + STORAGE_RAM_JNL_SIZE) > (STORAGE_RAM_JNL_BANK_ADDR + 0x40000U))
+#error "STORAGE_RAM: journal overlaps the flash LUN or leaves the bank"
+#endif
+
+#if ((STORAGE_RAM_JNL_ADDR % FLASH_PAGE_SIZE) != 0U) || ((STORAGE_RAM_JNL_HALF % FLASH_PAGE_SIZE) != 0U)
+#error "STORAGE_RAM: journal halves must be whole pages"
+#endif
+
+#if (16U + STORAGE_RAM_POOL_NBR * (8U + STORAGE_RAM_BLK_SIZ)) > STORAGE_RAM_JNL_HALF
+#error "STORAGE_RAM: a journal half cannot hold the whole pool"
+#endif
+
+static int8_t STORAGE_RAM_Init(uint8_t lun);
+static int8_t STORAGE_RAM_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size);
+static int8_t STORAGE_RAM_IsReady(uint8_t lun);
+static int8_t STORAGE_RAM_IsWriteProtected(uint8_t lun);
+static int8_t STORAGE_RAM_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_RAM_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_RAM_GetMaxLun(void);
+static uint8_t *STORAGE_RAM_GetReadAddr(uint8_t lun, uint32_t blk_addr, uint16_t blk_len);
+static uint8_t *STORAGE_RAM_GetWriteAddr(uint8_t lun, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_RAM_Flush(uint8_t lun);
+static int8_t STORAGE_RAM_Unmap(uint8_t lun, uint32_t blk_addr, uint32_t blk_len);
+
+static void RAM_JnlMount(void);
+
+static const int8_t STORAGE_RAM_Inquirydata[STANDARD_INQUIRY_DATA_LEN] = {
+    0x00,
+    0x80,
+    0x02,
+    0x02,
+    (STANDARD_INQUIRY_DATA_LEN - 5),
+    0x00,
+    0x00,
+    0x00,
+    'S', 'T', 'M', ' ', ' ', ' ', ' ', ' ', /* Manufacturer : 8 bytes */
+    'R', 'A', 'M', ' ', 'D', 'i', 's', 'k', /* Product      : 16 Bytes */
+    ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ',
+    '0', '.', '0', '1'                      /* Version      : 4 Bytes */
+};
+
+#define RAM_NO_BLK 0xFFU
+
+#define RAM_JNL_MAGIC  0x4C4E4A52U // "RJNL"
+#define RAM_JNL_DATA   1U
+#define RAM_JNL_ZERO   2U
+#define RAM_JNL_COMMIT 3U
+#define RAM_JNL_REC    (8U + STORAGE_RAM_BLK_SIZ)
+
+#define RAM_JNL_HALF_ADDR(half) (STORAGE_RAM_JNL_ADDR + (uint32_t)(half) * STORAGE_RAM_JNL_HALF)
+#define RAM_IS_DIRTY(blk)       ((ram_dirty[(blk) / 8U] & (1U << ((blk) % 8U))) != 0U)
+
+typedef struct {
+    uint16_t lba;
+    uint16_t type;
+    uint32_t check; // ~((type << 16) | lba)
+} RAM_JnlRecTypeDef;
+
+// 按字对齐, 方便逐字检查全零
+static uint32_t ram_pool[STORAGE_RAM_POOL_NBR][STORAGE_RAM_BLK_SIZ / 4U];
+static const uint32_t ram_zero[STORAGE_RAM_BLK_SIZ / 4U] = {0};
+static uint8_t ram_map[STORAGE_RAM_BLK_NBR];   // 扇区 -> 池块, RAM_NO_BLK 表示读出全零
+static uint8_t ram_free[STORAGE_RAM_POOL_NBR]; // 空闲池块栈
+static uint8_t ram_free_nbr = 0U;
+static uint8_t ram_ready = 0U;
+
+// 上次 Flush 之后改过的扇区
+static uint8_t ram_dirty[(STORAGE_RAM_BLK_NBR + 7U) / 8U];
+static uint8_t ram_jnl_half = 1U;
+static uint32_t ram_jnl_gen = 0U;
+static uint32_t ram_jnl_off = STORAGE_RAM_JNL_HALF; // 写满表示下次 Flush 要压缩
+
+static STORAGE_RAM_StatsTypeDef ram_stats;
+
+USBD_StorageTypeDef USBD_Storage_RAM_fops = {
+    STORAGE_RAM_Init,
+    STORAGE_RAM_GetCapacity,
+    STORAGE_RAM_IsReady,
+    STORAGE_RAM_IsWriteProtected,
+    STORAGE_RAM_Read,
+    STORAGE_RAM_Write,
+    STORAGE_RAM_GetMaxLun,
+    (int8_t *)STORAGE_RAM_Inquirydata,
+    STORAGE_RAM_GetReadAddr,
+    STORAGE_RAM_GetWriteAddr,
+    NULL,
+    STORAGE_RAM_Flush,
+    STORAGE_RAM_Unmap
+};
+
+static int8_t STORAGE_RAM_Init(uint8_t lun)
+{
+    uint32_t i;
+
+    UNUSED(lun);
+
+    // 重新枚举时保留盘里的数据
+    if (ram_ready == 0U) {
+        for (i = 0U; i < STORAGE_RAM_BLK_NBR; i++) {
+            ram_map[i] = RAM_NO_BLK;
+        }
+        for (i = 0U; i < STORAGE_RAM_POOL_NBR; i++) {
+            ram_free[i] = (uint8_t)(STORAGE_RAM_POOL_NBR - 1U - i);
+        }
+        ram_free_nbr = STORAGE_RAM_POOL_NBR;
+        ram_ready    = 1U;
+
+        RAM_JnlMount();
+    }
+
+    return (USBD_OK);
+}
+
+/**
+ * @brief Check a block for zeros, a word at a time when the buffer allows it.
+ */
+static uint8_t RAM_IsZero(const uint8_t *buf)
+{
+    const uint32_t *word = (const uint32_t *)buf;
+    uint32_t i;
+
+    if (((uint32_t)buf & 3U) == 0U) {
+        for (i = 0U; i < (STORAGE_RAM_BLK_SIZ / 4U); i++) {
+            if (word[i] != 0U) {
+                return 0U;
+            }
+        }
+    } else {
+        for (i = 0U; i < STORAGE_RAM_BLK_SIZ; i++) {
+            if (buf[i] != 0U) {
+                return 0U;
+            }
+        }
+    }
+
+    return 1U;
+}
+
+/**
+ * @brief Take a block from the pool for a sector, if it has none yet.
+ * @return 0 on success, -1 if the pool is exhausted
+ */
+static int8_t RAM_Alloc(uint32_t blk_addr)
+{
+    if (ram_map[blk_addr] != RAM_NO_BLK) {
+        return 0;
+    }
+
+    if (ram_free_nbr == 0U) {
+        ram_stats.pool_full++;
+        return -1;
+    }
+
+    ram_map[blk_addr] = ram_free[--ram_free_nbr];
+    ram_stats.allocated++;
+    return 0;
+}
+
+/**
+ * @brief Give the block of a sector back to the pool, it reads back as zeros.
+ */
+static void RAM_Release(uint32_t blk_addr)
+{
+    if (ram_map[blk_addr] != RAM_NO_BLK) {
+        ram_free[ram_free_nbr++] = ram_map[blk_addr];
+        ram_map[blk_addr]        = RAM_NO_BLK;
+        ram_stats.allocated--;
+    }
+}
+
+static int8_t STORAGE_RAM_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size)
+{
+    UNUSED(lun);
+    *block_num  = STORAGE_RAM_BLK_NBR;
+    *block_size = STORAGE_RAM_BLK_SIZ;
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_RAM_IsReady(uint8_t lun)
+{
+    UNUSED(lun);
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_RAM_IsWriteProtected(uint8_t lun)
+{
+    UNUSED(lun);
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_RAM_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    uint32_t i;
+
+    UNUSED(lun);
+
+    for (i = 0U; i < blk_len; i++, buf += STORAGE_RAM_BLK_SIZ) {
+        if (ram_map[blk_addr + i] == RAM_NO_BLK) {
+            memset(buf, 0, STORAGE_RAM_BLK_SIZ);
+        } else if (buf != (uint8_t *)ram_pool[ram_map[blk_addr + i]]) {
+            memcpy(buf, ram_pool[ram_map[blk_addr + i]], STORAGE_RAM_BLK_SIZ);
+        }
+    }
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_RAM_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    uint32_t i;
+
+    UNUSED(lun);
+
+    for (i = 0U; i < blk_len; i++, buf += STORAGE_RAM_BLK_SIZ) {
+        ram_dirty[(blk_addr + i) / 8U] |= (uint8_t)(1U << ((blk_addr + i) % 8U));
+
+        // 全零扇区不占池块, 包括零拷贝时已经写进池块的
+        if (RAM_IsZero(buf) != 0U) {
+            RAM_Release(blk_addr + i);
+            ram_stats.zero_writes++;
+            continue;
+        }
+
+        if (RAM_Alloc(blk_addr + i) != 0) {
+            return -1;
+        }
+
+        /* Zero-copy OUT transfers already landed in the pool */
+        if (buf != (uint8_t *)ram_pool[ram_map[blk_addr + i]]) {
+            memcpy(ram_pool[ram_map[blk_addr + i]], buf, STORAGE_RAM_BLK_SIZ);
+        }
+    }
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_RAM_GetMaxLun(void)
+{
+    return 0;
+}
+
+/**
+ * @brief Check that the blocks of a range follow each other in the pool.
+ * @return Pointer to the first one, NULL if they are scattered or unallocated
+ */
+static uint8_t *RAM_Contiguous(uint32_t blk_addr, uint16_t blk_len)
+{
+    uint32_t i;
+
+    for (i = 0U; i < blk_len; i++) {
+        if ((ram_map[blk_addr + i] == RAM_NO_BLK) ||
+            (ram_map[blk_addr + i] != (uint8_t)(ram_map[blk_addr] + i))) {
+            return NULL;
+        }
+    }
+
+    return (uint8_t *)ram_pool[ram_map[blk_addr]];
+}
+
+/**
+ * @brief Direct address of blocks in the RAM disk, used for zero-copy IN transfers.
+ *        A single unallocated sector is sent from a shared block of zeros.
+ * @return Pointer into the pool, NULL if the range cannot be mapped in one piece
+ */
+static uint8_t *STORAGE_RAM_GetReadAddr(uint8_t lun, uint32_t blk_addr, uint16_t blk_len)
+{
+    UNUSED(lun);
+
+    if ((blk_len == 0U) || (blk_addr >= STORAGE_RAM_BLK_NBR) ||
+        (blk_len > (STORAGE_RAM_BLK_NBR - blk_addr))) {
+        return NULL;
+    }
+
+    if ((blk_len == 1U) && (ram_map[blk_addr] == RAM_NO_BLK)) {
+        return (uint8_t *)ram_zero;
+    }
+
+    return RAM_Contiguous(blk_addr, blk_len);
+}
+
+/**
+ * @brief Direct address of blocks in the RAM disk, used for zero-copy OUT transfers.
+ *        A single sector gets its pool block here, STORAGE_RAM_Write gives it
+ *        back if the host wrote zeros.
+ * @return Pointer into the pool, NULL if the range cannot be mapped in one piece
+ */
+static uint8_t *STORAGE_RAM_GetWriteAddr(uint8_t lun, uint32_t blk_addr, uint16_t blk_len)
+{
+    UNUSED(lun);
+
+    if ((blk_len == 0U) || (blk_addr >= STORAGE_RAM_BLK_NBR) ||
+        (blk_len > (STORAGE_RAM_BLK_NBR - blk_addr))) {
+        return NULL;
+    }
+
+    if ((blk_len == 1U) && (RAM_Alloc(blk_addr) != 0)) {
+        return NULL;
+    }
+
+    return RAM_Contiguous(blk_addr, blk_len);
+}
+
+/**
+ * @brief Free the pool blocks of the sectors, they read back as zeros.
+ */
+static int8_t STORAGE_RAM_Unmap(uint8_t lun, uint32_t blk_addr, uint32_t blk_len)
+{
+    uint32_t i;
+
+    UNUSED(lun);
+
+    for (i = 0U; i < blk_len; i++) {
+        RAM_Release(blk_addr + i);
+        ram_dirty[(blk_addr + i) / 8U] |= (uint8_t)(1U << ((blk_addr + i) % 8U));
+    }
+
+    return (USBD_OK);
+}
+
+/**
+ * @brief Program len bytes (a multiple of 8) one doubleword at a time.
+ */
+static int8_t RAM_JnlProgram(uint32_t addr, const uint8_t *data, uint32_t len)
+{
+    uint64_t dw;
+    uint32_t i;
+    int8_t ret = 0;
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+
+    for (i = 0U; (ret == 0) && (i < len); i += sizeof(uint64_t)) {
+        memcpy(&dw, data + i, sizeof(uint64_t));
+
+        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, addr + i, dw) != HAL_OK) {
+            ret = -1;
+        }
+    }
+
+    HAL_FLASH_Lock();
+
+    return ret;
+}
+
+static uint8_t RAM_JnlIsErased(uint32_t addr, uint32_t len)
+{
+    const uint32_t *p = (const uint32_t *)addr;
+    uint32_t i;
+
+    for (i = 0U; i < len / sizeof(uint32_t); i++) {
+        if (p[i] != 0xFFFFFFFFU) {
+            return 0U;
+        }
+    }
+
+    return 1U;
+}
+
+/**
+ * @brief Append a record at *off of the half at base: data first, then the header.
+ * @return 0 on success, -1 on a flash error
+ */
+static int8_t RAM_JnlAppend(uint32_t base, uint32_t *off, uint16_t lba, uint16_t type, const uint8_t *data)
+{
+    RAM_JnlRecTypeDef rec;
+
+    rec.lba   = lba;
+    rec.type  = type;
+    rec.check = ~(((uint32_t)type << 16) | lba);
+
+    if ((type == RAM_JNL_DATA) && (RAM_JnlProgram(base + *off + 8U, data, STORAGE_RAM_BLK_SIZ) != 0)) {
+        return -1;
+    }
+
+    if (RAM_JnlProgram(base + *off, (const uint8_t *)&rec, sizeof(rec)) != 0) {
+        return -1;
+    }
+
+    *off += (type == RAM_JNL_DATA) ? RAM_JNL_REC : 8U;
+    if (type != RAM_JNL_COMMIT) {
+        ram_stats.journaled++;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Walk the records of a half, applying those below apply_end to the disk.
+ * @param end Offset after the last well-formed record
+ * @return Offset after the last COMMIT record
+ */
+static uint32_t RAM_JnlScan(uint8_t half, uint32_t apply_end, uint32_t *end)
+{
+    uint32_t base      = RAM_JNL_HALF_ADDR(half);
+    uint32_t off       = 8U;
+    uint32_t committed = 8U;
+    RAM_JnlRecTypeDef rec;
+
+    while ((off + 8U) <= STORAGE_RAM_JNL_HALF) {
+        memcpy(&rec, (const void *)(base + off), sizeof(rec));
+
+        if ((rec.check != ~(((uint32_t)rec.type << 16) | rec.lba)) ||
+            (rec.type < RAM_JNL_DATA) || (rec.type > RAM_JNL_COMMIT) ||
+            ((rec.type != RAM_JNL_COMMIT) && (rec.lba >= STORAGE_RAM_BLK_NBR)) ||
+            ((rec.type == RAM_JNL_DATA) && ((off + RAM_JNL_REC) > STORAGE_RAM_JNL_HALF))) {
+            break;
+        }
+
+        if (off < apply_end) {
+            if (rec.type == RAM_JNL_ZERO) {
+                RAM_Release(rec.lba);
+            } else if ((rec.type == RAM_JNL_DATA) && (RAM_Alloc(rec.lba) == 0)) {
+                memcpy(ram_pool[ram_map[rec.lba]], (const void *)(base + off + 8U), STORAGE_RAM_BLK_SIZ);
+                ram_stats.replayed++;
+            }
+        }
+
+        off += (rec.type == RAM_JNL_DATA) ? RAM_JNL_REC : 8U;
+
+        if (rec.type == RAM_JNL_COMMIT) {
+            committed = off;
+        }
+    }
+
+    *end = off;
+    return committed;
+}
+
+/**
+ * @brief Restore the disk from the newest complete half of the journal.
+ */
+static void RAM_JnlMount(void)
+{
+    uint32_t head[2];
+    uint32_t committed;
+    uint32_t end;
+    uint8_t found = 0U;
+    uint8_t half;
+
+    for (half = 0U; half < 2U; half++) {
+        memcpy(head, (const void *)RAM_JNL_HALF_ADDR(half), sizeof(head));
+
+        if ((head[0] == RAM_JNL_MAGIC) && ((found == 0U) || (head[1] > ram_jnl_gen))) {
+            ram_jnl_half = half;
+            ram_jnl_gen  = head[1];
+            found        = 1U;
+        }
+    }
+
+    // 没有日志: 第一次 Flush 压缩到半区 0
+    if (found == 0U) {
+        ram_jnl_half = 1U;
+        ram_jnl_off  = STORAGE_RAM_JNL_HALF;
+        return;
+    }
+
+    committed = RAM_JnlScan(ram_jnl_half, 0U, &end);
+    (void)RAM_JnlScan(ram_jnl_half, committed, &end);
+
+    // 末尾有没提交的记录或写了一半的记录, 不能接着追加
+    if ((end == committed) &&
+        (RAM_JnlIsErased(RAM_JNL_HALF_ADDR(ram_jnl_half) + end, MIN(RAM_JNL_REC, STORAGE_RAM_JNL_HALF - end)) != 0U)) {
+        ram_jnl_off = end;
+    } else {
+        ram_jnl_off = STORAGE_RAM_JNL_HALF;
+    }
+}
+
+/**
+ * @brief Write the whole disk to the other half, then make it the valid one.
+ * @return 0 on success, -1 on a flash error, the old half stays valid then
+ */
+static int8_t RAM_JnlCompact(void)
+{
+    FLASH_EraseInitTypeDef erase;
+    uint32_t page_error = 0U;
+    uint8_t half        = ram_jnl_half ^ 1U;
+    uint32_t base       = RAM_JNL_HALF_ADDR(half);
+    uint32_t off        = 8U;
+    uint32_t head[2];
+    uint32_t i;
+    int8_t ret = 0;
+
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.Banks     = STORAGE_RAM_JNL_BANK;
+    erase.Page      = (base - STORAGE_RAM_JNL_BANK_ADDR) / FLASH_PAGE_SIZE;
+    erase.NbPages   = STORAGE_RAM_JNL_HALF / FLASH_PAGE_SIZE;
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+
+    if (HAL_FLASHEx_Erase(&erase, &page_error) != HAL_OK) {
+        ret = -1;
+    }
+
+    HAL_FLASH_Lock();
+
+    for (i = 0U; (ret == 0) && (i < STORAGE_RAM_BLK_NBR); i++) {
+        if (ram_map[i] != RAM_NO_BLK) {
+            ret = RAM_JnlAppend(base, &off, (uint16_t)i, RAM_JNL_DATA, (const uint8_t *)ram_pool[ram_map[i]]);
+        }
+    }
+
+    head[0] = RAM_JNL_MAGIC;
+    head[1] = ram_jnl_gen + 1U;
+
+    if ((ret != 0) || (RAM_JnlAppend(base, &off, 0U, RAM_JNL_COMMIT, NULL) != 0) ||
+        (RAM_JnlProgram(base, (const uint8_t *)head, sizeof(head)) != 0)) {
+        ram_stats.jnl_errors++;
+        return -1;
+    }
+
+    ram_jnl_half = half;
+    ram_jnl_gen  = head[1];
+    ram_jnl_off  = off;
+    ram_stats.compactions++;
+
+    return 0;
+}
+
+/**
+ * @brief Journal the sectors changed since the last call.
+ *        Called on eject, suspend, SYNCHRONIZE CACHE and MSC_CACHE_IDLE_MS idle.
+ */
+static int8_t STORAGE_RAM_Flush(uint8_t lun)
+{
+    uint32_t base = RAM_JNL_HALF_ADDR(ram_jnl_half);
+    uint32_t need = 8U;
+    uint32_t i;
+    int8_t ret = 0;
+
+    UNUSED(lun);
+
+    for (i = 0U; i < STORAGE_RAM_BLK_NBR; i++) {
+        if (RAM_IS_DIRTY(i)) {
+            need += (ram_map[i] == RAM_NO_BLK) ? 8U : RAM_JNL_REC;
+        }
+    }
+
+    if (need == 8U) {
+        return (USBD_OK);
+    }
+
+    if ((ram_jnl_off + need) > STORAGE_RAM_JNL_HALF) {
+        ret = RAM_JnlCompact();
+    } else {
+        // 先写全零扇区: 重放时池块占用不会超过提交后的状态
+        for (i = 0U; (ret == 0) && (i < STORAGE_RAM_BLK_NBR); i++) {
+            if (RAM_IS_DIRTY(i) && (ram_map[i] == RAM_NO_BLK)) {
+                ret = RAM_JnlAppend(base, &ram_jnl_off, (uint16_t)i, RAM_JNL_ZERO, NULL);
+            }
+        }
+        for (i = 0U; (ret == 0) && (i < STORAGE_RAM_BLK_NBR); i++) {
+            if (RAM_IS_DIRTY(i) && (ram_map[i] != RAM_NO_BLK)) {
+                ret = RAM_JnlAppend(base, &ram_jnl_off, (uint16_t)i, RAM_JNL_DATA,
+                                    (const uint8_t *)ram_pool[ram_map[i]]);
+            }
+        }
+        if (ret == 0) {
+            ret = RAM_JnlAppend(base, &ram_jnl_off, 0U, RAM_JNL_COMMIT, NULL);
+        }
+
+        // 半区里留下了没提交的记录, 下次整体压缩到另一半
+        if (ret != 0) {
+            ram_jnl_off = STORAGE_RAM_JNL_HALF;
+            ram_stats.jnl_errors++;
+        }
+    }
+
+    if (ret != 0) {
+        return -1;
+    }
+
+    memset(ram_dirty, 0, sizeof(ram_dirty));
+    ram_stats.commits++;
+
+    return (USBD_OK);
+}
+
+/**
+ * @brief Return the pool usage counters.
+ */
+STORAGE_RAM_StatsTypeDef *STORAGE_RAM_GetStats(void)
+{
+    return &ram_stats;
+}
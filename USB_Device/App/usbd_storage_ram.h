@@ -0,0 +1,54 @@
+/**
+ * @file usbd_storage_ram.h
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Sparse RAM scratch disk backend for the MSC LUN table.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ */
+#ifndef USBD_STORAGE_RAM_H
+#define USBD_STORAGE_RAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "usbd_msc.h"
+
+// 对主机报告的容量, 扇区只有第一次写入非零数据时才从池里分配
+#define STORAGE_RAM_BLK_NBR  512
+#define STORAGE_RAM_BLK_SIZ  0x200
+// 实际占用的 RAM, 不能超过 255 块
+#define STORAGE_RAM_POOL_NBR 80
+
+// 掉电保存: 改过的扇区在 Flush 时 (弹出, 挂起, 空闲, SYNCHRONIZE CACHE)
+// 追加到 flash 日志, 上电时重放. 日志区在 bank 2 末尾, 分成两半轮流使用,
+// 一半写满时把整个盘压缩到另一半, 所以每一半都要放得下整个池
+#define STORAGE_RAM_JNL_BANK      FLASH_BANK_2
+#define STORAGE_RAM_JNL_BANK_ADDR 0x08040000U
+#define STORAGE_RAM_JNL_ADDR      0x08068000U
+#define STORAGE_RAM_JNL_SIZE      0x18000U
+#define STORAGE_RAM_JNL_HALF      (STORAGE_RAM_JNL_SIZE / 2U)
+
+typedef struct {
+    uint32_t allocated;   // 当前占用的池块
+    uint32_t zero_writes; // 全零写入, 没有存储
+    uint32_t pool_full;   // 池满导致失败的写入
+    uint32_t replayed;    // 上电时从日志恢复的扇区
+    uint32_t journaled;   // 写进日志的扇区记录
+    uint32_t commits;     // 提交的批次, 含压缩
+    uint32_t compactions; // 换到另一半日志区的次数
+    uint32_t jnl_errors;  // flash 编程或擦除失败
+} STORAGE_RAM_StatsTypeDef;
+
+extern USBD_StorageTypeDef USBD_Storage_RAM_fops;
+
+STORAGE_RAM_StatsTypeDef *STORAGE_RAM_GetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //! USBD_STORAGE_RAM_H
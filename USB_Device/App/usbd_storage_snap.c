@@ -0,0 +1,568 @@
+/**
+ * @file usbd_storage_snap.c
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Copy-on-write snapshots of a backend, with a read-only view LUN.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ * USBD_Storage_Snap_fops 包住 STORAGE_SNAP_ORIGIN 给主机继续读写,
+ * 快照之后第一次改写 (WRITE 或 UNMAP) 某个扇区前, 把旧内容复制到 RAM 池.
+ * 重映射表每项 4 字节 {lba, 池槽, 快照位图}, 按 lba 排序:
+ *   同一扇区的一份副本被位图里的所有快照共用, 没有表项的扇区直接读源盘.
+ * USBD_Storage_SnapView_fops 是 STORAGE_SNAP_View 选中的快照的只读视图.
+ * 创建/删除/切换只是登记请求, 在源盘 LUN 的 Flush 里生效, 这时缓存里
+ * 之前的写入都已写回源盘, 所以快照包含请求之前主机写完的所有数据.
+ */
+#include "usbd_storage_snap.h"
+#include "usbd_storage_ftl.h"
+#include "usbd_storage_vfat.h"
+#include "usbd_msc_readahead.h"
+
+#if (STORAGE_SNAP_NBR > 8U) || (STORAGE_SNAP_POOL_NBR > 255U)
+#error "STORAGE_SNAP: snapshot mask or pool slot does not fit the map entry"
+#endif
+
+static int8_t STORAGE_SNAP_Init(uint8_t lun);
+static int8_t STORAGE_SNAP_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size);
+static int8_t STORAGE_SNAP_IsReady(uint8_t lun);
+static int8_t STORAGE_SNAP_IsWriteProtected(uint8_t lun);
+static int8_t STORAGE_SNAP_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_SNAP_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_SNAP_GetMaxLun(void);
+static uint8_t *STORAGE_SNAP_GetReadAddr(uint8_t lun, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_SNAP_Poll(uint8_t lun);
+static int8_t STORAGE_SNAP_Flush(uint8_t lun);
+static int8_t STORAGE_SNAP_Unmap(uint8_t lun, uint32_t blk_addr, uint32_t blk_len);
+
+static int8_t STORAGE_SNAP_ViewInit(uint8_t lun);
+static int8_t STORAGE_SNAP_ViewIsReady(uint8_t lun);
+static int8_t STORAGE_SNAP_ViewIsWriteProtected(uint8_t lun);
+static int8_t STORAGE_SNAP_ViewRead(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_SNAP_ViewWrite(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+
+static const int8_t STORAGE_SNAP_Inquirydata[STANDARD_INQUIRY_DATA_LEN] = {
+    0x00,
+    0x80,
+    0x02,
+    0x02,
+    (STANDARD_INQUIRY_DATA_LEN - 5),
+    0x00,
+    0x00,
+    0x00,
+    'S', 'T', 'M', ' ', ' ', ' ', ' ', ' ', /* Manufacturer : 8 bytes */
+    'S', 'n', 'a', 'p', 's', 'h', 'o', 't', /* Product      : 16 Bytes */
+    ' ', 'O', 'r', 'i', 'g', 'i', 'n', ' ',
+    '0', '.', '0', '1'                      /* Version      : 4 Bytes */
+};
+
+static const int8_t STORAGE_SNAP_ViewInquirydata[STANDARD_INQUIRY_DATA_LEN] = {
+    0x00,
+    0x80,
+    0x02,
+    0x02,
+    (STANDARD_INQUIRY_DATA_LEN - 5),
+    0x00,
+    0x00,
+    0x00,
+    'S', 'T', 'M', ' ', ' ', ' ', ' ', ' ', /* Manufacturer : 8 bytes */
+    'S', 'n', 'a', 'p', 's', 'h', 'o', 't', /* Product      : 16 Bytes */
+    ' ', 'V', 'i', 'e', 'w', ' ', ' ', ' ',
+    '0', '.', '0', '1'                      /* Version      : 4 Bytes */
+};
+
+#define SNAP_BIT(id) ((uint8_t)(1U << (id)))
+
+typedef struct {
+    uint16_t lba;  // 源盘扇区
+    uint8_t slot;  // 旧内容所在的池槽
+    uint8_t mask;  // 看到这份旧内容的快照
+} SNAP_EntryTypeDef;
+
+static uint8_t snap_pool[STORAGE_SNAP_POOL_NBR][STORAGE_SNAP_BLK_SIZ];
+static SNAP_EntryTypeDef snap_map[STORAGE_SNAP_POOL_NBR]; // 按 lba 排序
+static uint8_t snap_map_nbr = 0U;
+static uint8_t snap_free[STORAGE_SNAP_POOL_NBR]; // 空闲池槽栈
+static uint8_t snap_free_nbr = 0U;
+static uint8_t snap_inited   = 0U;
+
+static uint8_t snap_active = 0U; // 存在的快照, 每个一位
+static uint8_t snap_view   = 0U;
+static uint8_t snap_view_lun = 0xFFU;
+static uint8_t snap_origin_inited = 0U; // 源盘已由源盘 LUN 挂载
+
+// 主线程登记, 源盘 Flush 时生效
+static __IO uint8_t snap_req_create = 0U;
+static __IO uint8_t snap_req_drop   = 0U;
+static __IO uint8_t snap_req_view   = 0U; // 快照号 + 1, 0 表示没有请求
+
+static STORAGE_SNAP_StatsTypeDef snap_stats;
+
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+USBD_StorageTypeDef USBD_Storage_Snap_fops = {
+    STORAGE_SNAP_Init,
+    STORAGE_SNAP_GetCapacity,
+    STORAGE_SNAP_IsReady,
+    STORAGE_SNAP_IsWriteProtected,
+    STORAGE_SNAP_Read,
+    STORAGE_SNAP_Write,
+    STORAGE_SNAP_GetMaxLun,
+    (int8_t *)STORAGE_SNAP_Inquirydata,
+    STORAGE_SNAP_GetReadAddr,
+    NULL, // 直接写进源盘会绕过写时复制
+    STORAGE_SNAP_Poll,
+    STORAGE_SNAP_Flush,
+    STORAGE_SNAP_Unmap
+};
+
+USBD_StorageTypeDef USBD_Storage_SnapView_fops = {
+    STORAGE_SNAP_ViewInit,
+    STORAGE_SNAP_GetCapacity,
+    STORAGE_SNAP_ViewIsReady,
+    STORAGE_SNAP_ViewIsWriteProtected,
+    STORAGE_SNAP_ViewRead,
+    STORAGE_SNAP_ViewWrite,
+    STORAGE_SNAP_GetMaxLun,
+    (int8_t *)STORAGE_SNAP_ViewInquirydata,
+    NULL, // 池槽在快照删除后会被复用, 不映射
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
+
+static void SNAP_Setup(void)
+{
+    uint8_t i;
+
+    if (snap_inited != 0U) {
+        return;
+    }
+
+    for (i = 0U; i < STORAGE_SNAP_POOL_NBR; i++) {
+        snap_free[i] = (uint8_t)(STORAGE_SNAP_POOL_NBR - 1U - i);
+    }
+    snap_free_nbr = STORAGE_SNAP_POOL_NBR;
+    snap_inited   = 1U;
+}
+
+/**
+ * @brief First map entry whose lba is not below blk_addr.
+ */
+static uint8_t SNAP_Find(uint32_t blk_addr)
+{
+    uint8_t lo = 0U;
+    uint8_t hi = snap_map_nbr;
+    uint8_t mid;
+
+    while (lo < hi) {
+        mid = (uint8_t)((lo + hi) / 2U);
+        if (snap_map[mid].lba < blk_addr) {
+            lo = (uint8_t)(mid + 1U);
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/**
+ * @brief Copy of the block kept for one of the snapshots in mask, NULL if the
+ *        block has not changed since they were taken.
+ */
+static SNAP_EntryTypeDef *SNAP_Lookup(uint32_t blk_addr, uint8_t mask)
+{
+    uint8_t i;
+
+    for (i = SNAP_Find(blk_addr); (i < snap_map_nbr) && (snap_map[i].lba == blk_addr); i++) {
+        if ((snap_map[i].mask & mask) != 0U) {
+            return &snap_map[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Forget the copies of the snapshots in mask, freeing the slots no
+ *        other snapshot uses.
+ */
+static void SNAP_Release(uint8_t mask)
+{
+    uint8_t i;
+    uint8_t n = 0U;
+
+    for (i = 0U; i < snap_map_nbr; i++) {
+        snap_map[i].mask &= (uint8_t)~mask;
+        if (snap_map[i].mask == 0U) {
+            snap_free[snap_free_nbr++] = snap_map[i].slot;
+        } else {
+            snap_map[n++] = snap_map[i];
+        }
+    }
+
+    snap_map_nbr          = n;
+    snap_stats.slots_used = n;
+}
+
+/**
+ * @brief The view LUN shows other data: drop its read-ahead window and raise
+ *        UNIT ATTENTION (medium may have changed) so that the host re-reads it.
+ */
+static void SNAP_ViewChanged(void)
+{
+    USBD_ENTER_CRITICAL();
+    MSC_RA_Invalidate(snap_view_lun);
+    SCSI_UnitAttention(&hUsbDeviceFS, snap_view_lun, MEDIUM_HAVE_CHANGED);
+    USBD_EXIT_CRITICAL();
+}
+
+/**
+ * @brief Read from the origin, waiting for a backend that completes in Poll.
+ */
+static int8_t SNAP_OriginRead(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    int8_t ret = STORAGE_SNAP_ORIGIN.Read(lun, buf, blk_addr, blk_len);
+
+    while ((ret > 0) && (STORAGE_SNAP_ORIGIN.Poll != NULL)) {
+        ret = STORAGE_SNAP_ORIGIN.Poll(lun);
+    }
+
+    return (ret == 0) ? (USBD_OK) : -1;
+}
+
+/**
+ * @brief Keep the current content of a block for every snapshot that still
+ *        sees it on the origin, before it is overwritten.
+ */
+static int8_t SNAP_Preserve(uint8_t lun, uint32_t blk_addr)
+{
+    uint8_t need = snap_active;
+    uint8_t slot;
+    uint8_t pos;
+    uint8_t i;
+
+    pos = SNAP_Find(blk_addr);
+    for (i = pos; (i < snap_map_nbr) && (snap_map[i].lba == blk_addr); i++) {
+        need &= (uint8_t)~snap_map[i].mask;
+    }
+    if (need == 0U) {
+        return (USBD_OK);
+    }
+
+    // 池满: 这些快照已经不完整, 丢掉而不是让主机的写入失败
+    if (snap_free_nbr == 0U) {
+        SNAP_Release(need);
+        snap_active &= (uint8_t)~need;
+        snap_stats.overflows++;
+        STORAGE_VFAT_Log("snap: pool full, dropped mask 0x%02x", need);
+        if ((need & SNAP_BIT(snap_view)) != 0U) {
+            SNAP_ViewChanged();
+        }
+        return (USBD_OK);
+    }
+
+    slot = snap_free[--snap_free_nbr];
+    if (SNAP_OriginRead(lun, snap_pool[slot], blk_addr, 1U) != 0) {
+        snap_free[snap_free_nbr++] = slot;
+        return -1;
+    }
+
+    for (i = snap_map_nbr; i > pos; i--) {
+        snap_map[i] = snap_map[i - 1U];
+    }
+    snap_map[pos].lba  = (uint16_t)blk_addr;
+    snap_map[pos].slot = slot;
+    snap_map[pos].mask = need;
+    snap_map_nbr++;
+
+    snap_stats.copies++;
+    snap_stats.slots_used = snap_map_nbr;
+    return (USBD_OK);
+}
+
+static int8_t SNAP_PreserveRange(uint8_t lun, uint32_t blk_addr, uint32_t blk_len)
+{
+    uint32_t i;
+
+    for (i = 0U; (i < blk_len) && (snap_active != 0U); i++) {
+        if (SNAP_Preserve(lun, blk_addr + i) != 0) {
+            return -1;
+        }
+    }
+
+    return (USBD_OK);
+}
+
+/**
+ * @brief Apply the requests taken since the last flush of the origin.
+ */
+static void SNAP_Apply(void)
+{
+    uint8_t create = snap_req_create;
+    uint8_t drop   = snap_req_drop;
+    uint8_t view   = snap_req_view;
+    uint8_t changed;
+
+    if ((create | drop | view) == 0U) {
+        return;
+    }
+
+    snap_req_create = 0U;
+    snap_req_drop   = 0U;
+    snap_req_view   = 0U;
+
+    // 先删后建: 对同一个快照号, 删除加创建就是重新拍一次
+    changed = (uint8_t)((drop | create) & snap_active);
+    SNAP_Release(changed);
+    snap_active &= (uint8_t)~drop;
+    snap_active |= create;
+    changed |= create;
+
+    if (drop != 0U) {
+        snap_stats.drops++;
+        STORAGE_VFAT_Log("snap: dropped mask 0x%02x", drop);
+    }
+    if (create != 0U) {
+        snap_stats.creates++;
+        STORAGE_VFAT_Log("snap: created mask 0x%02x", create);
+    }
+
+    if (view != 0U) {
+        snap_view = (uint8_t)(view - 1U);
+        changed |= SNAP_BIT(snap_view);
+    }
+    if ((changed & SNAP_BIT(snap_view)) != 0U) {
+        SNAP_ViewChanged();
+    }
+}
+
+static int8_t STORAGE_SNAP_Init(uint8_t lun)
+{
+    SNAP_Setup();
+    snap_origin_inited = 1U;
+    return STORAGE_SNAP_ORIGIN.Init(lun);
+}
+
+static int8_t STORAGE_SNAP_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size)
+{
+    return STORAGE_SNAP_ORIGIN.GetCapacity(lun, block_num, block_size);
+}
+
+static int8_t STORAGE_SNAP_IsReady(uint8_t lun)
+{
+    return STORAGE_SNAP_ORIGIN.IsReady(lun);
+}
+
+static int8_t STORAGE_SNAP_IsWriteProtected(uint8_t lun)
+{
+    return STORAGE_SNAP_ORIGIN.IsWriteProtected(lun);
+}
+
+static int8_t STORAGE_SNAP_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    return STORAGE_SNAP_ORIGIN.Read(lun, buf, blk_addr, blk_len);
+}
+
+static int8_t STORAGE_SNAP_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    if (SNAP_PreserveRange(lun, blk_addr, blk_len) != 0) {
+        return -1;
+    }
+
+    return STORAGE_SNAP_ORIGIN.Write(lun, buf, blk_addr, blk_len);
+}
+
+static int8_t STORAGE_SNAP_GetMaxLun(void)
+{
+    return 0;
+}
+
+static uint8_t *STORAGE_SNAP_GetReadAddr(uint8_t lun, uint32_t blk_addr, uint16_t blk_len)
+{
+    if (STORAGE_SNAP_ORIGIN.GetReadAddr == NULL) {
+        return NULL;
+    }
+
+    return STORAGE_SNAP_ORIGIN.GetReadAddr(lun, blk_addr, blk_len);
+}
+
+static int8_t STORAGE_SNAP_Poll(uint8_t lun)
+{
+    if (STORAGE_SNAP_ORIGIN.Poll == NULL) {
+        return -1;
+    }
+
+    return STORAGE_SNAP_ORIGIN.Poll(lun);
+}
+
+/**
+ * @brief Flush the origin, then apply the pending snapshot requests.
+ */
+static int8_t STORAGE_SNAP_Flush(uint8_t lun)
+{
+    int8_t ret = (USBD_OK);
+
+    if (STORAGE_SNAP_ORIGIN.Flush != NULL) {
+        ret = STORAGE_SNAP_ORIGIN.Flush(lun);
+    }
+
+    if (ret >= 0) {
+        SNAP_Apply();
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Unmapped blocks read back as zero, so they are preserved like a write.
+ */
+static int8_t STORAGE_SNAP_Unmap(uint8_t lun, uint32_t blk_addr, uint32_t blk_len)
+{
+    if (STORAGE_SNAP_ORIGIN.Unmap == NULL) {
+        return -1;
+    }
+
+    if ((blk_len != 0U) && (SNAP_PreserveRange(lun, blk_addr, blk_len) != 0)) {
+        return -1;
+    }
+
+    return STORAGE_SNAP_ORIGIN.Unmap(lun, blk_addr, blk_len);
+}
+
+static int8_t STORAGE_SNAP_ViewInit(uint8_t lun)
+{
+    SNAP_Setup();
+    snap_view_lun = lun;
+
+    // 再次 Init 会重新挂载源盘, 丢掉它在 RAM 里的映射状态
+    if (snap_origin_inited != 0U) {
+        return (USBD_OK);
+    }
+    snap_origin_inited = 1U;
+    return STORAGE_SNAP_ORIGIN.Init(lun);
+}
+
+/**
+ * @brief Ready while the viewed snapshot exists. A view change is reported
+ *        as UNIT ATTENTION by SNAP_ViewChanged.
+ */
+static int8_t STORAGE_SNAP_ViewIsReady(uint8_t lun)
+{
+    if ((snap_active & SNAP_BIT(snap_view)) == 0U) {
+        return -1;
+    }
+
+    return STORAGE_SNAP_ORIGIN.IsReady(lun);
+}
+
+static int8_t STORAGE_SNAP_ViewIsWriteProtected(uint8_t lun)
+{
+    UNUSED(lun);
+    return 1;
+}
+
+/**
+ * @brief Changed blocks come from the pool, runs of unchanged ones from the origin.
+ */
+static int8_t STORAGE_SNAP_ViewRead(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    uint8_t mask = SNAP_BIT(snap_view);
+    SNAP_EntryTypeDef *e;
+    uint16_t n;
+
+    if ((snap_active & mask) == 0U) {
+        return -1;
+    }
+
+    while (blk_len > 0U) {
+        e = SNAP_Lookup(blk_addr, mask);
+        if (e != NULL) {
+            memcpy(buf, snap_pool[e->slot], STORAGE_SNAP_BLK_SIZ);
+            n = 1U;
+        } else {
+            for (n = 1U; (n < blk_len) && (SNAP_Lookup(blk_addr + n, mask) == NULL); n++) {
+            }
+            if (SNAP_OriginRead(lun, buf, blk_addr, n) != 0) {
+                return -1;
+            }
+        }
+
+        buf += (uint32_t)n * STORAGE_SNAP_BLK_SIZ;
+        blk_addr += n;
+        blk_len -= n;
+    }
+
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_SNAP_ViewWrite(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    UNUSED(lun);
+    UNUSED(buf);
+    UNUSED(blk_addr);
+    UNUSED(blk_len);
+    return -1;
+}
+
+/**
+ * @brief Take snapshot id of the origin once the writes before this call are on it.
+ * @note The request is applied at the next flush of the origin LUN, which is
+ *       asked for here; taking an existing id again replaces that snapshot.
+ */
+int8_t STORAGE_SNAP_Create(uint8_t id)
+{
+    if (id >= STORAGE_SNAP_NBR) {
+        return -1;
+    }
+
+    snap_req_create |= SNAP_BIT(id);
+    USBD_MSC_RequestFlush(&hUsbDeviceFS);
+    return (USBD_OK);
+}
+
+/**
+ * @brief Drop snapshot id and free its copies, at the next flush of the origin LUN.
+ */
+int8_t STORAGE_SNAP_Drop(uint8_t id)
+{
+    if (id >= STORAGE_SNAP_NBR) {
+        return -1;
+    }
+
+    snap_req_drop |= SNAP_BIT(id);
+    snap_req_create &= (uint8_t)~SNAP_BIT(id);
+    USBD_MSC_RequestFlush(&hUsbDeviceFS);
+    return (USBD_OK);
+}
+
+/**
+ * @brief Show snapshot id on the view LUN, at the next flush of the origin LUN.
+ */
+int8_t STORAGE_SNAP_View(uint8_t id)
+{
+    if (id >= STORAGE_SNAP_NBR) {
+        return -1;
+    }
+
+    snap_req_view = (uint8_t)(id + 1U);
+    USBD_MSC_RequestFlush(&hUsbDeviceFS);
+    return (USBD_OK);
+}
+
+/**
+ * @brief Snapshots in effect, bit n for snapshot n.
+ */
+uint8_t STORAGE_SNAP_GetActive(void)
+{
+    return snap_active;
+}
+
+STORAGE_SNAP_StatsTypeDef *STORAGE_SNAP_GetStats(void)
+{
+    return &snap_stats;
+}
@@ -0,0 +1,51 @@
+/**
+ * @file usbd_storage_snap.h
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Copy-on-write snapshots of a backend, with a read-only view LUN.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ */
+#ifndef USBD_STORAGE_SNAP_H
+#define USBD_STORAGE_SNAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "usbd_msc.h"
+
+// 做快照的后端, 扇区必须是 512 字节, 扇区号不超过 16 位
+#define STORAGE_SNAP_ORIGIN     USBD_Storage_FTL_fops
+#define STORAGE_SNAP_BLK_SIZ    0x200U
+
+// 同时存在的快照个数, 每个快照在重映射表里占一位
+#define STORAGE_SNAP_NBR        4U
+
+// 快照之后被改写的扇区, 旧内容存在 RAM 池里, 池满时丢弃受影响的快照
+#define STORAGE_SNAP_POOL_NBR   16U
+
+typedef struct {
+    uint32_t creates;    // 生效的创建
+    uint32_t drops;      // 生效的删除
+    uint32_t copies;     // 写时复制的扇区
+    uint32_t slots_used; // 占用的池槽
+    uint32_t overflows;  // 池满被丢弃的快照
+} STORAGE_SNAP_StatsTypeDef;
+
+extern USBD_StorageTypeDef USBD_Storage_Snap_fops;
+extern USBD_StorageTypeDef USBD_Storage_SnapView_fops;
+
+int8_t STORAGE_SNAP_Create(uint8_t id);
+int8_t STORAGE_SNAP_Drop(uint8_t id);
+int8_t STORAGE_SNAP_View(uint8_t id);
+uint8_t STORAGE_SNAP_GetActive(void);
+STORAGE_SNAP_StatsTypeDef *STORAGE_SNAP_GetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //! USBD_STORAGE_SNAP_H
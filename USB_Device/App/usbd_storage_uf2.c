@@ -0,0 +1,374 @@
+/**
+ * @file usbd_storage_uf2.c
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief UF2 firmware blocks written to the virtual FAT LUN, streamed into
+ *        internal flash.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ * 每个 512 字节的 UF2 块自带目标地址, 块号和总块数, 所以主机按什么顺序写,
+ * 写到哪个簇都没关系. 第一次写到某一页时先擦除, 然后按双字编程.
+ * 总块数变化, 或者上一次更新停了 STORAGE_UF2_REBOOT_MS 没有新块时,
+ * 开始新的一次更新, 所有块号都收到后更新完成.
+ * 新的更新一开始就擦掉固件区第一页 (旧的向量表), 向量表的第一个双字
+ * (栈顶和复位向量) 留到最后写. 不管主机先写哪些块, 更新中途断电时
+ * STORAGE_UF2_Boot 看到的都是空的向量表, 会留在更新盘.
+ * 所以 .uf2 必须包含 STORAGE_UF2_APP_ADDR 处的向量表.
+ */
+#include "usbd_storage_uf2.h"
+#include "usbd_storage_ftl.h"
+#include "usbd_storage_vfat.h"
+
+#if (STORAGE_UF2_APP_ADDR + STORAGE_UF2_APP_SIZE) > STORAGE_FTL_ADDR
+#error "STORAGE_UF2: firmware region overlaps the flash LUNs"
+#endif
+
+#if (STORAGE_UF2_APP_ADDR % FLASH_PAGE_SIZE) != 0U
+#error "STORAGE_UF2: firmware region must start on a page"
+#endif
+
+#define UF2_MAGIC_START0   0x0A324655U // "UF2\n"
+#define UF2_MAGIC_START1   0x9E5D5157U
+#define UF2_MAGIC_END      0x0AB16F30U
+#define UF2_FLAG_NOT_MAIN  0x00000001U
+#define UF2_FLAG_FAMILY    0x00002000U
+#define UF2_PAYLOAD_MAX    476U
+
+#define UF2_PAGE_NBR       (STORAGE_UF2_APP_SIZE / FLASH_PAGE_SIZE)
+
+typedef struct {
+    uint32_t magic_start0;
+    uint32_t magic_start1;
+    uint32_t flags;
+    uint32_t target_addr;
+    uint32_t payload_size;
+    uint32_t block_no;
+    uint32_t num_blocks;
+    uint32_t family_id;
+    uint8_t data[UF2_PAYLOAD_MAX];
+    uint32_t magic_end;
+} UF2_BlockTypeDef;
+
+static uint8_t uf2_erased[(UF2_PAGE_NBR + 7U) / 8U];           // 本次更新已擦除的页
+static uint8_t uf2_seen[(STORAGE_UF2_BLOCK_MAX + 7U) / 8U];    // 本次更新已写入的块号
+static uint32_t uf2_addr_min;
+static uint32_t uf2_addr_max;
+static uint64_t uf2_vector;         // STORAGE_UF2_APP_ADDR 处的双字, 完成时再写
+static uint8_t uf2_vector_set = 0U;
+static uint8_t uf2_reboot     = 0U;
+static uint32_t uf2_last_tick = 0U; // 最近一个 UF2 块
+
+// 切换 MSP 之后还要用, 不能放在栈上
+static uint32_t uf2_boot_sp;
+static void (*uf2_boot_entry)(void);
+
+static STORAGE_UF2_StatsTypeDef uf2_stats;
+
+/**
+ * @brief End of the running image in flash, blocks below it are refused.
+ */
+static uint32_t UF2_ImageEnd(void)
+{
+#if defined(__CC_ARM) || defined(__ARMCC_VERSION)
+    extern uint32_t Load$$LR$$LR_IROM1$$Limit;
+    return (uint32_t)&Load$$LR$$LR_IROM1$$Limit;
+#elif defined(__GNUC__)
+    extern uint32_t _sidata, _sdata, _edata;
+    return (uint32_t)&_sidata + ((uint32_t)&_edata - (uint32_t)&_sdata);
+#else
+    return STORAGE_UF2_APP_ADDR;
+#endif
+}
+
+static void UF2_Reset(uint32_t total)
+{
+    memset(uf2_erased, 0, sizeof(uf2_erased));
+    memset(uf2_seen, 0, sizeof(uf2_seen));
+    uf2_stats.written = 0U;
+    uf2_stats.total   = total;
+    uf2_addr_min      = 0xFFFFFFFFU;
+    uf2_addr_max      = 0U;
+    uf2_vector_set    = 0U;
+}
+
+static int8_t UF2_Reject(uint32_t block_no, uint32_t addr, const char *why)
+{
+    uf2_stats.rejected++;
+    uf2_stats.reject_block = block_no;
+    uf2_stats.reject_addr  = addr;
+    uf2_stats.reject_why   = why;
+    STORAGE_VFAT_Log("uf2: block %lu at 0x%08lx refused, %s", (unsigned long)block_no, (unsigned long)addr, why);
+    return -1;
+}
+
+/**
+ * @brief Erase every page of [addr, addr + len) not yet erased in this update.
+ * @return 0 on success, -1 on a flash error
+ */
+static int8_t UF2_ErasePages(uint32_t addr, uint32_t len)
+{
+    FLASH_EraseInitTypeDef erase;
+    uint32_t page_error = 0U;
+    uint32_t page;
+    int8_t ret = 0;
+
+    for (page = (addr - STORAGE_UF2_APP_ADDR) / FLASH_PAGE_SIZE;
+         (ret == 0) && (page <= ((addr + len - 1U - STORAGE_UF2_APP_ADDR) / FLASH_PAGE_SIZE)); page++) {
+        if ((uf2_erased[page / 8U] & (1U << (page % 8U))) != 0U) {
+            continue;
+        }
+
+        erase.TypeErase = FLASH_TYPEERASE_PAGES;
+        erase.Banks     = STORAGE_UF2_BANK;
+        erase.Page      = (STORAGE_UF2_APP_ADDR - STORAGE_UF2_BANK_ADDR) / FLASH_PAGE_SIZE + page;
+        erase.NbPages   = 1U;
+
+        HAL_FLASH_Unlock();
+        __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+
+        if (HAL_FLASHEx_Erase(&erase, &page_error) != HAL_OK) {
+            ret = -1;
+        }
+
+        HAL_FLASH_Lock();
+
+        uf2_erased[page / 8U] |= (uint8_t)(1U << (page % 8U));
+        uf2_stats.erases++;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Program the payload, skipping doublewords that already hold it.
+ * @return 0 on success, -1 on a flash error or a doubleword that needs an erase
+ */
+static int8_t UF2_Program(uint32_t addr, const uint8_t *data, uint32_t len)
+{
+    uint64_t dword;
+    uint32_t i;
+    int8_t ret = 0;
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+
+    for (i = 0U; (ret == 0) && (i < len); i += sizeof(uint64_t)) {
+        memcpy(&dword, &data[i], sizeof(uint64_t));
+
+        if (*(__IO uint64_t *)(addr + i) == dword) {
+            continue;
+        }
+
+        if ((*(__IO uint64_t *)(addr + i) != 0xFFFFFFFFFFFFFFFFULL) ||
+            (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, addr + i, dword) != HAL_OK)) {
+            ret = -1;
+        }
+    }
+
+    HAL_FLASH_Lock();
+
+    return ret;
+}
+
+/**
+ * @brief Handle one sector written to a free cluster of the virtual FAT LUN.
+ * @return 1 if it is not a UF2 block, 0 if handled, -1 if refused or not written
+ */
+int8_t STORAGE_UF2_Block(const uint8_t *buf)
+{
+    UF2_BlockTypeDef blk;
+    uint32_t skip = 0U;
+
+    memcpy(&blk, buf, sizeof(blk));
+
+    if ((blk.magic_start0 != UF2_MAGIC_START0) || (blk.magic_start1 != UF2_MAGIC_START1) ||
+        (blk.magic_end != UF2_MAGIC_END)) {
+        return 1;
+    }
+
+    uf2_stats.blocks++;
+
+    // 主机中途放弃的更新不再续写, 块数相同的另一个文件也要从头写
+    if ((uf2_stats.total != 0U) && ((USBD_GetTick() - uf2_last_tick) >= STORAGE_UF2_REBOOT_MS)) {
+        STORAGE_VFAT_Log("uf2: update abandoned at %lu/%lu", (unsigned long)uf2_stats.written,
+                         (unsigned long)uf2_stats.total);
+        UF2_Reset(0U);
+    }
+    uf2_last_tick = USBD_GetTick();
+
+    // 其他芯片或不是主 flash 的块直接跳过
+    if (((blk.flags & UF2_FLAG_NOT_MAIN) != 0U) ||
+        (((blk.flags & UF2_FLAG_FAMILY) != 0U) && (blk.family_id != STORAGE_UF2_FAMILY_ID))) {
+        uf2_stats.skipped++;
+        return 0;
+    }
+
+    if ((blk.payload_size == 0U) || (blk.payload_size > UF2_PAYLOAD_MAX) ||
+        ((blk.payload_size % sizeof(uint64_t)) != 0U) || ((blk.target_addr % sizeof(uint64_t)) != 0U)) {
+        return UF2_Reject(blk.block_no, blk.target_addr, "payload not doubleword aligned");
+    }
+    if ((blk.num_blocks == 0U) || (blk.num_blocks > STORAGE_UF2_BLOCK_MAX) || (blk.block_no >= blk.num_blocks)) {
+        return UF2_Reject(blk.block_no, blk.target_addr, "bad block number");
+    }
+    if (blk.target_addr < STORAGE_UF2_APP_ADDR) {
+        return UF2_Reject(blk.block_no, blk.target_addr, "below App-Base, relink the image");
+    }
+    if (blk.target_addr < UF2_ImageEnd()) {
+        return UF2_Reject(blk.block_no, blk.target_addr, "overlaps the running firmware");
+    }
+    if (blk.payload_size > (STORAGE_UF2_APP_ADDR + STORAGE_UF2_APP_SIZE - blk.target_addr)) {
+        return UF2_Reject(blk.block_no, blk.target_addr, "past the end of the firmware region");
+    }
+
+    if (blk.num_blocks != uf2_stats.total) {
+        UF2_Reset(blk.num_blocks);
+        STORAGE_VFAT_Log("uf2: update started, %lu blocks", (unsigned long)blk.num_blocks);
+
+        // 先让旧的向量表失效, 后面的页才能动
+        if (UF2_ErasePages(STORAGE_UF2_APP_ADDR, sizeof(uf2_vector)) != 0) {
+            uf2_stats.errors++;
+            STORAGE_VFAT_Log("uf2: flash error at 0x%08lx", (unsigned long)STORAGE_UF2_APP_ADDR);
+            UF2_Reset(0U);
+            return -1;
+        }
+    }
+
+    // 主机重写同一个文件时会再发一遍
+    if ((uf2_seen[blk.block_no / 8U] & (1U << (blk.block_no % 8U))) != 0U) {
+        return 0;
+    }
+
+    if (blk.target_addr == STORAGE_UF2_APP_ADDR) {
+        memcpy(&uf2_vector, blk.data, sizeof(uf2_vector));
+        uf2_vector_set = 1U;
+        skip           = sizeof(uf2_vector);
+    }
+
+    if ((UF2_ErasePages(blk.target_addr, blk.payload_size) != 0) ||
+        (UF2_Program(blk.target_addr + skip, &blk.data[skip], blk.payload_size - skip) != 0)) {
+        uf2_stats.errors++;
+        STORAGE_VFAT_Log("uf2: flash error at 0x%08lx", (unsigned long)blk.target_addr);
+        return -1;
+    }
+
+    uf2_seen[blk.block_no / 8U] |= (uint8_t)(1U << (blk.block_no % 8U));
+    uf2_addr_min = MIN(uf2_addr_min, blk.target_addr);
+    uf2_addr_max = MAX(uf2_addr_max, blk.target_addr + blk.payload_size);
+
+    if (++uf2_stats.written == uf2_stats.total) {
+        if ((uf2_vector_set != 0U) &&
+            (UF2_Program(STORAGE_UF2_APP_ADDR, (const uint8_t *)&uf2_vector, sizeof(uf2_vector)) != 0)) {
+            uf2_stats.errors++;
+            STORAGE_VFAT_Log("uf2: flash error at 0x%08lx", (unsigned long)STORAGE_UF2_APP_ADDR);
+            UF2_Reset(0U);
+            return -1;
+        }
+
+        uf2_stats.completed++;
+        STORAGE_VFAT_Log("uf2: update done, 0x%08lx-0x%08lx", (unsigned long)uf2_addr_min,
+                         (unsigned long)uf2_addr_max);
+        STORAGE_UF2_CompleteCallback(uf2_addr_min, uf2_addr_max - uf2_addr_min);
+        UF2_Reset(0U);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Check the vector table at STORAGE_UF2_APP_ADDR: initial stack in
+ *        SRAM, reset handler a Thumb address inside the firmware region.
+ */
+uint8_t STORAGE_UF2_AppValid(void)
+{
+    const uint32_t *vec = (const uint32_t *)STORAGE_UF2_APP_ADDR;
+    uint32_t sp = vec[0];
+    uint32_t pc = vec[1];
+
+    // 本固件伸进了固件区, 那里不是应用
+    if (UF2_ImageEnd() > STORAGE_UF2_APP_ADDR) {
+        return 0U;
+    }
+
+    if (((sp % 4U) != 0U) || (sp <= STORAGE_UF2_SRAM_ADDR) ||
+        (sp > (STORAGE_UF2_SRAM_ADDR + STORAGE_UF2_SRAM_SIZE))) {
+        return 0U;
+    }
+
+    if (((pc & 1U) == 0U) || (pc < STORAGE_UF2_APP_ADDR) || (pc >= (STORAGE_UF2_APP_ADDR + STORAGE_UF2_APP_SIZE))) {
+        return 0U;
+    }
+
+    return 1U;
+}
+
+/**
+ * @brief Start the application unless it asked to stay in the update drive.
+ *        Runs before HAL_Init, so the application gets the reset clocks.
+ */
+void STORAGE_UF2_Boot(void)
+{
+    const uint32_t *vec = (const uint32_t *)STORAGE_UF2_APP_ADDR;
+
+    __HAL_RCC_RTCAPB_CLK_ENABLE();
+
+    if (TAMP->BKP0R == STORAGE_UF2_STAY_MAGIC) {
+        // 只留一次, 下次复位照常进入应用
+        __HAL_RCC_PWR_CLK_ENABLE();
+        SET_BIT(PWR->CR1, PWR_CR1_DBP);
+        TAMP->BKP0R = 0U;
+        return;
+    }
+
+    __HAL_RCC_RTCAPB_CLK_DISABLE();
+
+    if (STORAGE_UF2_AppValid() == 0U) {
+        return;
+    }
+
+    uf2_boot_sp    = vec[0];
+    uf2_boot_entry = (void (*)(void))vec[1];
+
+    __disable_irq();
+    SysTick->CTRL = 0U;
+    SCB->VTOR     = STORAGE_UF2_APP_ADDR;
+    __DSB();
+    __ISB();
+    __enable_irq();
+
+    // -O0 时局部变量按 SP 寻址, 切换 MSP 之后只用静态变量
+    __set_MSP(uf2_boot_sp);
+    uf2_boot_entry();
+}
+
+/**
+ * @brief Reset into the new image once the host has stopped writing.
+ */
+void STORAGE_UF2_Process(void)
+{
+    if ((uf2_reboot != 0U) && ((USBD_GetTick() - uf2_last_tick) >= STORAGE_UF2_REBOOT_MS) &&
+        (STORAGE_UF2_AppValid() != 0U)) {
+        NVIC_SystemReset();
+    }
+}
+
+/**
+ * @brief Return the update progress and error counters.
+ */
+STORAGE_UF2_StatsTypeDef *STORAGE_UF2_GetStats(void)
+{
+    return &uf2_stats;
+}
+
+/**
+ * @brief Default completion handler: STORAGE_UF2_Process resets into the
+ *        new image. Override it to keep running instead.
+ */
+__weak void STORAGE_UF2_CompleteCallback(uint32_t addr, uint32_t size)
+{
+    UNUSED(addr);
+    UNUSED(size);
+    uf2_reboot = 1U;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file usbd_storage_uf2.h
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief UF2 firmware blocks written to the virtual FAT LUN, streamed into
+ *        internal flash.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ * 本固件 (更新盘) 在 0x08000000, 必须小于 64KB. 要更新的应用程序链接到
+ * STORAGE_UF2_APP_ADDR: 链接脚本 FLASH ORIGIN = 0x08010000, LENGTH = 192K,
+ * system_stm32g4xx.c 定义 USER_VECT_TAB_ADDRESS 并把 VECT_TAB_OFFSET 改成
+ * 0x10000. 链接在 0x08000000 的普通 .uf2 会被拒绝, 原因写在 INFO_UF2.TXT.
+ * 上电时 STORAGE_UF2_Boot 检查应用的向量表, 有效就跳过去; 应用想回到
+ * 更新盘时把 STORAGE_UF2_STAY_MAGIC 写进 TAMP->BKP0R 再复位.
+ * bank 2 已经给了 FTL, Flash LUN 和 RAM 日志, 固件区只能放在 bank 1:
+ * 擦除一页 (约 22ms) 期间从 bank 1 取指的 CPU 和 USB 中断都会停住,
+ * USB 硬件这段时间回 NAK, 主机重试. 每次更新每页只擦一次.
+ */
+#ifndef USBD_STORAGE_UF2_H
+#define USBD_STORAGE_UF2_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "usbd_msc.h"
+
+// 固件区: bank 1 中当前程序之后的部分, 不能和当前程序及 bank 2 的 LUN 重叠
+#define STORAGE_UF2_BANK        FLASH_BANK_1
+#define STORAGE_UF2_BANK_ADDR   0x08000000U
+#define STORAGE_UF2_APP_ADDR    0x08010000U
+#define STORAGE_UF2_APP_SIZE    0x30000U
+
+// uf2families.json 里的 STM32G4
+#define STORAGE_UF2_FAMILY_ID   0x4C71240AU
+
+// 应用栈顶必须在 SRAM1 + SRAM2 + CCM 的连续映射里
+#define STORAGE_UF2_SRAM_ADDR   0x20000000U
+#define STORAGE_UF2_SRAM_SIZE   0x20000U
+
+// 应用写进 TAMP->BKP0R 后复位, 留在更新盘一次
+#define STORAGE_UF2_STAY_MAGIC  0x55463242U // "UF2B"
+
+// 这么久没有新的 UF2 块: 更新完成的复位进入新固件, 没完成的从头再来
+#define STORAGE_UF2_REBOOT_MS   1000U
+
+// 一个 UF2 文件最多的块数, 按每块 256 字节数据计算
+#define STORAGE_UF2_BLOCK_MAX   (STORAGE_UF2_APP_SIZE / 256U)
+
+typedef struct {
+    uint32_t blocks;       // 收到的 UF2 块, 含重复和跳过的
+    uint32_t written;      // 本次更新已写入的块
+    uint32_t total;        // 本次更新的总块数, 0 表示没有进行中的更新
+    uint32_t erases;       // 擦除的页
+    uint32_t skipped;      // 其他芯片或不是主 flash 的块
+    uint32_t rejected;     // 地址或格式不对, 没有写入的块
+    uint32_t errors;       // 编程失败的块
+    uint32_t completed;    // 完成的更新
+    uint32_t reject_block; // 最近一次拒绝的块号和地址
+    uint32_t reject_addr;
+    const char *reject_why;
+} STORAGE_UF2_StatsTypeDef;
+
+// main 最开始, HAL_Init 之前调用: 应用有效且没有要求留下就不返回
+void STORAGE_UF2_Boot(void);
+// 1: 固件区有一个可以跳转的向量表
+uint8_t STORAGE_UF2_AppValid(void);
+// 主循环里调用, 更新完成后复位
+void STORAGE_UF2_Process(void);
+
+// 返回 1 表示不是 UF2 块, 0 表示已处理, -1 表示拒绝或写入失败
+int8_t STORAGE_UF2_Block(const uint8_t *buf);
+
+STORAGE_UF2_StatsTypeDef *STORAGE_UF2_GetStats(void);
+
+// 最后一块写完后调用, 默认安排 STORAGE_UF2_REBOOT_MS 后复位到新固件
+void STORAGE_UF2_CompleteCallback(uint32_t addr, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //! USBD_STORAGE_UF2_H
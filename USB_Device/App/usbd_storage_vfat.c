@@ -0,0 +1,721 @@
+/**
+ * @file usbd_storage_vfat.c
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Synthesised FAT12 volume backend for the MSC LUN table: device
+ *        state as plain files, no backing store.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ * 卷布局 (每簇一个扇区):
+ *   扇区 0: 引导扇区
+ *   FAT 两份, 根目录一个扇区 (16 项), 然后是数据区
+ * 每次读都按 vfat_files 现场生成: FAT 链和目录项由文件表算出, 文件内容由
+ * 各自的 render 函数生成, 所以读到的总是当前状态.
+ * 写入 FAT 和目录的扇区直接丢弃. 写到 CONFIG.TXT 或空闲簇的文本, 只有第一行
+ * 是 VFAT_CONFIG_MAGIC 时才逐行解析 (主机重写文件时可能换到空闲簇, 而普通
+ * 文件里的 key=value 文本不能被当成配置).
+ * 写到空闲簇的 UF2 块交给 usbd_storage_uf2.c 写进 flash.
+ */
+#include "usbd_storage_vfat.h"
+#include "usbd_storage_ram.h"
+#include "usbd_storage_ftl.h"
+#include "usbd_storage_zram.h"
+#include "usbd_storage_uf2.h"
+#include "usbd_storage_snap.h"
+#include "usbd_cdc_if.h"
+#include "usbd_msc_cache.h"
+#include "usbd_msc_readahead.h"
+#include "usbd_msc_profile.h"
+#include <stdarg.h>
+
+#define VFAT_FAT_NBR     2U
+#define VFAT_ROOT_ENTS   16U
+#define VFAT_FAT_SECTORS ((((STORAGE_VFAT_BLK_NBR + 2U) * 3U + 1U) / 2U + STORAGE_VFAT_BLK_SIZ - 1U) / STORAGE_VFAT_BLK_SIZ)
+#define VFAT_FAT_LBA     1U
+#define VFAT_ROOT_LBA    (VFAT_FAT_LBA + VFAT_FAT_NBR * VFAT_FAT_SECTORS)
+#define VFAT_DATA_LBA    (VFAT_ROOT_LBA + (VFAT_ROOT_ENTS * 32U) / STORAGE_VFAT_BLK_SIZ)
+#define VFAT_CLUS_NBR    (STORAGE_VFAT_BLK_NBR - VFAT_DATA_LBA)
+#define VFAT_CLUSTERS(size) (((size) + STORAGE_VFAT_BLK_SIZ - 1U) / STORAGE_VFAT_BLK_SIZ)
+
+#if VFAT_CLUS_NBR >= 4085U
+#error "STORAGE_VFAT: too many clusters for FAT12"
+#endif
+
+// 文件大小固定, 内容不足时用空格补齐
+#define VFAT_README_SIZE 1024U
+#define VFAT_STATS_SIZE  2048U
+#define VFAT_LOG_SIZE    STORAGE_VFAT_LOG_SIZE
+#define VFAT_CONFIG_SIZE 512U
+#define VFAT_INFO_SIZE   512U
+#define VFAT_PROF_SIZE   8192U
+
+// CONFIG.TXT 的第一行, 没有它的扇区不会被当成配置
+#define VFAT_CONFIG_MAGIC "#!stm32-vfat-config"
+
+#define VFAT_README_CLUS 2U
+#define VFAT_STATS_CLUS  (VFAT_README_CLUS + VFAT_CLUSTERS(VFAT_README_SIZE))
+#define VFAT_LOG_CLUS    (VFAT_STATS_CLUS + VFAT_CLUSTERS(VFAT_STATS_SIZE))
+#define VFAT_CONFIG_CLUS (VFAT_LOG_CLUS + VFAT_CLUSTERS(VFAT_LOG_SIZE))
+#define VFAT_INFO_CLUS   (VFAT_CONFIG_CLUS + VFAT_CLUSTERS(VFAT_CONFIG_SIZE))
+#define VFAT_PROF_CLUS   (VFAT_INFO_CLUS + VFAT_CLUSTERS(VFAT_INFO_SIZE))
+
+#define VFAT_ATTR_RO     0x01U
+#define VFAT_ATTR_VOLUME 0x08U
+#define VFAT_ATTR_ARCH   0x20U
+#define VFAT_DATE        (((2024U - 1980U) << 9) | (1U << 5) | 1U)
+
+// 只保存目标扇区落在 [start, start + 512) 内的字节, 文件按需从头生成
+typedef struct {
+    uint8_t *dst;
+    uint32_t start;
+    uint32_t end;
+    uint32_t pos;
+} VFAT_WriterTypeDef;
+
+typedef struct {
+    char name[11];
+    uint8_t attr;
+    uint16_t cluster;
+    uint32_t size;
+    void (*render)(VFAT_WriterTypeDef *w);
+} VFAT_FileTypeDef;
+
+static int8_t STORAGE_VFAT_Init(uint8_t lun);
+static int8_t STORAGE_VFAT_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size);
+static int8_t STORAGE_VFAT_IsReady(uint8_t lun);
+static int8_t STORAGE_VFAT_IsWriteProtected(uint8_t lun);
+static int8_t STORAGE_VFAT_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_VFAT_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_VFAT_GetMaxLun(void);
+
+static void VFAT_RenderReadme(VFAT_WriterTypeDef *w);
+static void VFAT_RenderStats(VFAT_WriterTypeDef *w);
+static void VFAT_RenderLog(VFAT_WriterTypeDef *w);
+static void VFAT_RenderConfig(VFAT_WriterTypeDef *w);
+static void VFAT_RenderInfo(VFAT_WriterTypeDef *w);
+static void VFAT_RenderProfile(VFAT_WriterTypeDef *w);
+
+static const int8_t STORAGE_VFAT_Inquirydata[STANDARD_INQUIRY_DATA_LEN] = {
+    0x00,
+    0x80,
+    0x02,
+    0x02,
+    (STANDARD_INQUIRY_DATA_LEN - 5),
+    0x00,
+    0x00,
+    0x00,
+    'S', 'T', 'M', ' ', ' ', ' ', ' ', ' ', /* Manufacturer : 8 bytes */
+    'V', 'i', 'r', 't', 'u', 'a', 'l', ' ', /* Product      : 16 Bytes */
+    'F', 'A', 'T', ' ', ' ', ' ', ' ', ' ',
+    '0', '.', '0', '1'                      /* Version      : 4 Bytes */
+};
+
+static const VFAT_FileTypeDef vfat_files[] = {
+    {"README  TXT", VFAT_ATTR_RO, VFAT_README_CLUS, VFAT_README_SIZE, VFAT_RenderReadme},
+    {"STATS   TXT", VFAT_ATTR_RO, VFAT_STATS_CLUS, VFAT_STATS_SIZE, VFAT_RenderStats},
+    {"LOG     TXT", VFAT_ATTR_RO, VFAT_LOG_CLUS, VFAT_LOG_SIZE, VFAT_RenderLog},
+    {"CONFIG  TXT", VFAT_ATTR_ARCH, VFAT_CONFIG_CLUS, VFAT_CONFIG_SIZE, VFAT_RenderConfig},
+    {"INFO_UF2TXT", VFAT_ATTR_RO, VFAT_INFO_CLUS, VFAT_INFO_SIZE, VFAT_RenderInfo},
+    {"PROFILE TXT", VFAT_ATTR_RO, VFAT_PROF_CLUS, VFAT_PROF_SIZE, VFAT_RenderProfile},
+};
+
+#define VFAT_FILE_NBR (sizeof(vfat_files) / sizeof(vfat_files[0]))
+
+static const char vfat_readme[] =
+    "Virtual FAT volume, generated on every read.\n"
+    "STATS.TXT  USB and storage counters\n"
+    "LOG.TXT    device log, oldest line first\n"
+    "CONFIG.TXT key=value lines, applied when written, keep its first line\n"
+    "           log=clear empties LOG.TXT\n"
+    "           snap.create=N, snap.drop=N snapshot the flash disk\n"
+    "           snap.view=N shows snapshot N on the view LUN\n"
+    "INFO_UF2.TXT firmware update status, copy a .uf2 file here to update\n"
+    "           link the image at its App-Base, refused blocks are listed\n"
+    "PROFILE.TXT SCSI command latency per opcode, hist n:count is [2^n, 2^(n+1)) cycles\n";
+
+// 文本超过文件大小时结尾会被截掉, 编译时检查
+typedef char vfat_readme_fits[((sizeof(vfat_readme) - 1U) <= VFAT_README_SIZE) ? 1 : -1];
+
+static char vfat_log[VFAT_LOG_SIZE];
+static uint32_t vfat_log_head = 0U; // 下一个写入位置
+static uint8_t vfat_log_full  = 0U;
+
+static char vfat_config[VFAT_CONFIG_SIZE] = VFAT_CONFIG_MAGIC "\n# key=value, one per line\n";
+
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+USBD_StorageTypeDef USBD_Storage_VFAT_fops = {
+    STORAGE_VFAT_Init,
+    STORAGE_VFAT_GetCapacity,
+    STORAGE_VFAT_IsReady,
+    STORAGE_VFAT_IsWriteProtected,
+    STORAGE_VFAT_Read,
+    STORAGE_VFAT_Write,
+    STORAGE_VFAT_GetMaxLun,
+    (int8_t *)STORAGE_VFAT_Inquirydata,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
+
+static int8_t STORAGE_VFAT_Init(uint8_t lun)
+{
+    UNUSED(lun);
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_VFAT_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size)
+{
+    UNUSED(lun);
+    *block_num  = STORAGE_VFAT_BLK_NBR;
+    *block_size = STORAGE_VFAT_BLK_SIZ;
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_VFAT_IsReady(uint8_t lun)
+{
+    UNUSED(lun);
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_VFAT_IsWriteProtected(uint8_t lun)
+{
+    UNUSED(lun);
+    return (USBD_OK);
+}
+
+static void VFAT_Putc(VFAT_WriterTypeDef *w, char c)
+{
+    if ((w->pos >= w->start) && (w->pos < w->end) && ((w->pos - w->start) < STORAGE_VFAT_BLK_SIZ)) {
+        w->dst[w->pos - w->start] = (uint8_t)c;
+    }
+    w->pos++;
+}
+
+static void VFAT_Puts(VFAT_WriterTypeDef *w, const char *s)
+{
+    while (*s != '\0') {
+        VFAT_Putc(w, *s++);
+    }
+}
+
+static void VFAT_Printf(VFAT_WriterTypeDef *w, const char *fmt, ...)
+{
+    char line[96];
+    va_list args;
+
+    va_start(args, fmt);
+    (void)vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+    VFAT_Puts(w, line);
+}
+
+static void VFAT_RenderReadme(VFAT_WriterTypeDef *w)
+{
+    VFAT_Puts(w, vfat_readme);
+}
+
+static void VFAT_RenderStats(VFAT_WriterTypeDef *w)
+{
+    USBD_MSC_StatsTypeDef *msc        = USBD_MSC_GetStats(&hUsbDeviceFS);
+    USBD_MSC_CacheStatsTypeDef *cache = USBD_MSC_GetCacheStats();
+    USBD_MSC_RAStatsTypeDef *ra       = USBD_MSC_GetReadAheadStats();
+    STORAGE_RAM_StatsTypeDef *ram     = STORAGE_RAM_GetStats();
+    STORAGE_FTL_StatsTypeDef *ftl     = STORAGE_FTL_GetStats();
+    STORAGE_ZRAM_StatsTypeDef *zram   = STORAGE_ZRAM_GetStats();
+    STORAGE_SNAP_StatsTypeDef *snap   = STORAGE_SNAP_GetStats();
+    CDC_StatsTypeDef *cdc;
+    uint8_t port;
+
+    VFAT_Printf(w, "uptime_ms=%lu\n", (unsigned long)HAL_GetTick());
+
+    if (msc != NULL) {
+        VFAT_Printf(w, "msc.rd_cmds=%lu\nmsc.rd_bytes=%lu\nmsc.rd_ticks=%lu\n",
+                    (unsigned long)msc->rd_cmds, (unsigned long)msc->rd_bytes,
+                    (unsigned long)msc->rd_ticks);
+        VFAT_Printf(w, "msc.rd_mapped=%lu\nmsc.wr_mapped=%lu\n",
+                    (unsigned long)msc->rd_mapped, (unsigned long)msc->wr_mapped);
+    }
+
+    VFAT_Printf(w, "cache.hits=%lu\ncache.misses=%lu\ncache.writebacks=%lu\ncache.flushes=%lu\n",
+                (unsigned long)cache->hits, (unsigned long)cache->misses,
+                (unsigned long)cache->writebacks, (unsigned long)cache->flushes);
+    VFAT_Printf(w, "ra.blocks=%lu\nra.hits=%lu\nra.prefetched=%lu\n",
+                (unsigned long)ra->blocks, (unsigned long)ra->hits, (unsigned long)ra->prefetched);
+    VFAT_Printf(w, "ram.allocated=%lu\nram.zero_writes=%lu\nram.pool_full=%lu\n",
+                (unsigned long)ram->allocated, (unsigned long)ram->zero_writes,
+                (unsigned long)ram->pool_full);
+    VFAT_Printf(w, "ram.replayed=%lu\nram.journaled=%lu\nram.commits=%lu\n",
+                (unsigned long)ram->replayed, (unsigned long)ram->journaled,
+                (unsigned long)ram->commits);
+    VFAT_Printf(w, "ram.compactions=%lu\nram.jnl_errors=%lu\n",
+                (unsigned long)ram->compactions, (unsigned long)ram->jnl_errors);
+    VFAT_Printf(w, "ftl.host_writes=%lu\nftl.flash_writes=%lu\nftl.erases=%lu\n",
+                (unsigned long)ftl->host_writes, (unsigned long)ftl->flash_writes,
+                (unsigned long)ftl->erases);
+    VFAT_Printf(w, "ftl.gc_runs=%lu\nftl.wl_moves=%lu\nftl.unmapped=%lu\n",
+                (unsigned long)ftl->gc_runs, (unsigned long)ftl->wl_moves,
+                (unsigned long)ftl->unmapped);
+    VFAT_Printf(w, "zram.sectors=%lu\nzram.raw_sectors=%lu\nzram.packed_bytes=%lu\n",
+                (unsigned long)zram->sectors, (unsigned long)zram->raw_sectors,
+                (unsigned long)zram->packed_bytes);
+    VFAT_Printf(w, "zram.chunks_used=%lu\nzram.zero_writes=%lu\nzram.pool_full=%lu\n",
+                (unsigned long)zram->chunks_used, (unsigned long)zram->zero_writes,
+                (unsigned long)zram->pool_full);
+    VFAT_Printf(w, "zram.encodes=%lu\nzram.encode_cycles=%lu\n",
+                (unsigned long)zram->encodes, (unsigned long)zram->encode_cycles);
+    VFAT_Printf(w, "zram.decodes=%lu\nzram.decode_cycles=%lu\n",
+                (unsigned long)zram->decodes, (unsigned long)zram->decode_cycles);
+    VFAT_Printf(w, "snap.active=0x%02x\nsnap.creates=%lu\nsnap.drops=%lu\n",
+                (unsigned int)STORAGE_SNAP_GetActive(), (unsigned long)snap->creates,
+                (unsigned long)snap->drops);
+    VFAT_Printf(w, "snap.copies=%lu\nsnap.slots_used=%lu\nsnap.overflows=%lu\n",
+                (unsigned long)snap->copies, (unsigned long)snap->slots_used,
+                (unsigned long)snap->overflows);
+
+    for (port = 0; port < USBD_CDC_PORT_NBR; port++) {
+        cdc = CDC_GetStats_FS(port);
+        VFAT_Printf(w, "cdc%u.rx_packets=%lu\ncdc%u.rx_bytes=%lu\ncdc%u.rx_throttled=%lu\n",
+                    (unsigned int)port, (unsigned long)cdc->rx_packets,
+                    (unsigned int)port, (unsigned long)cdc->rx_bytes,
+                    (unsigned int)port, (unsigned long)cdc->rx_throttled);
+        VFAT_Printf(w, "cdc%u.rx_overruns=%lu\ncdc%u.tx_bytes=%lu\ncdc%u.tx_refused=%lu\n",
+                    (unsigned int)port, (unsigned long)cdc->rx_overruns,
+                    (unsigned int)port, (unsigned long)cdc->tx_bytes,
+                    (unsigned int)port, (unsigned long)cdc->tx_refused);
+        VFAT_Printf(w, "cdc%u.tx_xfers=%lu\ncdc%u.tx_zlps=%lu\n",
+                    (unsigned int)port, (unsigned long)cdc->tx_xfers,
+                    (unsigned int)port, (unsigned long)cdc->tx_zlps);
+    }
+}
+
+static void VFAT_RenderLog(VFAT_WriterTypeDef *w)
+{
+    uint32_t i;
+
+    if (vfat_log_full != 0U) {
+        for (i = vfat_log_head; i < VFAT_LOG_SIZE; i++) {
+            VFAT_Putc(w, vfat_log[i]);
+        }
+    }
+    for (i = 0U; i < vfat_log_head; i++) {
+        VFAT_Putc(w, vfat_log[i]);
+    }
+}
+
+static void VFAT_RenderConfig(VFAT_WriterTypeDef *w)
+{
+    VFAT_Puts(w, vfat_config);
+}
+
+static void VFAT_RenderInfo(VFAT_WriterTypeDef *w)
+{
+    STORAGE_UF2_StatsTypeDef *uf2 = STORAGE_UF2_GetStats();
+
+    VFAT_Puts(w, "UF2 Bootloader 0.1\nModel: STM32G473 USB MSC CDC\nBoard-ID: STM32G473-MSC\n");
+    VFAT_Printf(w, "Family-ID: 0x%08lx\nApp-Base: 0x%08lx\nFlash: 0x%08lx-0x%08lx\n",
+                (unsigned long)STORAGE_UF2_FAMILY_ID, (unsigned long)STORAGE_UF2_APP_ADDR,
+                (unsigned long)STORAGE_UF2_APP_ADDR, (unsigned long)(STORAGE_UF2_APP_ADDR + STORAGE_UF2_APP_SIZE));
+    VFAT_Printf(w, "App: %s\n", (STORAGE_UF2_AppValid() != 0U) ? "valid" : "none");
+    VFAT_Printf(w, "Progress: %lu/%lu\nCompleted: %lu\nSkipped: %lu\nRejected: %lu\nErrors: %lu\n",
+                (unsigned long)uf2->written, (unsigned long)uf2->total, (unsigned long)uf2->completed,
+                (unsigned long)uf2->skipped, (unsigned long)uf2->rejected, (unsigned long)uf2->errors);
+
+    if (uf2->rejected != 0U) {
+        VFAT_Printf(w, "Last-Rejected: block %lu at 0x%08lx, %s\n", (unsigned long)uf2->reject_block,
+                    (unsigned long)uf2->reject_addr, uf2->reject_why);
+    }
+}
+
+#if (MSC_PROF_ENABLE == 1U)
+static USBD_MSC_ProfileTypeDef vfat_prof; // 快照太大, 不放在栈上
+#endif
+
+static void VFAT_RenderProfile(VFAT_WriterTypeDef *w)
+{
+#if (MSC_PROF_ENABLE == 1U)
+    const USBD_MSC_ProfSlotTypeDef *slot;
+    uint8_t used = USBD_MSC_GetProfile(&vfat_prof);
+    uint8_t i;
+    uint8_t bin;
+
+    VFAT_Printf(w, "media.read_cycles=%lu\nmedia.write_cycles=%lu\n",
+                (unsigned long)vfat_prof.read_cycles, (unsigned long)vfat_prof.write_cycles);
+    VFAT_Printf(w, "media.other_cycles=%lu\nbus_cycles=%lu\n",
+                (unsigned long)vfat_prof.other_cycles, (unsigned long)vfat_prof.bus_cycles);
+
+    for (i = 0U; i < used; i++) {
+        slot = &vfat_prof.slot[i];
+        if (slot->count == 0U) {
+            continue;
+        }
+        VFAT_Printf(w, "op%02x.count=%lu\nop%02x.failed=%lu\nop%02x.kbytes=%lu\n",
+                    (unsigned int)slot->opcode, (unsigned long)slot->count,
+                    (unsigned int)slot->opcode, (unsigned long)slot->failed,
+                    (unsigned int)slot->opcode, (unsigned long)(slot->bytes / 1024U));
+        VFAT_Printf(w, "op%02x.avg_cycles=%lu\nop%02x.max_cycles=%lu\nop%02x.media_cycles=%lu\n",
+                    (unsigned int)slot->opcode, (unsigned long)(slot->cycles / slot->count),
+                    (unsigned int)slot->opcode, (unsigned long)slot->max_cycles,
+                    (unsigned int)slot->opcode, (unsigned long)(slot->media_cycles / slot->count));
+        VFAT_Printf(w, "op%02x.hist=", (unsigned int)slot->opcode);
+        for (bin = 0U; bin < MSC_PROF_BINS; bin++) {
+            if (slot->hist[bin] != 0U) {
+                VFAT_Printf(w, " %u:%lu", (unsigned int)bin, (unsigned long)slot->hist[bin]);
+            }
+        }
+        VFAT_Puts(w, "\n");
+    }
+#else
+    VFAT_Puts(w, "profile disabled, build with MSC_PROF_ENABLE=1\n");
+#endif
+}
+
+/**
+ * @brief Append a line to LOG.TXT, dropping the oldest ones when it is full.
+ */
+void STORAGE_VFAT_Log(const char *fmt, ...)
+{
+    char line[96];
+    va_list args;
+    int n;
+    int i;
+
+    n = snprintf(line, sizeof(line), "[%lu] ", (unsigned long)HAL_GetTick());
+
+    va_start(args, fmt);
+    (void)vsnprintf(&line[n], sizeof(line) - (uint32_t)n - 1U, fmt, args);
+    va_end(args);
+
+    n = (int)strlen(line);
+    line[n++] = '\n';
+
+    for (i = 0; i < n; i++) {
+        vfat_log[vfat_log_head++] = line[i];
+        if (vfat_log_head >= VFAT_LOG_SIZE) {
+            vfat_log_head = 0U;
+            vfat_log_full = 1U;
+        }
+    }
+}
+
+/**
+ * @brief Default handler for CONFIG.TXT keys, override it in the application.
+ */
+__weak int8_t STORAGE_VFAT_ConfigCallback(const char *key, const char *value)
+{
+    UNUSED(key);
+    UNUSED(value);
+    return -1;
+}
+
+static void VFAT_Trim(char *s)
+{
+    uint32_t n = strlen(s);
+
+    while ((n > 0U) && ((s[n - 1U] == ' ') || (s[n - 1U] == '\t'))) {
+        s[--n] = '\0';
+    }
+}
+
+/**
+ * @brief snap.create, snap.drop and snap.view, with a snapshot number as value.
+ */
+static int8_t VFAT_ApplySnap(const char *key, const char *value)
+{
+    uint8_t id;
+
+    if ((value[0] < '0') || (value[0] > '9') || (value[1] != '\0')) {
+        return -1;
+    }
+    id = (uint8_t)(value[0] - '0');
+
+    if (strcmp(key, "snap.create") == 0) {
+        return STORAGE_SNAP_Create(id);
+    } else if (strcmp(key, "snap.drop") == 0) {
+        return STORAGE_SNAP_Drop(id);
+    } else if (strcmp(key, "snap.view") == 0) {
+        return STORAGE_SNAP_View(id);
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Apply one key=value line: built-in keys first, then the application.
+ */
+static void VFAT_ApplyLine(char *line)
+{
+    char *key = line;
+    char *value;
+
+    while ((*key == ' ') || (*key == '\t')) {
+        key++;
+    }
+    if ((*key == '#') || ((value = strchr(key, '=')) == NULL)) {
+        return;
+    }
+
+    *value++ = '\0';
+    while ((*value == ' ') || (*value == '\t')) {
+        value++;
+    }
+    VFAT_Trim(key);
+    VFAT_Trim(value);
+
+    if ((strcmp(key, "log") == 0) && (strcmp(value, "clear") == 0)) {
+        vfat_log_head = 0U;
+        vfat_log_full = 0U;
+        STORAGE_VFAT_Log("log cleared");
+    } else if ((strncmp(key, "snap.", 5U) == 0) && (VFAT_ApplySnap(key, value) == 0)) {
+        STORAGE_VFAT_Log("config: %s=%s", key, value);
+    } else if (STORAGE_VFAT_ConfigCallback(key, value) != 0) {
+        STORAGE_VFAT_Log("config: unknown %s=%s", key, value);
+    }
+}
+
+/**
+ * @brief Take a written data sector as CONFIG.TXT if it is text starting
+ *        with the VFAT_CONFIG_MAGIC line.
+ */
+static void VFAT_ParseConfig(const uint8_t *buf)
+{
+    char line[64];
+    uint32_t len;
+    uint32_t n;
+    char *p;
+
+    len = sizeof(VFAT_CONFIG_MAGIC) - 1U;
+    if ((memcmp(buf, VFAT_CONFIG_MAGIC, len) != 0) || ((buf[len] != '\r') && (buf[len] != '\n'))) {
+        return;
+    }
+
+    for (len = 0U; (len < (VFAT_CONFIG_SIZE - 1U)) && (buf[len] != 0U); len++) {
+        if (((buf[len] < 0x20U) || (buf[len] > 0x7EU)) &&
+            (buf[len] != '\t') && (buf[len] != '\r') && (buf[len] != '\n')) {
+            return;
+        }
+    }
+
+    memcpy(vfat_config, buf, len);
+    vfat_config[len] = '\0';
+
+    for (p = vfat_config; *p != '\0';) {
+        n = 0U;
+        while ((*p != '\0') && (*p != '\n')) {
+            if ((*p != '\r') && (n < (sizeof(line) - 1U))) {
+                line[n++] = *p;
+            }
+            p++;
+        }
+        if (*p == '\n') {
+            p++;
+        }
+
+        line[n] = '\0';
+        VFAT_ApplyLine(line);
+    }
+}
+
+/**
+ * @brief Find the file owning a data cluster.
+ */
+static const VFAT_FileTypeDef *VFAT_FindFile(uint32_t clus)
+{
+    uint32_t i;
+
+    for (i = 0U; i < VFAT_FILE_NBR; i++) {
+        if ((clus >= vfat_files[i].cluster) &&
+            (clus < (vfat_files[i].cluster + VFAT_CLUSTERS(vfat_files[i].size)))) {
+            return &vfat_files[i];
+        }
+    }
+
+    return NULL;
+}
+
+static uint16_t VFAT_FatEntry(uint32_t clus)
+{
+    const VFAT_FileTypeDef *file;
+    uint32_t last;
+
+    if (clus < 2U) {
+        return (clus == 0U) ? 0xFF8U : 0xFFFU;
+    }
+
+    file = VFAT_FindFile(clus);
+    if (file == NULL) {
+        return 0U;
+    }
+
+    last = file->cluster + VFAT_CLUSTERS(file->size) - 1U;
+    return (clus == last) ? 0xFFFU : (uint16_t)(clus + 1U);
+}
+
+static void VFAT_BootSector(uint8_t *buf)
+{
+    static const uint8_t head[] = {
+        0xEB, 0x3C, 0x90,                        // jmp
+        'M', 'S', 'W', 'I', 'N', '4', '.', '1',  // OEM
+        0x00, 0x02,                              // 每扇区字节
+        0x01,                                    // 每簇扇区
+        0x01, 0x00,                              // 保留扇区
+        VFAT_FAT_NBR,                            // FAT 份数
+        VFAT_ROOT_ENTS, 0x00,                    // 根目录项数
+        (uint8_t)STORAGE_VFAT_BLK_NBR, (uint8_t)(STORAGE_VFAT_BLK_NBR >> 8),
+        0xF8,                                    // 介质类型
+        VFAT_FAT_SECTORS, 0x00,                  // 每份 FAT 扇区
+        0x01, 0x00, 0x01, 0x00,                  // 每磁道扇区, 磁头数
+        0x00, 0x00, 0x00, 0x00,                  // 隐藏扇区
+        0x00, 0x00, 0x00, 0x00,                  // 32 位总扇区
+        0x80, 0x00, 0x29,                        // 驱动器号, 扩展引导标记
+        0x31, 0x47, 0x34, 0x56,                  // 卷序列号
+        'S', 'T', 'M', '3', '2', ' ', 'V', 'F', 'A', 'T', ' ',
+        'F', 'A', 'T', '1', '2', ' ', ' ', ' '
+    };
+
+    memcpy(buf, head, sizeof(head));
+    buf[510] = 0x55U;
+    buf[511] = 0xAAU;
+}
+
+static void VFAT_FatSector(uint32_t sector, uint8_t *buf)
+{
+    uint32_t k;
+    uint32_t i;
+    uint16_t e0;
+    uint16_t e1;
+
+    // 每三个字节存两个 12 位表项
+    for (i = 0U; i < STORAGE_VFAT_BLK_SIZ; i++) {
+        k  = sector * STORAGE_VFAT_BLK_SIZ + i;
+        e0 = VFAT_FatEntry((k / 3U) * 2U);
+        e1 = VFAT_FatEntry((k / 3U) * 2U + 1U);
+
+        switch (k % 3U) {
+            case 0U:
+                buf[i] = (uint8_t)e0;
+                break;
+            case 1U:
+                buf[i] = (uint8_t)(((e0 >> 8) & 0x0FU) | ((e1 & 0x0FU) << 4));
+                break;
+            default:
+                buf[i] = (uint8_t)(e1 >> 4);
+                break;
+        }
+    }
+}
+
+static void VFAT_DirEntry(uint8_t *ent, const char *name, uint8_t attr, uint16_t clus, uint32_t size)
+{
+    memcpy(ent, name, 11U);
+    ent[11] = attr;
+    ent[16] = (uint8_t)VFAT_DATE;
+    ent[17] = (uint8_t)(VFAT_DATE >> 8);
+    ent[18] = (uint8_t)VFAT_DATE;
+    ent[19] = (uint8_t)(VFAT_DATE >> 8);
+    ent[24] = (uint8_t)VFAT_DATE;
+    ent[25] = (uint8_t)(VFAT_DATE >> 8);
+    ent[26] = (uint8_t)clus;
+    ent[27] = (uint8_t)(clus >> 8);
+    ent[28] = (uint8_t)size;
+    ent[29] = (uint8_t)(size >> 8);
+    ent[30] = (uint8_t)(size >> 16);
+    ent[31] = (uint8_t)(size >> 24);
+}
+
+static void VFAT_RootSector(uint8_t *buf)
+{
+    uint32_t i;
+
+    VFAT_DirEntry(buf, "STM32 VFAT ", VFAT_ATTR_VOLUME, 0U, 0U);
+
+    for (i = 0U; i < VFAT_FILE_NBR; i++) {
+        VFAT_DirEntry(&buf[(i + 1U) * 32U], vfat_files[i].name, vfat_files[i].attr,
+                      vfat_files[i].cluster, vfat_files[i].size);
+    }
+}
+
+static void VFAT_DataSector(uint32_t lba, uint8_t *buf)
+{
+    const VFAT_FileTypeDef *file = VFAT_FindFile(lba - VFAT_DATA_LBA + 2U);
+    VFAT_WriterTypeDef w;
+    uint32_t offset;
+
+    if (file == NULL) {
+        return;
+    }
+
+    offset = (lba - VFAT_DATA_LBA + 2U - file->cluster) * STORAGE_VFAT_BLK_SIZ;
+    memset(buf, ' ', MIN(file->size - offset, STORAGE_VFAT_BLK_SIZ));
+
+    w.dst   = buf;
+    w.start = offset;
+    w.end   = file->size;
+    w.pos   = 0U;
+    file->render(&w);
+
+    if ((file->size - 1U) < (offset + STORAGE_VFAT_BLK_SIZ)) {
+        buf[file->size - 1U - offset] = '\n';
+    }
+}
+
+static int8_t STORAGE_VFAT_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    uint32_t lba;
+
+    UNUSED(lun);
+
+    for (lba = blk_addr; lba < (blk_addr + blk_len); lba++, buf += STORAGE_VFAT_BLK_SIZ) {
+        memset(buf, 0, STORAGE_VFAT_BLK_SIZ);
+
+        if (lba == 0U) {
+            VFAT_BootSector(buf);
+        } else if (lba < VFAT_ROOT_LBA) {
+            VFAT_FatSector((lba - VFAT_FAT_LBA) % VFAT_FAT_SECTORS, buf);
+        } else if (lba == VFAT_ROOT_LBA) {
+            VFAT_RootSector(buf);
+        } else if (lba >= VFAT_DATA_LBA) {
+            VFAT_DataSector(lba, buf);
+        }
+    }
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_VFAT_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    const VFAT_FileTypeDef *file;
+    uint32_t lba;
+    int8_t ret;
+
+    UNUSED(lun);
+
+    // 引导扇区, FAT 和目录都是生成的, 写入直接丢弃
+    for (lba = blk_addr; lba < (blk_addr + blk_len); lba++, buf += STORAGE_VFAT_BLK_SIZ) {
+        if (lba < VFAT_DATA_LBA) {
+            continue;
+        }
+
+        file = VFAT_FindFile(lba - VFAT_DATA_LBA + 2U);
+        if ((file == NULL) || (file->cluster == VFAT_CONFIG_CLUS)) {
+            ret = STORAGE_UF2_Block(buf);
+            if (ret < 0) {
+                return -1;
+            }
+            if (ret > 0) {
+                VFAT_ParseConfig(buf);
+            }
+        }
+    }
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_VFAT_GetMaxLun(void)
+{
+    return 0;
+}
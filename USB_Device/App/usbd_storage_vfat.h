@@ -0,0 +1,40 @@
+/**
+ * @file usbd_storage_vfat.h
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Synthesised FAT12 volume backend for the MSC LUN table: device
+ *        state as plain files, no backing store.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ */
+#ifndef USBD_STORAGE_VFAT_H
+#define USBD_STORAGE_VFAT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "usbd_msc.h"
+
+// 卷大小, 每簇一个扇区, 簇数必须小于 4085 才是 FAT12
+#define STORAGE_VFAT_BLK_NBR   2048U
+#define STORAGE_VFAT_BLK_SIZ   0x200U
+
+// LOG.TXT 的环形缓冲大小, 也是文件大小
+#define STORAGE_VFAT_LOG_SIZE  2048U
+
+extern USBD_StorageTypeDef USBD_Storage_VFAT_fops;
+
+// 追加一行到 LOG.TXT, 只能在主循环里调用
+void STORAGE_VFAT_Log(const char *fmt, ...);
+
+// 主机写入 CONFIG.TXT 时每个 key=value 行调用一次, 返回 0 表示已处理
+int8_t STORAGE_VFAT_ConfigCallback(const char *key, const char *value);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //! USBD_STORAGE_VFAT_H
@@ -0,0 +1,142 @@
+/**
+ * @file usbd_storage_xip.c
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Read-only disk backend over a linker-defined internal flash
+ *        region, sent straight from the flash address.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ */
+#include "usbd_storage_xip.h"
+
+// 弱引用: 链接脚本里没有这个区域时地址为 0
+#if defined(__CC_ARM) || defined(__ARMCC_VERSION)
+extern __WEAK const uint8_t Image$$ER_REFDATA$$Base[];
+extern __WEAK const uint8_t Image$$ER_REFDATA$$Limit[];
+#define XIP_REGION_BASE  ((const uint8_t *)Image$$ER_REFDATA$$Base)
+#define XIP_REGION_LIMIT ((const uint8_t *)Image$$ER_REFDATA$$Limit)
+#else
+extern __WEAK const uint8_t __refdata_start__[];
+extern __WEAK const uint8_t __refdata_end__[];
+#define XIP_REGION_BASE  ((const uint8_t *)__refdata_start__)
+#define XIP_REGION_LIMIT ((const uint8_t *)__refdata_end__)
+#endif
+
+static int8_t STORAGE_XIP_Init(uint8_t lun);
+static int8_t STORAGE_XIP_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size);
+static int8_t STORAGE_XIP_IsReady(uint8_t lun);
+static int8_t STORAGE_XIP_IsWriteProtected(uint8_t lun);
+static int8_t STORAGE_XIP_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_XIP_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_XIP_GetMaxLun(void);
+static uint8_t *STORAGE_XIP_GetReadAddr(uint8_t lun, uint32_t blk_addr, uint16_t blk_len);
+
+static const int8_t STORAGE_XIP_Inquirydata[STANDARD_INQUIRY_DATA_LEN] = {
+    0x00,
+    0x80,
+    0x02,
+    0x02,
+    (STANDARD_INQUIRY_DATA_LEN - 5),
+    0x00,
+    0x00,
+    0x00,
+    'S', 'T', 'M', ' ', ' ', ' ', ' ', ' ', /* Manufacturer : 8 bytes */
+    'R', 'e', 'f', 'e', 'r', 'e', 'n', 'c', /* Product      : 16 Bytes */
+    'e', ' ', 'D', 'a', 't', 'a', ' ', ' ',
+    '0', '.', '0', '1'                      /* Version      : 4 Bytes */
+};
+
+USBD_StorageTypeDef USBD_Storage_XIP_fops = {
+    STORAGE_XIP_Init,
+    STORAGE_XIP_GetCapacity,
+    STORAGE_XIP_IsReady,
+    STORAGE_XIP_IsWriteProtected,
+    STORAGE_XIP_Read,
+    STORAGE_XIP_Write,
+    STORAGE_XIP_GetMaxLun,
+    (int8_t *)STORAGE_XIP_Inquirydata,
+    STORAGE_XIP_GetReadAddr,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
+
+/**
+ * @brief Whole blocks in the linker region, a partial last block is not exposed.
+ */
+static uint32_t XIP_BlockNbr(void)
+{
+    if ((XIP_REGION_BASE == NULL) || (XIP_REGION_LIMIT <= XIP_REGION_BASE)) {
+        return 0U;
+    }
+
+    return (uint32_t)(XIP_REGION_LIMIT - XIP_REGION_BASE) / STORAGE_XIP_BLK_SIZ;
+}
+
+static int8_t STORAGE_XIP_Init(uint8_t lun)
+{
+    UNUSED(lun);
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_XIP_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size)
+{
+    UNUSED(lun);
+    *block_num  = XIP_BlockNbr();
+    *block_size = STORAGE_XIP_BLK_SIZ;
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_XIP_IsReady(uint8_t lun)
+{
+    UNUSED(lun);
+    return (XIP_BlockNbr() != 0U) ? (USBD_OK) : -1;
+}
+
+static int8_t STORAGE_XIP_IsWriteProtected(uint8_t lun)
+{
+    UNUSED(lun);
+    return 1;
+}
+
+static int8_t STORAGE_XIP_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    UNUSED(lun);
+    memcpy(buf, XIP_REGION_BASE + blk_addr * STORAGE_XIP_BLK_SIZ, blk_len * STORAGE_XIP_BLK_SIZ);
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_XIP_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    UNUSED(lun);
+    UNUSED(buf);
+    UNUSED(blk_addr);
+    UNUSED(blk_len);
+    return -1;
+}
+
+static int8_t STORAGE_XIP_GetMaxLun(void)
+{
+    return 0;
+}
+
+/**
+ * @brief Flash address of the blocks, every READ is sent from it without a copy.
+ * @return Pointer into the region, NULL if the range is outside it
+ */
+static uint8_t *STORAGE_XIP_GetReadAddr(uint8_t lun, uint32_t blk_addr, uint16_t blk_len)
+{
+    uint32_t blk_nbr = XIP_BlockNbr();
+
+    UNUSED(lun);
+
+    if ((blk_addr >= blk_nbr) || (blk_len > (blk_nbr - blk_addr))) {
+        return NULL;
+    }
+
+    return (uint8_t *)(XIP_REGION_BASE + blk_addr * STORAGE_XIP_BLK_SIZ);
+}
@@ -0,0 +1,33 @@
+/**
+ * @file usbd_storage_xip.h
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Read-only disk backend over a linker-defined internal flash
+ *        region, sent straight from the flash address.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ */
+#ifndef USBD_STORAGE_XIP_H
+#define USBD_STORAGE_XIP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "usbd_msc.h"
+
+// 区域由链接脚本给出, 放一个现成的 FAT 镜像 (校准表, 手册等):
+//   MDK: 执行域 ER_REFDATA, 用 Image$$ER_REFDATA$$Base / Limit
+//   GCC: 段的起止符号 __refdata_start__ / __refdata_end__
+// 没有这个区域时 LUN 报告无介质
+#define STORAGE_XIP_BLK_SIZ 0x200U
+
+extern USBD_StorageTypeDef USBD_Storage_XIP_fops;
+
+#ifdef __cplusplus
+}
+#endif
+#endif //! USBD_STORAGE_XIP_H
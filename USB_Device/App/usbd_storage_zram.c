@@ -0,0 +1,490 @@
+/**
+ * @file usbd_storage_zram.c
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Compressed RAM disk backend for the MSC LUN table.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ * 每个扇区单独用 LZ 压缩, 结果存进 STORAGE_ZRAM_CHUNK_SIZ 大小的小块链里.
+ * 压缩格式 (类似 LZ4, 只在一个扇区内部引用):
+ *   token: 高 4 位字面量长度, 低 4 位匹配长度 - 4, 值为 15 时后面跟
+ *          255 续接的扩展长度字节
+ *   字面量, 然后 2 字节小端偏移, 然后匹配长度的扩展字节
+ * 解出 512 字节后结束, 所以最后一组只有字面量.
+ * 全零扇区不占存储, 压不下去的扇区原样存储.
+ */
+#include "usbd_storage_zram.h"
+
+#if STORAGE_ZRAM_CHUNK_NBR >= 0xFFFFU
+#error "STORAGE_ZRAM: too many chunks"
+#endif
+
+#define ZRAM_NO_CHUNK  0xFFFFU
+#define ZRAM_MIN_MATCH 4U
+#define ZRAM_CHUNKS(len) (((len) + STORAGE_ZRAM_CHUNK_SIZ - 1U) / STORAGE_ZRAM_CHUNK_SIZ)
+
+typedef struct {
+    uint16_t head; // 第一个小块
+    uint16_t len;  // 压缩后长度, 0 表示全零, STORAGE_ZRAM_BLK_SIZ 表示原样存储
+} ZRAM_SectorTypeDef;
+
+static int8_t STORAGE_ZRAM_Init(uint8_t lun);
+static int8_t STORAGE_ZRAM_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size);
+static int8_t STORAGE_ZRAM_IsReady(uint8_t lun);
+static int8_t STORAGE_ZRAM_IsWriteProtected(uint8_t lun);
+static int8_t STORAGE_ZRAM_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_ZRAM_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_ZRAM_GetMaxLun(void);
+static int8_t STORAGE_ZRAM_Unmap(uint8_t lun, uint32_t blk_addr, uint32_t blk_len);
+
+static const int8_t STORAGE_ZRAM_Inquirydata[STANDARD_INQUIRY_DATA_LEN] = {
+    0x00,
+    0x80,
+    0x02,
+    0x02,
+    (STANDARD_INQUIRY_DATA_LEN - 5),
+    0x00,
+    0x00,
+    0x00,
+    'S', 'T', 'M', ' ', ' ', ' ', ' ', ' ', /* Manufacturer : 8 bytes */
+    'Z', 'R', 'A', 'M', ' ', 'D', 'i', 's', /* Product      : 16 Bytes */
+    'k', ' ', ' ', ' ', ' ', ' ', ' ', ' ',
+    '0', '.', '0', '1'                      /* Version      : 4 Bytes */
+};
+
+static uint8_t zram_pool[STORAGE_ZRAM_CHUNK_NBR][STORAGE_ZRAM_CHUNK_SIZ];
+static uint16_t zram_next[STORAGE_ZRAM_CHUNK_NBR]; // 链中下一个小块, 空闲小块也用它串成栈
+static uint16_t zram_free_head = ZRAM_NO_CHUNK;
+static uint16_t zram_free_nbr  = 0U;
+static ZRAM_SectorTypeDef zram_map[STORAGE_ZRAM_BLK_NBR];
+static uint16_t zram_hash[1U << STORAGE_ZRAM_HASH_BITS]; // 位置 + 1, 0 表示空
+static uint8_t zram_buf[STORAGE_ZRAM_BLK_SIZ];          // 压缩数据的中间缓冲
+static uint8_t zram_ready = 0U;
+
+static STORAGE_ZRAM_StatsTypeDef zram_stats;
+
+USBD_StorageTypeDef USBD_Storage_ZRAM_fops = {
+    STORAGE_ZRAM_Init,
+    STORAGE_ZRAM_GetCapacity,
+    STORAGE_ZRAM_IsReady,
+    STORAGE_ZRAM_IsWriteProtected,
+    STORAGE_ZRAM_Read,
+    STORAGE_ZRAM_Write,
+    STORAGE_ZRAM_GetMaxLun,
+    (int8_t *)STORAGE_ZRAM_Inquirydata,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    STORAGE_ZRAM_Unmap
+};
+
+static int8_t STORAGE_ZRAM_Init(uint8_t lun)
+{
+    uint32_t i;
+
+    UNUSED(lun);
+
+    // 重新枚举时保留盘里的数据
+    if (zram_ready == 0U) {
+        for (i = 0U; i < STORAGE_ZRAM_BLK_NBR; i++) {
+            zram_map[i].head = ZRAM_NO_CHUNK;
+            zram_map[i].len  = 0U;
+        }
+        for (i = 0U; i < STORAGE_ZRAM_CHUNK_NBR; i++) {
+            zram_next[i] = (i + 1U < STORAGE_ZRAM_CHUNK_NBR) ? (uint16_t)(i + 1U) : ZRAM_NO_CHUNK;
+        }
+        zram_free_head = 0U;
+        zram_free_nbr  = STORAGE_ZRAM_CHUNK_NBR;
+        zram_ready     = 1U;
+    }
+
+    // 打开周期计数器, 用于统计编解码开销
+    USBD_CyclesInit();
+
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_ZRAM_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size)
+{
+    UNUSED(lun);
+    *block_num  = STORAGE_ZRAM_BLK_NBR;
+    *block_size = STORAGE_ZRAM_BLK_SIZ;
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_ZRAM_IsReady(uint8_t lun)
+{
+    UNUSED(lun);
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_ZRAM_IsWriteProtected(uint8_t lun)
+{
+    UNUSED(lun);
+    return (USBD_OK);
+}
+
+/**
+ * @brief Check a block for zeros, a word at a time when the buffer allows it.
+ */
+static uint8_t ZRAM_IsZero(const uint8_t *buf)
+{
+    const uint32_t *word = (const uint32_t *)buf;
+    uint32_t i;
+
+    if (((uint32_t)buf & 3U) == 0U) {
+        for (i = 0U; i < (STORAGE_ZRAM_BLK_SIZ / 4U); i++) {
+            if (word[i] != 0U) {
+                return 0U;
+            }
+        }
+    } else {
+        for (i = 0U; i < STORAGE_ZRAM_BLK_SIZ; i++) {
+            if (buf[i] != 0U) {
+                return 0U;
+            }
+        }
+    }
+
+    return 1U;
+}
+
+/**
+ * @brief Append one sequence: token, literals, then offset and match length.
+ * @param match_len 0 for the last sequence, which only carries literals
+ * @return New output length, 0 if it does not fit in cap
+ */
+static uint32_t ZRAM_Emit(uint8_t *dst, uint32_t op, uint32_t cap, const uint8_t *lit,
+                          uint32_t lit_len, uint32_t match_len, uint32_t offset)
+{
+    uint32_t ml = (match_len != 0U) ? (match_len - ZRAM_MIN_MATCH) : 0U;
+    uint32_t tok;
+    uint32_t n;
+
+    // 最坏情况: token + 扩展长度 + 字面量 + 偏移 + 扩展长度
+    if ((op + 1U + (lit_len / 255U + 1U) + lit_len + 2U + (ml / 255U + 1U)) > cap) {
+        return 0U;
+    }
+
+    tok      = op++;
+    dst[tok] = (uint8_t)((MIN(lit_len, 15U) << 4) | MIN(ml, 15U));
+
+    if (lit_len >= 15U) {
+        for (n = lit_len - 15U; n >= 255U; n -= 255U) {
+            dst[op++] = 255U;
+        }
+        dst[op++] = (uint8_t)n;
+    }
+
+    memcpy(&dst[op], lit, lit_len);
+    op += lit_len;
+
+    if (match_len != 0U) {
+        dst[op++] = (uint8_t)offset;
+        dst[op++] = (uint8_t)(offset >> 8);
+
+        if (ml >= 15U) {
+            for (n = ml - 15U; n >= 255U; n -= 255U) {
+                dst[op++] = 255U;
+            }
+            dst[op++] = (uint8_t)n;
+        }
+    }
+
+    return op;
+}
+
+/**
+ * @brief Compress one sector, greedy matching with a single-entry hash table.
+ * @return Compressed length, 0 if it would exceed cap
+ */
+static uint32_t ZRAM_Encode(const uint8_t *src, uint8_t *dst, uint32_t cap)
+{
+    uint32_t ip     = 0U;
+    uint32_t anchor = 0U;
+    uint32_t op     = 0U;
+    uint32_t ref;
+    uint32_t len;
+    uint32_t seq;
+    uint32_t h;
+
+    memset(zram_hash, 0, sizeof(zram_hash));
+
+    while ((ip + ZRAM_MIN_MATCH) <= STORAGE_ZRAM_BLK_SIZ) {
+        seq = (uint32_t)src[ip] | ((uint32_t)src[ip + 1U] << 8) |
+              ((uint32_t)src[ip + 2U] << 16) | ((uint32_t)src[ip + 3U] << 24);
+        h           = (seq * 2654435761U) >> (32U - STORAGE_ZRAM_HASH_BITS);
+        ref         = zram_hash[h];
+        zram_hash[h] = (uint16_t)(ip + 1U);
+
+        if ((ref == 0U) || (memcmp(&src[ref - 1U], &src[ip], ZRAM_MIN_MATCH) != 0)) {
+            ip++;
+            continue;
+        }
+
+        ref--;
+        len = ZRAM_MIN_MATCH;
+        while (((ip + len) < STORAGE_ZRAM_BLK_SIZ) && (src[ref + len] == src[ip + len])) {
+            len++;
+        }
+
+        op = ZRAM_Emit(dst, op, cap, &src[anchor], ip - anchor, len, ip - ref);
+        if (op == 0U) {
+            return 0U;
+        }
+
+        ip += len;
+        anchor = ip;
+    }
+
+    if (anchor < STORAGE_ZRAM_BLK_SIZ) {
+        op = ZRAM_Emit(dst, op, cap, &src[anchor], STORAGE_ZRAM_BLK_SIZ - anchor, 0U, 0U);
+    }
+
+    return op;
+}
+
+/**
+ * @brief Decompress one sector, checking every length against both buffers.
+ * @return 0 on success, -1 if the data is corrupt
+ */
+static int8_t ZRAM_Decode(const uint8_t *src, uint32_t len, uint8_t *dst)
+{
+    uint32_t ip = 0U;
+    uint32_t op = 0U;
+    uint32_t tok;
+    uint32_t off;
+    uint32_t n;
+
+    while (op < STORAGE_ZRAM_BLK_SIZ) {
+        if (ip >= len) {
+            return -1;
+        }
+        tok = src[ip++];
+
+        n = tok >> 4;
+        if (n == 15U) {
+            do {
+                if (ip >= len) {
+                    return -1;
+                }
+                n += src[ip];
+            } while (src[ip++] == 255U);
+        }
+
+        if ((n > (len - ip)) || (n > (STORAGE_ZRAM_BLK_SIZ - op))) {
+            return -1;
+        }
+        memcpy(&dst[op], &src[ip], n);
+        ip += n;
+        op += n;
+
+        if (op == STORAGE_ZRAM_BLK_SIZ) {
+            break;
+        }
+
+        if ((ip + 2U) > len) {
+            return -1;
+        }
+        off = (uint32_t)src[ip] | ((uint32_t)src[ip + 1U] << 8);
+        ip += 2U;
+
+        n = (tok & 15U) + ZRAM_MIN_MATCH;
+        if ((tok & 15U) == 15U) {
+            do {
+                if (ip >= len) {
+                    return -1;
+                }
+                n += src[ip];
+            } while (src[ip++] == 255U);
+        }
+
+        if ((off == 0U) || (off > op) || (n > (STORAGE_ZRAM_BLK_SIZ - op))) {
+            return -1;
+        }
+
+        // 偏移可以小于长度 (重复数据), 只能逐字节复制
+        for (; n > 0U; n--, op++) {
+            dst[op] = dst[op - off];
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Give the chunks of a sector back to the pool, it reads back as zeros.
+ */
+static void ZRAM_Release(uint32_t blk_addr)
+{
+    ZRAM_SectorTypeDef *sec = &zram_map[blk_addr];
+    uint16_t chunk          = sec->head;
+    uint16_t next;
+
+    if (sec->len == 0U) {
+        return;
+    }
+
+    while (chunk != ZRAM_NO_CHUNK) {
+        next             = zram_next[chunk];
+        zram_next[chunk] = zram_free_head;
+        zram_free_head   = chunk;
+        zram_free_nbr++;
+        chunk = next;
+    }
+
+    zram_stats.sectors--;
+    zram_stats.packed_bytes -= sec->len;
+    zram_stats.chunks_used -= ZRAM_CHUNKS(sec->len);
+    if (sec->len == STORAGE_ZRAM_BLK_SIZ) {
+        zram_stats.raw_sectors--;
+    }
+
+    sec->head = ZRAM_NO_CHUNK;
+    sec->len  = 0U;
+}
+
+/**
+ * @brief Copy data into a chain of free chunks, the caller checked that
+ *        enough of them are left.
+ */
+static void ZRAM_Store(uint32_t blk_addr, const uint8_t *src, uint32_t len)
+{
+    ZRAM_SectorTypeDef *sec = &zram_map[blk_addr];
+    uint16_t *link          = &sec->head;
+    uint16_t chunk;
+    uint32_t off;
+
+    for (off = 0U; off < len; off += STORAGE_ZRAM_CHUNK_SIZ) {
+        chunk          = zram_free_head;
+        zram_free_head = zram_next[chunk];
+        zram_free_nbr--;
+
+        memcpy(zram_pool[chunk], &src[off], MIN(len - off, STORAGE_ZRAM_CHUNK_SIZ));
+        *link = chunk;
+        link  = &zram_next[chunk];
+    }
+    *link = ZRAM_NO_CHUNK;
+
+    sec->len = (uint16_t)len;
+    zram_stats.sectors++;
+    zram_stats.packed_bytes += len;
+    zram_stats.chunks_used += ZRAM_CHUNKS(len);
+    if (len == STORAGE_ZRAM_BLK_SIZ) {
+        zram_stats.raw_sectors++;
+    }
+}
+
+/**
+ * @brief Gather the chunks of a sector into a contiguous buffer.
+ */
+static void ZRAM_Gather(uint32_t blk_addr, uint8_t *dst)
+{
+    const ZRAM_SectorTypeDef *sec = &zram_map[blk_addr];
+    uint16_t chunk                = sec->head;
+    uint32_t off;
+
+    for (off = 0U; off < sec->len; off += STORAGE_ZRAM_CHUNK_SIZ) {
+        memcpy(&dst[off], zram_pool[chunk], MIN(sec->len - off, STORAGE_ZRAM_CHUNK_SIZ));
+        chunk = zram_next[chunk];
+    }
+}
+
+static int8_t STORAGE_ZRAM_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    uint32_t start;
+    uint32_t i;
+
+    UNUSED(lun);
+
+    for (i = 0U; i < blk_len; i++, buf += STORAGE_ZRAM_BLK_SIZ) {
+        if (zram_map[blk_addr + i].len == 0U) {
+            memset(buf, 0, STORAGE_ZRAM_BLK_SIZ);
+        } else if (zram_map[blk_addr + i].len == STORAGE_ZRAM_BLK_SIZ) {
+            ZRAM_Gather(blk_addr + i, buf);
+        } else {
+            ZRAM_Gather(blk_addr + i, zram_buf);
+
+            start = USBD_GetCycles();
+            if (ZRAM_Decode(zram_buf, zram_map[blk_addr + i].len, buf) != 0) {
+                return -1;
+            }
+            zram_stats.decode_cycles += USBD_GetCycles() - start;
+            zram_stats.decodes++;
+        }
+    }
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_ZRAM_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    const uint8_t *src;
+    uint32_t start;
+    uint32_t len;
+    uint32_t i;
+
+    UNUSED(lun);
+
+    for (i = 0U; i < blk_len; i++, buf += STORAGE_ZRAM_BLK_SIZ) {
+        if (ZRAM_IsZero(buf) != 0U) {
+            ZRAM_Release(blk_addr + i);
+            zram_stats.zero_writes++;
+            continue;
+        }
+
+        // 压缩后至少要省下一个小块, 否则原样存储
+        start = USBD_GetCycles();
+        len   = ZRAM_Encode(buf, zram_buf, STORAGE_ZRAM_BLK_SIZ - STORAGE_ZRAM_CHUNK_SIZ);
+        zram_stats.encode_cycles += USBD_GetCycles() - start;
+        zram_stats.encodes++;
+
+        src = zram_buf;
+        if (len == 0U) {
+            src = buf;
+            len = STORAGE_ZRAM_BLK_SIZ;
+        }
+
+        // 先确认放得下, 池满时旧数据保持不变
+        if (ZRAM_CHUNKS(len) > (zram_free_nbr + ZRAM_CHUNKS(zram_map[blk_addr + i].len))) {
+            zram_stats.pool_full++;
+            return -1;
+        }
+
+        ZRAM_Release(blk_addr + i);
+        ZRAM_Store(blk_addr + i, src, len);
+    }
+    return (USBD_OK);
+}
+
+static int8_t STORAGE_ZRAM_GetMaxLun(void)
+{
+    return 0;
+}
+
+/**
+ * @brief Free the chunks of the sectors, they read back as zeros.
+ */
+static int8_t STORAGE_ZRAM_Unmap(uint8_t lun, uint32_t blk_addr, uint32_t blk_len)
+{
+    uint32_t i;
+
+    UNUSED(lun);
+
+    for (i = 0U; i < blk_len; i++) {
+        ZRAM_Release(blk_addr + i);
+    }
+
+    return (USBD_OK);
+}
+
+/**
+ * @brief Return the compression ratio and codec cost counters.
+ */
+STORAGE_ZRAM_StatsTypeDef *STORAGE_ZRAM_GetStats(void)
+{
+    return &zram_stats;
+}
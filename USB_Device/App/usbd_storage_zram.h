@@ -0,0 +1,52 @@
+/**
+ * @file usbd_storage_zram.h
+ * @author Liu Yuanlin (liuyuanlins@outlook.com)
+ * @brief Compressed RAM disk backend for the MSC LUN table.
+ * @version 0.1
+ * @date 2026-10-17
+ * @last modified 2026-10-17
+ *
+ * @copyright Copyright (c) 2024 Liu Yuanlin Personal.
+ *
+ */
+#ifndef USBD_STORAGE_ZRAM_H
+#define USBD_STORAGE_ZRAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "usbd_msc.h"
+
+// 对主机报告的容量, 日志和配置文件一般能压到 1/4 以下
+#define STORAGE_ZRAM_BLK_NBR    256U
+#define STORAGE_ZRAM_BLK_SIZ    0x200U
+
+// 压缩后的扇区存在定长小块组成的链里
+#define STORAGE_ZRAM_CHUNK_SIZ  64U
+#define STORAGE_ZRAM_CHUNK_NBR  384U
+
+// LZ 编码器哈希表大小 (2^n 项)
+#define STORAGE_ZRAM_HASH_BITS  8U
+
+typedef struct {
+    uint32_t sectors;       // 占用存储的扇区
+    uint32_t raw_sectors;   // 压不下去, 原样存储的扇区
+    uint32_t packed_bytes;  // 所有扇区压缩后的字节数, 压缩比 = sectors * 512 / packed_bytes
+    uint32_t chunks_used;   // 占用的小块
+    uint32_t zero_writes;   // 全零写入, 没有存储
+    uint32_t pool_full;     // 池满导致失败的写入
+    uint32_t encodes;       // 编码次数
+    uint32_t encode_cycles; // 编码总周期数 (DWT), 单块开销 = encode_cycles / encodes
+    uint32_t decodes;       // 解码次数
+    uint32_t decode_cycles; // 解码总周期数 (DWT)
+} STORAGE_ZRAM_StatsTypeDef;
+
+extern USBD_StorageTypeDef USBD_Storage_ZRAM_fops;
+
+STORAGE_ZRAM_StatsTypeDef *STORAGE_ZRAM_GetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //! USBD_STORAGE_ZRAM_H
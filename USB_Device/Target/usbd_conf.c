@@ -26,6 +26,7 @@
 
 #include "usbd_dfu.h"
 #include "usbd_msc.h"
+#include "usbd_cdc.h"
 
 /* USER CODE BEGIN Includes */
 #include "main.h"
@@ -37,6 +38,18 @@
 
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN PV */
+/* PMA layout: the BTABLE takes 8 bytes per endpoint number in use, the
+   buffers follow it. EP0 and the MSC take 64 bytes per direction, each CDC
+   port two 64-byte data buffers and one for its command endpoint. */
+#define EP_NUM                (2U + (2U * USBD_CDC_PORT_NBR))
+#define PMAADRESS_START       (0x08U * EP_NUM)
+#define PMA_CDC_PORT_SIZE     ((2U * CDC_DATA_FS_MAX_PACKET_SIZE) + CDC_CMD_PACKET_SIZE)
+#define PMA_CDC_ADDRESS(n)    (PMAADRESS_START + (4U * 64U) + ((n) * PMA_CDC_PORT_SIZE))
+#define PMA_SIZE              1024U
+
+#if (PMA_CDC_ADDRESS(USBD_CDC_PORT_NBR) > PMA_SIZE)
+#error "USBD_CDC_PORT_NBR: the endpoint buffers do not fit in the 1 KB PMA"
+#endif
 
 /* USER CODE END PV */
 
@@ -253,6 +266,8 @@ void HAL_PCD_SuspendCallback(PCD_HandleTypeDef *hpcd)
   }
   /* USER CODE END 2 */
   /* USER CODE BEGIN HAL_PCD_SuspendCallback_PostTreatment */
+  /* The host may cut power while suspended: commit cached MSC writes */
+  USBD_MSC_RequestFlush((USBD_HandleTypeDef*)hpcd->pData);
 
   /* USER CODE END HAL_PCD_SuspendCallback_PostTreatment */
 }
@@ -432,8 +447,6 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
   /* USER CODE END RegisterCallBackSecondPart */
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
   /* USER CODE BEGIN EndPoint_Configuration */
-  #define EP_NUM 3
-  #define PMAADRESS_START (0x08 * EP_NUM)
   HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x00 , PCD_SNG_BUF, PMAADRESS_START+64*0);
   HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x80 , PCD_SNG_BUF, PMAADRESS_START+64*1);
   /* USER CODE END EndPoint_Configuration */
@@ -442,9 +455,12 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
   HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x01 , PCD_SNG_BUF, PMAADRESS_START+64*3);
   /* USER CODE END EndPoint_Configuration_MSC */
   /* USER CODE BEGIN EndPoint_Configuration_CDC */
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x82 , PCD_SNG_BUF, PMAADRESS_START+64*4);
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x02 , PCD_SNG_BUF, PMAADRESS_START+64*5);
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x83 , PCD_SNG_BUF, PMAADRESS_START+64*6);
+  for (uint8_t port = 0U; port < USBD_CDC_PORT_NBR; port++)
+  {
+    HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , CDC_IN_EP_PORT(port) , PCD_SNG_BUF, PMA_CDC_ADDRESS(port));
+    HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , CDC_OUT_EP_PORT(port) , PCD_SNG_BUF, PMA_CDC_ADDRESS(port)+64);
+    HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , CDC_CMD_EP_PORT(port) , PCD_SNG_BUF, PMA_CDC_ADDRESS(port)+128);
+  }
   /* USER CODE END EndPoint_Configuration_CDC */
   return USBD_OK;
 }
@@ -65,7 +65,9 @@
   */
 
 /*---------- -----------*/
-#define USBD_MAX_NUM_INTERFACES     3U
+#define USBD_CDC_PORT_NBR     2U
+/*---------- -----------*/
+#define USBD_MAX_NUM_INTERFACES     (1U + 2U * USBD_CDC_PORT_NBR)
 /*---------- -----------*/
 #define USBD_MAX_NUM_CONFIGURATION     1U
 /*---------- -----------*/
@@ -81,11 +83,23 @@
 /*---------- -----------*/
 #define MSC_MEDIA_PACKET     512U
 /*---------- -----------*/
+#define MSC_MAX_LUN     8U
+/*---------- -----------*/
+#define MSC_CACHE_BLK_NBR     8U
+/*---------- -----------*/
+#define MSC_CACHE_LUN_MASK     0x06U
+/*---------- -----------*/
+#define MSC_CACHE_IDLE_MS     500U
+/*---------- -----------*/
+#define MSC_RA_BLK_NBR     8U
+/*---------- -----------*/
+#define MSC_RA_LUN_MASK     0xCFU
+/*---------- -----------*/
 #define USBD_DFU_MAX_ITF_NUM     1U
 /*---------- -----------*/
 #define USBD_DFU_XFER_SIZE     1024U
 /*---------- -----------*/
-#define USBD_DFU_APP_DEFAULT_ADD     0x08000000U
+#define USBD_DFU_APP_DEFAULT_ADD     0x08010000U
 
 /****************************************/
 /* #define for FS and HS identification */
@@ -117,6 +131,22 @@
 /** Alias for delay. */
 #define USBD_Delay          HAL_Delay
 
+/** Alias for millisecond tick. */
+#define USBD_GetTick        HAL_GetTick
+
+/** CPU cycle counter, used by the MSC command profile. */
+#define USBD_GetCycles()    (DWT->CYCCNT)
+
+/** Start the cycle counter. */
+#define USBD_CyclesInit()   do { CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; \
+                                 DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; } while (0)
+
+/** Mask the USB interrupt while thread-mode code touches class state. */
+#define USBD_ENTER_CRITICAL()   HAL_NVIC_DisableIRQ(USB_LP_IRQn)
+
+/** Unmask the USB interrupt. */
+#define USBD_EXIT_CRITICAL()    HAL_NVIC_EnableIRQ(USB_LP_IRQn)
+
 /* DEBUG macros */
 
 #if (USBD_DEBUG_LEVEL > 0)